@@ -5,6 +5,8 @@
 
 #define USE_CORTEX			// build a MotionServer module for connecting to Cortex MoCap systems
 
+// #define USE_CORTEX_STUB	// replace the Cortex SDK by a stand-in that replays capture files (no SDK library needed)
+
  #define USE_KINECT		// build a MotionServer module that uses the Kinect
 
 // #define USE_PIECEMETA	// build a MotionServer module that reads data from the PieceMeta website
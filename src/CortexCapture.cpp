@@ -0,0 +1,592 @@
+#include "CortexCapture.h"
+#include "Portability.h"
+
+#ifdef USE_CORTEX
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "CortexCapture"
+
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <string.h>
+
+
+// file header: identifier and version
+static const char CAPTURE_MAGIC[8] = { 'C', 'X', 'C', 'A', 'P', 'T', '0', '1' };
+
+// upper limit for counts read from a file to detect corrupt data
+#define MAX_CAPTURE_COUNT 100000
+
+// frames the recorder queues before dropping frames (a few seconds at typical rates)
+#define MAX_CAPTURE_QUEUE_FRAMES 1000
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CortexBodyDefs class
+//
+
+CortexBodyDefs::CortexBodyDefs()
+{
+	memset(&defs, 0, sizeof(defs));
+}
+
+
+void CortexBodyDefs::copyFrom(const sBodyDefs& refSource)
+{
+	clear();
+	defs.nBodyDefs = std::min(refSource.nBodyDefs, MAX_N_BODIES);
+	for (int bIdx = 0; bIdx < defs.nBodyDefs; bIdx++)
+	{
+		const sBodyDef& refSourceDef = refSource.BodyDefs[bIdx];
+		sBodyDef&       refDef       = defs.BodyDefs[bIdx];
+
+		refDef.szName   = addString(refSourceDef.szName);
+		refDef.nMarkers = refSourceDef.nMarkers;
+		refDef.szMarkerNames = addStringArray(refSourceDef.nMarkers);
+		for (int mIdx = 0; mIdx < refSourceDef.nMarkers; mIdx++)
+		{
+			refDef.szMarkerNames[mIdx] = addString(refSourceDef.szMarkerNames[mIdx]);
+		}
+
+		const sHierarchy& refSourceHierarchy = refSourceDef.Hierarchy;
+		sHierarchy&       refHierarchy       = refDef.Hierarchy;
+		refHierarchy.nSegments      = refSourceHierarchy.nSegments;
+		refHierarchy.szSegmentNames = addStringArray(refSourceHierarchy.nSegments);
+		refHierarchy.iParents       = addIntArray(refSourceHierarchy.nSegments);
+		for (int sIdx = 0; sIdx < refSourceHierarchy.nSegments; sIdx++)
+		{
+			refHierarchy.szSegmentNames[sIdx] = addString(refSourceHierarchy.szSegmentNames[sIdx]);
+			refHierarchy.iParents[sIdx]       = refSourceHierarchy.iParents[sIdx];
+		}
+	}
+}
+
+
+sBodyDefs& CortexBodyDefs::get()
+{
+	return defs;
+}
+
+
+void CortexBodyDefs::clear()
+{
+	memset(&defs, 0, sizeof(defs));
+	arrStrings.clear();
+	arrStringArrays.clear();
+	arrIntArrays.clear();
+}
+
+
+char* CortexBodyDefs::addString(const std::string& strValue)
+{
+	arrStrings.push_back(strValue);
+	return &(arrStrings.back()[0]);
+}
+
+
+char** CortexBodyDefs::addStringArray(size_t count)
+{
+	arrStringArrays.push_back(std::vector<char*>(std::max<size_t>(count, 1), NULL));
+	return arrStringArrays.back().data();
+}
+
+
+int* CortexBodyDefs::addIntArray(size_t count)
+{
+	arrIntArrays.push_back(std::vector<int>(std::max<size_t>(count, 1), 0));
+	return arrIntArrays.back().data();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CortexFrame class
+//
+
+CortexFrame::CortexFrame()
+{
+	memset(&frame, 0, sizeof(frame));
+}
+
+
+void CortexFrame::copyFrom(const sFrameOfData& refSource)
+{
+	clear();
+	frame.iFrame  = refSource.iFrame;
+	frame.fDelay  = refSource.fDelay;
+	frame.nBodies = std::min(refSource.nBodies, MAX_N_BODIES);
+
+	for (int bIdx = 0; bIdx < frame.nBodies; bIdx++)
+	{
+		const sBodyData& refSourceBody = refSource.BodyData[bIdx];
+		sBodyData&       refBody       = frame.BodyData[bIdx];
+		strncpy_s(refBody.szName, refSourceBody.szName, sizeof(refBody.szName));
+		setBodyArrays(refBody, refSourceBody.nMarkers, refSourceBody.nSegments);
+		memcpy(refBody.Markers,  refSourceBody.Markers,  refSourceBody.nMarkers  * sizeof(tMarkerData));
+		memcpy(refBody.Segments, refSourceBody.Segments, refSourceBody.nSegments * sizeof(tSegmentData));
+	}
+
+	setUnidentifiedMarkerArray(refSource.nUnidentifiedMarkers);
+	memcpy(frame.UnidentifiedMarkers, refSource.UnidentifiedMarkers, refSource.nUnidentifiedMarkers * sizeof(tMarkerData));
+}
+
+
+sFrameOfData& CortexFrame::get()
+{
+	return frame;
+}
+
+
+void CortexFrame::clear()
+{
+	// keep buffers for the next frame
+	frame.nBodies = 0;
+	frame.nUnidentifiedMarkers = 0;
+}
+
+
+void CortexFrame::setBodyArrays(sBodyData& refBody, int nMarkers, int nSegments)
+{
+	size_t bIdx = &refBody - frame.BodyData;
+	if (arrMarkerBuffers.size() <= bIdx)
+	{
+		arrMarkerBuffers.resize(bIdx + 1);
+		arrSegmentBuffers.resize(bIdx + 1);
+	}
+
+	std::vector<float>& refMarkers = arrMarkerBuffers[bIdx];
+	refMarkers.resize(std::max(nMarkers, 1) * 3);
+	refBody.nMarkers = nMarkers;
+	refBody.Markers  = (tMarkerData*) refMarkers.data();
+
+	std::vector<double>& refSegments = arrSegmentBuffers[bIdx];
+	refSegments.resize(std::max(nSegments, 1) * 7);
+	refBody.nSegments = nSegments;
+	refBody.Segments  = (tSegmentData*) refSegments.data();
+}
+
+
+void CortexFrame::setUnidentifiedMarkerArray(int nMarkers)
+{
+	unidentifiedMarkers.resize(std::max(nMarkers, 1) * 3);
+	frame.nUnidentifiedMarkers = nMarkers;
+	frame.UnidentifiedMarkers  = (tMarkerData*) unidentifiedMarkers.data();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CortexCaptureWriter class
+//
+
+bool CortexCaptureWriter::open(const std::string& strFilename, float frameRate, float unitsToMillimeters)
+{
+	close();
+	file.open(strFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (file.is_open())
+	{
+		file.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+		write(frameRate);
+		write(unitsToMillimeters);
+		LOG_INFO("Capture file '" << strFilename << "' opened");
+	}
+	else
+	{
+		LOG_ERROR("Could not open capture file '" << strFilename << "'");
+	}
+	return isOpen();
+}
+
+
+bool CortexCaptureWriter::isOpen() const
+{
+	return file.is_open();
+}
+
+
+void CortexCaptureWriter::writeBodyDefs(const sBodyDefs& refBodyDefs)
+{
+	if (!isOpen()) return;
+
+	write((int) CAPTURE_BODYDEFS);
+	write(refBodyDefs.nBodyDefs);
+	for (int bIdx = 0; bIdx < refBodyDefs.nBodyDefs; bIdx++)
+	{
+		const sBodyDef& refDef = refBodyDefs.BodyDefs[bIdx];
+		writeString(refDef.szName);
+		write(refDef.nMarkers);
+		for (int mIdx = 0; mIdx < refDef.nMarkers; mIdx++)
+		{
+			writeString(refDef.szMarkerNames[mIdx]);
+		}
+		write(refDef.Hierarchy.nSegments);
+		for (int sIdx = 0; sIdx < refDef.Hierarchy.nSegments; sIdx++)
+		{
+			writeString(refDef.Hierarchy.szSegmentNames[sIdx]);
+			write(refDef.Hierarchy.iParents[sIdx]);
+		}
+	}
+}
+
+
+void CortexCaptureWriter::writeFrame(const sFrameOfData& refFrame)
+{
+	if (!isOpen()) return;
+
+	write((int) CAPTURE_FRAME);
+	write(refFrame.iFrame);
+	write(refFrame.fDelay);
+	write(refFrame.nBodies);
+	for (int bIdx = 0; bIdx < refFrame.nBodies; bIdx++)
+	{
+		const sBodyData& refBody = refFrame.BodyData[bIdx];
+		write(refBody.nMarkers);
+		file.write((const char*) refBody.Markers, refBody.nMarkers * sizeof(tMarkerData));
+		write(refBody.nSegments);
+		file.write((const char*) refBody.Segments, refBody.nSegments * sizeof(tSegmentData));
+	}
+	write(refFrame.nUnidentifiedMarkers);
+	file.write((const char*) refFrame.UnidentifiedMarkers, refFrame.nUnidentifiedMarkers * sizeof(tMarkerData));
+}
+
+
+void CortexCaptureWriter::close()
+{
+	if (file.is_open())
+	{
+		write((int) CAPTURE_END);
+		file.close();
+		LOG_INFO("Capture file closed");
+	}
+}
+
+
+void CortexCaptureWriter::writeString(const char* czString)
+{
+	int length = (czString != NULL) ? (int) strlen(czString) : 0;
+	write(length);
+	file.write(czString, length);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CortexCaptureRecorder class
+//
+
+CortexCaptureRecorder::CortexCaptureRecorder() :
+	framesAllocated(0),
+	running(false),
+	framesWritten(0),
+	framesDropped(0)
+{
+	// nothing else to do
+}
+
+
+CortexCaptureRecorder::~CortexCaptureRecorder()
+{
+	stop();
+}
+
+
+bool CortexCaptureRecorder::start(const std::string& strFilename, float frameRate, float unitsToMillimeters, const sBodyDefs& refBodyDefs)
+{
+	stop();
+	if (writer.open(strFilename, frameRate, unitsToMillimeters))
+	{
+		writer.writeBodyDefs(refBodyDefs);
+		running = true;
+		thread  = std::thread(&CortexCaptureRecorder::writerThread, this);
+	}
+	return running;
+}
+
+
+void CortexCaptureRecorder::addBodyDefs(const sBodyDefs& refBodyDefs)
+{
+	sRecord record;
+	record.pBodyDefs.reset(new CortexBodyDefs());
+	record.pBodyDefs->copyFrom(refBodyDefs);
+	{
+		std::lock_guard<std::mutex> lock(mtxQueue);
+		if (!running) return;
+		queue.push_back(std::move(record));
+	}
+	cvQueue.notify_one();
+}
+
+
+bool CortexCaptureRecorder::addFrame(const sFrameOfData& refFrame)
+{
+	sRecord record;
+	{
+		std::lock_guard<std::mutex> lock(mtxQueue);
+		if (!running) return false;
+		if (!arrFramePool.empty())
+		{
+			record.pFrame = std::move(arrFramePool.back());
+			arrFramePool.pop_back();
+		}
+		else if (framesAllocated < MAX_CAPTURE_QUEUE_FRAMES)
+		{
+			framesAllocated++;
+		}
+		else
+		{
+			// writer can't keep up with the file
+			framesDropped++;
+			return false;
+		}
+	}
+
+	// copy without holding the lock
+	if (!record.pFrame)
+	{
+		record.pFrame.reset(new CortexFrame());
+	}
+	record.pFrame->copyFrom(refFrame);
+
+	{
+		std::lock_guard<std::mutex> lock(mtxQueue);
+		queue.push_back(std::move(record));
+	}
+	cvQueue.notify_one();
+	return true;
+}
+
+
+void CortexCaptureRecorder::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtxQueue);
+		running = false;
+	}
+	cvQueue.notify_one();
+
+	if (thread.joinable())
+	{
+		thread.join();
+		LOG_INFO("Frames captured: " << framesWritten << " (dropped: " << framesDropped << ")");
+	}
+	writer.close();
+}
+
+
+void CortexCaptureRecorder::writerThread()
+{
+	TraceRecorder::setThreadName("Cortex capture");
+
+	std::unique_lock<std::mutex> lock(mtxQueue);
+	while (true)
+	{
+		cvQueue.wait(lock, [this] { return !running || !queue.empty(); });
+		if (queue.empty()) break; // stopped and everything is written
+
+		sRecord record = std::move(queue.front());
+		queue.pop_front();
+
+		// write without holding the lock
+		lock.unlock();
+		if (record.pBodyDefs)
+		{
+			writer.writeBodyDefs(record.pBodyDefs->get());
+		}
+		if (record.pFrame)
+		{
+			TRACE_SCOPE("write capture frame");
+			writer.writeFrame(record.pFrame->get());
+		}
+		lock.lock();
+
+		if (record.pFrame)
+		{
+			framesWritten++;
+			arrFramePool.push_back(std::move(record.pFrame));
+		}
+	}
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// CortexCaptureReader class
+//
+
+bool CortexCaptureReader::open(const std::string& strFilename)
+{
+	close();
+	file.open(strFilename, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Could not open capture file '" << strFilename << "'");
+		return false;
+	}
+
+	char magic[sizeof(CAPTURE_MAGIC)];
+	file.read(magic, sizeof(magic));
+	if (!file.good() || (memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0) || !read(frameRate) || !read(unitsToMillimeters))
+	{
+		LOG_ERROR("'" << strFilename << "' is not a Cortex capture file");
+		file.close();
+		return false;
+	}
+
+	firstRecord = file.tellg();
+	LOG_INFO("Capture file '" << strFilename << "' opened (" << frameRate << "Hz)");
+	return true;
+}
+
+
+float CortexCaptureReader::getFrameRate() const
+{
+	return frameRate;
+}
+
+
+float CortexCaptureReader::getUnitsToMillimeters() const
+{
+	return unitsToMillimeters;
+}
+
+
+int CortexCaptureReader::readRecord(CortexBodyDefs& refBodyDefs, CortexFrame& refFrame)
+{
+	int type = CAPTURE_END;
+	if (!file.is_open() || !read(type)) return CAPTURE_END;
+
+	switch (type)
+	{
+		case CAPTURE_BODYDEFS:
+			if (!readBodyDefs(refBodyDefs)) type = CAPTURE_END;
+			break;
+
+		case CAPTURE_FRAME:
+			if (!readFrame(refFrame)) type = CAPTURE_END;
+			break;
+
+		default:
+			type = CAPTURE_END;
+			break;
+	}
+	return type;
+}
+
+
+void CortexCaptureReader::rewind()
+{
+	if (file.is_open())
+	{
+		file.clear();
+		file.seekg(firstRecord);
+	}
+}
+
+
+void CortexCaptureReader::close()
+{
+	if (file.is_open())
+	{
+		file.close();
+	}
+}
+
+
+bool CortexCaptureReader::readString(std::string& strValue)
+{
+	int length = 0;
+	if (!read(length) || (length < 0) || (length > MAX_CAPTURE_COUNT)) return false;
+	strValue.resize(length);
+	if (length > 0)
+	{
+		file.read(&strValue[0], length);
+	}
+	return file.good();
+}
+
+
+bool CortexCaptureReader::readBodyDefs(CortexBodyDefs& refBodyDefs)
+{
+	refBodyDefs.clear();
+	sBodyDefs& refDefs = refBodyDefs.get();
+
+	int nBodies = 0;
+	if (!read(nBodies) || (nBodies < 0) || (nBodies > MAX_N_BODIES)) return false;
+
+	std::string strValue;
+	for (int bIdx = 0; bIdx < nBodies; bIdx++)
+	{
+		sBodyDef& refDef = refDefs.BodyDefs[bIdx];
+		if (!readString(strValue)) return false;
+		refDef.szName = refBodyDefs.addString(strValue);
+
+		int nMarkers = 0;
+		if (!read(nMarkers) || (nMarkers < 0) || (nMarkers > MAX_CAPTURE_COUNT)) return false;
+		refDef.nMarkers      = nMarkers;
+		refDef.szMarkerNames = refBodyDefs.addStringArray(nMarkers);
+		for (int mIdx = 0; mIdx < nMarkers; mIdx++)
+		{
+			if (!readString(strValue)) return false;
+			refDef.szMarkerNames[mIdx] = refBodyDefs.addString(strValue);
+		}
+
+		int nSegments = 0;
+		if (!read(nSegments) || (nSegments < 0) || (nSegments > MAX_CAPTURE_COUNT)) return false;
+		sHierarchy& refHierarchy = refDef.Hierarchy;
+		refHierarchy.nSegments      = nSegments;
+		refHierarchy.szSegmentNames = refBodyDefs.addStringArray(nSegments);
+		refHierarchy.iParents       = refBodyDefs.addIntArray(nSegments);
+		for (int sIdx = 0; sIdx < nSegments; sIdx++)
+		{
+			if (!readString(strValue) || !read(refHierarchy.iParents[sIdx])) return false;
+			refHierarchy.szSegmentNames[sIdx] = refBodyDefs.addString(strValue);
+		}
+		refDefs.nBodyDefs = bIdx + 1;
+	}
+	return true;
+}
+
+
+bool CortexCaptureReader::readFrame(CortexFrame& refFrame)
+{
+	refFrame.clear();
+	sFrameOfData& refData = refFrame.get();
+
+	int nBodies = 0;
+	if (!read(refData.iFrame) || !read(refData.fDelay) || !read(nBodies) || (nBodies < 0) || (nBodies > MAX_N_BODIES)) return false;
+
+	for (int bIdx = 0; bIdx < nBodies; bIdx++)
+	{
+		sBodyData& refBody = refData.BodyData[bIdx];
+		int nMarkers  = 0;
+		int nSegments = 0;
+
+		if (!read(nMarkers) || (nMarkers < 0) || (nMarkers > MAX_CAPTURE_COUNT)) return false;
+		refFrame.setBodyArrays(refBody, nMarkers, 0);
+		file.read((char*) refBody.Markers, nMarkers * sizeof(tMarkerData));
+
+		if (!read(nSegments) || (nSegments < 0) || (nSegments > MAX_CAPTURE_COUNT)) return false;
+		refFrame.setBodyArrays(refBody, nMarkers, nSegments);
+		file.read((char*) refBody.Segments, nSegments * sizeof(tSegmentData));
+		if (!file.good()) return false;
+
+		refData.nBodies = bIdx + 1;
+	}
+
+	int nMarkers = 0;
+	if (!read(nMarkers) || (nMarkers < 0) || (nMarkers > MAX_CAPTURE_COUNT)) return false;
+	refFrame.setUnidentifiedMarkerArray(nMarkers);
+	file.read((char*) refData.UnidentifiedMarkers, nMarkers * sizeof(tMarkerData));
+
+	return file.good();
+}
+
+#endif // #ifdef USE_CORTEX
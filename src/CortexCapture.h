@@ -0,0 +1,301 @@
+/**
+ * Classes for recording Cortex body definitions and frames into a capture file
+ * and for reading them back, e.g., for replaying them through the Cortex stand-in (see USE_CORTEX_STUB).
+ */
+
+#pragma once
+
+#include "Config.h"
+
+#ifdef USE_CORTEX
+
+#include "Cortex.h"
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// record types in a capture file
+#define CAPTURE_END      0
+#define CAPTURE_BODYDEFS 1
+#define CAPTURE_FRAME    2
+
+
+/**
+ * Cortex body definitions that own all the data their pointers refer to.
+ */
+class CortexBodyDefs
+{
+public:
+	CortexBodyDefs();
+
+	/**
+	 * Replaces the body definitions by a deep copy of another set of definitions.
+	 *
+	 * @param refSource  the body definitions to copy
+	 */
+	void copyFrom(const sBodyDefs& refSource);
+
+	/**
+	 * Gets the Cortex structure.
+	 *
+	 * @return the body definitions
+	 */
+	sBodyDefs& get();
+
+private:
+
+	friend class CortexCaptureReader;
+
+	void   clear();
+	char*  addString(const std::string& strValue);
+	char** addStringArray(size_t count);
+	int*   addIntArray(size_t count);
+
+private:
+
+	sBodyDefs                       defs;
+	std::deque<std::string>         arrStrings;      // deque: elements don't move when growing
+	std::deque<std::vector<char*>>  arrStringArrays;
+	std::deque<std::vector<int>>    arrIntArrays;
+};
+
+
+/**
+ * Cortex frame that owns all the data its pointers refer to.
+ * Analog data is not copied.
+ */
+class CortexFrame
+{
+public:
+	CortexFrame();
+
+	/**
+	 * Replaces the frame by a deep copy of another frame.
+	 *
+	 * @param refSource  the frame to copy
+	 */
+	void copyFrom(const sFrameOfData& refSource);
+
+	/**
+	 * Gets the Cortex structure.
+	 *
+	 * @return the frame
+	 */
+	sFrameOfData& get();
+
+private:
+
+	friend class CortexCaptureReader;
+
+	void clear();
+	void setBodyArrays(sBodyData& refBody, int nMarkers, int nSegments);
+	void setUnidentifiedMarkerArray(int nMarkers);
+
+private:
+
+	sFrameOfData                      frame;
+	std::vector<std::vector<float>>   arrMarkerBuffers;   // per body, reused between frames
+	std::vector<std::vector<double>>  arrSegmentBuffers;  // per body, reused between frames
+	std::vector<float>                unidentifiedMarkers;
+};
+
+
+/**
+ * Class for writing Cortex data into a binary capture file.
+ */
+class CortexCaptureWriter
+{
+public:
+
+	/**
+	 * Opens a capture file for writing.
+	 *
+	 * @param strFilename         the name of the file
+	 * @param frameRate           the frame rate of the captured data
+	 * @param unitsToMillimeters  the conversion factor from Cortex units to millimeters
+	 *
+	 * @return <code>true</code> if the file was opened
+	 */
+	bool open(const std::string& strFilename, float frameRate, float unitsToMillimeters);
+
+	/**
+	 * Checks if the capture file is open.
+	 *
+	 * @return <code>true</code> if the file is open
+	 */
+	bool isOpen() const;
+
+	void writeBodyDefs(const sBodyDefs& refBodyDefs);
+	void writeFrame(const sFrameOfData& refFrame);
+
+	/**
+	 * Closes the capture file.
+	 */
+	void close();
+
+private:
+
+	template<typename T> void write(const T& value)
+	{
+		file.write((const char*) &value, sizeof(value));
+	}
+
+	void writeString(const char* czString);
+
+private:
+
+	std::ofstream file;
+};
+
+
+/**
+ * Class for recording Cortex data into a capture file on a separate thread,
+ * so that the Cortex callback never waits for the file.
+ * Frames are copied into a bounded queue, frames that don't fit are dropped and counted.
+ */
+class CortexCaptureRecorder
+{
+public:
+	CortexCaptureRecorder();
+	~CortexCaptureRecorder();
+
+	/**
+	 * Opens a capture file, writes the initial body definitions, and starts the writer thread.
+	 *
+	 * @param strFilename         the name of the file
+	 * @param frameRate           the frame rate of the captured data
+	 * @param unitsToMillimeters  the conversion factor from Cortex units to millimeters
+	 * @param refBodyDefs         the body definitions the recording starts with
+	 *
+	 * @return <code>true</code> if the recording was started
+	 */
+	bool start(const std::string& strFilename, float frameRate, float unitsToMillimeters, const sBodyDefs& refBodyDefs);
+
+	/**
+	 * Queues a copy of changed body definitions for writing.
+	 *
+	 * @param refBodyDefs  the body definitions
+	 */
+	void addBodyDefs(const sBodyDefs& refBodyDefs);
+
+	/**
+	 * Queues a copy of a frame for writing without waiting for the file.
+	 *
+	 * @param refFrame  the frame
+	 *
+	 * @return <code>false</code> if the queue is full and the frame was dropped
+	 */
+	bool addFrame(const sFrameOfData& refFrame);
+
+	/**
+	 * Writes the queued data, stops the writer thread, and closes the capture file.
+	 */
+	void stop();
+
+private:
+
+	/**
+	 * Body definitions or a frame to write.
+	 */
+	struct sRecord
+	{
+		std::unique_ptr<CortexBodyDefs> pBodyDefs;
+		std::unique_ptr<CortexFrame>    pFrame;
+	};
+
+	void writerThread();
+
+private:
+
+	CortexCaptureWriter                        writer;
+	std::thread                                thread;
+	std::mutex                                 mtxQueue;
+	std::condition_variable                    cvQueue;
+	std::deque<sRecord>                        queue;
+	std::vector<std::unique_ptr<CortexFrame>>  arrFramePool;    // written frames, reused for copying
+	size_t                                     framesAllocated; // limits the frames in the queue
+	bool                                       running;
+	uint64_t                                   framesWritten;
+	uint64_t                                   framesDropped;
+};
+
+
+/**
+ * Class for reading Cortex data from a binary capture file.
+ */
+class CortexCaptureReader
+{
+public:
+
+	/**
+	 * Opens a capture file for reading.
+	 *
+	 * @param strFilename  the name of the file
+	 *
+	 * @return <code>true</code> if the file was opened and has the correct format
+	 */
+	bool open(const std::string& strFilename);
+
+	/**
+	 * Gets the frame rate of the captured data.
+	 *
+	 * @return the frame rate in Hz
+	 */
+	float getFrameRate() const;
+
+	/**
+	 * Gets the conversion factor of the captured data from Cortex units to millimeters.
+	 *
+	 * @return the conversion factor
+	 */
+	float getUnitsToMillimeters() const;
+
+	/**
+	 * Reads the next record from the file.
+	 *
+	 * @param refBodyDefs  the body definitions to fill in if the record contains definitions
+	 * @param refFrame     the frame to fill in if the record contains a frame
+	 *
+	 * @return the record type (CAPTURE_BODYDEFS, CAPTURE_FRAME, or CAPTURE_END at the end of the file or on errors)
+	 */
+	int readRecord(CortexBodyDefs& refBodyDefs, CortexFrame& refFrame);
+
+	/**
+	 * Jumps back to the first record.
+	 */
+	void rewind();
+
+	/**
+	 * Closes the capture file.
+	 */
+	void close();
+
+private:
+
+	template<typename T> bool read(T& value)
+	{
+		file.read((char*) &value, sizeof(value));
+		return file.good();
+	}
+
+	bool readString(std::string& strValue);
+	bool readBodyDefs(CortexBodyDefs& refBodyDefs);
+	bool readFrame(CortexFrame& refFrame);
+
+private:
+
+	std::ifstream  file;
+	std::streampos firstRecord;
+	float          frameRate;
+	float          unitsToMillimeters;
+};
+
+#endif // #ifdef USE_CORTEX
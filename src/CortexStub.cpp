@@ -0,0 +1,277 @@
+/**
+ * Stand-in for the Cortex SDK that replays a capture file instead of connecting to a Cortex host.
+ * This allows running and profiling the Cortex conversion code without the SDK library or a live system.
+ *
+ * The capture file name is passed instead of the Cortex host address (-cortexRemoteAddr <filename>).
+ * Capture files are recorded from a live system with the Cortex "record <filename>" command.
+ * The stand-in builds on Linux as well, e.g., for the replay test in test/.
+ */
+
+#include "Config.h"
+
+#if defined(USE_CORTEX) && defined(USE_CORTEX_STUB)
+
+#include "CortexCapture.h"
+#include "Portability.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "CortexStub"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+// state of the replay
+static std::mutex          mtxStub;
+static CortexCaptureReader captureReader;
+static CortexBodyDefs      currentBodyDefs;
+static CortexFrame         currentFrame;
+static bool                hasFrame = false;
+static float               frameRate = 100.0f;
+static float               unitsToMillimeters = 1.0f;
+static std::thread             replayThread;
+static std::condition_variable cvReplay;   // wakes up the replay thread when it is stopped
+static std::atomic<bool>       replayRunning(false);
+static std::atomic<bool>       replayPaused(false);
+
+// handlers are set from the main thread while the replay thread calls them
+static std::atomic<void (*)(sFrameOfData*)> pDataHandler(NULL);
+static std::atomic<void (*)(int, char*)>    pMessageHandler(NULL);
+
+// structures handed out to the caller, released through Cortex_FreeBodyDefs/Cortex_FreeFrame
+static std::map<sBodyDefs*,    std::unique_ptr<CortexBodyDefs>> mapBodyDefs;
+static std::map<sFrameOfData*, std::unique_ptr<CortexFrame>>    mapFrames;
+
+
+/**
+ * Reads the capture file and calls the data handler at the recorded frame rate.
+ * The file is looped.
+ */
+static void replayCapture()
+{
+	CortexBodyDefs bodyDefs;
+	CortexFrame    frame;
+	bool           hasFrames = false;
+
+	std::chrono::steady_clock::time_point nextTick = std::chrono::steady_clock::now();
+	while (replayRunning)
+	{
+		int record;
+		{
+			std::lock_guard<std::mutex> lock(mtxStub);
+			record = captureReader.readRecord(bodyDefs, frame);
+			if (record == CAPTURE_BODYDEFS)
+			{
+				currentBodyDefs.copyFrom(bodyDefs.get());
+			}
+			else if (record == CAPTURE_FRAME)
+			{
+				currentFrame.copyFrom(frame.get());
+				hasFrame  = true;
+				hasFrames = true;
+			}
+			else if (hasFrames)
+			{
+				// end of file > loop
+				captureReader.rewind();
+			}
+		}
+
+		if (record == CAPTURE_END && !hasFrames)
+		{
+			LOG_ERROR("Capture file contains no frames");
+			break;
+		}
+
+		if (record == CAPTURE_FRAME)
+		{
+			// the handler is called without the lock, like the SDK does from its own thread
+			void (*pHandler)(sFrameOfData*) = pDataHandler;
+			if (pHandler && replayRunning && !replayPaused)
+			{
+				pHandler(&frame.get());
+			}
+
+			// wait for the next frame, unless Cortex_Exit() stops the replay
+			nextTick += std::chrono::microseconds((long long) (1000000.0f / frameRate));
+			std::unique_lock<std::mutex> lock(mtxStub);
+			cvReplay.wait_until(lock, nextTick, [] { return !replayRunning; });
+		}
+	}
+}
+
+
+int Cortex_GetSdkVersion(unsigned char Version[4])
+{
+	Version[0] = 0;
+	Version[1] = 0;
+	Version[2] = 0;
+	Version[3] = 0;
+	return RC_Okay;
+}
+
+
+int Cortex_SetErrorMsgHandlerFunc(void (*MyFunction)(int iLogLevel, char* szLogMessage))
+{
+	pMessageHandler = MyFunction;
+	return RC_Okay;
+}
+
+
+int Cortex_SetDataHandlerFunc(void (*MyFunction)(sFrameOfData* pFrameOfData))
+{
+	pDataHandler = MyFunction;
+	return RC_Okay;
+}
+
+
+int Cortex_Initialize(char* szTalkToHostNicCardAddress, char* szHostNicCardAddress)
+{
+	Cortex_Exit();
+
+	// the host address is the name of the capture file
+	std::lock_guard<std::mutex> lock(mtxStub);
+	if (!captureReader.open(szHostNicCardAddress))
+	{
+		return RC_GeneralError;
+	}
+	frameRate          = captureReader.getFrameRate();
+	unitsToMillimeters = captureReader.getUnitsToMillimeters();
+	if (frameRate <= 0) frameRate = 100.0f;
+
+	// the body definitions need to be available right away
+	CortexFrame frame;
+	if (captureReader.readRecord(currentBodyDefs, frame) != CAPTURE_BODYDEFS)
+	{
+		LOG_ERROR("Capture file does not start with body definitions");
+		captureReader.close();
+		return RC_GeneralError;
+	}
+
+	hasFrame      = false;
+	replayPaused  = false;
+	replayRunning = true;
+	replayThread  = std::thread(replayCapture);
+	return RC_Okay;
+}
+
+
+int Cortex_GetHostInfo(sHostInfo* pHostInfo)
+{
+	memset(pHostInfo, 0, sizeof(sHostInfo));
+	pHostInfo->bFoundHost = replayRunning ? 1 : 0;
+	strncpy_s(pHostInfo->szHostMachineName, "localhost",   sizeof(pHostInfo->szHostMachineName));
+	strncpy_s(pHostInfo->szHostProgramName, "Cortex Stub", sizeof(pHostInfo->szHostProgramName));
+	pHostInfo->HostMachineAddress[0] = 127;
+	pHostInfo->HostMachineAddress[3] = 1;
+	return RC_Okay;
+}
+
+
+int Cortex_GetPortNumbers(int* TalkToHostPort, int* HostPort, int* HostMulticastPort,
+                          int* TalkToClientsRequestPort, int* TalkToClientsMulticastPort, int* ClientsMulticastPort)
+{
+	int* arrPorts[] = { TalkToHostPort, HostPort, HostMulticastPort, TalkToClientsRequestPort, TalkToClientsMulticastPort, ClientsMulticastPort };
+	for (int* pPort : arrPorts)
+	{
+		if (pPort) *pPort = 0;
+	}
+	return RC_Okay;
+}
+
+
+int Cortex_Request(char* szCommand, void** ppResponse, int* pnBytes)
+{
+	std::string strCommand(szCommand);
+	if (strCommand == "GetConversionToMillimeters")
+	{
+		*ppResponse = &unitsToMillimeters;
+		*pnBytes    = sizeof(unitsToMillimeters);
+	}
+	else if (strCommand == "GetContextFrameRate")
+	{
+		*ppResponse = &frameRate;
+		*pnBytes    = sizeof(frameRate);
+	}
+	else if (strCommand == "LiveMode")
+	{
+		replayPaused = false;
+	}
+	else if (strCommand == "Pause")
+	{
+		replayPaused = true;
+	}
+	else
+	{
+		return RC_Unrecognized;
+	}
+	return RC_Okay;
+}
+
+
+sBodyDefs* Cortex_GetBodyDefs()
+{
+	std::lock_guard<std::mutex> lock(mtxStub);
+	std::unique_ptr<CortexBodyDefs> pCopy(new CortexBodyDefs());
+	pCopy->copyFrom(currentBodyDefs.get());
+	sBodyDefs* pBodyDefs = &pCopy->get();
+	mapBodyDefs[pBodyDefs] = std::move(pCopy);
+	return pBodyDefs;
+}
+
+
+int Cortex_FreeBodyDefs(sBodyDefs* pBodyDefs)
+{
+	std::lock_guard<std::mutex> lock(mtxStub);
+	return (mapBodyDefs.erase(pBodyDefs) > 0) ? RC_Okay : RC_GeneralError;
+}
+
+
+sFrameOfData* Cortex_GetCurrentFrame()
+{
+	std::lock_guard<std::mutex> lock(mtxStub);
+	if (!hasFrame) return NULL;
+
+	std::unique_ptr<CortexFrame> pCopy(new CortexFrame());
+	pCopy->copyFrom(currentFrame.get());
+	sFrameOfData* pFrame = &pCopy->get();
+	mapFrames[pFrame] = std::move(pCopy);
+	return pFrame;
+}
+
+
+int Cortex_FreeFrame(sFrameOfData* pFrame)
+{
+	std::lock_guard<std::mutex> lock(mtxStub);
+	return (mapFrames.erase(pFrame) > 0) ? RC_Okay : RC_GeneralError;
+}
+
+
+int Cortex_Exit()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtxStub);
+		replayRunning = false;
+	}
+	cvReplay.notify_all();
+
+	// the data handler does not wait for the MoCap data lock, so this can be called with that lock held
+	if (replayThread.joinable())
+	{
+		replayThread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(mtxStub);
+	captureReader.close();
+	mapBodyDefs.clear();
+	mapFrames.clear();
+	return RC_Okay;
+}
+
+#endif // #if defined(USE_CORTEX) && defined(USE_CORTEX_STUB)
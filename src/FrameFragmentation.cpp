@@ -0,0 +1,536 @@
+#include "FrameFragmentation.h"
+#include "Portability.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "FrameFragmentation"
+
+#include <algorithm>
+#include <string.h>
+
+
+// Estimated sizes of the NatNet frame packet elements
+// frame#, 6x element counts, latency, timecode, subframe, timestamp, params, end of data tag
+#define FRAME_OVERHEAD   64
+#define MARKER_SIZE      (3 * sizeof(float))                 // X, Y, Z
+#define RB_MARKER_SIZE   (MARKER_SIZE + sizeof(int) + sizeof(float)) // position, ID, size
+#define LABELED_SIZE     (sizeof(int) + 4 * sizeof(float) + sizeof(short))
+
+
+static size_t estimateMarkerSetSize(const sMarkerSetData& refMarkerSet, int nMarkers)
+{
+	// name, marker count, markers
+	return strlen(refMarkerSet.szName) + 1 + sizeof(int) + nMarkers * MARKER_SIZE;
+}
+
+
+static size_t estimateRigidBodySize(const sRigidBodyData& refRigidBody)
+{
+	// ID, position, orientation, marker count, markers, mean error, params
+	return sizeof(int) + 7 * sizeof(float) + sizeof(int) + refRigidBody.nMarkers * RB_MARKER_SIZE + sizeof(float) + sizeof(short);
+}
+
+
+static size_t estimateSkeletonSize(const sSkeletonData& refSkeleton)
+{
+	// ID, bone count, bones
+	size_t size = 2 * sizeof(int);
+	for (int bIdx = 0; bIdx < refSkeleton.nRigidBodies; bIdx++)
+	{
+		size += estimateRigidBodySize(refSkeleton.RigidBodyData[bIdx]);
+	}
+	return size;
+}
+
+
+static size_t estimateForcePlateSize(const sForcePlateData& refForcePlate)
+{
+	// ID, channel count, channels (frame count, values), params
+	size_t size = 2 * sizeof(int) + sizeof(short);
+	for (int cIdx = 0; cIdx < refForcePlate.nChannels; cIdx++)
+	{
+		size += sizeof(int) + refForcePlate.ChannelData[cIdx].nFrames * sizeof(float);
+	}
+	return size;
+}
+
+
+size_t estimateFramePacketSize(const sFrameOfMocapData& refFrame)
+{
+	size_t size = FRAME_OVERHEAD;
+	for (int msIdx = 0; msIdx < refFrame.nMarkerSets; msIdx++)
+	{
+		size += estimateMarkerSetSize(refFrame.MocapData[msIdx], refFrame.MocapData[msIdx].nMarkers);
+	}
+	size += refFrame.nOtherMarkers * MARKER_SIZE;
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		size += estimateRigidBodySize(refFrame.RigidBodies[rbIdx]);
+	}
+	for (int skIdx = 0; skIdx < refFrame.nSkeletons; skIdx++)
+	{
+		size += estimateSkeletonSize(refFrame.Skeletons[skIdx]);
+	}
+	size += refFrame.nLabeledMarkers * LABELED_SIZE;
+	for (int fpIdx = 0; fpIdx < refFrame.nForcePlates; fpIdx++)
+	{
+		size += estimateForcePlateSize(refFrame.ForcePlates[fpIdx]);
+	}
+	return size;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// FrameFragmenter class
+//
+
+FrameFragmenter::FrameFragmenter(size_t maxPacketSize) :
+	m_maxPacketSize(0),
+	m_fragmentSize(0)
+{
+	setMaxPacketSize(maxPacketSize);
+}
+
+
+void FrameFragmenter::setMaxPacketSize(size_t maxPacketSize)
+{
+	// needs to hold at least the frame overhead and one element,
+	// and must fit into the packet buffer and its 16 bit length field (like FramePacketWriter)
+	m_maxPacketSize = std::min<size_t>(std::max<size_t>(maxPacketSize, 1024), std::min<size_t>(MAX_PACKETSIZE, 0xFFFF));
+}
+
+
+size_t FrameFragmenter::getMaxPacketSize() const
+{
+	return m_maxPacketSize;
+}
+
+
+const std::vector<const sFrameOfMocapData*>& FrameFragmenter::fragment(const sFrameOfMocapData& refFrame)
+{
+	m_arrFragments.clear();
+
+	if (estimateFramePacketSize(refFrame) <= m_maxPacketSize)
+	{
+		// fits into one packet > no need to split
+		m_arrFragments.push_back(&refFrame);
+		return m_arrFragments;
+	}
+
+	sFrameOfMocapData* pFragment = &startFragment(refFrame);
+
+	// starts a new fragment if the current one is not empty and an element does not fit any more
+	auto makeSpace = [&](size_t elementSize)
+	{
+		if ((m_fragmentSize > FRAME_OVERHEAD) && (m_fragmentSize + elementSize > m_maxPacketSize))
+		{
+			pFragment = &startFragment(refFrame);
+		}
+	};
+
+	// marker sets (large ones are split into several chunks with the same name)
+	for (int msIdx = 0; msIdx < refFrame.nMarkerSets; msIdx++)
+	{
+		const sMarkerSetData& refMarkerSet = refFrame.MocapData[msIdx];
+		int markerIdx = 0;
+		do
+		{
+			makeSpace(estimateMarkerSetSize(refMarkerSet, std::min(refMarkerSet.nMarkers, 1)));
+
+			// how many markers fit into this fragment?
+			size_t space    = m_maxPacketSize - std::min(m_maxPacketSize, m_fragmentSize + estimateMarkerSetSize(refMarkerSet, 0));
+			int    nMarkers = std::min(refMarkerSet.nMarkers - markerIdx, std::max(1, (int) (space / MARKER_SIZE)));
+
+			sMarkerSetData& refChunk = pFragment->MocapData[pFragment->nMarkerSets];
+			strncpy_s(refChunk.szName, refMarkerSet.szName, sizeof(refChunk.szName));
+			refChunk.nMarkers = nMarkers;
+			refChunk.Markers  = refMarkerSet.Markers + markerIdx;
+			pFragment->nMarkerSets++;
+
+			m_fragmentSize += estimateMarkerSetSize(refMarkerSet, nMarkers);
+			markerIdx      += nMarkers;
+		} while (markerIdx < refMarkerSet.nMarkers);
+	}
+
+	// rigid bodies
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		size_t size = estimateRigidBodySize(refFrame.RigidBodies[rbIdx]);
+		makeSpace(size);
+		pFragment->RigidBodies[pFragment->nRigidBodies] = refFrame.RigidBodies[rbIdx];
+		pFragment->nRigidBodies++;
+		m_fragmentSize += size;
+	}
+
+	// skeletons (cannot be split)
+	for (int skIdx = 0; skIdx < refFrame.nSkeletons; skIdx++)
+	{
+		size_t size = estimateSkeletonSize(refFrame.Skeletons[skIdx]);
+		makeSpace(size);
+		if (FRAME_OVERHEAD + size > m_maxPacketSize)
+		{
+			LOG_WARNING("Skeleton " << refFrame.Skeletons[skIdx].skeletonID << " exceeds the maximum packet size");
+		}
+		pFragment->Skeletons[pFragment->nSkeletons] = refFrame.Skeletons[skIdx];
+		pFragment->nSkeletons++;
+		m_fragmentSize += size;
+	}
+
+	// labeled markers
+	for (int mIdx = 0; mIdx < refFrame.nLabeledMarkers; mIdx++)
+	{
+		makeSpace(LABELED_SIZE);
+		pFragment->LabeledMarkers[pFragment->nLabeledMarkers] = refFrame.LabeledMarkers[mIdx];
+		pFragment->nLabeledMarkers++;
+		m_fragmentSize += LABELED_SIZE;
+	}
+
+	// force plates
+	for (int fpIdx = 0; fpIdx < refFrame.nForcePlates; fpIdx++)
+	{
+		size_t size = estimateForcePlateSize(refFrame.ForcePlates[fpIdx]);
+		makeSpace(size);
+		pFragment->ForcePlates[pFragment->nForcePlates] = refFrame.ForcePlates[fpIdx];
+		pFragment->nForcePlates++;
+		m_fragmentSize += size;
+	}
+
+	// unidentified markers (one contiguous chunk per fragment)
+	int markerIdx = 0;
+	while (markerIdx < refFrame.nOtherMarkers)
+	{
+		makeSpace(MARKER_SIZE);
+		size_t space    = m_maxPacketSize - std::min(m_maxPacketSize, m_fragmentSize);
+		int    nMarkers = std::min(refFrame.nOtherMarkers - markerIdx, std::max(1, (int) (space / MARKER_SIZE)));
+		pFragment->OtherMarkers  = refFrame.OtherMarkers + markerIdx;
+		pFragment->nOtherMarkers = nMarkers;
+		m_fragmentSize += nMarkers * MARKER_SIZE;
+		markerIdx      += nMarkers;
+		if (markerIdx < refFrame.nOtherMarkers)
+		{
+			pFragment = &startFragment(refFrame);
+		}
+	}
+
+	// fill in fragment index and count
+	unsigned int fragmentCount = (unsigned int) m_arrFragments.size();
+	if (fragmentCount > 0xFFFF)
+	{
+		LOG_ERROR("Frame " << refFrame.iFrame << " needs too many fragments (" << fragmentCount << ")");
+	}
+	for (unsigned int fIdx = 0; fIdx < fragmentCount; fIdx++)
+	{
+		m_arrFragmentPool[fIdx]->TimecodeSubframe = ((fIdx & 0xFFFF) << 16) | (fragmentCount & 0xFFFF);
+	}
+
+	return m_arrFragments;
+}
+
+
+sFrameOfMocapData& FrameFragmenter::startFragment(const sFrameOfMocapData& refFrame)
+{
+	size_t fIdx = m_arrFragments.size();
+	if (fIdx >= m_arrFragmentPool.size())
+	{
+		// pool is too small > add another (zeroed) fragment structure
+		m_arrFragmentPool.push_back(std::unique_ptr<sFrameOfMocapData>(new sFrameOfMocapData()));
+	}
+
+	sFrameOfMocapData& refFragment = *m_arrFragmentPool[fIdx];
+	refFragment.iFrame           = refFrame.iFrame;
+	refFragment.nMarkerSets      = 0;
+	refFragment.nOtherMarkers    = 0;
+	refFragment.OtherMarkers     = NULL;
+	refFragment.nRigidBodies     = 0;
+	refFragment.nSkeletons       = 0;
+	refFragment.nLabeledMarkers  = 0;
+	refFragment.nForcePlates     = 0;
+	refFragment.fLatency         = refFrame.fLatency;
+	refFragment.Timecode         = refFrame.Timecode;
+	refFragment.TimecodeSubframe = 0; // filled in at the end
+	refFragment.fTimestamp       = refFrame.fTimestamp;
+	refFragment.params           = refFrame.params | FRAME_PARAMS_FRAGMENTED;
+
+	m_arrFragments.push_back(&refFragment);
+	m_fragmentSize = FRAME_OVERHEAD;
+
+	return refFragment;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// FrameAssembler class
+//
+
+/**
+ * Structure for a frame that owns all the data its pointers refer to.
+ */
+struct FrameAssembler::sFrameCopy
+{
+	sFrameOfMocapData                         frame;
+	std::vector<std::vector<float>>           arrFloatBuffers;
+	std::vector<std::vector<int>>             arrIntBuffers;
+	std::vector<std::vector<sRigidBodyData>>  arrBoneBuffers;
+
+	sFrameCopy()
+	{
+		memset(&frame, 0, sizeof(frame));
+	}
+
+	void clear()
+	{
+		frame.nMarkerSets     = 0;
+		frame.nOtherMarkers   = 0;
+		frame.OtherMarkers    = NULL;
+		frame.nRigidBodies    = 0;
+		frame.nSkeletons      = 0;
+		frame.nLabeledMarkers = 0;
+		frame.nForcePlates    = 0;
+		arrFloatBuffers.clear();
+		arrIntBuffers.clear();
+		arrBoneBuffers.clear();
+	}
+
+	float* copyFloats(const float* pSource, size_t count)
+	{
+		if ((pSource == NULL) || (count == 0)) return NULL;
+		arrFloatBuffers.push_back(std::vector<float>(pSource, pSource + count));
+		return arrFloatBuffers.back().data();
+	}
+
+	int* copyInts(const int* pSource, size_t count)
+	{
+		if ((pSource == NULL) || (count == 0)) return NULL;
+		arrIntBuffers.push_back(std::vector<int>(pSource, pSource + count));
+		return arrIntBuffers.back().data();
+	}
+
+	MarkerData* copyMarkers(const MarkerData* pSource, int count)
+	{
+		return (MarkerData*) copyFloats((const float*) pSource, count * 3);
+	}
+
+	void copyRigidBody(const sRigidBodyData& refSource, sRigidBodyData& refDestination)
+	{
+		refDestination = refSource;
+		refDestination.Markers     = copyMarkers(refSource.Markers, refSource.nMarkers);
+		refDestination.MarkerIDs   = copyInts(refSource.MarkerIDs, refSource.nMarkers);
+		refDestination.MarkerSizes = copyFloats(refSource.MarkerSizes, refSource.nMarkers);
+	}
+
+	void copySkeleton(const sSkeletonData& refSource, sSkeletonData& refDestination)
+	{
+		refDestination = refSource;
+		arrBoneBuffers.push_back(std::vector<sRigidBodyData>(refSource.nRigidBodies));
+		refDestination.RigidBodyData = arrBoneBuffers.back().data();
+		for (int bIdx = 0; bIdx < refSource.nRigidBodies; bIdx++)
+		{
+			copyRigidBody(refSource.RigidBodyData[bIdx], refDestination.RigidBodyData[bIdx]);
+		}
+	}
+
+	void copyFrom(const sFrameOfMocapData& refSource)
+	{
+		clear();
+		frame.iFrame           = refSource.iFrame;
+		frame.fLatency         = refSource.fLatency;
+		frame.Timecode         = refSource.Timecode;
+		frame.TimecodeSubframe = refSource.TimecodeSubframe;
+		frame.fTimestamp       = refSource.fTimestamp;
+		frame.params           = refSource.params;
+
+		frame.nMarkerSets = refSource.nMarkerSets;
+		for (int msIdx = 0; msIdx < refSource.nMarkerSets; msIdx++)
+		{
+			frame.MocapData[msIdx] = refSource.MocapData[msIdx];
+			frame.MocapData[msIdx].Markers = copyMarkers(refSource.MocapData[msIdx].Markers, refSource.MocapData[msIdx].nMarkers);
+		}
+
+		frame.nOtherMarkers = refSource.nOtherMarkers;
+		frame.OtherMarkers  = copyMarkers(refSource.OtherMarkers, refSource.nOtherMarkers);
+
+		frame.nRigidBodies = refSource.nRigidBodies;
+		for (int rbIdx = 0; rbIdx < refSource.nRigidBodies; rbIdx++)
+		{
+			copyRigidBody(refSource.RigidBodies[rbIdx], frame.RigidBodies[rbIdx]);
+		}
+
+		frame.nSkeletons = refSource.nSkeletons;
+		for (int skIdx = 0; skIdx < refSource.nSkeletons; skIdx++)
+		{
+			copySkeleton(refSource.Skeletons[skIdx], frame.Skeletons[skIdx]);
+		}
+
+		frame.nLabeledMarkers = refSource.nLabeledMarkers;
+		std::copy(refSource.LabeledMarkers, refSource.LabeledMarkers + refSource.nLabeledMarkers, frame.LabeledMarkers);
+
+		frame.nForcePlates = refSource.nForcePlates;
+		std::copy(refSource.ForcePlates, refSource.ForcePlates + refSource.nForcePlates, frame.ForcePlates);
+	}
+};
+
+
+FrameAssembler::FrameAssembler() :
+	m_iFrame(-1),
+	m_nReceived(0),
+	m_nIncompleteFrames(0),
+	m_pFrame(new sFrameCopy())
+{
+	// nothing else to do
+}
+
+
+FrameAssembler::~FrameAssembler()
+{
+	// nothing to do, buffers clean up themselves
+}
+
+
+bool FrameAssembler::addFragment(const sFrameOfMocapData& refFragment)
+{
+	if ((refFragment.params & FRAME_PARAMS_FRAGMENTED) == 0)
+	{
+		// not fragmented > complete frame
+		if (m_nReceived > 0) m_nIncompleteFrames++;
+		m_nReceived = 0;
+		m_pFrame->copyFrom(refFragment);
+		return true;
+	}
+
+	int fragmentIdx   = (refFragment.TimecodeSubframe >> 16) & 0xFFFF;
+	int fragmentCount = (refFragment.TimecodeSubframe      ) & 0xFFFF;
+	if ((fragmentCount == 0) || (fragmentIdx >= fragmentCount))
+	{
+		LOG_WARNING("Invalid fragment " << fragmentIdx << "/" << fragmentCount << " of frame " << refFragment.iFrame);
+		return false;
+	}
+
+	if ((refFragment.iFrame != m_iFrame) || (fragmentCount != (int) m_arrReceived.size()))
+	{
+		// fragment of a new frame > start over
+		if (m_nReceived > 0) m_nIncompleteFrames++;
+		m_iFrame    = refFragment.iFrame;
+		m_nReceived = 0;
+		m_arrReceived.assign(fragmentCount, false);
+		while ((int) m_arrFragments.size() < fragmentCount)
+		{
+			m_arrFragments.push_back(std::unique_ptr<sFrameCopy>(new sFrameCopy()));
+		}
+	}
+
+	if (!m_arrReceived[fragmentIdx])
+	{
+		m_arrFragments[fragmentIdx]->copyFrom(refFragment);
+		m_arrReceived[fragmentIdx] = true;
+		m_nReceived++;
+	}
+
+	if (m_nReceived == fragmentCount)
+	{
+		assemble();
+		m_nReceived = 0;
+		m_iFrame    = -1;
+		return true;
+	}
+	return false;
+}
+
+
+const sFrameOfMocapData& FrameAssembler::getFrame() const
+{
+	return m_pFrame->frame;
+}
+
+
+int FrameAssembler::getIncompleteFrameCount() const
+{
+	return m_nIncompleteFrames;
+}
+
+
+void FrameAssembler::assemble()
+{
+	sFrameCopy&        refResult = *m_pFrame;
+	sFrameOfMocapData& refFrame  = refResult.frame;
+	refResult.clear();
+
+	const sFrameOfMocapData& refFirst = m_arrFragments[0]->frame;
+	refFrame.iFrame           = refFirst.iFrame;
+	refFrame.fLatency         = refFirst.fLatency;
+	refFrame.Timecode         = refFirst.Timecode;
+	refFrame.TimecodeSubframe = 0;
+	refFrame.fTimestamp       = refFirst.fTimestamp;
+	refFrame.params           = refFirst.params & ~FRAME_PARAMS_FRAGMENTED;
+
+	// marker set chunks and unidentified markers are collected first, pointers are set at the end
+	std::vector<std::vector<float>> arrMarkerSetData;
+	std::vector<float>              arrOtherMarkers;
+
+	for (size_t fIdx = 0; fIdx < m_arrReceived.size(); fIdx++)
+	{
+		const sFrameOfMocapData& refFragment = m_arrFragments[fIdx]->frame;
+
+		for (int msIdx = 0; msIdx < refFragment.nMarkerSets; msIdx++)
+		{
+			const sMarkerSetData& refChunk = refFragment.MocapData[msIdx];
+			// chunks of the same marker set are consecutive > only check the last marker set
+			int lastIdx = refFrame.nMarkerSets - 1;
+			if ((lastIdx < 0) || (strcmp(refFrame.MocapData[lastIdx].szName, refChunk.szName) != 0))
+			{
+				sMarkerSetData& refMarkerSet = refFrame.MocapData[refFrame.nMarkerSets];
+				strncpy_s(refMarkerSet.szName, refChunk.szName, sizeof(refMarkerSet.szName));
+				refMarkerSet.nMarkers = 0;
+				refMarkerSet.Markers  = NULL;
+				refFrame.nMarkerSets++;
+				arrMarkerSetData.push_back(std::vector<float>());
+			}
+			const float* pMarkers = (const float*) refChunk.Markers;
+			arrMarkerSetData.back().insert(arrMarkerSetData.back().end(), pMarkers, pMarkers + refChunk.nMarkers * 3);
+			refFrame.MocapData[refFrame.nMarkerSets - 1].nMarkers += refChunk.nMarkers;
+		}
+
+		const float* pOtherMarkers = (const float*) refFragment.OtherMarkers;
+		if (pOtherMarkers != NULL)
+		{
+			arrOtherMarkers.insert(arrOtherMarkers.end(), pOtherMarkers, pOtherMarkers + refFragment.nOtherMarkers * 3);
+		}
+
+		for (int rbIdx = 0; rbIdx < refFragment.nRigidBodies; rbIdx++)
+		{
+			refResult.copyRigidBody(refFragment.RigidBodies[rbIdx], refFrame.RigidBodies[refFrame.nRigidBodies]);
+			refFrame.nRigidBodies++;
+		}
+
+		for (int skIdx = 0; skIdx < refFragment.nSkeletons; skIdx++)
+		{
+			refResult.copySkeleton(refFragment.Skeletons[skIdx], refFrame.Skeletons[refFrame.nSkeletons]);
+			refFrame.nSkeletons++;
+		}
+
+		for (int mIdx = 0; mIdx < refFragment.nLabeledMarkers; mIdx++)
+		{
+			refFrame.LabeledMarkers[refFrame.nLabeledMarkers] = refFragment.LabeledMarkers[mIdx];
+			refFrame.nLabeledMarkers++;
+		}
+
+		for (int fpIdx = 0; fpIdx < refFragment.nForcePlates; fpIdx++)
+		{
+			refFrame.ForcePlates[refFrame.nForcePlates] = refFragment.ForcePlates[fpIdx];
+			refFrame.nForcePlates++;
+		}
+	}
+
+	// now that all marker data is collected, transfer buffers and set pointers
+	for (int msIdx = 0; msIdx < refFrame.nMarkerSets; msIdx++)
+	{
+		refResult.arrFloatBuffers.push_back(std::move(arrMarkerSetData[msIdx]));
+		refFrame.MocapData[msIdx].Markers = (MarkerData*) refResult.arrFloatBuffers.back().data();
+	}
+	refFrame.nOtherMarkers = (int) (arrOtherMarkers.size() / 3);
+	refResult.arrFloatBuffers.push_back(std::move(arrOtherMarkers));
+	refFrame.OtherMarkers = (MarkerData*) refResult.arrFloatBuffers.back().data();
+}
@@ -0,0 +1,163 @@
+/**
+ * Classes for splitting frames that are too large for a single NatNet packet into several fragments,
+ * and for reassembling those fragments into a complete frame on the client side.
+ *
+ * Each fragment is a valid NatNet frame with the same frame number.
+ * Fragmented frames are marked by FRAME_PARAMS_FRAGMENTED in the frame parameters,
+ * and the timecode subframe field carries the fragment index (upper 16 bits)
+ * and the amount of fragments (lower 16 bits).
+ *
+ * Clients that poll frames with NAT_REQUEST_FRAMEOFDATA receive the first fragment of the latest frame.
+ * They request the remaining fragments with the NAT_REQUEST "getFrameFragment <frame> <index>",
+ * which is rejected when the frame has been replaced meanwhile.
+ */
+
+#pragma once
+
+#include "NatNetTypes.h"
+
+#include <memory>
+#include <vector>
+
+
+// frame parameter bit marking a frame fragment
+#define FRAME_PARAMS_FRAGMENTED 0x0080
+
+// default maximum payload for a frame packet (stays below the UDP datagram limit)
+#define DEFAULT_MAX_FRAME_PACKET_SIZE 60000
+
+
+/**
+ * Estimates the size of the NatNet packet payload for a frame.
+ * The estimate is an upper bound of the size that PacketizeFrameOfMocapData produces.
+ *
+ * @param refFrame  the frame to estimate the size of
+ *
+ * @return the estimated packet payload size in bytes
+ */
+size_t estimateFramePacketSize(const sFrameOfMocapData& refFrame);
+
+
+/**
+ * Class for splitting a frame into fragments that each fit into a single packet.
+ * The fragments do not copy any marker data, they only point into the original frame.
+ */
+class FrameFragmenter
+{
+public:
+
+	/**
+	 * Creates a frame fragmenter.
+	 *
+	 * @param maxPacketSize  the maximum packet payload size per fragment
+	 */
+	FrameFragmenter(size_t maxPacketSize = DEFAULT_MAX_FRAME_PACKET_SIZE);
+
+	/**
+	 * Sets the maximum packet payload size per fragment.
+	 * The size is limited to the range from 1024 bytes to the size of a NatNet packet (at most 65535 bytes).
+	 *
+	 * @param maxPacketSize  the maximum packet payload size
+	 */
+	void setMaxPacketSize(size_t maxPacketSize);
+
+	/**
+	 * Gets the maximum packet payload size per fragment.
+	 *
+	 * @return the maximum packet payload size
+	 */
+	size_t getMaxPacketSize() const;
+
+	/**
+	 * Splits a frame into fragments.
+	 * If the frame fits into a single packet, the only fragment is the frame itself.
+	 * The fragments are valid until the next call or until the original frame data changes.
+	 *
+	 * @param refFrame  the frame to split
+	 *
+	 * @return the list of fragments
+	 */
+	const std::vector<const sFrameOfMocapData*>& fragment(const sFrameOfMocapData& refFrame);
+
+private:
+
+	/**
+	 * Starts a new fragment.
+	 *
+	 * @param refFrame  the frame that is being split
+	 *
+	 * @return the new (empty) fragment
+	 */
+	sFrameOfMocapData& startFragment(const sFrameOfMocapData& refFrame);
+
+private:
+
+	size_t                                          m_maxPacketSize;
+	size_t                                          m_fragmentSize; // estimated size of the current fragment
+	std::vector<std::unique_ptr<sFrameOfMocapData>> m_arrFragmentPool;
+	std::vector<const sFrameOfMocapData*>           m_arrFragments;
+};
+
+
+/**
+ * Class for reassembling frame fragments into a complete frame, e.g., in a client.
+ * Fragments can arrive in any order.
+ * When a fragment of a new frame arrives before the current one is complete, the incomplete frame is discarded.
+ */
+class FrameAssembler
+{
+public:
+
+	/**
+	 * Creates a frame assembler.
+	 */
+	FrameAssembler();
+
+	/**
+	 * Destroys the frame assembler.
+	 */
+	~FrameAssembler();
+
+	/**
+	 * Adds a received frame or frame fragment.
+	 * The data is copied, so the received frame can be released afterwards.
+	 *
+	 * @param refFragment  the received frame or fragment
+	 *
+	 * @return <code>true</code> if the frame is complete and can be retrieved with getFrame()
+	 */
+	bool addFragment(const sFrameOfMocapData& refFragment);
+
+	/**
+	 * Gets the last complete frame.
+	 * The frame is valid until the next call to addFragment().
+	 *
+	 * @return the last complete frame
+	 */
+	const sFrameOfMocapData& getFrame() const;
+
+	/**
+	 * Gets the amount of frames that were discarded because fragments were missing.
+	 *
+	 * @return the amount of incomplete frames
+	 */
+	int getIncompleteFrameCount() const;
+
+private:
+
+	struct sFrameCopy;
+
+	/**
+	 * Merges all received fragments into the complete frame.
+	 */
+	void assemble();
+
+private:
+
+	std::vector<std::unique_ptr<sFrameCopy>> m_arrFragments;
+	std::vector<bool>                        m_arrReceived;
+	int                                      m_iFrame;
+	int                                      m_nReceived;
+	int                                      m_nIncompleteFrames;
+	std::unique_ptr<sFrameCopy>              m_pFrame;
+};
@@ -0,0 +1,191 @@
+#include "FramePacketWriter.h"
+
+#include <algorithm>
+
+
+// end of data tag of a frame packet
+#define END_OF_DATA_TAG 0
+
+
+FramePacketWriter::FramePacketWriter(sPacket& refPacket, const uint8_t arrNatNetVersion[4], size_t maxPacketSize) :
+	m_packet(refPacket),
+	m_major(arrNatNetVersion[0]),
+	m_minor(arrNatNetVersion[1]),
+	m_maxSize(std::min<size_t>(maxPacketSize, std::min<size_t>(MAX_PACKETSIZE, 0xFFFF))),
+	m_size(0),
+	m_overflow(false)
+{
+	// nothing else to do
+}
+
+
+bool FramePacketWriter::isSupportedVersion(const uint8_t arrNatNetVersion[4])
+{
+	// NatNet 3 changed the rigid body and marker layout
+	return arrNatNetVersion[0] == 2;
+}
+
+
+void FramePacketWriter::beginFrame(int iFrame)
+{
+	m_size     = 0;
+	m_overflow = false;
+	write(iFrame);
+}
+
+
+void FramePacketWriter::beginMarkerSets(int count)
+{
+	write(count);
+}
+
+
+void FramePacketWriter::beginMarkerSet(const char* szName, int nMarkers)
+{
+	writeBytes(szName, strlen(szName) + 1);
+	write(nMarkers);
+}
+
+
+void FramePacketWriter::writeMarker(const MarkerData& refMarker)
+{
+	writeBytes(refMarker, sizeof(MarkerData));
+}
+
+
+void FramePacketWriter::beginOtherMarkers(int count)
+{
+	write(count);
+}
+
+
+void FramePacketWriter::beginRigidBodies(int count)
+{
+	write(count);
+}
+
+
+void FramePacketWriter::writeRigidBody(const sRigidBodyData& refRigidBody)
+{
+	write(refRigidBody.ID);
+	write(refRigidBody.x);  write(refRigidBody.y);  write(refRigidBody.z);
+	write(refRigidBody.qx); write(refRigidBody.qy); write(refRigidBody.qz); write(refRigidBody.qw);
+
+	int nMarkers = (refRigidBody.Markers != NULL) ? refRigidBody.nMarkers : 0;
+	write(nMarkers);
+	for (int mIdx = 0; mIdx < nMarkers; mIdx++)
+	{
+		writeMarker(refRigidBody.Markers[mIdx]);
+	}
+	// marker IDs and sizes, missing arrays are filled with 0
+	for (int mIdx = 0; mIdx < nMarkers; mIdx++)
+	{
+		write((refRigidBody.MarkerIDs != NULL) ? refRigidBody.MarkerIDs[mIdx] : 0);
+	}
+	for (int mIdx = 0; mIdx < nMarkers; mIdx++)
+	{
+		write((refRigidBody.MarkerSizes != NULL) ? refRigidBody.MarkerSizes[mIdx] : 0.0f);
+	}
+
+	write(refRigidBody.MeanError);
+	if (isVersion(2, 6))
+	{
+		write(refRigidBody.params);
+	}
+}
+
+
+void FramePacketWriter::beginSkeletons(int count)
+{
+	if (isVersion(2, 1))
+	{
+		write(count);
+	}
+}
+
+
+void FramePacketWriter::beginSkeleton(int skeletonID, int nRigidBodies)
+{
+	write(skeletonID);
+	write(nRigidBodies);
+}
+
+
+void FramePacketWriter::beginLabeledMarkers(int count)
+{
+	if (isVersion(2, 3))
+	{
+		write(count);
+	}
+}
+
+
+void FramePacketWriter::writeLabeledMarker(const sMarker& refMarker)
+{
+	write(refMarker.ID);
+	write(refMarker.x); write(refMarker.y); write(refMarker.z);
+	write(refMarker.size);
+	if (isVersion(2, 6))
+	{
+		write(refMarker.params);
+	}
+}
+
+
+void FramePacketWriter::beginForcePlates(int count)
+{
+	if (isVersion(2, 9))
+	{
+		write(count);
+	}
+}
+
+
+void FramePacketWriter::writeForcePlate(const sForcePlateData& refForcePlate)
+{
+	write(refForcePlate.ID);
+	write(refForcePlate.nChannels);
+	for (int cIdx = 0; cIdx < refForcePlate.nChannels; cIdx++)
+	{
+		const sAnalogChannelData& refChannel = refForcePlate.ChannelData[cIdx];
+		write(refChannel.nFrames);
+		writeBytes(refChannel.Values, refChannel.nFrames * sizeof(float));
+	}
+}
+
+
+bool FramePacketWriter::endFrame(float fLatency, unsigned int timecode, unsigned int timecodeSubframe, double fTimestamp, short params)
+{
+	write(fLatency);
+	write(timecode);
+	write(timecodeSubframe);
+	if (isVersion(2, 7))
+	{
+		write(fTimestamp);
+	}
+	else
+	{
+		write((float) fTimestamp);
+	}
+	write(params);
+	write((int) END_OF_DATA_TAG);
+
+	if (!m_overflow)
+	{
+		m_packet.iMessage   = NAT_FRAMEOFDATA;
+		m_packet.nDataBytes = (unsigned short) m_size;
+	}
+	return !m_overflow;
+}
+
+
+bool FramePacketWriter::hasOverflowed() const
+{
+	return m_overflow;
+}
+
+
+bool FramePacketWriter::isVersion(int major, int minor) const
+{
+	return (m_major > major) || ((m_major == major) && (m_minor >= minor));
+}
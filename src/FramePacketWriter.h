@@ -0,0 +1,120 @@
+/**
+ * Class for serialising a frame directly into a NatNet packet,
+ * without the intermediate sFrameOfMocapData structure.
+ *
+ * The elements have to be written in the order of the NatNet frame format:
+ * marker sets, unidentified markers, rigid bodies, skeletons, labeled markers, force plates.
+ * Each block starts with a begin...() call that writes the element count.
+ */
+
+#pragma once
+
+#include "NatNetTypes.h"
+
+#include <stdint.h>
+#include <string.h>
+
+
+class FramePacketWriter
+{
+public:
+
+	/**
+	 * Creates a writer for a frame packet.
+	 *
+	 * @param refPacket         the packet to write into
+	 * @param arrNatNetVersion  the NatNet version to produce the format for
+	 * @param maxPacketSize     the maximum payload size before the writer overflows
+	 */
+	FramePacketWriter(sPacket& refPacket, const uint8_t arrNatNetVersion[4], size_t maxPacketSize);
+
+	/**
+	 * Checks if the writer can produce the frame format of a NatNet version.
+	 *
+	 * @param arrNatNetVersion  the NatNet version to check
+	 *
+	 * @return <code>true</code> if the version is supported
+	 */
+	static bool isSupportedVersion(const uint8_t arrNatNetVersion[4]);
+
+	/**
+	 * Starts a new frame and resets the packet.
+	 *
+	 * @param iFrame  the frame number
+	 */
+	void beginFrame(int iFrame);
+
+	void beginMarkerSets(int count);
+	void beginMarkerSet(const char* szName, int nMarkers);
+	void writeMarker(const MarkerData& refMarker);
+
+	void beginOtherMarkers(int count);
+
+	void beginRigidBodies(int count);
+	void writeRigidBody(const sRigidBodyData& refRigidBody);
+
+	void beginSkeletons(int count);
+	void beginSkeleton(int skeletonID, int nRigidBodies);
+
+	void beginLabeledMarkers(int count);
+	void writeLabeledMarker(const sMarker& refMarker);
+
+	void beginForcePlates(int count);
+	void writeForcePlate(const sForcePlateData& refForcePlate);
+
+	/**
+	 * Finishes the frame and sets the packet header.
+	 *
+	 * @param fLatency          the frame latency
+	 * @param timecode          the SMPTE timecode
+	 * @param timecodeSubframe  the timecode subframe
+	 * @param fTimestamp        the frame timestamp
+	 * @param params            the frame parameters
+	 *
+	 * @return <code>true</code> if the frame fitted into the packet
+	 */
+	bool endFrame(float fLatency, unsigned int timecode, unsigned int timecodeSubframe, double fTimestamp, short params);
+
+	/**
+	 * Checks if the data written so far exceeded the maximum packet size.
+	 *
+	 * @return <code>true</code> if the packet has overflowed
+	 */
+	bool hasOverflowed() const;
+
+private:
+
+	/**
+	 * Checks if the target NatNet version is at least a specific version.
+	 */
+	bool isVersion(int major, int minor) const;
+
+	/**
+	 * Appends raw bytes to the packet.
+	 */
+	void writeBytes(const void* pData, size_t size)
+	{
+		if (m_size + size <= m_maxSize)
+		{
+			memcpy(m_packet.Data.cData + m_size, pData, size);
+		}
+		else
+		{
+			m_overflow = true;
+		}
+		m_size += size;
+	}
+
+	template<typename T> void write(const T& value)
+	{
+		writeBytes(&value, sizeof(value));
+	}
+
+private:
+
+	sPacket& m_packet;
+	int      m_major, m_minor;
+	size_t   m_maxSize;
+	size_t   m_size;
+	bool     m_overflow;
+};
@@ -0,0 +1,202 @@
+#include "FrameSender.h"
+#include "TraceRecorder.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "FrameSender"
+
+#include <algorithm>
+
+
+FrameSender::FrameSender(NatNetServer& refServer, const std::string& strDestination) :
+	m_server(refServer),
+	m_strDestination(strDestination),
+	m_running(false),
+	m_maxQueueSize(8),
+	m_pacingInterval(0),
+	m_framesQueued(0),
+	m_framesDropped(0),
+	m_packetsSent(0),
+	m_bytesSent(0),
+	m_batches(0),
+	m_maxBatchSize(0)
+{
+	// nothing else to do
+}
+
+
+FrameSender::~FrameSender()
+{
+	stop();
+}
+
+
+bool FrameSender::start()
+{
+	if (!m_running)
+	{
+		m_running      = true;
+		m_lastSendTime = std::chrono::steady_clock::now();
+		m_senderThread = std::thread(&FrameSender::senderThread, this);
+		LOG_INFO("Sender thread started (Destination: " << m_strDestination
+			<< ", Queue size: " << m_maxQueueSize
+			<< ", Pacing: " << m_pacingInterval.count() << "us)");
+	}
+	return isRunning();
+}
+
+
+bool FrameSender::isRunning() const
+{
+	return m_running;
+}
+
+
+void FrameSender::setQueueSize(size_t maxFrames)
+{
+	std::lock_guard<std::mutex> lock(m_mtxQueue);
+	m_maxQueueSize = std::max<size_t>(1, maxFrames);
+}
+
+
+void FrameSender::setPacingInterval(std::chrono::microseconds interval)
+{
+	std::lock_guard<std::mutex> lock(m_mtxQueue);
+	m_pacingInterval = std::max(std::chrono::microseconds(0), interval);
+}
+
+
+void FrameSender::enqueue(const std::shared_ptr<const FramePacketList>& pFrame)
+{
+	if (!pFrame || pFrame->empty() || !m_running) return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mtxQueue);
+		if (m_queue.size() >= m_maxQueueSize)
+		{
+			// sender can't keep up > drop oldest frame with all its fragments, the newest one is more relevant
+			m_queue.pop_front();
+			m_framesDropped++;
+		}
+		m_queue.push_back(pFrame);
+		m_framesQueued++;
+	}
+	m_cvQueue.notify_one();
+}
+
+
+void FrameSender::stop()
+{
+	if (m_running)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtxQueue);
+			m_running = false;
+		}
+		m_cvQueue.notify_one();
+
+		if (m_senderThread.joinable())
+		{
+			m_senderThread.join();
+		}
+
+		std::lock_guard<std::mutex> lock(m_mtxQueue);
+		m_framesDropped += m_queue.size();
+		m_queue.clear();
+	}
+}
+
+
+void FrameSender::printStatistics(std::ostream& refOutput) const
+{
+	std::lock_guard<std::mutex> lock(m_mtxQueue);
+
+	refOutput << "Frame Sender Statistics" << std::endl
+		<< "\tDestination:     " << m_strDestination << " (all counters are totals for all clients)" << std::endl
+		<< "\tFrames queued:   " << m_framesQueued  << std::endl
+		<< "\tFrames dropped:  " << m_framesDropped << std::endl
+		<< "\tPackets sent:    " << m_packetsSent   << " (" << m_bytesSent << " bytes)" << std::endl
+		<< "\tBatches:         " << m_batches << " (max. " << m_maxBatchSize << " frames)" << std::endl
+		<< "\tPacing interval: " << m_pacingInterval.count() << "us" << std::endl;
+
+	if (m_sendErrors.empty())
+	{
+		refOutput << "\tSend errors:     none" << std::endl;
+	}
+	for (auto& error : m_sendErrors)
+	{
+		refOutput << "\tSend errors:     " << error.second << " (error code " << error.first << ")" << std::endl;
+	}
+}
+
+
+void FrameSender::senderThread()
+{
+	TraceRecorder::setThreadName("Frame sender");
+
+	std::vector<std::shared_ptr<const FramePacketList>> batch;
+	batch.reserve(m_maxQueueSize);
+
+	std::unique_lock<std::mutex> lock(m_mtxQueue);
+	while (m_running)
+	{
+		m_cvQueue.wait(lock, [this] { return !m_running || !m_queue.empty(); });
+		if (!m_running) break;
+
+		// take all waiting frames at once
+		batch.assign(m_queue.begin(), m_queue.end());
+		m_queue.clear();
+		m_maxBatchSize = std::max(m_maxBatchSize, batch.size());
+		std::chrono::microseconds pacing = m_pacingInterval;
+		lock.unlock();
+
+		sendBatch(batch, pacing);
+		batch.clear(); // releases the packets back to the pool
+
+		lock.lock();
+	}
+}
+
+
+void FrameSender::sendBatch(const std::vector<std::shared_ptr<const FramePacketList>>& refBatch, std::chrono::microseconds pacing)
+{
+	m_batches++;
+
+	for (auto& pFrame : refBatch)
+	{
+		for (auto& pPacket : *pFrame)
+		{
+			if (pacing.count() > 0)
+			{
+				// pacing > spread packets out
+				std::this_thread::sleep_until(m_lastSendTime + pacing);
+			}
+			sendPacket(*pPacket);
+		}
+	}
+}
+
+
+void FrameSender::sendPacket(const sPacket& refPacket)
+{
+	TRACE_SCOPE("send packet");
+	// NatNet API is not const-correct, but does not modify the packet
+	int result = m_server.SendPacket(const_cast<sPacket*>(&refPacket));
+	m_lastSendTime = std::chrono::steady_clock::now();
+
+	if (result == ErrorCode_OK)
+	{
+		m_packetsSent++;
+		m_bytesSent += refPacket.nDataBytes;
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(m_mtxQueue);
+		uint64_t& errors = m_sendErrors[result];
+		if (errors == 0)
+		{
+			LOG_ERROR("Could not send packet to " << m_strDestination << " (error code " << result << ")");
+		}
+		errors++;
+	}
+}
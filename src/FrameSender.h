@@ -0,0 +1,150 @@
+/**
+ * Class for sending serialised frame packets to the network on a separate thread.
+ * A frame is queued with all its packets (fragments), and is sent or dropped as a whole.
+ *
+ * Only the sender thread calls NatNetServer::SendPacket, and it does so without the server mutex:
+ * packetising (PacketizeFrameOfMocapData/PacketizeDataDescriptions) only writes into the given packet,
+ * so producers that need the mutex never wait for network I/O.
+ * The NatNet server distributes each packet to its clients (multicast group or unicast clients)
+ * within one SendPacket call and does not report results per client,
+ * so the counters are a single aggregate for all clients of the server.
+ */
+
+#pragma once
+
+#include "NatNetTypes.h"
+#include "NatNetServer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// the packets of a frame (several when the frame is split into fragments)
+typedef std::vector<std::shared_ptr<const sPacket>> FramePacketList;
+
+
+class FrameSender
+{
+public:
+
+	/**
+	 * Creates a frame sender for a NatNet server.
+	 * The server must not be destroyed before the sender is stopped.
+	 *
+	 * @param refServer        the NatNet server to send the packets through
+	 * @param strDestination   the destination of the server's data stream, e.g., "239.255.42.99:1509"
+	 */
+	FrameSender(NatNetServer& refServer, const std::string& strDestination);
+
+	/**
+	 * Stops the sender thread and destroys the frame sender.
+	 */
+	~FrameSender();
+
+	/**
+	 * Starts the sender thread.
+	 *
+	 * @return <code>true</code> if the thread is running
+	 */
+	bool start();
+
+	/**
+	 * Checks if the sender thread is running.
+	 *
+	 * @return <code>true</code> if the thread is running
+	 */
+	bool isRunning() const;
+
+	/**
+	 * Sets the maximum amount of frames waiting to be sent.
+	 * When the queue is full, the oldest frame is dropped with all its packets.
+	 *
+	 * @param maxFrames  the maximum amount of waiting frames
+	 */
+	void setQueueSize(size_t maxFrames);
+
+	/**
+	 * Sets the minimum time between two consecutive packets.
+	 * This avoids bursts of packets when the MoCap system delivers several frames at once.
+	 *
+	 * @param interval  the minimum time between two packets (0: no pacing)
+	 */
+	void setPacingInterval(std::chrono::microseconds interval);
+
+	/**
+	 * Queues a serialised frame for sending.
+	 * This function does not block on the network.
+	 *
+	 * @param pFrame  the packets of the frame to send (must not be modified afterwards)
+	 */
+	void enqueue(const std::shared_ptr<const FramePacketList>& pFrame);
+
+	/**
+	 * Stops the sender thread. Frames still waiting in the queue are dropped.
+	 */
+	void stop();
+
+	/**
+	 * Prints the sender statistics into an output stream.
+	 *
+	 * @param refOutput  the stream to print to
+	 */
+	void printStatistics(std::ostream& refOutput) const;
+
+private:
+
+	/**
+	 * Thread that sends the queued packets in the background.
+	 */
+	void senderThread();
+
+	/**
+	 * Sends a batch of frames, respecting the pacing interval.
+	 *
+	 * @param refBatch  the frames to send
+	 * @param pacing    the minimum time between two packets
+	 */
+	void sendBatch(const std::vector<std::shared_ptr<const FramePacketList>>& refBatch, std::chrono::microseconds pacing);
+
+	/**
+	 * Sends a single packet and updates the statistics.
+	 * Only to be called from the sender thread.
+	 *
+	 * @param refPacket  the packet to send
+	 */
+	void sendPacket(const sPacket& refPacket);
+
+private:
+
+	NatNetServer&                               m_server;
+	std::string                                 m_strDestination;
+
+	std::thread                                 m_senderThread;
+	std::atomic<bool>                           m_running;
+
+	mutable std::mutex                          m_mtxQueue;
+	std::condition_variable                     m_cvQueue;
+	std::deque<std::shared_ptr<const FramePacketList>> m_queue;
+	size_t                                      m_maxQueueSize;
+
+	std::chrono::microseconds                   m_pacingInterval;
+	std::chrono::steady_clock::time_point       m_lastSendTime;
+
+	// statistics, aggregated over all clients
+	std::atomic<uint64_t>                       m_framesQueued;
+	std::atomic<uint64_t>                       m_framesDropped;
+	std::atomic<uint64_t>                       m_packetsSent;
+	std::atomic<uint64_t>                       m_bytesSent;
+	std::atomic<uint64_t>                       m_batches;
+	size_t                                      m_maxBatchSize; // in frames
+	std::map<int, uint64_t>                     m_sendErrors; // error counter per NatNet error code
+};
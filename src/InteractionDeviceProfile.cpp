@@ -0,0 +1,282 @@
+#include "InteractionDeviceProfile.h"
+#include "NatNetTypes.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <glob.h>
+#endif
+#include <stdlib.h>
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "InteractionDeviceProfile"
+
+
+#define MAX_DIGITAL_PIN 12
+
+
+// profile of the AUT joystick, used when there are no profile files
+// (must stay the same as Hardware/InteractionDevice_Joystick1.xml, checked by test/InteractionDeviceProfileTest.cpp)
+static const char* DEFAULT_PROFILES =
+	"<interaction>"
+	"  <device type='Joystick' match='oystick'>"
+	"    <channel name='button1'> <digital D2='0' value='1' /> </channel>"
+	"    <channel name='button2'> <digital D3='0' value='1' /> </channel>"
+	"    <channel name='button3'> <digital D6='0' D4='1' D5='1' value='1' /> </channel>"
+	"    <channel name='button4'> <digital D6='0' D4='0' D5='1' value='1' /> </channel>"
+	"    <channel name='button5'> <digital D6='0' D4='1' D5='0' value='1' /> </channel>"
+	"    <channel name='button6'> <digital D6='0' D4='0' D5='0' value='1' /> </channel>"
+	"    <channel name='axis1'>"
+	"      <digital D7='0' D4='1' D5='0' value='-1' />"
+	"      <digital D7='0' D4='0' D5='1' value='1' />"
+	"    </channel>"
+	"    <channel name='axis2'>"
+	"      <digital D7='0' D4='0' D5='0' value='1' />"
+	"      <digital D7='0' D4='1' D5='1' value='-1' />"
+	"    </channel>"
+	"  </device>"
+	"</interaction>";
+
+
+/**
+ * Adds the profiles of all <device> elements within <interaction> elements.
+ */
+static size_t addProfiles(const XmlElement& refElement, const std::string& strSource, std::vector<InteractionDeviceProfile>& arrProfiles)
+{
+	size_t count = 0;
+	if (refElement.name == "interaction")
+	{
+		for (auto& device : refElement.children)
+		{
+			if (device.name != "device") continue;
+
+			InteractionDeviceProfile profile;
+			if (profile.parse(device))
+			{
+				arrProfiles.push_back(profile);
+				count++;
+			}
+			else
+			{
+				LOG_WARNING("Ignoring invalid device profile '" << device.getAttribute("type") << "' in " << strSource);
+			}
+		}
+	}
+	else
+	{
+		for (auto& child : refElement.children)
+		{
+			count += addProfiles(child, strSource, arrProfiles);
+		}
+	}
+	return count;
+}
+
+
+size_t InteractionDeviceProfile::loadFolder(const std::string& strFolder, std::vector<InteractionDeviceProfile>& arrProfiles)
+{
+	std::vector<std::string> arrFiles;
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind = FindFirstFileA((strFolder + "\\*.xml").c_str(), &findData);
+	if (hFind != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			arrFiles.push_back(strFolder + "\\" + findData.cFileName);
+		} while (FindNextFileA(hFind, &findData));
+		FindClose(hFind);
+	}
+#else
+	glob_t result;
+	if (glob((strFolder + "/*.xml").c_str(), 0, NULL, &result) == 0)
+	{
+		for (size_t idx = 0; idx < result.gl_pathc; idx++)
+		{
+			arrFiles.push_back(result.gl_pathv[idx]);
+		}
+	}
+	globfree(&result);
+#endif
+
+	size_t count = 0;
+	for (auto& strFile : arrFiles)
+	{
+		count += loadFile(strFile, arrProfiles);
+	}
+	return count;
+}
+
+
+size_t InteractionDeviceProfile::loadFile(const std::string& strFilename, std::vector<InteractionDeviceProfile>& arrProfiles)
+{
+	XmlReader  reader;
+	XmlElement root;
+	if (!reader.load(strFilename, root))
+	{
+		LOG_WARNING(reader.getError());
+		return 0;
+	}
+
+	size_t count = addProfiles(root, strFilename, arrProfiles);
+	if (count > 0)
+	{
+		LOG_INFO("Loaded " << count << " device profile(s) from " << strFilename);
+	}
+	return count;
+}
+
+
+void InteractionDeviceProfile::getDefaultProfiles(std::vector<InteractionDeviceProfile>& arrProfiles)
+{
+	XmlReader  reader;
+	XmlElement root;
+	if (reader.parse(DEFAULT_PROFILES, root))
+	{
+		addProfiles(root, "default profiles", arrProfiles);
+	}
+}
+
+
+InteractionDeviceProfile::InteractionDeviceProfile() :
+	m_strType(""),
+	m_strMatch("")
+{
+	// nothing else to do
+}
+
+
+bool InteractionDeviceProfile::parse(const XmlElement& refDevice)
+{
+	m_strType  = refDevice.getAttribute("type");
+	m_strMatch = refDevice.getAttribute("match", m_strType);
+	m_arrChannelNames.clear();
+	m_arrDebounceTimes.clear();
+	m_arrDigitalRules.clear();
+	m_arrAnalogRules.clear();
+
+	for (auto& channel : refDevice.children)
+	{
+		if (channel.name != "channel") continue;
+
+		if (m_arrChannelNames.size() >= MAX_ANALOG_CHANNELS)
+		{
+			LOG_ERROR("Device profile '" << m_strType << "' has more than " << MAX_ANALOG_CHANNELS << " channels");
+			return false;
+		}
+
+		uint16_t channelIdx = (uint16_t) m_arrChannelNames.size();
+		m_arrChannelNames.push_back(channel.getAttribute("name"));
+		m_arrDebounceTimes.push_back((uint32_t) atoi(channel.getAttribute("debounce", "0").c_str()));
+
+		for (auto& rule : channel.children)
+		{
+			bool valid = true;
+			if      (rule.name == "digital") valid = parseDigitalRule(rule, channelIdx);
+			else if (rule.name == "analog")  valid = parseAnalogRule(rule, channelIdx);
+			else
+			{
+				LOG_ERROR("Unknown rule <" << rule.name << "> in device profile '" << m_strType << "'");
+				valid = false;
+			}
+			if (!valid) return false;
+		}
+	}
+
+	return !m_strMatch.empty() && !m_arrChannelNames.empty();
+}
+
+
+bool InteractionDeviceProfile::parseDigitalRule(const XmlElement& refRule, uint16_t channel)
+{
+	sDigitalRule rule;
+	rule.mask    = 0;
+	rule.pattern = 0;
+	rule.channel = channel;
+	rule.value   = refRule.getAttribute("value", 1.0f);
+
+	// every attribute "Dx" is a pin condition
+	for (auto& attribute : refRule.attributes)
+	{
+		const std::string& strName = attribute.first;
+		if ((strName.size() < 2) || (strName[0] != 'D')) continue;
+
+		int pin = atoi(strName.c_str() + 1);
+		if ((pin < 0) || (pin > MAX_DIGITAL_PIN))
+		{
+			LOG_ERROR("Invalid pin " << strName << " in device profile '" << m_strType << "'");
+			return false;
+		}
+		rule.mask |= (1 << pin);
+		if (attribute.second != "0")
+		{
+			rule.pattern |= (1 << pin);
+		}
+	}
+
+	m_arrDigitalRules.push_back(rule);
+	return true;
+}
+
+
+bool InteractionDeviceProfile::parseAnalogRule(const XmlElement& refRule, uint16_t channel)
+{
+	sAnalogRule rule;
+	std::string strInput = refRule.getAttribute("input");
+	if ((strInput.size() == 2) && (strInput[0] == 'A') && (strInput[1] >= '0') && (strInput[1] <= '3'))
+	{
+		rule.input = (uint16_t) (strInput[1] - '0');
+	}
+	else if (strInput == "supply")
+	{
+		rule.input = 7;
+	}
+	else
+	{
+		LOG_ERROR("Invalid analog input '" << strInput << "' in device profile '" << m_strType << "'");
+		return false;
+	}
+	rule.channel = channel;
+	rule.scale   = refRule.getAttribute("scale",  1.0f);
+	rule.offset  = refRule.getAttribute("offset", 0.0f);
+
+	m_arrAnalogRules.push_back(rule);
+	return true;
+}
+
+
+const std::string& InteractionDeviceProfile::getType() const
+{
+	return m_strType;
+}
+
+
+bool InteractionDeviceProfile::matches(const std::string& strNodeName) const
+{
+	return strNodeName.find(m_strMatch) != std::string::npos;
+}
+
+
+const std::vector<std::string>& InteractionDeviceProfile::getChannelNames() const
+{
+	return m_arrChannelNames;
+}
+
+
+const std::vector<uint32_t>& InteractionDeviceProfile::getDebounceTimes() const
+{
+	return m_arrDebounceTimes;
+}
+
+
+const std::vector<InteractionDeviceProfile::sDigitalRule>& InteractionDeviceProfile::getDigitalRules() const
+{
+	return m_arrDigitalRules;
+}
+
+
+const std::vector<InteractionDeviceProfile::sAnalogRule>& InteractionDeviceProfile::getAnalogRules() const
+{
+	return m_arrAnalogRules;
+}
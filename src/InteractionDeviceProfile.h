@@ -0,0 +1,132 @@
+/**
+ * Description of an interaction device type: how the inputs of an XBee module map to data channels.
+ * Profiles are read from the <interaction> section of the hardware XML files, e.g.,
+ *
+ *   <interaction>
+ *     <device type="Joystick" match="oystick">
+ *       <channel name="button1" debounce="20">
+ *         <digital D2="0" value="1" />
+ *       </channel>
+ *       <channel name="slider">
+ *         <analog input="A0" scale="0.000977" offset="0" />
+ *       </channel>
+ *     </device>
+ *   </interaction>
+ *
+ * A device profile is used for all XBee nodes whose name contains the "match" text.
+ * A channel value is the sum of its rules:
+ * - digital: adds "value" when all listed pins (D0-D12) have the given state
+ * - analog:  adds the 10 bit input value (A0-A3, or "supply") multiplied by "scale" plus "offset"
+ * Value changes within "debounce" milliseconds after the previous change are ignored.
+ *
+ * The rules are compiled into flat tables when loading,
+ * so decoding a sample is a simple loop over the table.
+ */
+
+#pragma once
+
+#include "XmlReader.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+class InteractionDeviceProfile
+{
+public:
+
+	struct sDigitalRule
+	{
+		uint16_t mask;    // pins to check
+		uint16_t pattern; // required state of these pins
+		uint16_t channel; // index of the channel to add the value to
+		float    value;   // value to add when the pins match
+	};
+
+	struct sAnalogRule
+	{
+		uint16_t input;   // index of the analog input
+		uint16_t channel; // index of the channel to add the value to
+		float    scale;
+		float    offset;
+	};
+
+public:
+
+	/**
+	 * Loads the device profiles from all XML files in a folder.
+	 *
+	 * @param strFolder    the folder with the XML files
+	 * @param arrProfiles  the list to add the profiles to
+	 *
+	 * @return the amount of profiles that were added
+	 */
+	static size_t loadFolder(const std::string& strFolder, std::vector<InteractionDeviceProfile>& arrProfiles);
+
+	/**
+	 * Loads the device profiles from an XML file.
+	 *
+	 * @param strFilename  the name of the XML file
+	 * @param arrProfiles  the list to add the profiles to
+	 *
+	 * @return the amount of profiles that were added
+	 */
+	static size_t loadFile(const std::string& strFilename, std::vector<InteractionDeviceProfile>& arrProfiles);
+
+	/**
+	 * Gets the built-in profiles to use when no profile files are found.
+	 *
+	 * @param arrProfiles  the list to add the profiles to
+	 */
+	static void getDefaultProfiles(std::vector<InteractionDeviceProfile>& arrProfiles);
+
+	/**
+	 * Creates an empty profile.
+	 */
+	InteractionDeviceProfile();
+
+	/**
+	 * Compiles the profile from a <device> XML element.
+	 *
+	 * @param refDevice  the XML element describing the device
+	 *
+	 * @return <code>true</code> if the profile is valid
+	 */
+	bool parse(const XmlElement& refDevice);
+
+	/**
+	 * Gets the type name of the device.
+	 *
+	 * @return the type name, e.g., "Joystick"
+	 */
+	const std::string& getType() const;
+
+	/**
+	 * Checks if the profile applies to an XBee node.
+	 *
+	 * @param strNodeName  the node identifier of the XBee module
+	 *
+	 * @return <code>true</code> if the profile applies to the node
+	 */
+	bool matches(const std::string& strNodeName) const;
+
+	const std::vector<std::string>&  getChannelNames()   const;
+	const std::vector<uint32_t>&     getDebounceTimes()  const; // in milliseconds, per channel
+	const std::vector<sDigitalRule>& getDigitalRules()   const;
+	const std::vector<sAnalogRule>&  getAnalogRules()    const;
+
+private:
+
+	bool parseDigitalRule(const XmlElement& refRule, uint16_t channel);
+	bool parseAnalogRule(const XmlElement& refRule, uint16_t channel);
+
+private:
+
+	std::string                m_strType;
+	std::string                m_strMatch;
+	std::vector<std::string>   m_arrChannelNames;
+	std::vector<uint32_t>      m_arrDebounceTimes;
+	std::vector<sDigitalRule>  m_arrDigitalRules;
+	std::vector<sAnalogRule>   m_arrAnalogRules;
+};
@@ -1,19 +1,101 @@
 #include "InteractionSystem.h"
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <math.h>
+#include <mutex>
 
 #include "Logging.h"
 #undef   LOG_CLASS
 #define  LOG_CLASS "InteractionSystem"
 
 
+#define DEFAULT_DISCOVERY_INTERVAL 10000 // in ms
+#define MAX_MISSED_DISCOVERIES     3     // devices without a sign of life for this many discoveries are removed
+#define MAX_FRAME_PERIOD           100   // in ms, longer gaps between frames are pauses in streaming
+
+// function in the main program
+extern void signalSceneChange();
+
+
+// state shared by the probes of one findController() call, kept alive by probes that are still busy after the call
+struct sProbeScan
+{
+	std::mutex              mtxState;
+	std::condition_variable cvFinished;
+	InteractionSystem*      pFound    = NULL;
+	size_t                  finished  = 0;
+	bool                    cancelled = false;
+	std::vector<bool>       arrFinished; // per probe
+};
+
+struct sProbe
+{
+	std::string                 strPortName;
+	std::thread                 thread;
+	std::shared_ptr<sProbeScan> pScan;
+	size_t                      index;
+};
+
+static std::mutex          mtxLateProbes;
+static std::vector<sProbe> arrLateProbes; // probes that were still busy when their findController() call returned
+
+
+/**
+ * Joins the probes of earlier findController() calls that are finished or hold one of the given ports.
+ *
+ * @param pPortNames  the ports that are needed (<code>NULL</code>: join all probes)
+ */
+static void joinProbes(const std::vector<std::string>* pPortNames)
+{
+	std::lock_guard<std::mutex> lock(mtxLateProbes);
+	for (auto iProbe = arrLateProbes.begin(); iProbe != arrLateProbes.end(); )
+	{
+		bool finished;
+		{
+			std::lock_guard<std::mutex> lockScan(iProbe->pScan->mtxState);
+			finished = iProbe->pScan->arrFinished[iProbe->index];
+		}
+		bool portNeeded = (pPortNames == NULL) ||
+			(std::find(pPortNames->begin(), pPortNames->end(), iProbe->strPortName) != pPortNames->end());
+		if (finished || portNeeded)
+		{
+			if (!finished)
+			{
+				LOG_INFO("Waiting for the probe of " << iProbe->strPortName << " to finish");
+			}
+			iProbe->thread.join();
+			iProbe = arrLateProbes.erase(iProbe);
+		}
+		else
+		{
+			++iProbe;
+		}
+	}
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
-InteractionDevice::InteractionDevice(const std::string& name) :
-	m_deviceName(name)
+InteractionDevice::InteractionDevice(int id, const std::string& name) :
+	m_deviceID(id),
+	m_deviceName(name),
+	m_snapshot(),
+	m_samplesDropped(false),
+	m_streamedCount(0)
 {
 	// nothing else to do
 }
 
 
+int InteractionDevice::getID() const
+{
+	return m_deviceID;
+}
+
+
 const std::string& InteractionDevice::getName() const
 {
 	return m_deviceName;
@@ -32,25 +114,85 @@ const std::vector<Channel>& InteractionDevice::getChannels() const
 }
 
 
+void InteractionDevice::getSnapshot(sChannelSnapshot& refSnapshot) const
+{
+	m_published.read(refSnapshot);
+}
+
+
+void InteractionDevice::publish(std::chrono::steady_clock::time_point timestamp)
+{
+	for (size_t chnIdx = 0; (chnIdx < m_arrChannels.size()) && (chnIdx < MAX_ANALOG_CHANNELS); chnIdx++)
+	{
+		m_snapshot.values[chnIdx] = m_arrChannels[chnIdx].value;
+	}
+	m_snapshot.timestamp = timestamp;
+	m_snapshot.sampleCount++;
+	m_published.write(m_snapshot);
+	if (!m_samples.push(m_snapshot))
+	{
+		// nobody is streaming at the moment
+		m_samplesDropped = true;
+	}
+}
+
+
+size_t InteractionDevice::getNewSamples(sChannelSnapshot arrSamples[], size_t maxSamples, std::chrono::steady_clock::time_point oldest)
+{
+	// collect in a circular fashion so only the latest samples are kept
+	size_t           count = 0;
+	sChannelSnapshot sample;
+	while (m_samples.pop(sample))
+	{
+		if ((int32_t) (sample.sampleCount - m_streamedCount) <= 0) continue; // already streamed
+		m_streamedCount = sample.sampleCount;
+		if (sample.timestamp < oldest) continue; // stale
+		arrSamples[count % maxSamples] = sample;
+		count++;
+	}
+
+	if (m_samplesDropped.exchange(false))
+	{
+		// the queue has been full > the latest sample might be missing
+		m_published.read(sample);
+		if (((int32_t) (sample.sampleCount - m_streamedCount) > 0) && (sample.timestamp >= oldest))
+		{
+			arrSamples[count % maxSamples] = sample;
+			m_streamedCount = sample.sampleCount;
+			count++;
+		}
+	}
+
+	if (count > maxSamples)
+	{
+		// bring the oldest of the kept samples to the front
+		std::rotate(arrSamples, arrSamples + (count % maxSamples), arrSamples + maxSamples);
+		count = maxSamples;
+	}
+	return count;
+}
+
+
 
 ///////////////////////////////////////////////////////////////////////////////
 
-InteractionDevice_Joystick::InteractionDevice_Joystick(const std::string& name, XBeeRemoteDevice& refDevice) :
-	InteractionDevice(name),
-	m_device(refDevice)
-{
-	m_arrChannels.push_back(Channel("button1"));
-	m_arrChannels.push_back(Channel("button2"));
-	m_arrChannels.push_back(Channel("button3"));
-	m_arrChannels.push_back(Channel("button4"));
-	m_arrChannels.push_back(Channel("button5"));
-	m_arrChannels.push_back(Channel("button6"));
-	m_arrChannels.push_back(Channel("axis1"));
-	m_arrChannels.push_back(Channel("axis2"));
+InteractionDevice_XBee::InteractionDevice_XBee(int id, const std::string& name, const std::shared_ptr<XBeeRemoteDevice>& pDevice, const InteractionDeviceProfile& refProfile) :
+	InteractionDevice(id, name),
+	m_pDevice(pDevice),
+	m_arrDigitalRules(refProfile.getDigitalRules()),
+	m_arrAnalogRules(refProfile.getAnalogRules())
+{
+	for (size_t chnIdx = 0; chnIdx < refProfile.getChannelNames().size(); chnIdx++)
+	{
+		m_arrChannels.push_back(Channel(refProfile.getChannelNames()[chnIdx]));
+		m_arrDebounceTimes.push_back(std::chrono::milliseconds(refProfile.getDebounceTimes()[chnIdx]));
+	}
+	m_arrDecoded.resize(m_arrChannels.size(), 0.0f);
+	m_arrLastChange.resize(m_arrChannels.size());
 }
 
 
-bool InteractionDevice_Joystick::update(const XBeePacket_Receive& refPacket)
+bool InteractionDevice_XBee::update(const XBeePacket_Receive& refPacket, std::chrono::steady_clock::time_point timestamp)
 {
 	bool success = false;
 	// is this the right packet type
@@ -58,48 +200,33 @@ bool InteractionDevice_Joystick::update(const XBeePacket_Receive& refPacket)
 	{
 		// is this from the correct device?
 		const XBeePacket_IO_DataSample& sample = (const XBeePacket_IO_DataSample&) refPacket;
-		if (sample.getNetworkAddress() == m_device.getNetworkAddress())
+		if (sample.getNetworkAddress() == m_pDevice->getNetworkAddress())
 		{
-			// yes > parse
-			uint8_t pinState  = ((uint8_t)(sample.getDigitalInputState() & 0x00FF)); // only use lower 8 bits
-			
-			bool btnPrimary   = (pinState & 0x04) == 0; // pin 2: Primary Fire pressed
-			bool btnSecondary = (pinState & 0x08) == 0; // pin 3: Secondary Fire pressed
-			bool btnThumb     = (pinState & 0x40) == 0; // pin 6: Thumb buttons pressed
-			bool btnStick     = (pinState & 0x80) == 0; // pin 7: Thumbstick moved
-			uint8_t bitsThumb = (pinState & 0x30) >> 4; // pins 4 and 5: encoded thumb button/stick direction
-
-			m_arrChannels[0].value = btnPrimary   ? 1.0f : 0;
-			m_arrChannels[1].value = btnSecondary ? 1.0f : 0;
-
-			m_arrChannels[2].value = (btnThumb & (bitsThumb == 3)) ? 1.0f : 0; // BL
-			m_arrChannels[3].value = (btnThumb & (bitsThumb == 2)) ? 1.0f : 0; // BR
-			m_arrChannels[4].value = (btnThumb & (bitsThumb == 1)) ? 1.0f : 0; // TL
-			m_arrChannels[5].value = (btnThumb & (bitsThumb == 0)) ? 1.0f : 0; // TR
-
-			float x = 0;
-			float y = 0;
-			if (btnStick)
+			// yes > walk the decoding tables
+			std::fill(m_arrDecoded.begin(), m_arrDecoded.end(), 0.0f);
+
+			uint16_t pinState = sample.getDigitalInputState();
+			for (auto& rule : m_arrDigitalRules)
 			{
-				// thumbstick pressed > translate into axis
-				switch (bitsThumb)
+				m_arrDecoded[rule.channel] += ((pinState & rule.mask) == rule.pattern) ? rule.value : 0.0f;
+			}
+			for (auto& rule : m_arrAnalogRules)
+			{
+				m_arrDecoded[rule.channel] += sample.getAnalogInputValue(rule.input) * rule.scale + rule.offset;
+			}
+
+			for (size_t chnIdx = 0; chnIdx < m_arrChannels.size(); chnIdx++)
+			{
+				// ignore changes that follow the previous one too quickly (bouncing contacts)
+				if ((m_arrDecoded[chnIdx] != m_arrChannels[chnIdx].value) &&
+				    (timestamp - m_arrLastChange[chnIdx] >= m_arrDebounceTimes[chnIdx]))
 				{
-					case 0: y = +1; break; // forward
-					case 1: x = -1; break; // left
-					case 2: x = +1; break; // right
-					case 3: y = -1; break; // backwards
+					m_arrChannels[chnIdx].value = m_arrDecoded[chnIdx];
+					m_arrLastChange[chnIdx]     = timestamp;
 				}
 			}
-			m_arrChannels[6].value = x;
-			m_arrChannels[7].value = y;
-
-			/*
-			LOG_INFO("update " << std::hex << (int) pinState << " " << btnPrimary << " " << btnSecondary
-				<< " " << m_arrChannels[2] << " " << m_arrChannels[3]
-				<< " " << m_arrChannels[4] << " " << m_arrChannels[5]
-				<< " X:" << m_arrChannels[6] << ", Y:" << m_arrChannels[7]);
-			*/
 
+			publish(timestamp);
 			success = true;
 		}
 	}
@@ -109,7 +236,16 @@ bool InteractionDevice_Joystick::update(const XBeePacket_Receive& refPacket)
 
 
 
-InteractionSystem::InteractionSystem(std::unique_ptr<SerialPort>& pPort)
+InteractionSystem::InteractionSystem(std::unique_ptr<SerialPort>& pPort) :
+	m_receiverRunning(false),
+	m_discoveryInterval(DEFAULT_DISCOVERY_INTERVAL),
+	m_devicesChanged(false),
+	m_sceneDescribed(false),
+	m_lastFrameTime(),
+	m_framePeriod(std::chrono::milliseconds(MAX_FRAME_PERIOD)),
+	m_latencyCount(0),
+	m_latencyTotal(0),
+	m_latencyMax(0)
 {
 	m_pSerialPort = std::move(pPort);
 }
@@ -124,114 +260,223 @@ InteractionSystem::~InteractionSystem()
 }
 
 
-bool InteractionSystem::initialise()
+InteractionSystem* InteractionSystem::findController(const std::vector<std::string>& arrPortNames, int timeout)
 {
-	if (m_pSerialPort && m_pSerialPort->open() && m_pSerialPort->isOpen())
+	// probes of an earlier scan that still hold one of these ports have to let go of it first
+	joinProbes(&arrPortNames);
+
+	std::shared_ptr<sProbeScan> pScan = std::make_shared<sProbeScan>();
+	pScan->arrFinished.resize(arrPortNames.size(), false);
+
+	std::vector<sProbe> arrProbes;
+	for (size_t portIdx = 0; portIdx < arrPortNames.size(); portIdx++)
 	{
-		m_pCoordinator.reset(new XBeeCoordinator(*m_pSerialPort));
-		if (m_pCoordinator->isValid())
+		std::string strPortName = arrPortNames[portIdx];
+		sProbe      probe;
+		probe.strPortName = strPortName;
+		probe.pScan       = pScan;
+		probe.index       = portIdx;
+		// the probe only shares the scan state, so it can outlive this call
+		probe.thread = std::thread([pScan, strPortName, portIdx]()
 		{
-			// detect connected devices
-			LOG_INFO("Scanning for devices...");
-			m_pCoordinator->setNumberOfRetries(20);
-			m_pCoordinator->scanDevices();
-			if (!m_pCoordinator->getConnectedDevices().empty())
+			std::unique_ptr<InteractionSystem> pSystem;
 			{
-				std::stringstream output;
-				bool firstLine = true; // avoid unnecessary line after list
-				for each (auto& node in m_pCoordinator->getConnectedDevices())
+				std::lock_guard<std::mutex> lock(pScan->mtxState);
+				if (!pScan->cancelled && (pScan->pFound == NULL))
 				{
-					if (!firstLine) output << std::endl;
-					output << " - '" << node->getName() << "': "
-						<< "Serial# " << std::hex << node->getSerialNumber()
-						<< ", Address " << std::hex << node->getNetworkAddress()
-						<< ", Type " << std::hex << node->getDeviceType()
-						<< ", Parent " << std::hex << node->getParentAddress()
-						<< ", Battery " << std::hex << (roundf(node->getBatteryVoltage() * 10) / 10) << "V";
-					firstLine = false;
-
-					if (node->getName().find("oystick") != std::string::npos)
-					{
-						m_arrDevices.push_back(
-							std::unique_ptr<InteractionDevice>(
-								new InteractionDevice_Joystick(node->getName(), *node)));
-					}
+					std::unique_ptr<SerialPort> pPort(new SerialPort(strPortName));
+					pSystem.reset(new InteractionSystem(pPort));
 				}
-				LOG_INFO("Connected devices: " << std::endl << output.str());
-
-				// start receiver thread
-				m_receiverThread = std::thread(&InteractionSystem::receiverThread, this);
-				LOG_INFO("Initialised");
 			}
-			else
+
+			// the read timeout of the coordinator limits how long an unresponsive port is probed
+			bool found = pSystem && pSystem->connect();
+
 			{
-				LOG_INFO("No devices connected");
+				std::lock_guard<std::mutex> lock(pScan->mtxState);
+				if (found && pScan->cancelled)
+				{
+					LOG_INFO("Coordinator on " << strPortName << " answered after the timeout");
+				}
+				else if (found && (pScan->pFound == NULL))
+				{
+					pScan->pFound = pSystem.release();
+				}
+				pScan->arrFinished[portIdx] = true;
+				pScan->finished++;
 			}
+			pScan->cvFinished.notify_all();
+			// any other system is not the first > its port is closed here, before the thread ends
+		});
+		arrProbes.push_back(std::move(probe));
+	}
+
+	InteractionSystem* pFound = NULL;
+	{
+		std::unique_lock<std::mutex> lock(pScan->mtxState);
+		pScan->cvFinished.wait_for(lock, std::chrono::milliseconds(timeout), [&]()
+		{
+			return (pScan->pFound != NULL) || (pScan->finished == arrPortNames.size());
+		});
+		// from now on, no probe hands over a system
+		pScan->cancelled = true;
+		pFound = pScan->pFound;
+	}
 
+	// probes that are still busy (e.g., opening a Bluetooth port) close their port when they are done,
+	// they are joined before the next scan of that port or at shutdown
+	std::lock_guard<std::mutex> lock(mtxLateProbes);
+	for (auto& probe : arrProbes)
+	{
+		bool finished;
+		{
+			std::lock_guard<std::mutex> lockScan(pScan->mtxState);
+			finished = pScan->arrFinished[probe.index];
 		}
+		if (finished)
+		{
+			probe.thread.join();
+		}
+		else
+		{
+			arrLateProbes.push_back(std::move(probe));
+		}
+	}
+	return pFound;
+}
+
+
+void InteractionSystem::finishProbes()
+{
+	joinProbes(NULL);
+}
+
+
+bool InteractionSystem::connect()
+{
+	if (!m_pCoordinator && m_pSerialPort && m_pSerialPort->open() && m_pSerialPort->isOpen())
+	{
+		m_pCoordinator.reset(new XBeeCoordinator(*m_pSerialPort));
 	}
 	return isActive();
 }
 
 
-bool InteractionSystem::isActive()
+void InteractionSystem::setProfiles(const std::vector<InteractionDeviceProfile>& arrProfiles)
+{
+	m_arrProfiles = arrProfiles;
+}
+
+
+void InteractionSystem::setDiscoveryInterval(int interval)
+{
+	m_discoveryInterval = std::chrono::milliseconds((interval > 0) ? interval : 0);
+}
+
+
+bool InteractionSystem::initialise()
+{
+	if (m_arrProfiles.empty())
+	{
+		InteractionDeviceProfile::getDefaultProfiles(m_arrProfiles);
+	}
+
+	if (connect() && !m_receiverThread.joinable())
+	{
+		// devices are discovered by the receiver thread, so the stream does not need to wait
+		LOG_INFO("Discovering devices in the background...");
+		m_receiverRunning = true;
+		m_receiverThread = std::thread(&InteractionSystem::receiverThread, this);
+		LOG_INFO("Initialised");
+	}
+	return isActive();
+}
+
+
+bool InteractionSystem::isActive() const
 {
 	return (m_pCoordinator && m_pCoordinator->isValid());
 }
 
 
+std::string InteractionSystem::getPortName() const
+{
+	return m_pSerialPort ? m_pSerialPort->getName() : "";
+}
+
+
 void InteractionSystem::getSceneDescription(MoCapData& refData)
 {
-	int plateID = 0;
+	applyDeviceChanges(refData);
 
 	// fill in each device
-	for each ( auto& device in m_arrDevices )
-	{
-		// create and zero new description structure
-		sForcePlateDescription* pForce = new sForcePlateDescription();
-		memset(pForce, 0, sizeof(*pForce));
-		
-		// plate ID (start counting at 1)
-		plateID++; pForce->ID = plateID; 
-		// plate serial#/name
-		strncpy_s(pForce->strSerialNo, device->getName().c_str(), sizeof(pForce->strSerialNo));
-		
-		// channel information
-		pForce->nChannels = device->getChannelCount(); // channel count
-		for (size_t chnIdx = 0; chnIdx < device->getChannelCount(); chnIdx++)
-		{
-			strncpy_s(
-				pForce->szChannelNames[chnIdx], 
-				device->getChannels()[chnIdx].name.c_str(), 
-				sizeof(pForce->szChannelNames[chnIdx]));
-		}
-
-		sDataDescription& refDescription = refData.description.arrDataDescriptions[refData.description.nDataDescriptions];
-		refDescription.type = DataDescriptors::Descriptor_ForcePlate;
-		refDescription.Data.ForcePlateDescription = pForce;
-		refData.description.nDataDescriptions++; // that was one desciption more
+	for (auto& device : m_arrDevices)
+	{
+		addDescription(*device, refData);
 	}
+	m_sceneDescribed = true;
 }
 
 
 void InteractionSystem::getFrameData(MoCapData& refData)
 {
-	refData.frame.nForcePlates = m_arrDevices.size(); // number of plates/devices
+	TRACE_SCOPE("interaction frame data");
+	applyDeviceChanges(refData);
+
+	size_t nPlates = std::min(m_arrDevices.size(), (size_t) MAX_FORCEPLATES);
+	refData.frame.nForcePlates = (int) nPlates; // number of plates/devices
 	
-	int plateID = 0;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	sChannelSnapshot arrSamples[MAX_ANALOG_SUBFRAMES];
+
+	// after a pause in streaming, the queued samples are history > only stream the last frame period
+	std::chrono::steady_clock::time_point oldest = std::chrono::steady_clock::time_point::min();
+	std::chrono::nanoseconds              gap    = now - m_lastFrameTime;
+	if (gap > std::chrono::milliseconds(MAX_FRAME_PERIOD))
+	{
+		oldest = now - m_framePeriod;
+	}
+	else
+	{
+		m_framePeriod = gap;
+	}
+	m_lastFrameTime = now;
+
 	// fill in each device channel values
-	for each (auto& device in m_arrDevices)
+	for (size_t plateIdx = 0; plateIdx < nPlates; plateIdx++)
 	{
-		sForcePlateData& refForce = refData.frame.ForcePlates[plateID];
-		// plate ID (start counting at 1)
-		plateID++; refForce.ID = plateID; 
+		InteractionDevice& device = *m_arrDevices[plateIdx];
+
+		// every sample since the last frame becomes a subframe, so short button presses are not lost
+		size_t nSamples = device.getNewSamples(arrSamples, MAX_ANALOG_SUBFRAMES, oldest);
+		for (size_t sIdx = 0; sIdx < nSamples; sIdx++)
+		{
+			std::chrono::nanoseconds latency = now - arrSamples[sIdx].timestamp;
+			m_latencyCount++;
+			m_latencyTotal += latency;
+			m_latencyMax    = std::max(m_latencyMax, latency);
+		}
+		if (nSamples == 0)
+		{
+			// nothing new > repeat the latest values
+			device.getSnapshot(arrSamples[0]);
+			nSamples = 1;
+		}
+
+		sForcePlateData& refForce = refData.frame.ForcePlates[plateIdx];
+		// plate ID (stays the same while devices come and go)
+		refForce.ID = device.getID(); 
 		// channel count
-		refForce.nChannels = device->getChannelCount();  
+		refForce.nChannels = device.getChannelCount();  
 		// values
-		for (size_t chnIdx = 0; chnIdx < device->getChannelCount(); chnIdx++)
+		for (size_t chnIdx = 0; chnIdx < device.getChannelCount(); chnIdx++)
 		{
-			refForce.ChannelData[chnIdx].nFrames   = 1; // 1 subframe
-			refForce.ChannelData[chnIdx].Values[0] = device->getChannels()[chnIdx].value;
+			sAnalogChannelData& refChannel = refForce.ChannelData[chnIdx];
+			refChannel.nFrames = (int) nSamples;
+			for (size_t sIdx = 0; sIdx < nSamples; sIdx++)
+			{
+				refChannel.Values[sIdx] = arrSamples[sIdx].values[chnIdx];
+			}
 		}
 		// parameters
 		refForce.params = 0; 
@@ -239,18 +484,123 @@ void InteractionSystem::getFrameData(MoCapData& refData)
 }
 
 
+void InteractionSystem::applyDeviceChanges(MoCapData& refData)
+{
+	if (!m_devicesChanged) return;
+
+	std::unique_ptr<DeviceList> pDevices;
+	{
+		std::lock_guard<std::mutex> lock(m_mtxDevices);
+		pDevices = std::move(m_pPendingDevices);
+		m_devicesChanged = false;
+	}
+	if (!pDevices) return;
+
+	m_arrDevices.swap(*pDevices);
+	if (!m_sceneDescribed) return;
+
+	// remove the descriptions of devices that are gone, keep the others as they are
+	sDataDescriptions& refDescr = refData.description;
+	std::vector<int>   arrDescribed;
+	int                idxDataBlock = 0;
+	for (int idx = 0; idx < refDescr.nDataDescriptions; idx++)
+	{
+		sDataDescription& refDescription = refDescr.arrDataDescriptions[idx];
+		if (refDescription.type == Descriptor_ForcePlate)
+		{
+			int  id      = refDescription.Data.ForcePlateDescription->ID;
+			bool present = std::any_of(m_arrDevices.begin(), m_arrDevices.end(),
+				[id](const std::shared_ptr<InteractionDevice>& pDevice) { return pDevice->getID() == id; });
+			if (!present)
+			{
+				MoCapData::freeNatNetForcePlateDescription(refDescription.Data.ForcePlateDescription);
+				refDescription.Data.ForcePlateDescription = NULL;
+				continue;
+			}
+			arrDescribed.push_back(id);
+		}
+		refDescr.arrDataDescriptions[idxDataBlock] = refDescription;
+		idxDataBlock++;
+	}
+	refDescr.nDataDescriptions = idxDataBlock;
+
+	// add the descriptions of new devices
+	for (auto& device : m_arrDevices)
+	{
+		if (std::find(arrDescribed.begin(), arrDescribed.end(), device->getID()) == arrDescribed.end())
+		{
+			addDescription(*device, refData);
+		}
+	}
+
+	LOG_INFO("Device list updated (" << m_arrDevices.size() << " devices)");
+	signalSceneChange();
+}
+
+
+void InteractionSystem::addDescription(const InteractionDevice& refDevice, MoCapData& refData)
+{
+	if (refData.description.nDataDescriptions >= MAX_MODELS)
+	{
+		LOG_ERROR("Too many descriptions, dropping description of device '" << refDevice.getName() << "'");
+		return;
+	}
+
+	// create and zero new description structure
+	sForcePlateDescription* pForce = new sForcePlateDescription();
+	memset(pForce, 0, sizeof(*pForce));
+	
+	// plate ID
+	pForce->ID = refDevice.getID(); 
+	// plate serial#/name
+	strncpy_s(pForce->strSerialNo, refDevice.getName().c_str(), sizeof(pForce->strSerialNo));
+	
+	// channel information
+	pForce->nChannels = refDevice.getChannelCount(); // channel count
+	for (size_t chnIdx = 0; chnIdx < refDevice.getChannelCount(); chnIdx++)
+	{
+		strncpy_s(
+			pForce->szChannelNames[chnIdx], 
+			refDevice.getChannels()[chnIdx].name.c_str(), 
+			sizeof(pForce->szChannelNames[chnIdx]));
+	}
+
+	sDataDescription& refDescription = refData.description.arrDataDescriptions[refData.description.nDataDescriptions];
+	refDescription.type = DataDescriptors::Descriptor_ForcePlate;
+	refDescription.Data.ForcePlateDescription = pForce;
+	refData.description.nDataDescriptions++; // that was one desciption more
+}
+
+
+void InteractionSystem::printLatencyStatistics(std::ostream& refOutput) const
+{
+	refOutput << "Interaction System Latency Statistics" << std::endl
+		<< "\tSamples:         " << m_latencyCount << std::endl;
+	if (m_latencyCount > 0)
+	{
+		refOutput
+			<< "\tAverage latency: " << (m_latencyTotal.count() / m_latencyCount / 1000) << "us" << std::endl
+			<< "\tMaximum latency: " << (m_latencyMax.count() / 1000) << "us" << std::endl;
+	}
+}
+
+
 bool InteractionSystem::deinitialise()
 {
 	if (isActive())
 	{
-		m_pCoordinator.reset(NULL);
-		m_pSerialPort.reset(NULL);
-
+		// stop the receiver thread before the coordinator it uses is gone
+		m_receiverRunning = false;
 		if (m_receiverThread.joinable())
 		{
 			m_receiverThread.join();
 		}
 
+		m_mapAddresses.clear();
+		m_mapNodes.clear();
+		m_pCoordinator.reset(NULL);
+		m_pSerialPort.reset(NULL);
+
 		LOG_INFO("Deinitialised");
 	}
 	return true;
@@ -259,24 +609,204 @@ bool InteractionSystem::deinitialise()
 
 void InteractionSystem::receiverThread()
 {
+	typedef std::chrono::steady_clock clock;
+
+	TraceRecorder::setThreadName("Interaction receiver");
 	LOG_INFO("Receiver Thread started");
-	while (isActive())
+
+	std::chrono::milliseconds discoveryTimeout(m_pCoordinator->getDiscoveryTimeout());
+	bool                      discovering   = false;
+	clock::time_point         nextDiscovery = clock::now(); // first discovery right away
+	clock::time_point         discoveryEnd;
+
+	while (m_receiverRunning)
 	{
-		// start receiving
-		std::unique_ptr<XBeePacket_Receive> packet = m_pCoordinator->receive();
-		if (packet)
+		// discovery in the background: the answers arrive between the IO samples
+		clock::time_point now = clock::now();
+		if (discovering && (now >= discoveryEnd))
 		{
-			for each (auto& device in m_arrDevices)
+			// every device has had the chance to answer
+			TRACE_SCOPE("finish discovery");
+			finishDiscovery();
+			discovering   = false;
+			nextDiscovery = (m_discoveryInterval.count() > 0) ? (now + m_discoveryInterval) : clock::time_point::max();
+		}
+		if (!discovering && (now >= nextDiscovery))
+		{
+			discovering   = m_pCoordinator->startDiscovery();
+			discoveryEnd  = now + discoveryTimeout;
+			nextDiscovery = now + discoveryTimeout; // when sending failed
+		}
+
+		const XBeePacket_Receive* pPacket = m_pCoordinator->receive();
+		if (pPacket == NULL)
+		{
+			continue;
+		}
+		std::chrono::steady_clock::time_point timestamp = clock::now();
+		TRACE_SCOPE("handle packet");
+
+		switch (pPacket->getFrameTypeID())
+		{
+		case XBeePacket_IO_DataSample::FRAME_TYPE_ID:
+		{
+			// IO samples go straight to the device with the sender's address
+			const XBeePacket_IO_DataSample& sample = (const XBeePacket_IO_DataSample&) *pPacket;
+			auto iNode = m_mapAddresses.find(sample.getNetworkAddress());
+			if (iNode != m_mapAddresses.end())
 			{
-				if (device->update(*packet))
+				iNode->second->seen = true;
+				if (iNode->second->pDevice)
 				{
-					// packet was parsed > no need to continue
-					break;
+					iNode->second->pDevice->update(*pPacket, timestamp);
 				}
 			}
+			else if (!discovering && (m_discoveryInterval.count() > 0))
+			{
+				// unknown sender > don't wait for the regular discovery
+				nextDiscovery = std::min(nextDiscovery, now + discoveryTimeout);
+			}
+			break;
+		}
+
+		case XBeePacket_AT_CommandResponse::FRAME_TYPE_ID:
+		{
+			const XBeePacket_AT_CommandResponse& response = (const XBeePacket_AT_CommandResponse&) *pPacket;
+			if ((response.getCommand() == "ND") && response.isOK())
+			{
+				handleDiscoveryResponse(response);
+			}
+			break;
+		}
+
+		case XBeePacket_RemoteAT_CommandResponse::FRAME_TYPE_ID:
+		{
+			const XBeePacket_RemoteAT_CommandResponse& response = (const XBeePacket_RemoteAT_CommandResponse&) *pPacket;
+			auto iNode = m_mapNodes.find(response.getSerialNumber());
+			if ((iNode != m_mapNodes.end()) && iNode->second.pNode->update(response) && (response.getCommand() == "%V"))
+			{
+				XBeeRemoteDevice& node = *iNode->second.pNode;
+				LOG_INFO("Device '" << node.getName() << "': Battery " << (roundf(node.getBatteryVoltage() * 10) / 10) << "V");
+			}
+			break;
+		}
+
+		default:
+			break;
 		}
 	}
 	LOG_INFO("Receiver Thread stopped");
 }
 
 
+void InteractionSystem::handleDiscoveryResponse(const XBeePacket_AT_CommandResponse& refResponse)
+{
+	std::shared_ptr<XBeeRemoteDevice> pNode(new XBeeRemoteDevice(*m_pCoordinator, refResponse.getRawData()));
+
+	auto iNode = m_mapNodes.find(pNode->getSerialNumber());
+	if (iNode != m_mapNodes.end())
+	{
+		// known device > it might have rejoined the network with a new address
+		sNode& refNode = iNode->second;
+		refNode.seen = true;
+		if (refNode.pNode->getNetworkAddress() != pNode->getNetworkAddress())
+		{
+			m_mapAddresses.erase(refNode.pNode->getNetworkAddress());
+			refNode.pNode->setNetworkAddress(pNode->getNetworkAddress());
+			m_mapAddresses[pNode->getNetworkAddress()] = &refNode;
+		}
+		return;
+	}
+
+	// new device
+	sNode& refNode = m_mapNodes[pNode->getSerialNumber()];
+	refNode.pNode             = pNode;
+	refNode.missedDiscoveries = 0;
+	refNode.seen              = true;
+	m_mapAddresses[pNode->getNetworkAddress()] = &refNode;
+
+	std::stringstream output;
+	output << "'" << pNode->getName() << "': "
+		<< "Serial# " << std::hex << pNode->getSerialNumber()
+		<< ", Address " << std::hex << pNode->getNetworkAddress()
+		<< ", Type " << std::hex << pNode->getDeviceType()
+		<< ", Parent " << std::hex << pNode->getParentAddress();
+
+	// find the profile for the device
+	for (auto& profile : m_arrProfiles)
+	{
+		if (profile.matches(pNode->getName()))
+		{
+			// a device that reconnects gets its previous ID back
+			auto iID = m_mapDeviceIDs.find(pNode->getSerialNumber());
+			int  id  = (iID != m_mapDeviceIDs.end()) ? iID->second : ((int) m_mapDeviceIDs.size() + 1);
+			m_mapDeviceIDs[pNode->getSerialNumber()] = id;
+
+			output << ", Profile '" << profile.getType() << "', ID " << std::dec << id;
+			refNode.pDevice.reset(new InteractionDevice_XBee(id, pNode->getName(), pNode, profile));
+			break;
+		}
+	}
+	LOG_INFO("Device connected: " << output.str());
+
+	// the answer arrives later like any other packet
+	pNode->requestBatteryVoltage();
+
+	if (refNode.pDevice)
+	{
+		publishDevices();
+	}
+}
+
+
+void InteractionSystem::finishDiscovery()
+{
+	bool changed = false;
+	for (auto iNode = m_mapNodes.begin(); iNode != m_mapNodes.end(); )
+	{
+		sNode& refNode = iNode->second;
+		refNode.missedDiscoveries = refNode.seen ? 0 : (refNode.missedDiscoveries + 1);
+		refNode.seen = false;
+
+		if (refNode.missedDiscoveries >= MAX_MISSED_DISCOVERIES)
+		{
+			LOG_INFO("Device disconnected: '" << refNode.pNode->getName() << "'");
+			auto iAddress = m_mapAddresses.find(refNode.pNode->getNetworkAddress());
+			if ((iAddress != m_mapAddresses.end()) && (iAddress->second == &refNode))
+			{
+				m_mapAddresses.erase(iAddress);
+			}
+			changed |= (refNode.pDevice != NULL);
+			iNode = m_mapNodes.erase(iNode);
+		}
+		else
+		{
+			++iNode;
+		}
+	}
+
+	if (changed)
+	{
+		publishDevices();
+	}
+}
+
+
+void InteractionSystem::publishDevices()
+{
+	std::unique_ptr<DeviceList> pDevices(new DeviceList());
+	for (auto& node : m_mapNodes)
+	{
+		if (node.second.pDevice)
+		{
+			pDevices->push_back(node.second.pDevice);
+		}
+	}
+	// stable order of the force plates
+	std::sort(pDevices->begin(), pDevices->end(),
+		[](const std::shared_ptr<InteractionDevice>& pA, const std::shared_ptr<InteractionDevice>& pB) { return pA->getID() < pB->getID(); });
+
+	std::lock_guard<std::mutex> lock(m_mtxDevices);
+	m_pPendingDevices = std::move(pDevices);
+	m_devicesChanged  = true;
+}
@@ -1,9 +1,19 @@
 #pragma once
 
 #include "XBeeDevice.h"
+#include "InteractionDeviceProfile.h"
 #include "MoCapData.h"
-
+#include "SeqLock.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <thread>
+#include <unordered_map>
 
 
 /**
@@ -26,6 +36,18 @@ public:
 
 
 
+/**
+ * Consistent set of channel values of a device.
+ */
+struct sChannelSnapshot
+{
+	float                                 values[MAX_ANALOG_CHANNELS];
+	std::chrono::steady_clock::time_point timestamp;   // time the sample was received
+	uint32_t                              sampleCount; // incremented with every sample
+};
+
+
+
 /**
  * Abstract base class for a single interaction device and its data channels.
  */
@@ -36,12 +58,20 @@ public:
 	/**
 	 * Creates an interaction device instance.
 	 *
+	 * @param id    the ID of the device (used as force plate ID)
 	 * @param name  the name of the device
 	 */
-	InteractionDevice(const std::string& name);
+	InteractionDevice(int id, const std::string& name);
 
 	virtual ~InteractionDevice() { }
 
+	/**
+	 * Gets the ID of the interaction device.
+	 *
+	 * @return  the ID of the device
+	 */
+	int getID() const;
+
 	/**
 	 * Gets the name of the interaction device.
 	 *
@@ -57,7 +87,8 @@ public:
 	size_t getChannelCount() const;
 
 	/**
-	 * Gets the list of data channels
+	 * Gets the list of data channels.
+	 * The values are only valid on the receiver thread, other threads use getSnapshot().
 	 *
 	 * @return  the list of data channels
 	 */
@@ -67,42 +98,95 @@ public:
 	 * Updates the data from a received packet.
 	 *
 	 * @param  refPacket  the received packet
+	 * @param  timestamp  the time the packet was received
 	 *
 	 * @return <code>true</code> if the packet was parsed successfully
 	 */
-	virtual bool update(const XBeePacket_Receive& refPacket) = 0;
+	virtual bool update(const XBeePacket_Receive& refPacket, std::chrono::steady_clock::time_point timestamp) = 0;
+
+	/**
+	 * Gets a consistent copy of the channel values of the latest sample.
+	 * Can be called from any thread while the receiver thread is updating the device.
+	 *
+	 * @param  refSnapshot  the structure to copy the values into
+	 */
+	void getSnapshot(sChannelSnapshot& refSnapshot) const;
+
+	/**
+	 * Gets the samples that were received since the last call, oldest first.
+	 * If there are more samples than fit into the array, only the latest ones are returned.
+	 * Samples received before <code>oldest</code> are discarded,
+	 * e.g., the ones that queued up while nobody was streaming.
+	 * Must only be called from one thread (the streaming thread).
+	 *
+	 * @param  arrSamples  the array to copy the samples into
+	 * @param  maxSamples  the size of the array
+	 * @param  oldest      the time of the oldest sample to return
+	 *
+	 * @return the amount of samples copied into the array (0: no new samples)
+	 */
+	size_t getNewSamples(sChannelSnapshot arrSamples[], size_t maxSamples, std::chrono::steady_clock::time_point oldest);
 
 protected:
 
-	std::string          m_deviceName;
-	std::vector<Channel> m_arrChannels;
+	/**
+	 * Publishes the current channel values for getSnapshot() and getNewSamples().
+	 * Called by update() implementations after changing the values.
+	 *
+	 * @param  timestamp  the time the sample was received
+	 */
+	void publish(std::chrono::steady_clock::time_point timestamp);
+
+protected:
+
+	int                        m_deviceID;
+	std::string                m_deviceName;
+	std::vector<Channel>       m_arrChannels;
+
+private:
+
+	sChannelSnapshot                 m_snapshot;       // only used by the receiver thread
+	SeqLock<sChannelSnapshot>        m_published;      // latest sample
+	SpscQueue<sChannelSnapshot, 64>  m_samples;        // samples not streamed yet
+	std::atomic<bool>                m_samplesDropped; // queue was full
+	uint32_t                         m_streamedCount;  // sample count of the last streamed sample
 
 };
 
 
 
 /**
- * Class for a Joystick interaction device.
+ * Class for an XBee based interaction device, decoded by a device profile.
  */
-class InteractionDevice_Joystick : public InteractionDevice
+class InteractionDevice_XBee : public InteractionDevice
 {
 public:
 
 	/**
-	* Creates a Joystick interaction device instance.
-	*
-	* @param name       the name of the device
-	* @param refDevice  the XBee device for the joystick
-	*/
-	InteractionDevice_Joystick(const std::string& name, XBeeRemoteDevice& refDevice);
+	 * Creates an XBee interaction device instance.
+	 *
+	 * @param id          the ID of the device
+	 * @param name        the name of the device
+	 * @param pDevice     the XBee device
+	 * @param refProfile  the profile describing the channels of the device
+	 */
+	InteractionDevice_XBee(int id, const std::string& name, const std::shared_ptr<XBeeRemoteDevice>& pDevice, const InteractionDeviceProfile& refProfile);
 
-	virtual ~InteractionDevice_Joystick() { }
+	virtual ~InteractionDevice_XBee() { }
 
-	virtual bool update(const XBeePacket_Receive& refPacket);
+	virtual bool update(const XBeePacket_Receive& refPacket, std::chrono::steady_clock::time_point timestamp);
 
 protected:
 
-	XBeeRemoteDevice& m_device;
+	std::shared_ptr<XBeeRemoteDevice> m_pDevice;
+
+	// decoding tables, copied from the profile
+	std::vector<InteractionDeviceProfile::sDigitalRule> m_arrDigitalRules;
+	std::vector<InteractionDeviceProfile::sAnalogRule>  m_arrAnalogRules;
+	std::vector<std::chrono::milliseconds>              m_arrDebounceTimes;
+
+	std::vector<float>                                  m_arrDecoded;     // channel values before debouncing
+	std::vector<std::chrono::steady_clock::time_point>  m_arrLastChange;  // time of the last accepted change per channel
 
 };
 
@@ -128,7 +212,54 @@ public:
 	~InteractionSystem();
 
 	/**
-	 * Initialises the system by opening the serial port and polling for connected devices.
+	 * Probes several serial ports in parallel for an XBee coordinator.
+	 * Returns as soon as the first coordinator answered, or at the latest when the timeout has passed.
+	 * Probes that are still busy then (some ports, e.g., Bluetooth serial ports, can block for a while
+	 * when being opened) close their port when they are done, and a coordinator answering late is dropped.
+	 * They are waited for before their port is probed again, or in finishProbes().
+	 *
+	 * @param arrPortNames  the names of the ports to probe, e.g., "COM3"
+	 * @param timeout       the time in milliseconds to wait for a coordinator to answer
+	 *
+	 * @return the connected, but not yet initialised system
+	 *         (or <code>NULL</code> if no coordinator was found)
+	 */
+	static InteractionSystem* findController(const std::vector<std::string>& arrPortNames, int timeout);
+
+	/**
+	 * Waits for the probes of findController() that were still busy when it returned.
+	 * Needs to be called before shutting down.
+	 */
+	static void finishProbes();
+
+	/**
+	 * Opens the serial port and checks if an XBee coordinator answers.
+	 * This is quicker than initialise() because there is no scan for devices.
+	 *
+	 * @return <code>true</code> if a coordinator was found
+	 */
+	bool connect();
+
+	/**
+	 * Sets the profiles for recognising and decoding devices.
+	 * Needs to be called before initialise(). Without profiles, the built-in ones are used.
+	 *
+	 * @param arrProfiles  the device profiles
+	 */
+	void setProfiles(const std::vector<InteractionDeviceProfile>& arrProfiles);
+
+	/**
+	 * Sets the time between two discoveries of devices.
+	 * Needs to be called before initialise().
+	 *
+	 * @param interval  the time between discoveries in milliseconds (0: only discover once)
+	 */
+	void setDiscoveryInterval(int interval);
+
+	/**
+	 * Initialises the system by opening the serial port and starting the receiver thread.
+	 * The receiver thread discovers the devices in the background, and repeats that regularly,
+	 * so devices that are switched on later are added and devices that are switched off are removed.
 	 *
 	 * @return <code>true</code> if initialisation was succesful
 	 */
@@ -139,10 +270,19 @@ public:
 	 *
 	 * @return <code>true</code> if initialisation was succesful
 	 */
-	bool isActive();
+	bool isActive() const;
+
+	/**
+	 * Gets the name of the serial port the system is using.
+	 *
+	 * @return the name of the serial port (empty if the system is not active)
+	 */
+	std::string getPortName() const;
 
 	/**
 	 * Fills in the interaction device descriptions into the MoCap description structure.
+	 * From then on, getFrameData() keeps the descriptions up to date when devices come and go.
+	 * Needs to be protected by the same lock as getFrameData().
 	 *
 	 * @param refData  the MoCap data structure to fill in
 	 */
@@ -150,11 +290,19 @@ public:
 
 	/**
 	 * Fills in the interaction device data into the MoCap data structure.
+	 * Changes of the device list are applied here, so frame and description always match.
 	 *
 	 * @param refData  the MoCap data structure to fill in
 	 */
 	void getFrameData(MoCapData& refData);
 	
+	/**
+	 * Prints statistics about the time between receiving samples and streaming them.
+	 *
+	 * @param refOutput  the stream to print to
+	 */
+	void printLatencyStatistics(std::ostream& refOutput) const;
+
 	/**
 	 * Deinitialises the system by closing the serial port and releasing it.
 	 *
@@ -165,17 +313,86 @@ public:
 protected:
 
 	/**
-	 * Thread that receives data from the XBee devices in the background.
+	 * Thread that receives data from the XBee devices in the background
+	 * and regularly discovers the devices.
 	 */
 	void receiverThread();
 
+	/**
+	 * Adds a newly discovered device or updates a known one (receiver thread).
+	 *
+	 * @param refResponse  the response to the discovery command
+	 */
+	void handleDiscoveryResponse(const XBeePacket_AT_CommandResponse& refResponse);
+
+	/**
+	 * Removes the devices that have not shown any sign of life for several discoveries (receiver thread).
+	 */
+	void finishDiscovery();
+
+	/**
+	 * Hands the current list of devices over to the streaming thread (receiver thread).
+	 */
+	void publishDevices();
+
+	/**
+	 * Takes over a new list of devices from the receiver thread
+	 * and updates the force plate descriptions (streaming thread).
+	 *
+	 * @param refData  the MoCap data structure with the descriptions
+	 */
+	void applyDeviceChanges(MoCapData& refData);
+
+	/**
+	 * Adds the force plate description of a device.
+	 *
+	 * @param refDevice  the device to describe
+	 * @param refData    the MoCap data structure to add the description to
+	 */
+	void addDescription(const InteractionDevice& refDevice, MoCapData& refData);
+
 protected:
 
+	typedef std::vector<std::shared_ptr<InteractionDevice>> DeviceList;
+
+	struct sNode
+	{
+		std::shared_ptr<XBeeRemoteDevice>  pNode;
+		std::shared_ptr<InteractionDevice> pDevice;           // NULL if there is no profile for the node
+		int                                missedDiscoveries; // discoveries in a row without a sign of life
+		bool                               seen;              // answered or sent data since the last discovery
+	};
+
 	std::unique_ptr<SerialPort>      m_pSerialPort;
 	std::unique_ptr<XBeeCoordinator> m_pCoordinator;
 	std::thread                      m_receiverThread;
+	std::atomic<bool>                m_receiverRunning;
+
+	std::vector<InteractionDeviceProfile> m_arrProfiles;
+	std::chrono::milliseconds             m_discoveryInterval;
+
+	// only used by the receiver thread
+	std::map<uint64_t, sNode>            m_mapNodes;       // known nodes by serial#
+	std::unordered_map<uint16_t, sNode*> m_mapAddresses;   // known nodes by XBee network address
+	std::map<uint64_t, int>              m_mapDeviceIDs;   // device ID by serial#, kept when a device reconnects
+
+	// device list handed over from the receiver thread to the streaming thread
+	std::mutex                           m_mtxDevices;
+	std::unique_ptr<DeviceList>          m_pPendingDevices;
+	std::atomic<bool>                    m_devicesChanged;
+
+	// only used by the streaming thread
+	DeviceList                           m_arrDevices;
+	bool                                 m_sceneDescribed; // force plate descriptions need to be kept up to date
+
+	// time of the previous frame and the regular time between frames (only used in getFrameData)
+	std::chrono::steady_clock::time_point m_lastFrameTime;
+	std::chrono::nanoseconds              m_framePeriod;
 
-	std::vector<std::unique_ptr<InteractionDevice>> m_arrDevices;
+	// latency from receiving a sample to streaming it (only used in getFrameData)
+	uint64_t                     m_latencyCount;
+	std::chrono::nanoseconds     m_latencyTotal;
+	std::chrono::nanoseconds     m_latencyMax;
 
 };
 
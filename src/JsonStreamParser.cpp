@@ -0,0 +1,428 @@
+#include "JsonStreamParser.h"
+
+#include <clocale>
+#include <stdlib.h>
+#include <sstream>
+
+
+#define MAX_DEPTH 200 // maximum nesting of objects and arrays
+
+
+static inline bool isDigit(char c)
+{
+	return (c >= '0') && (c <= '9');
+}
+
+
+/**
+ * Checks a number against the JSON grammar: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+ * strtod() alone would accept more, e.g., "01", "1.", or "-".
+ */
+static bool isJsonNumber(const std::string& strNumber)
+{
+	const char* p = strNumber.c_str();
+	if (*p == '-') p++;
+
+	// integer part without leading zeros
+	if (*p == '0')
+	{
+		p++;
+	}
+	else if ((*p >= '1') && (*p <= '9'))
+	{
+		while (isDigit(*p)) p++;
+	}
+	else
+	{
+		return false;
+	}
+
+	if (*p == '.')
+	{
+		p++;
+		if (!isDigit(*p)) return false;
+		while (isDigit(*p)) p++;
+	}
+
+	if ((*p == 'e') || (*p == 'E'))
+	{
+		p++;
+		if ((*p == '+') || (*p == '-')) p++;
+		if (!isDigit(*p)) return false;
+		while (isDigit(*p)) p++;
+	}
+
+	return *p == '\0';
+}
+
+
+JsonStreamParser::JsonStreamParser(JsonStreamHandler& refHandler) :
+	handler(refHandler)
+{
+	reset();
+}
+
+
+void JsonStreamParser::reset()
+{
+	expect        = EXPECT_VALUE;
+	token         = TOKEN_NONE;
+	tokenIsKey    = false;
+	escape        = false;
+	unicodeDigits = 0;
+	unicodeValue  = 0;
+	highSurrogate = 0;
+	position      = 0;
+	tokenBuffer.clear();
+	stack.clear();
+	strError.clear();
+}
+
+
+bool JsonStreamParser::parse(const char* pData, size_t length)
+{
+	if (!strError.empty()) return false;
+
+	for (size_t idx = 0; idx < length; idx++, position++)
+	{
+		char c = pData[idx];
+
+		// continue a token that may have started in an earlier chunk
+		if (token == TOKEN_STRING)
+		{
+			if (!parseStringChar(c)) return false;
+			continue;
+		}
+		else if (token == TOKEN_NUMBER)
+		{
+			if (((c >= '0') && (c <= '9')) || (c == '-') || (c == '+') || (c == '.') || (c == 'e') || (c == 'E'))
+			{
+				tokenBuffer += c;
+				continue;
+			}
+			if (!finishNumber()) return false;
+		}
+		else if (token == TOKEN_LITERAL)
+		{
+			if ((c >= 'a') && (c <= 'z'))
+			{
+				tokenBuffer += c;
+				continue;
+			}
+			if (!finishLiteral()) return false;
+		}
+
+		if ((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r')) continue;
+
+		bool valid = true;
+		switch (expect)
+		{
+			case EXPECT_VALUE_OR_ARRAY_END:
+				valid = (c == ']') ? endContainer(c) : startValue(c);
+				break;
+
+			case EXPECT_VALUE:
+				valid = startValue(c);
+				break;
+
+			case EXPECT_KEY_OR_OBJECT_END:
+				if (c == '}')
+				{
+					valid = endContainer(c);
+					break;
+				}
+				// fall through
+			case EXPECT_KEY:
+				if (c == '"')
+				{
+					token      = TOKEN_STRING;
+					tokenIsKey = true;
+					tokenBuffer.clear();
+				}
+				else
+				{
+					valid = fail("Expected key");
+				}
+				break;
+
+			case EXPECT_COLON:
+				if (c == ':')
+				{
+					expect = EXPECT_VALUE;
+				}
+				else
+				{
+					valid = fail("Expected ':'");
+				}
+				break;
+
+			case EXPECT_COMMA_OR_END:
+				if (c == ',')
+				{
+					expect = (stack.back() == '{') ? EXPECT_KEY : EXPECT_VALUE;
+				}
+				else
+				{
+					valid = endContainer(c);
+				}
+				break;
+
+			case EXPECT_END_OF_DOCUMENT:
+				valid = fail("Unexpected data after end of document");
+				break;
+		}
+		if (!valid) return false;
+	}
+	return true;
+}
+
+
+bool JsonStreamParser::finish()
+{
+	if (!strError.empty()) return false;
+
+	// a number at the very end of the document has no terminating character
+	if ((token == TOKEN_NUMBER) && !finishNumber()) return false;
+	if ((token == TOKEN_LITERAL) && !finishLiteral()) return false;
+
+	if ((token != TOKEN_NONE) || (expect != EXPECT_END_OF_DOCUMENT))
+	{
+		return fail("Unexpected end of document");
+	}
+	return true;
+}
+
+
+const std::string& JsonStreamParser::getError() const
+{
+	return strError;
+}
+
+
+bool JsonStreamParser::startValue(char c)
+{
+	if ((c == '{') || (c == '['))
+	{
+		if (stack.size() >= MAX_DEPTH) return fail("Nesting too deep");
+		stack.push_back(c);
+		if (c == '{')
+		{
+			handler.startObject();
+			expect = EXPECT_KEY_OR_OBJECT_END;
+		}
+		else
+		{
+			handler.startArray();
+			expect = EXPECT_VALUE_OR_ARRAY_END;
+		}
+	}
+	else if (c == '"')
+	{
+		token      = TOKEN_STRING;
+		tokenIsKey = false;
+		tokenBuffer.clear();
+	}
+	else if ((c == '-') || ((c >= '0') && (c <= '9')))
+	{
+		token = TOKEN_NUMBER;
+		tokenBuffer.assign(1, c);
+	}
+	else if ((c >= 'a') && (c <= 'z'))
+	{
+		token = TOKEN_LITERAL;
+		tokenBuffer.assign(1, c);
+	}
+	else
+	{
+		return fail(std::string("Unexpected character '") + c + "'");
+	}
+	return true;
+}
+
+
+bool JsonStreamParser::endContainer(char c)
+{
+	char open = (c == '}') ? '{' : ((c == ']') ? '[' : 0);
+	if ((open == 0) || stack.empty() || (stack.back() != open))
+	{
+		return fail(std::string("Unexpected character '") + c + "'");
+	}
+	stack.pop_back();
+	if (open == '{') handler.endObject(); else handler.endArray();
+	valueComplete();
+	return true;
+}
+
+
+void JsonStreamParser::valueComplete()
+{
+	expect = stack.empty() ? EXPECT_END_OF_DOCUMENT : EXPECT_COMMA_OR_END;
+}
+
+
+bool JsonStreamParser::parseStringChar(char c)
+{
+	if ((highSurrogate != 0) && (unicodeDigits == 0) && !(escape ? (c == 'u') : (c == '\\')))
+	{
+		// the first half of a surrogate pair has to be followed by the second half
+		return fail("Unpaired surrogate in \\u escape");
+	}
+
+	if (unicodeDigits > 0)
+	{
+		int digit;
+		if      ((c >= '0') && (c <= '9')) digit = c - '0';
+		else if ((c >= 'a') && (c <= 'f')) digit = c - 'a' + 10;
+		else if ((c >= 'A') && (c <= 'F')) digit = c - 'A' + 10;
+		else return fail("Invalid \\u escape");
+
+		unicodeValue = (unicodeValue << 4) | digit;
+		unicodeDigits--;
+		if (unicodeDigits == 0)
+		{
+			bool isHigh = (unicodeValue >= 0xD800) && (unicodeValue <= 0xDBFF);
+			bool isLow  = (unicodeValue >= 0xDC00) && (unicodeValue <= 0xDFFF);
+			if (isLow != (highSurrogate != 0))
+			{
+				// second half without a first half, or first half followed by something else
+				return fail("Unpaired surrogate in \\u escape");
+			}
+
+			if (isHigh)
+			{
+				// first half of a surrogate pair
+				highSurrogate = unicodeValue;
+			}
+			else if (isLow)
+			{
+				appendCodepoint(0x10000 + ((highSurrogate - 0xD800) << 10) + (unicodeValue - 0xDC00));
+				highSurrogate = 0;
+			}
+			else
+			{
+				appendCodepoint(unicodeValue);
+			}
+		}
+	}
+	else if (escape)
+	{
+		escape = false;
+		switch (c)
+		{
+			case '"':  tokenBuffer += '"';  break;
+			case '\\': tokenBuffer += '\\'; break;
+			case '/':  tokenBuffer += '/';  break;
+			case 'b':  tokenBuffer += '\b'; break;
+			case 'f':  tokenBuffer += '\f'; break;
+			case 'n':  tokenBuffer += '\n'; break;
+			case 'r':  tokenBuffer += '\r'; break;
+			case 't':  tokenBuffer += '\t'; break;
+			case 'u':  unicodeDigits = 4; unicodeValue = 0; break;
+			default:   return fail("Invalid escape sequence");
+		}
+	}
+	else if (c == '\\')
+	{
+		escape = true;
+	}
+	else if (c == '"')
+	{
+		token = TOKEN_NONE;
+		if (tokenIsKey)
+		{
+			handler.key(tokenBuffer);
+			expect = EXPECT_COLON;
+		}
+		else
+		{
+			handler.string(tokenBuffer);
+			valueComplete();
+		}
+	}
+	else if ((unsigned char) c < 0x20)
+	{
+		return fail("Control character in string");
+	}
+	else
+	{
+		tokenBuffer += c;
+	}
+	return true;
+}
+
+
+bool JsonStreamParser::finishNumber()
+{
+	token = TOKEN_NONE;
+	if (!isJsonNumber(tokenBuffer))
+	{
+		return fail("Invalid number '" + tokenBuffer + "'");
+	}
+
+	// strtod() expects the decimal point of the current locale
+	char decimalPoint = localeconv()->decimal_point[0];
+	if (decimalPoint != '.')
+	{
+		size_t pointPos = tokenBuffer.find('.');
+		if (pointPos != std::string::npos) tokenBuffer[pointPos] = decimalPoint;
+	}
+
+	char*  pEnd  = NULL;
+	double value = strtod(tokenBuffer.c_str(), &pEnd);
+	if ((pEnd == NULL) || (*pEnd != '\0'))
+	{
+		return fail("Invalid number '" + tokenBuffer + "'");
+	}
+	handler.number(value);
+	valueComplete();
+	return true;
+}
+
+
+bool JsonStreamParser::finishLiteral()
+{
+	token = TOKEN_NONE;
+	if      (tokenBuffer == "true")  handler.boolean(true);
+	else if (tokenBuffer == "false") handler.boolean(false);
+	else if (tokenBuffer == "null")  handler.null();
+	else return fail("Invalid literal '" + tokenBuffer + "'");
+	valueComplete();
+	return true;
+}
+
+
+void JsonStreamParser::appendCodepoint(uint32_t codepoint)
+{
+	// encode as UTF-8
+	if (codepoint < 0x80)
+	{
+		tokenBuffer += (char) codepoint;
+	}
+	else if (codepoint < 0x800)
+	{
+		tokenBuffer += (char) (0xC0 | (codepoint >> 6));
+		tokenBuffer += (char) (0x80 | (codepoint & 0x3F));
+	}
+	else if (codepoint < 0x10000)
+	{
+		tokenBuffer += (char) (0xE0 | (codepoint >> 12));
+		tokenBuffer += (char) (0x80 | ((codepoint >> 6) & 0x3F));
+		tokenBuffer += (char) (0x80 | (codepoint & 0x3F));
+	}
+	else
+	{
+		tokenBuffer += (char) (0xF0 | (codepoint >> 18));
+		tokenBuffer += (char) (0x80 | ((codepoint >> 12) & 0x3F));
+		tokenBuffer += (char) (0x80 | ((codepoint >> 6) & 0x3F));
+		tokenBuffer += (char) (0x80 | (codepoint & 0x3F));
+	}
+}
+
+
+bool JsonStreamParser::fail(const std::string& strError)
+{
+	std::stringstream strm;
+	strm << strError << " at position " << position;
+	this->strError = strm.str();
+	return false;
+}
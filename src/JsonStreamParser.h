@@ -0,0 +1,122 @@
+/**
+ * Event based (SAX style) JSON parser that processes its input in chunks as they arrive,
+ * without building a document tree. Values are passed to a handler as soon as they are complete.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+/**
+ * Interface for receiving the parser events.
+ * All methods have an empty default implementation.
+ */
+class JsonStreamHandler
+{
+public:
+	virtual ~JsonStreamHandler() { }
+
+	virtual void startObject() { }
+	virtual void endObject() { }
+	virtual void startArray() { }
+	virtual void endArray() { }
+	virtual void key(const std::string&) { }
+	virtual void string(const std::string&) { }
+	virtual void number(double) { }
+	virtual void boolean(bool) { }
+	virtual void null() { }
+};
+
+
+class JsonStreamParser
+{
+public:
+
+	/**
+	 * Creates a parser.
+	 *
+	 * @param refHandler  the handler to pass the events to
+	 */
+	JsonStreamParser(JsonStreamHandler& refHandler);
+
+	/**
+	 * Prepares the parser for a new document.
+	 */
+	void reset();
+
+	/**
+	 * Parses the next chunk of the document.
+	 * Tokens may be split across chunks.
+	 *
+	 * @param pData   the characters to parse
+	 * @param length  the amount of characters
+	 *
+	 * @return <code>true</code> if the chunk was parsed, <code>false</code> on syntax errors
+	 */
+	bool parse(const char* pData, size_t length);
+
+	/**
+	 * Signals the end of the document.
+	 *
+	 * @return <code>true</code> if the document was complete and valid
+	 */
+	bool finish();
+
+	/**
+	 * Gets a description of the last syntax error.
+	 *
+	 * @return the error description (empty if there was no error)
+	 */
+	const std::string& getError() const;
+
+private:
+
+	enum eExpect
+	{
+		EXPECT_VALUE,
+		EXPECT_VALUE_OR_ARRAY_END,
+		EXPECT_KEY,
+		EXPECT_KEY_OR_OBJECT_END,
+		EXPECT_COLON,
+		EXPECT_COMMA_OR_END,
+		EXPECT_END_OF_DOCUMENT
+	};
+
+	enum eToken
+	{
+		TOKEN_NONE,
+		TOKEN_STRING,
+		TOKEN_NUMBER,
+		TOKEN_LITERAL
+	};
+
+	bool startValue(char c);
+	bool endContainer(char c);
+	void valueComplete();
+	bool parseStringChar(char c);
+	bool finishNumber();
+	bool finishLiteral();
+	void appendCodepoint(uint32_t codepoint);
+	bool fail(const std::string& strError);
+
+private:
+
+	JsonStreamHandler& handler;
+
+	eExpect            expect;
+	eToken             token;
+	std::string        tokenBuffer;   // reused, keeps its capacity
+	bool               tokenIsKey;
+	bool               escape;
+	int                unicodeDigits; // remaining hex digits of a \u escape
+	uint32_t           unicodeValue;
+	uint32_t           highSurrogate;
+
+	std::vector<char>  stack;         // '{' or '[' per open container
+	size_t             position;
+	std::string        strError;
+};
@@ -0,0 +1,132 @@
+#include "KinectNuiSensor.h"
+
+#ifdef USE_KINECT
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "KinectNuiSensor"
+
+
+KinectNuiSensor::KinectNuiSensor() :
+	pNuiSensor(NULL),
+	skeletonEvent(NULL)
+{
+	// nothing else to do
+}
+
+
+KinectNuiSensor::~KinectNuiSensor()
+{
+	close();
+}
+
+
+bool KinectNuiSensor::open()
+{
+	LOG_INFO("Kinect SDK version v 1.8");
+
+	if (FAILED(NuiCreateSensorByIndex(0, &pNuiSensor)))
+	{
+		LOG_INFO("Cannot find connected kinect.");
+		pNuiSensor = NULL;
+		return false;
+	}
+
+	if (FAILED(pNuiSensor->NuiInitialize(NUI_INITIALIZE_FLAG_USES_SKELETON)))
+	{
+		LOG_INFO("Cannot open kinect.");
+		close();
+		return false;
+	}
+
+	skeletonEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+	if (FAILED(pNuiSensor->NuiSkeletonTrackingEnable(skeletonEvent, NUI_SKELETON_TRACKING_FLAG_ENABLE_SEATED_SUPPORT)))
+	{
+		LOG_INFO("Cannot enable skeleton tracking.");
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+
+bool KinectNuiSensor::waitForFrame(KinectFrame& refFrame, int timeoutMs)
+{
+	if (WaitForSingleObject(skeletonEvent, timeoutMs) != WAIT_OBJECT_0)
+	{
+		return false;
+	}
+
+	NUI_SKELETON_FRAME skeletonFrame = { 0 };
+	if (FAILED(pNuiSensor->NuiSkeletonGetNextFrame(0, &skeletonFrame)))
+	{
+		return false;
+	}
+
+	convertSkeletonFrame(skeletonFrame, refFrame);
+	return true;
+}
+
+
+void KinectNuiSensor::close()
+{
+	if (pNuiSensor != NULL)
+	{
+		pNuiSensor->NuiShutdown();
+		pNuiSensor->Release();
+		pNuiSensor = NULL;
+	}
+	if (skeletonEvent != NULL)
+	{
+		CloseHandle(skeletonEvent);
+		skeletonEvent = NULL;
+	}
+}
+
+
+std::string KinectNuiSensor::getName()
+{
+	return "Kinect sensor";
+}
+
+
+void KinectNuiSensor::convertSkeletonFrame(const NUI_SKELETON_FRAME& refSkeletonFrame, KinectFrame& refFrame)
+{
+	refFrame.frameNumber = refSkeletonFrame.dwFrameNumber;
+	refFrame.timestamp   = (double) refSkeletonFrame.liTimeStamp.QuadPart;
+	refFrame.nUsers      = 0;
+
+	for (int i = 0; i < NUI_SKELETON_COUNT; i++)
+	{
+		const NUI_SKELETON_DATA& skeleton = refSkeletonFrame.SkeletonData[i];
+		if (skeleton.eTrackingState == NUI_SKELETON_NOT_TRACKED) continue;
+
+		KinectUser& refUser = refFrame.users[refFrame.nUsers];
+		refUser.trackingId    = skeleton.dwTrackingID;
+		refUser.skeletonValid = (skeleton.eTrackingState == NUI_SKELETON_TRACKED);
+		for (int j = 0; j < KINECT_JOINT_COUNT; j++)
+		{
+			KinectJoint& refJoint = refUser.joints[j];
+			if (refUser.skeletonValid)
+			{
+				const Vector4& point = skeleton.SkeletonPositions[j];
+				refJoint.x       = point.x;
+				refJoint.y       = point.y;
+				refJoint.z       = point.z;
+				refJoint.tracked = (skeleton.eSkeletonPositionTrackingState[j] == NUI_SKELETON_POSITION_TRACKED);
+			}
+			else
+			{
+				// only the position of the user is known > report it as the root joint
+				refJoint.x       = (j == 0) ? skeleton.Position.x : 0;
+				refJoint.y       = (j == 0) ? skeleton.Position.y : 0;
+				refJoint.z       = (j == 0) ? skeleton.Position.z : 0;
+				refJoint.tracked = (j == 0);
+			}
+		}
+		refFrame.nUsers++;
+	}
+}
+
+#endif // #ifdef USE_KINECT
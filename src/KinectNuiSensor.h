@@ -0,0 +1,38 @@
+/**
+ * Kinect sensor access through the Kinect for Windows SDK v1.8.
+ */
+
+#pragma once
+
+#include "Config.h"
+
+#ifdef USE_KINECT
+
+#pragma comment(lib, "Kinect10.lib")
+
+#include <Windows.h>
+#include "NuiApi.h"
+
+#include "KinectSkeleton.h"
+
+
+class KinectNuiSensor : public KinectSensor
+{
+public:
+	KinectNuiSensor();
+	virtual ~KinectNuiSensor();
+
+	virtual bool        open();
+	virtual bool        waitForFrame(KinectFrame& refFrame, int timeoutMs);
+	virtual void        close();
+	virtual std::string getName();
+
+private:
+	void convertSkeletonFrame(const NUI_SKELETON_FRAME& refSkeletonFrame, KinectFrame& refFrame);
+
+private:
+	INuiSensor* pNuiSensor;
+	HANDLE      skeletonEvent;
+};
+
+#endif // #ifdef USE_KINECT
@@ -0,0 +1,184 @@
+#include "KinectRecording.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "KinectRecording"
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+
+#define FRAME_INTERVAL_MS 33.3 // time between the last and the first frame when looping (30Hz)
+
+
+bool KinectFrameRecorder::open(const std::string& strFilename)
+{
+	close();
+	file.open(strFilename.c_str(), std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Could not create Kinect recording '" << strFilename << "'");
+		return false;
+	}
+	file << "# Kinect joint recording: F <frame> <time ms> <users>, U <tracking ID> <skeleton valid> (<x> <y> <z> <tracked>) x " << KINECT_JOINT_COUNT << std::endl;
+	LOG_INFO("Recording Kinect frames into '" << strFilename << "'");
+	return true;
+}
+
+
+bool KinectFrameRecorder::isOpen() const
+{
+	return file.is_open();
+}
+
+
+void KinectFrameRecorder::write(const KinectFrame& refFrame)
+{
+	if (!file.is_open()) return;
+
+	int nUsers = std::min(refFrame.nUsers, KINECT_MAX_USERS);
+	file << "F " << refFrame.frameNumber << " " << refFrame.timestamp << " " << nUsers << "\n";
+	for (int uIdx = 0; uIdx < nUsers; uIdx++)
+	{
+		const KinectUser& refUser = refFrame.users[uIdx];
+		file << "U " << refUser.trackingId << " " << (refUser.skeletonValid ? 1 : 0);
+		for (int jIdx = 0; jIdx < KINECT_JOINT_COUNT; jIdx++)
+		{
+			const KinectJoint& refJoint = refUser.joints[jIdx];
+			file << " " << refJoint.x << " " << refJoint.y << " " << refJoint.z << " " << (refJoint.tracked ? 1 : 0);
+		}
+		file << "\n";
+	}
+}
+
+
+void KinectFrameRecorder::close()
+{
+	if (file.is_open())
+	{
+		file.close();
+		LOG_INFO("Kinect recording closed");
+	}
+}
+
+
+KinectRecordedSensor::KinectRecordedSensor(const std::string& strFilename) :
+	strFilename(strFilename),
+	loopCount(0),
+	firstTimestamp(0),
+	lastTimestamp(0),
+	hasPendingFrame(false)
+{
+	// nothing else to do
+}
+
+
+bool KinectRecordedSensor::open()
+{
+	file.open(strFilename.c_str(), std::ios::in);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Could not open Kinect recording '" << strFilename << "'");
+		return false;
+	}
+
+	if (!readFrame(pendingFrame))
+	{
+		LOG_ERROR("Kinect recording '" << strFilename << "' contains no frames");
+		file.close();
+		return false;
+	}
+	hasPendingFrame = true;
+	firstTimestamp  = pendingFrame.timestamp;
+	lastTimestamp   = firstTimestamp;
+	loopCount       = 0;
+	startTime       = std::chrono::steady_clock::now();
+	return true;
+}
+
+
+bool KinectRecordedSensor::waitForFrame(KinectFrame& refFrame, int timeoutMs)
+{
+	if (!hasPendingFrame)
+	{
+		hasPendingFrame = readFrame(pendingFrame);
+		if (!hasPendingFrame)
+		{
+			// end of recording > loop, continuing the time line
+			file.clear();
+			file.seekg(0);
+			loopCount++;
+			startTime += std::chrono::microseconds((long long) ((lastTimestamp - firstTimestamp + FRAME_INTERVAL_MS) * 1000));
+			hasPendingFrame = readFrame(pendingFrame);
+			if (!hasPendingFrame) return false;
+		}
+	}
+
+	// wait until the frame is due
+	std::chrono::steady_clock::time_point due = startTime +
+		std::chrono::microseconds((long long) ((pendingFrame.timestamp - firstTimestamp) * 1000));
+	std::chrono::steady_clock::time_point timeout = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	if (due > timeout)
+	{
+		std::this_thread::sleep_until(timeout);
+		return false;
+	}
+	std::this_thread::sleep_until(due);
+
+	refFrame        = pendingFrame;
+	lastTimestamp   = pendingFrame.timestamp;
+	hasPendingFrame = false;
+	return true;
+}
+
+
+void KinectRecordedSensor::close()
+{
+	file.close();
+	hasPendingFrame = false;
+}
+
+
+std::string KinectRecordedSensor::getName()
+{
+	return "Kinect recording '" + strFilename + "'";
+}
+
+
+bool KinectRecordedSensor::readFrame(KinectFrame& refFrame)
+{
+	std::string strLine;
+	while (std::getline(file, strLine))
+	{
+		if (strLine.empty() || (strLine[0] != 'F')) continue;
+
+		std::istringstream frameLine(strLine.substr(1));
+		if (!(frameLine >> refFrame.frameNumber >> refFrame.timestamp >> refFrame.nUsers)) continue;
+		refFrame.nUsers = std::max(0, std::min(refFrame.nUsers, KINECT_MAX_USERS));
+
+		for (int uIdx = 0; uIdx < refFrame.nUsers; uIdx++)
+		{
+			KinectUser& refUser = refFrame.users[uIdx];
+			int skeletonValid = 0;
+			if (!std::getline(file, strLine) || strLine.empty() || (strLine[0] != 'U')) return false;
+			std::istringstream userLine(strLine.substr(1));
+			userLine >> refUser.trackingId >> skeletonValid;
+			refUser.skeletonValid = (skeletonValid != 0);
+			for (int jIdx = 0; jIdx < KINECT_JOINT_COUNT; jIdx++)
+			{
+				KinectJoint& refJoint = refUser.joints[jIdx];
+				int tracked = 0;
+				userLine >> refJoint.x >> refJoint.y >> refJoint.z >> tracked;
+				refJoint.tracked = (tracked != 0);
+			}
+			if (userLine.fail())
+			{
+				LOG_ERROR("Invalid user data in frame " << refFrame.frameNumber);
+				return false;
+			}
+		}
+		return true;
+	}
+	return false;
+}
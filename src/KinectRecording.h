@@ -0,0 +1,96 @@
+/**
+ * Classes for recording Kinect frames into a text file and for replaying them as a sensor stand-in.
+ * This allows testing the Kinect processing on systems without the Kinect SDK or a sensor.
+ *
+ * File format (one record per line):
+ *   F <frame number> <timestamp in ms> <amount of users>
+ *   U <tracking ID> <skeleton valid> (<x> <y> <z> <tracked>) x 20 joints
+ * Lines starting with # are comments.
+ */
+
+#pragma once
+
+#include "KinectSkeleton.h"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+
+
+/**
+ * Class for writing Kinect frames into a recording.
+ */
+class KinectFrameRecorder
+{
+public:
+
+	/**
+	 * Opens a recording for writing.
+	 *
+	 * @param strFilename  the name of the file
+	 *
+	 * @return <code>true</code> if the file was opened
+	 */
+	bool open(const std::string& strFilename);
+
+	/**
+	 * Checks if the recording is open.
+	 *
+	 * @return <code>true</code> if the file is open
+	 */
+	bool isOpen() const;
+
+	/**
+	 * Writes a frame into the recording.
+	 *
+	 * @param refFrame  the frame to write
+	 */
+	void write(const KinectFrame& refFrame);
+
+	/**
+	 * Closes the recording.
+	 */
+	void close();
+
+private:
+
+	std::ofstream file;
+};
+
+
+/**
+ * Sensor stand-in that replays a recording at its original speed.
+ * The recording is looped.
+ */
+class KinectRecordedSensor : public KinectSensor
+{
+public:
+
+	/**
+	 * Creates a sensor stand-in for a recording.
+	 *
+	 * @param strFilename  the name of the recording
+	 */
+	KinectRecordedSensor(const std::string& strFilename);
+
+	virtual bool        open();
+	virtual bool        waitForFrame(KinectFrame& refFrame, int timeoutMs);
+	virtual void        close();
+	virtual std::string getName();
+
+private:
+
+	bool readFrame(KinectFrame& refFrame);
+
+private:
+
+	std::string   strFilename;
+	std::ifstream file;
+	int           loopCount;
+	double        firstTimestamp;
+	double        lastTimestamp;
+	bool          hasPendingFrame;
+	KinectFrame   pendingFrame;
+
+	std::chrono::steady_clock::time_point startTime;
+};
@@ -0,0 +1,313 @@
+#include "KinectSkeleton.h"
+#include "Portability.h"
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "KinectSkeletonMapper"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+
+/**
+ * Joint information in the order of NUI_SKELETON_POSITION_INDEX.
+ * The offset is the position relative to the parent joint in a T-pose facing the sensor (m).
+ */
+struct sJointInfo
+{
+	const char* szName;
+	int         parent;
+	int         child;  // joint the bone points at (-1: use the direction from the parent)
+	float       offset[3];
+};
+
+static const sJointInfo JOINTS[KINECT_JOINT_COUNT] =
+{
+	{ "HIP_CENTER",      -1,  1, {  0.00f,  0.00f,  0.00f } },
+	{ "SPINE",            0,  2, {  0.00f,  0.10f,  0.00f } },
+	{ "SHOULDER_CENTER",  1,  3, {  0.00f,  0.30f,  0.00f } },
+	{ "HEAD",             2, -1, {  0.00f,  0.20f,  0.00f } },
+	{ "SHOULDER_LEFT",    2,  5, { -0.18f,  0.00f,  0.00f } },
+	{ "ELBOW_LEFT",       4,  6, { -0.28f,  0.00f,  0.00f } },
+	{ "WRIST_LEFT",       5,  7, { -0.25f,  0.00f,  0.00f } },
+	{ "HAND_LEFT",        6, -1, { -0.08f,  0.00f,  0.00f } },
+	{ "SHOULDER_RIGHT",   2,  9, {  0.18f,  0.00f,  0.00f } },
+	{ "ELBOW_RIGHT",      8, 10, {  0.28f,  0.00f,  0.00f } },
+	{ "WRIST_RIGHT",      9, 11, {  0.25f,  0.00f,  0.00f } },
+	{ "HAND_RIGHT",      10, -1, {  0.08f,  0.00f,  0.00f } },
+	{ "HIP_LEFT",         0, 13, { -0.08f, -0.06f,  0.00f } },
+	{ "KNEE_LEFT",       12, 14, {  0.00f, -0.42f,  0.00f } },
+	{ "ANKLE_LEFT",      13, 15, {  0.00f, -0.40f,  0.00f } },
+	{ "FOOT_LEFT",       14, -1, {  0.00f, -0.04f, -0.10f } },
+	{ "HIP_RIGHT",        0, 17, {  0.08f, -0.06f,  0.00f } },
+	{ "KNEE_RIGHT",      16, 18, {  0.00f, -0.42f,  0.00f } },
+	{ "ANKLE_RIGHT",     17, 19, {  0.00f, -0.40f,  0.00f } },
+	{ "FOOT_RIGHT",      18, -1, {  0.00f, -0.04f, -0.10f } },
+};
+
+
+KinectSkeletonMapper::KinectSkeletonMapper(int lostFrameLimit) :
+	lostFrameLimit(lostFrameLimit),
+	iFrame(0)
+{
+	for (int sIdx = 0; sIdx < KINECT_MAX_USERS; sIdx++)
+	{
+		sSlot& refSlot = arrSlots[sIdx];
+		refSlot.active        = false;
+		refSlot.trackingValid = false;
+		refSlot.lostFrames    = 0;
+		memset(&refSlot.user, 0, sizeof(refSlot.user));
+	}
+}
+
+
+const char* KinectSkeletonMapper::getJointName(int jointIdx)
+{
+	return JOINTS[jointIdx].szName;
+}
+
+
+int KinectSkeletonMapper::getJointParent(int jointIdx)
+{
+	return JOINTS[jointIdx].parent;
+}
+
+
+bool KinectSkeletonMapper::update(const KinectFrame& refFrame)
+{
+	bool changed = false;
+	iFrame = refFrame.frameNumber;
+
+	for (int sIdx = 0; sIdx < KINECT_MAX_USERS; sIdx++)
+	{
+		arrSlots[sIdx].trackingValid = false;
+	}
+
+	// assign users to skeletons, known users keep theirs
+	int nUsers = std::min(refFrame.nUsers, KINECT_MAX_USERS);
+	for (int uIdx = 0; uIdx < nUsers; uIdx++)
+	{
+		const KinectUser& refUser = refFrame.users[uIdx];
+		int slotIdx = findSlot(refUser.trackingId);
+		if (slotIdx < 0)
+		{
+			// new user > first free skeleton
+			for (int sIdx = 0; (sIdx < KINECT_MAX_USERS) && (slotIdx < 0); sIdx++)
+			{
+				if (!arrSlots[sIdx].active) slotIdx = sIdx;
+			}
+			if (slotIdx < 0) continue;
+			LOG_INFO("User " << refUser.trackingId << " assigned to skeleton " << (slotIdx + 1));
+			changed = true;
+		}
+
+		sSlot& refSlot = arrSlots[slotIdx];
+		refSlot.active        = true;
+		refSlot.trackingValid = true;
+		refSlot.lostFrames    = 0;
+		refSlot.user          = refUser;
+		calculateOrientations(refSlot);
+	}
+
+	// free skeletons of users that have been gone for a while
+	bool tracked = false;
+	for (int sIdx = 0; sIdx < KINECT_MAX_USERS; sIdx++)
+	{
+		sSlot& refSlot = arrSlots[sIdx];
+		if (refSlot.trackingValid)
+		{
+			tracked = true;
+		}
+		else if (refSlot.active)
+		{
+			refSlot.lostFrames++;
+			if (refSlot.lostFrames > lostFrameLimit)
+			{
+				LOG_INFO("User " << refSlot.user.trackingId << " lost, skeleton " << (sIdx + 1) << " is free");
+				refSlot.active = false;
+				refSlot.user.trackingId = 0;
+			}
+			// clients need to see the loss of tracking
+			changed = true;
+		}
+	}
+
+	return tracked || changed;
+}
+
+
+void KinectSkeletonMapper::createSceneDescription(MoCapData& refData)
+{
+	int descrIdx = 0;
+	for (int sIdx = 0; sIdx < KINECT_MAX_USERS; sIdx++)
+	{
+		char czName[MAX_NAMELENGTH];
+		snprintf(czName, sizeof(czName), "user %d", sIdx + 1);
+
+		// markerset with one marker per joint
+		sMarkerSetDescription* pMarkerDesc = new sMarkerSetDescription();
+		sMarkerSetData&        msData      = refData.frame.MocapData[sIdx];
+		strncpy_s(pMarkerDesc->szName, czName, sizeof(pMarkerDesc->szName));
+		strncpy_s(msData.szName,       czName, sizeof(msData.szName));
+		pMarkerDesc->nMarkers      = KINECT_JOINT_COUNT;
+		pMarkerDesc->szMarkerNames = new char*[KINECT_JOINT_COUNT];
+		msData.nMarkers            = KINECT_JOINT_COUNT;
+		msData.Markers             = new MarkerData[KINECT_JOINT_COUNT];
+		for (int jIdx = 0; jIdx < KINECT_JOINT_COUNT; jIdx++)
+		{
+			size_t length = strlen(JOINTS[jIdx].szName) + 1;
+			pMarkerDesc->szMarkerNames[jIdx] = new char[length];
+			memcpy(pMarkerDesc->szMarkerNames[jIdx], JOINTS[jIdx].szName, length);
+			msData.Markers[jIdx][0] = msData.Markers[jIdx][1] = msData.Markers[jIdx][2] = 0;
+		}
+		refData.description.arrDataDescriptions[descrIdx].type = Descriptor_MarkerSet;
+		refData.description.arrDataDescriptions[descrIdx].Data.MarkerSetDescription = pMarkerDesc;
+		descrIdx++;
+
+		// skeleton with one bone per joint
+		sSkeletonDescription* pSkeletonDesc = new sSkeletonDescription();
+		sSkeletonData&        skData        = refData.frame.Skeletons[sIdx];
+		strncpy_s(pSkeletonDesc->szName, czName, sizeof(pSkeletonDesc->szName));
+		pSkeletonDesc->skeletonID   = sIdx + 1;
+		pSkeletonDesc->nRigidBodies = KINECT_JOINT_COUNT;
+		skData.skeletonID    = sIdx + 1;
+		skData.nRigidBodies  = KINECT_JOINT_COUNT;
+		skData.RigidBodyData = new sRigidBodyData[KINECT_JOINT_COUNT];
+		for (int jIdx = 0; jIdx < KINECT_JOINT_COUNT; jIdx++)
+		{
+			sRigidBodyDescription& refBoneDesc = pSkeletonDesc->RigidBodies[jIdx];
+			strncpy_s(refBoneDesc.szName, JOINTS[jIdx].szName, sizeof(refBoneDesc.szName));
+			refBoneDesc.ID       = jIdx;
+			refBoneDesc.parentID = JOINTS[jIdx].parent;
+			refBoneDesc.offsetx  = JOINTS[jIdx].offset[0];
+			refBoneDesc.offsety  = JOINTS[jIdx].offset[1];
+			refBoneDesc.offsetz  = JOINTS[jIdx].offset[2];
+
+			sRigidBodyData& refBone = skData.RigidBodyData[jIdx];
+			memset(&refBone, 0, sizeof(refBone));
+			refBone.ID          = jIdx;
+			refBone.qw          = 1;
+			refBone.Markers     = NULL;
+			refBone.MarkerIDs   = NULL;
+			refBone.MarkerSizes = NULL;
+		}
+		refData.description.arrDataDescriptions[descrIdx].type = Descriptor_Skeleton;
+		refData.description.arrDataDescriptions[descrIdx].Data.SkeletonDescription = pSkeletonDesc;
+		descrIdx++;
+	}
+	refData.description.nDataDescriptions = descrIdx;
+
+	// pre-fill in frame data
+	refData.frame.nMarkerSets  = KINECT_MAX_USERS;
+	refData.frame.nRigidBodies = 0;
+	refData.frame.nSkeletons   = KINECT_MAX_USERS;
+
+	refData.frame.nOtherMarkers = 0;
+	refData.frame.OtherMarkers  = NULL;
+
+	refData.frame.nLabeledMarkers = 0;
+
+	refData.frame.nForcePlates = 0;
+
+	refData.frame.fLatency = 0;
+	refData.frame.Timecode = 0;
+	refData.frame.TimecodeSubframe = 0;
+}
+
+
+void KinectSkeletonMapper::writeFrame(sFrameOfMocapData& refFrame)
+{
+	refFrame.iFrame = iFrame;
+
+	int nSlots = std::min(std::min(refFrame.nMarkerSets, refFrame.nSkeletons), KINECT_MAX_USERS);
+	for (int sIdx = 0; sIdx < nSlots; sIdx++)
+	{
+		const sSlot&    refSlot   = arrSlots[sIdx];
+		sMarkerSetData& refMarkers = refFrame.MocapData[sIdx];
+		sSkeletonData&  refSkeleton = refFrame.Skeletons[sIdx];
+		int nJoints = std::min(std::min(refMarkers.nMarkers, refSkeleton.nRigidBodies), KINECT_JOINT_COUNT);
+
+		for (int jIdx = 0; jIdx < nJoints; jIdx++)
+		{
+			const KinectJoint& refJoint = refSlot.user.joints[jIdx];
+			bool valid = refSlot.active && refJoint.tracked;
+
+			// untracked joints are reported at exactly 0, like vanished markers
+			refMarkers.Markers[jIdx][0] = valid ? refJoint.x : 0;
+			refMarkers.Markers[jIdx][1] = valid ? refJoint.y : 0;
+			refMarkers.Markers[jIdx][2] = valid ? refJoint.z : 0;
+
+			sRigidBodyData&   refBone        = refSkeleton.RigidBodyData[jIdx];
+			const Quaternion& refOrientation = refSlot.orientations[jIdx];
+			refBone.x  = refMarkers.Markers[jIdx][0];
+			refBone.y  = refMarkers.Markers[jIdx][1];
+			refBone.z  = refMarkers.Markers[jIdx][2];
+			refBone.qx = valid ? refOrientation.x : 0;
+			refBone.qy = valid ? refOrientation.y : 0;
+			refBone.qz = valid ? refOrientation.z : 0;
+			refBone.qw = valid ? refOrientation.w : 1;
+			refBone.params = (valid && refSlot.trackingValid) ? 0x01 : 0x00; // tracking OK
+		}
+	}
+}
+
+
+int KinectSkeletonMapper::getActiveUserCount() const
+{
+	int count = 0;
+	for (int sIdx = 0; sIdx < KINECT_MAX_USERS; sIdx++)
+	{
+		if (arrSlots[sIdx].active) count++;
+	}
+	return count;
+}
+
+
+uint32_t KinectSkeletonMapper::getTrackingId(int slotIdx) const
+{
+	return arrSlots[slotIdx].active ? arrSlots[slotIdx].user.trackingId : 0;
+}
+
+
+int KinectSkeletonMapper::findSlot(uint32_t trackingId)
+{
+	for (int sIdx = 0; sIdx < KINECT_MAX_USERS; sIdx++)
+	{
+		if (arrSlots[sIdx].active && (arrSlots[sIdx].user.trackingId == trackingId))
+		{
+			return sIdx;
+		}
+	}
+	return -1;
+}
+
+
+void KinectSkeletonMapper::calculateOrientations(sSlot& refSlot)
+{
+	const KinectJoint* pJoints = refSlot.user.joints;
+	for (int jIdx = 0; jIdx < KINECT_JOINT_COUNT; jIdx++)
+	{
+		// a bone points from its joint to the child joint, end bones continue the direction of their parent bone
+		int from = jIdx;
+		int to   = JOINTS[jIdx].child;
+		if (to < 0)
+		{
+			from = JOINTS[jIdx].parent;
+			to   = jIdx;
+		}
+
+		Quaternion& refOrientation = refSlot.orientations[jIdx];
+		if (refSlot.user.skeletonValid && pJoints[from].tracked && pJoints[to].tracked)
+		{
+			Vector3D restDir, actualDir;
+			restDir.set(JOINTS[to].offset[0], JOINTS[to].offset[1], JOINTS[to].offset[2]);
+			actualDir.set(pJoints[to].x - pJoints[from].x, pJoints[to].y - pJoints[from].y, pJoints[to].z - pJoints[from].z);
+			refOrientation.fromVectors(restDir, actualDir);
+		}
+		else
+		{
+			refOrientation = Quaternion();
+		}
+	}
+}
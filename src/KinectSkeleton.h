@@ -0,0 +1,186 @@
+/**
+ * Sensor independent Kinect skeleton data and the mapping of Kinect users to NatNet skeletons.
+ * The mapping uses a fixed layout of KINECT_MAX_USERS marker sets and skeletons
+ * so that users entering or leaving the scene do not change the NatNet data structures.
+ */
+
+#pragma once
+
+#include "MoCapData.h"
+#include "VectorMath.h"
+
+#include <stdint.h>
+#include <string>
+
+
+#define KINECT_MAX_USERS   6  // users the sensor can report per frame
+#define KINECT_JOINT_COUNT 20 // joints per user (same order as NUI_SKELETON_POSITION_INDEX)
+
+
+/**
+ * Position of a joint in sensor coordinates (m).
+ */
+struct KinectJoint
+{
+	float x, y, z;
+	bool  tracked;  // false: joint is not tracked or only inferred
+};
+
+
+/**
+ * A user as reported by the sensor.
+ */
+struct KinectUser
+{
+	uint32_t    trackingId;     // ID the sensor assigned to the user, stays the same while the user is visible
+	bool        skeletonValid;  // false: only the position of the user is known (joint 0)
+	KinectJoint joints[KINECT_JOINT_COUNT];
+};
+
+
+/**
+ * All users reported by the sensor at one point in time.
+ */
+struct KinectFrame
+{
+	uint32_t   frameNumber;
+	double     timestamp;  // in ms
+	int        nUsers;
+	KinectUser users[KINECT_MAX_USERS];
+};
+
+
+/**
+ * Interface for a source of Kinect frames, e.g., a physical sensor or a recording.
+ */
+class KinectSensor
+{
+public:
+
+	virtual ~KinectSensor() { }
+
+	/**
+	 * Opens the sensor.
+	 *
+	 * @return <code>true</code> if the sensor is ready to deliver frames
+	 */
+	virtual bool open() = 0;
+
+	/**
+	 * Waits until the sensor delivers the next frame.
+	 *
+	 * @param refFrame   the frame to fill in
+	 * @param timeoutMs  the maximum time to wait in ms
+	 *
+	 * @return <code>true</code> if a new frame was received,
+	 *         <code>false</code> when the time ran out
+	 */
+	virtual bool waitForFrame(KinectFrame& refFrame, int timeoutMs) = 0;
+
+	/**
+	 * Closes the sensor.
+	 */
+	virtual void close() = 0;
+
+	/**
+	 * Gets a description of the sensor for log output.
+	 *
+	 * @return the description
+	 */
+	virtual std::string getName() = 0;
+};
+
+
+/**
+ * Class for assigning Kinect users to a fixed set of NatNet skeletons.
+ * A user keeps the skeleton it was first assigned to for as long as the sensor tracks it.
+ */
+class KinectSkeletonMapper
+{
+public:
+
+	/**
+	 * Creates a mapper.
+	 *
+	 * @param lostFrameLimit  amount of frames a user may be missing before its skeleton is freed
+	 */
+	KinectSkeletonMapper(int lostFrameLimit = 15);
+
+	/**
+	 * Gets the name of a joint.
+	 *
+	 * @param jointIdx  the index of the joint
+	 *
+	 * @return the name of the joint
+	 */
+	static const char* getJointName(int jointIdx);
+
+	/**
+	 * Gets the parent of a joint in the bone hierarchy.
+	 *
+	 * @param jointIdx  the index of the joint
+	 *
+	 * @return the index of the parent joint or -1 for the root joint
+	 */
+	static int getJointParent(int jointIdx);
+
+	/**
+	 * Assigns the users of a new frame to skeletons and calculates the bone orientations.
+	 *
+	 * @param refFrame  the frame from the sensor
+	 *
+	 * @return <code>true</code> if the frame contains data worth streaming,
+	 *         i.e., at least one user is tracked or a user has been lost
+	 */
+	bool update(const KinectFrame& refFrame);
+
+	/**
+	 * Creates the NatNet description of the fixed layout and allocates the frame data.
+	 *
+	 * @param refData  the data structure to fill in
+	 */
+	void createSceneDescription(MoCapData& refData);
+
+	/**
+	 * Writes the latest user data into the preallocated NatNet frame.
+	 *
+	 * @param refFrame  the frame to write into (layout created by createSceneDescription())
+	 */
+	void writeFrame(sFrameOfMocapData& refFrame);
+
+	/**
+	 * Gets the amount of users that are currently assigned to a skeleton.
+	 *
+	 * @return the amount of active users
+	 */
+	int getActiveUserCount() const;
+
+	/**
+	 * Gets the sensor tracking ID of the user assigned to a skeleton.
+	 *
+	 * @param slotIdx  the index of the skeleton
+	 *
+	 * @return the tracking ID or 0 if no user is assigned
+	 */
+	uint32_t getTrackingId(int slotIdx) const;
+
+private:
+
+	struct sSlot
+	{
+		bool       active;
+		bool       trackingValid;  // user was part of the latest frame
+		int        lostFrames;
+		KinectUser user;
+		Quaternion orientations[KINECT_JOINT_COUNT];
+	};
+
+	int  findSlot(uint32_t trackingId);
+	void calculateOrientations(sSlot& refSlot);
+
+private:
+
+	int      lostFrameLimit;
+	sSlot    arrSlots[KINECT_MAX_USERS];
+	uint32_t iFrame;
+};
@@ -0,0 +1,514 @@
+#include "Logger.h"
+#include "MpscQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string.h>
+#include <thread>
+
+
+#define LOG_TEXT_SIZE        480   // longer messages continue on the heap
+#define LOG_QUEUE_SIZE       1024  // messages waiting for the sink thread
+#define SINK_POLL_INTERVAL   5     // in ms
+#define FLUSH_TIMEOUT        2000  // in ms
+
+
+std::atomic<int> Logger::s_minLevel(Logger::Info);
+
+
+/**
+ * A formatted message on its way to the sink thread.
+ */
+struct sLogRecord
+{
+	Logger::Level                         level;
+	const char*                           strClass;
+	std::chrono::system_clock::time_point time;
+	uint32_t                              suppressed; // messages from the same place that were suppressed before this one
+	bool                                  prefix;     // start of a line
+	bool                                  newline;    // end of a line
+	size_t                                length;
+	std::string*                          pLongText;  // the part that did not fit into the text (owned by the record)
+	char                                  text[LOG_TEXT_SIZE];
+};
+
+
+
+/**
+ * Stream buffer that formats a message into a record.
+ * There is one per thread, so formatting does not allocate memory for usual message lengths.
+ */
+class LogBuffer : public std::streambuf
+{
+public:
+
+	LogBuffer() :
+		m_stream(this),
+		m_busy(false)
+	{
+		// nothing else to do
+	}
+
+	bool isBusy() const
+	{
+		return m_busy;
+	}
+
+	void begin(Logger::Level level, const char* strClass, uint32_t suppressed, bool prefix, bool newline)
+	{
+		m_busy              = true;
+		m_record.level      = level;
+		m_record.strClass   = strClass;
+		m_record.time       = std::chrono::system_clock::now();
+		m_record.suppressed = suppressed;
+		m_record.prefix     = prefix;
+		m_record.newline    = newline;
+		m_record.pLongText  = NULL;
+		m_strOverflow.clear();
+		setp(m_record.text, m_record.text + LOG_TEXT_SIZE);
+		m_stream.clear();
+	}
+
+	std::ostream& stream()
+	{
+		return m_stream;
+	}
+
+	sLogRecord& finish()
+	{
+		m_record.length = (size_t) (pptr() - pbase());
+		if (!m_strOverflow.empty())
+		{
+			m_record.pLongText = new std::string(m_strOverflow);
+		}
+		m_busy = false;
+		return m_record;
+	}
+
+protected:
+
+	virtual std::streamsize xsputn(const char* pData, std::streamsize count)
+	{
+		std::streamsize fitting = std::min(count, (std::streamsize) (epptr() - pptr()));
+		memcpy(pptr(), pData, (size_t) fitting);
+		pbump((int) fitting);
+		if (fitting < count)
+		{
+			m_strOverflow.append(pData + fitting, (size_t) (count - fitting));
+		}
+		return count;
+	}
+
+	virtual int_type overflow(int_type ch)
+	{
+		if (!traits_type::eq_int_type(ch, traits_type::eof()))
+		{
+			m_strOverflow += traits_type::to_char_type(ch);
+		}
+		return traits_type::not_eof(ch);
+	}
+
+private:
+
+	sLogRecord   m_record;
+	std::string  m_strOverflow;
+	std::ostream m_stream;
+	bool         m_busy;
+};
+
+
+static thread_local LogBuffer t_buffer;
+
+
+
+/**
+ * Receives the records from all threads and writes them to the console and the log file.
+ */
+class LogSink
+{
+public:
+
+	/**
+	 * Gets the sink, starting it with the first message.
+	 * The sink is never destroyed, so messages from static destructors can still be written.
+	 */
+	static LogSink& getInstance()
+	{
+		static LogSink* pInstance = new LogSink();
+		return *pInstance;
+	}
+
+	void submit(sLogRecord& refRecord)
+	{
+		if (m_running)
+		{
+			if (m_queue.push(refRecord))
+			{
+				m_enqueued++;
+				if (!m_running)
+				{
+					// stopped while pushing > the sink thread might have done its last round already
+					std::lock_guard<std::mutex> lock(m_mtxOutput);
+					m_written += drainQueue();
+				}
+			}
+			else
+			{
+				delete refRecord.pLongText;
+				m_dropped++;
+			}
+		}
+		else
+		{
+			// sink thread has been stopped > write directly
+			std::lock_guard<std::mutex> lock(m_mtxOutput);
+			write(refRecord);
+			std::cout.flush();
+			std::cerr.flush();
+			if (m_file.is_open()) m_file.flush(); // the sink is never destroyed, so nothing else flushes the file
+		}
+	}
+
+	bool openFile(const std::string& strFilename, size_t maxSize, int maxFiles)
+	{
+		std::lock_guard<std::mutex> lock(m_mtxOutput);
+		m_file.close();
+		m_strFilename = strFilename;
+		m_maxFileSize = maxSize;
+		m_maxFiles    = maxFiles;
+		m_file.open(strFilename.c_str(), std::ios::out | std::ios::app);
+		m_fileSize    = m_file.is_open() ? (size_t) m_file.tellp() : 0;
+		return m_file.is_open();
+	}
+
+	void flush()
+	{
+		uint64_t target = m_enqueued;
+		std::chrono::steady_clock::time_point timeout = std::chrono::steady_clock::now() + std::chrono::milliseconds(FLUSH_TIMEOUT);
+		while (m_running && (m_written < target) && (std::chrono::steady_clock::now() < timeout))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	void stop()
+	{
+		if (m_running.exchange(false) && m_thread.joinable())
+		{
+			m_thread.join();
+
+			// records pushed while the sink thread did its last round
+			std::lock_guard<std::mutex> lock(m_mtxOutput);
+			m_written += drainQueue();
+		}
+	}
+
+	uint64_t getDroppedMessages() const
+	{
+		return m_dropped;
+	}
+
+private:
+
+	LogSink() :
+		m_running(true),
+		m_enqueued(0),
+		m_written(0),
+		m_dropped(0),
+		m_droppedReported(0),
+		m_strFilename(""),
+		m_maxFileSize(0),
+		m_maxFiles(0),
+		m_fileSize(0)
+	{
+		m_thread = std::thread(&LogSink::sinkThread, this);
+		std::atexit(&Logger::shutdown);
+	}
+
+	void sinkThread()
+	{
+		bool running = true;
+		while (running)
+		{
+			// one last round after being stopped
+			running = m_running;
+
+			uint64_t count = 0;
+			{
+				std::lock_guard<std::mutex> lock(m_mtxOutput);
+				count = drainQueue();
+			}
+			m_written += count;
+
+			if ((count == 0) && running)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(SINK_POLL_INTERVAL));
+			}
+		}
+	}
+
+	/**
+	 * Writes all queued records. The output mutex must be locked,
+	 * it also makes sure that there is only one thread taking records from the queue.
+	 *
+	 * @return the amount of written records
+	 */
+	uint64_t drainQueue()
+	{
+		uint64_t   count = 0;
+		sLogRecord record;
+		while (m_queue.pop(record))
+		{
+			write(record);
+			count++;
+		}
+
+		uint64_t dropped = m_dropped;
+		if (dropped != m_droppedReported)
+		{
+			std::stringstream strm;
+			strm << (dropped - m_droppedReported) << " messages dropped because the queue was full";
+			writeNote(Logger::Warning, strm.str());
+			m_droppedReported = dropped;
+		}
+
+		if (count > 0)
+		{
+			std::cout.flush();
+			std::cerr.flush();
+			if (m_file.is_open()) m_file.flush();
+		}
+		return count;
+	}
+
+	void write(sLogRecord& refRecord)
+	{
+		std::ostream& console = (refRecord.level == Logger::Info) ? std::cout : std::cerr;
+
+		if (refRecord.prefix)
+		{
+			writePrefix(console, refRecord);
+			if (m_file.is_open())
+			{
+				writeTimestamp(m_file, refRecord.time);
+				writePrefix(m_file, refRecord);
+			}
+		}
+
+		writeText(console, refRecord);
+		if (m_file.is_open()) writeText(m_file, refRecord);
+
+		if (refRecord.newline)
+		{
+			console << '\n';
+			if (m_file.is_open())
+			{
+				m_file << '\n';
+				m_fileSize = (size_t) m_file.tellp();
+				if ((m_maxFileSize > 0) && (m_fileSize >= m_maxFileSize)) rotateFile();
+			}
+		}
+
+		delete refRecord.pLongText;
+		refRecord.pLongText = NULL;
+	}
+
+	void writeNote(Logger::Level level, const std::string& strText)
+	{
+		sLogRecord record;
+		record.level      = level;
+		record.strClass   = "Logger";
+		record.time       = std::chrono::system_clock::now();
+		record.suppressed = 0;
+		record.prefix     = true;
+		record.newline    = true;
+		record.length     = 0;
+		record.pLongText  = new std::string(strText);
+		write(record);
+	}
+
+	static void writePrefix(std::ostream& refOutput, const sLogRecord& refRecord)
+	{
+		static const char arrLevels[] = { 'I', 'W', 'E', '?' };
+		refOutput << arrLevels[refRecord.level] << " (" << refRecord.strClass << ") : ";
+	}
+
+	static void writeText(std::ostream& refOutput, const sLogRecord& refRecord)
+	{
+		refOutput.write(refRecord.text, refRecord.length);
+		if (refRecord.pLongText)
+		{
+			refOutput << *refRecord.pLongText;
+		}
+		if (refRecord.suppressed > 0)
+		{
+			refOutput << " (" << refRecord.suppressed << " similar messages suppressed)";
+		}
+	}
+
+	static void writeTimestamp(std::ostream& refOutput, std::chrono::system_clock::time_point time)
+	{
+		time_t    seconds = std::chrono::system_clock::to_time_t(time);
+		struct tm local;
+#ifdef _WIN32
+		localtime_s(&local, &seconds);
+#else
+		localtime_r(&seconds, &local);
+#endif
+		char strTime[32];
+		strftime(strTime, sizeof(strTime), "%Y-%m-%d %H:%M:%S", &local);
+		long long milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+		refOutput << strTime << '.' << std::setw(3) << std::setfill('0') << milliseconds << std::setfill(' ') << ' ';
+	}
+
+	void rotateFile()
+	{
+		m_file.close();
+		// "log.2" > "log.3", "log.1" > "log.2", "log" > "log.1"
+		for (int fileIdx = m_maxFiles; fileIdx > 0; fileIdx--)
+		{
+			std::stringstream strOlder, strNewer;
+			strOlder << m_strFilename << "." << fileIdx;
+			strNewer << m_strFilename;
+			if (fileIdx > 1) strNewer << "." << (fileIdx - 1);
+			std::remove(strOlder.str().c_str()); // rename does not replace files on Windows
+			std::rename(strNewer.str().c_str(), strOlder.str().c_str());
+		}
+		if (m_maxFiles <= 0)
+		{
+			std::remove(m_strFilename.c_str());
+		}
+		m_file.open(m_strFilename.c_str(), std::ios::out | std::ios::trunc);
+		m_fileSize = 0;
+	}
+
+private:
+
+	MpscQueue<sLogRecord, LOG_QUEUE_SIZE> m_queue;
+	std::thread                           m_thread;
+	std::atomic<bool>                     m_running;
+	std::atomic<uint64_t>                 m_enqueued;
+	std::atomic<uint64_t>                 m_written;
+	std::atomic<uint64_t>                 m_dropped;
+	uint64_t                              m_droppedReported;
+
+	// output, used by the sink thread (and by writing and draining after stopping)
+	std::mutex                            m_mtxOutput;
+	std::ofstream                         m_file;
+	std::string                           m_strFilename;
+	size_t                                m_maxFileSize;
+	int                                   m_maxFiles;
+	size_t                                m_fileSize;
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+void Logger::setLevel(Level level)
+{
+	s_minLevel = level;
+}
+
+
+bool Logger::parseLevel(const std::string& strLevel, Level& refLevel)
+{
+	bool valid = true;
+	if      (strLevel == "info")    refLevel = Info;
+	else if (strLevel == "warning") refLevel = Warning;
+	else if (strLevel == "error")   refLevel = Error;
+	else if (strLevel == "off")     refLevel = Off;
+	else                            valid    = false;
+	return valid;
+}
+
+
+bool Logger::openFile(const std::string& strFilename, size_t maxSize, int maxFiles)
+{
+	return LogSink::getInstance().openFile(strFilename, maxSize, maxFiles);
+}
+
+
+void Logger::flush()
+{
+	LogSink::getInstance().flush();
+}
+
+
+void Logger::shutdown()
+{
+	LogSink::getInstance().stop();
+}
+
+
+uint64_t Logger::getDroppedMessages()
+{
+	return LogSink::getInstance().getDroppedMessages();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool LogRateLimit::allow()
+{
+	int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+
+	// start a new second
+	int64_t windowStart = m_windowStart.load(std::memory_order_relaxed);
+	if ((now - windowStart >= 1000) &&
+	    m_windowStart.compare_exchange_strong(windowStart, now, std::memory_order_relaxed))
+	{
+		m_count.store(0, std::memory_order_relaxed);
+	}
+
+	if (m_count.fetch_add(1, std::memory_order_relaxed) < MAX_MESSAGES_PER_SECOND)
+	{
+		return true;
+	}
+	m_suppressed.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+
+uint32_t LogRateLimit::takeSuppressed()
+{
+	return m_suppressed.exchange(0, std::memory_order_relaxed);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+LogLine::LogLine(Logger::Level level, const char* strClass, uint32_t suppressed, bool prefix, bool newline) :
+	m_pBuffer(&t_buffer)
+{
+	if (m_pBuffer->isBusy())
+	{
+		// a value that is being logged logs something itself
+		m_pNested.reset(new LogBuffer());
+		m_pBuffer = m_pNested.get();
+	}
+	m_pBuffer->begin(level, strClass, suppressed, prefix, newline);
+}
+
+
+LogLine::~LogLine()
+{
+	LogSink::getInstance().submit(m_pBuffer->finish());
+}
+
+
+std::ostream& LogLine::stream()
+{
+	return m_pBuffer->stream();
+}
@@ -0,0 +1,188 @@
+/**
+ * Asynchronous logger behind the LOG_* macros in Logging.h.
+ *
+ * A message is formatted into a buffer of the calling thread and passed through a lock-free queue
+ * to a sink thread, which writes it to the console and, optionally, into a rotating log file.
+ * So logging never waits for the console or the disk, e.g., on the Cortex callback thread.
+ * When the queue is full, messages are dropped and counted instead of blocking.
+ *
+ * Levels can be filtered at compile time (LOG_LEVEL in Logging.h) and at runtime (setLevel()).
+ * Each place in the code can log a limited amount of messages per second,
+ * the next message after a burst reports how many were suppressed.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+
+
+class Logger
+{
+public:
+
+	enum Level
+	{
+		Info    = 0,
+		Warning = 1,
+		Error   = 2,
+		Off     = 3
+	};
+
+public:
+
+	/**
+	 * Checks if messages of a specific level are logged.
+	 *
+	 * @param level  the level to check
+	 *
+	 * @return <code>true</code> if messages of the level are logged
+	 */
+	static bool isEnabled(Level level)
+	{
+		return level >= s_minLevel.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Sets the minimum level of the messages to log.
+	 *
+	 * @param level  the minimum level
+	 */
+	static void setLevel(Level level);
+
+	/**
+	 * Converts a level name ("info", "warning", "error", "off") to a level.
+	 *
+	 * @param strLevel  the name of the level
+	 * @param refLevel  the variable to store the level in
+	 *
+	 * @return <code>true</code> if the name is valid
+	 */
+	static bool parseLevel(const std::string& strLevel, Level& refLevel);
+
+	/**
+	 * Writes the messages into a file in addition to the console.
+	 * When the file reaches the maximum size, it is renamed to "<name>.1" (older ones to "<name>.2" and so on),
+	 * and a new file is started.
+	 *
+	 * @param strFilename  the name of the log file
+	 * @param maxSize      the maximum size of a log file in bytes
+	 * @param maxFiles     the amount of old log files to keep
+	 *
+	 * @return <code>true</code> if the file could be opened
+	 */
+	static bool openFile(const std::string& strFilename, size_t maxSize, int maxFiles);
+
+	/**
+	 * Waits until all messages that were logged so far have been written.
+	 */
+	static void flush();
+
+	/**
+	 * Writes the remaining messages and stops the sink thread.
+	 * Messages that are logged afterwards are written directly.
+	 */
+	static void shutdown();
+
+	/**
+	 * Gets the amount of messages that were dropped because the queue was full.
+	 *
+	 * @return the amount of dropped messages
+	 */
+	static uint64_t getDroppedMessages();
+
+private:
+
+	static std::atomic<int> s_minLevel;
+};
+
+
+
+/**
+ * Limits the amount of messages from one place in the code.
+ * Used as a static variable within the LOG_* macros, so it is initialised at compile time.
+ */
+class LogRateLimit
+{
+public:
+
+	static const uint32_t MAX_MESSAGES_PER_SECOND = 100;
+
+	constexpr LogRateLimit() :
+		m_windowStart(0),
+		m_count(0),
+		m_suppressed(0)
+	{
+		// nothing else to do
+	}
+
+	/**
+	 * Checks if a message may be logged.
+	 *
+	 * @return <code>true</code> if the message may be logged,
+	 *         <code>false</code> if it is suppressed
+	 */
+	bool allow();
+
+	/**
+	 * Gets and resets the amount of suppressed messages.
+	 *
+	 * @return the amount of messages suppressed since the last call
+	 */
+	uint32_t takeSuppressed();
+
+private:
+
+	std::atomic<int64_t>  m_windowStart; // start of the current second in milliseconds
+	std::atomic<uint32_t> m_count;       // messages in the current second
+	std::atomic<uint32_t> m_suppressed;
+};
+
+
+
+class LogBuffer;
+
+/**
+ * A single message while it is being formatted.
+ * Passed to the sink thread when it goes out of scope.
+ */
+class LogLine
+{
+public:
+
+	/**
+	 * Starts a message.
+	 *
+	 * @param level       the level of the message
+	 * @param strClass    the name of the class logging the message (string literal)
+	 * @param suppressed  the amount of suppressed messages to report
+	 * @param prefix      <code>false</code> to continue a line without a level and class prefix
+	 * @param newline     <code>false</code> to leave the line open for further parts
+	 */
+	LogLine(Logger::Level level, const char* strClass, uint32_t suppressed, bool prefix = true, bool newline = true);
+
+	/**
+	 * Passes the message on to the sink thread.
+	 */
+	~LogLine();
+
+	/**
+	 * Gets the stream to format the message with.
+	 *
+	 * @return the stream of the message
+	 */
+	std::ostream& stream();
+
+private:
+
+	LogLine(const LogLine&);
+	LogLine& operator=(const LogLine&);
+
+private:
+
+	LogBuffer*                 m_pBuffer;
+	std::unique_ptr<LogBuffer> m_pNested; // for messages that are formatted while formatting another one
+};
@@ -191,7 +191,12 @@ void printFrameOfData(std::ostream& refOutput, sFrameOfMocapData& refData)
 		for (int chIdx = 0; chIdx < refForcePlate.nChannels; chIdx++)
 		{
 			sAnalogChannelData& refChannel = refForcePlate.ChannelData[chIdx];
-			refOutput << "\tChn #" << chIdx << ":\t" << refChannel.Values[0] << std::endl;
+			refOutput << "\tChn #" << chIdx << ":\t" << refChannel.Values[0];
+			for (int sIdx = 1; sIdx < refChannel.nFrames; sIdx++)
+			{
+				refOutput << ", " << refChannel.Values[sIdx];
+			}
+			refOutput << std::endl;
 		}
 	}
 }
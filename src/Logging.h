@@ -1,15 +1,53 @@
 #include <iostream>
 #include <sstream>
 
+#include "Logger.h"
+
 /**
  * Macros for logging information, warnings, and errors.
  *
- * The intermediate stringstream reduces the chances of threads interfering with each other's output.
+ * The messages are formatted on the calling thread and written by the sink thread of the Logger.
+ * Levels below LOG_LEVEL are removed at compile time, e.g., with /DLOG_LEVEL=LOG_LEVEL_WARNING.
  */
+#define LOG_LEVEL_INFO     0
+#define LOG_LEVEL_WARNING  1
+#define LOG_LEVEL_ERROR    2
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL  LOG_LEVEL_INFO
+#endif
+
 #define LOG_CLASS  "Global"
-#define LOG_INFO(x)    { std::stringstream strm; strm << "I (" LOG_CLASS ") : " << x << std::endl; std::cout << strm.str(); }
-#define LOG_WARNING(x) { std::stringstream strm; strm << "W (" LOG_CLASS ") : " << x << std::endl; std::cerr << strm.str(); }
-#define LOG_ERROR(x)   { std::stringstream strm; strm << "E (" LOG_CLASS ") : " << x << std::endl; std::cerr << strm.str(); }
+#define LOG_MESSAGE(level, x) { static LogRateLimit logRateLimit; if (Logger::isEnabled(level) && logRateLimit.allow()) { LogLine logLine(level, LOG_CLASS, logRateLimit.takeSuppressed()); logLine.stream() << x; } }
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(x)    LOG_MESSAGE(Logger::Info, x)
+#else
+#define LOG_INFO(x)    { }
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(x) LOG_MESSAGE(Logger::Warning, x)
+#else
+#define LOG_WARNING(x) { }
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(x)   LOG_MESSAGE(Logger::Error, x)
+#else
+#define LOG_ERROR(x)   { }
+#endif
+
+// Macros for log lines that are assembled piece by piece, e.g., for progress output (not rate limited)
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO_START(x) { if (Logger::isEnabled(Logger::Info)) { LogLine logLine(Logger::Info, LOG_CLASS, 0, true,  false); logLine.stream() << x; } }
+#define LOG_INFO_MID(x)   { if (Logger::isEnabled(Logger::Info)) { LogLine logLine(Logger::Info, LOG_CLASS, 0, false, false); logLine.stream() << x; } }
+#define LOG_INFO_END()    { if (Logger::isEnabled(Logger::Info)) { LogLine logLine(Logger::Info, LOG_CLASS, 0, false, true); } }
+#else
+#define LOG_INFO_START(x) { }
+#define LOG_INFO_MID(x)   { }
+#define LOG_INFO_END()    { }
+#endif
 
 
 #include "NatNetTypes.h"
@@ -6,14 +6,30 @@
 #undef   LOG_CLASS
 #define  LOG_CLASS "MoCapCortex"
 
+#include "Portability.h"
+
+#include "TraceRecorder.h"
 #include "VectorMath.h"
 
 #include <algorithm>
+#include <iostream>
 #include <iterator>
+#include <sstream>
 #include <string>
 
 
-#define MAX_UNKNOWN_MARKERS 256 // maximum number of unknown markers
+#define MIN_UNKNOWN_MARKER_CAPACITY 64 // initial size of the unknown marker array
+
+// time between two scene requests while frames don't match the scene, doubling up to the maximum
+static const std::chrono::milliseconds SCENE_REQUEST_BACKOFF_MIN(100);
+static const std::chrono::milliseconds SCENE_REQUEST_BACKOFF_MAX(5000);
+
+
+// Cortex instance receiving the data callbacks
+static MoCapCortex* pCallbackInstance = NULL;
+
+// frame handed over by the data callback, only set on the streaming thread while it signals the frame
+static thread_local sFrameOfData* pStreamingFrame = NULL;
 
 
 /**
@@ -39,11 +55,14 @@ void __cdecl callbackMoCapCortexMessageHandler(int iMessageType, char* czMessage
  */
 void __cdecl callbackMoCapCortexDataHandler(sFrameOfData* pFrameOfData)
 {
-	// process data
-	// merely signal new frame, the main system will pick up the data through getFrameData(...)
-	// which uses Cortex_GetCurrentFrame() 
-	// which hopefully will have this frame data
-	signalNewFrame();
+	TraceRecorder::setThreadName("Cortex callback");
+	TRACE_SCOPE("Cortex frame");
+
+	MoCapCortex* pInstance = pCallbackInstance;
+	if (pInstance && pFrameOfData)
+	{
+		pInstance->handleFrame(*pFrameOfData);
+	}
 }
 
 
@@ -53,7 +72,29 @@ MoCapCortex::MoCapCortex(const std::string &strCortexAddress, const std::string
 	pCortexInfo(NULL),
 	unitScaleFactor(1.0f),
 	updateRate(100.0f),
-	handleUnknownMarkers(false)
+	handleUnknownMarkers(false),
+	otherMarkerCapacity(0),
+	pFilteredFrame(NULL),
+	filteredFrameNumber(-1),
+	lastFrameNumber(-1),
+	framesReceived(0),
+	framesDuplicated(0),
+	framesSkipped(0),
+	framesReplaced(0),
+	frameSkipped(false),
+	framesSkippedForScene(0),
+	sceneGeneration(0),
+	nextBodyId(0),
+	writeSlot(0),
+	readSlot(1),
+	publishedSlot(2),
+	frameStreamingRunning(false),
+	conversionCount(0),
+	conversionTimeTotal(0),
+	conversionTimeMax(0),
+	sceneUpdateRunning(false),
+	sceneUpdateReady(false),
+	sceneRequestBackoff(SCENE_REQUEST_BACKOFF_MIN)
 {
 	this->strCortexAddress = strCortexAddress;
 	this->strLocalAddress  = strLocalAddress;
@@ -76,6 +117,7 @@ bool MoCapCortex::initialise()
 			<< (strLocalAddress.empty() ? "" : " from address ") << strLocalAddress);
 
 		// set up callback handler for logging and streaming
+		pCallbackInstance = this;
 		Cortex_SetErrorMsgHandlerFunc(callbackMoCapCortexMessageHandler);
 		Cortex_SetDataHandlerFunc(callbackMoCapCortexDataHandler);
 
@@ -114,7 +156,7 @@ bool MoCapCortex::initialise()
 				float unitToMillimeter = 1;
 				void *pResponse = NULL;
 				int  iResponseSize = 0;
-				if (Cortex_Request("GetConversionToMillimeters", &pResponse, &iResponseSize) == RC_Okay)
+				if (Cortex_Request((char*) "GetConversionToMillimeters", &pResponse, &iResponseSize) == RC_Okay)
 				{
 					unitToMillimeter = *((float*)pResponse);
 					LOG_INFO("Units to millimeters: " << unitToMillimeter);
@@ -123,7 +165,7 @@ bool MoCapCortex::initialise()
 
 				// determine update rate
 				updateRate = 100.0f; // default usually around 100
-				if (Cortex_Request("GetContextFrameRate", &pResponse, &iResponseSize) == RC_Okay)
+				if (Cortex_Request((char*) "GetContextFrameRate", &pResponse, &iResponseSize) == RC_Okay)
 				{
 					updateRate = *((float*)pResponse);
 					LOG_INFO("Cortex Framerate: " << updateRate);
@@ -132,6 +174,10 @@ bool MoCapCortex::initialise()
 				LOG_INFO("Initialised");
 
 				initialised = true;
+
+				// frames are converted on a separate thread, not in the Cortex callback
+				frameStreamingRunning = true;
+				frameThread = std::thread(&MoCapCortex::frameStreamingThread, this);
 			}
 			else
 			{
@@ -141,6 +187,12 @@ bool MoCapCortex::initialise()
 				Cortex_Exit();
 			}
 		}
+
+		if (!initialised)
+		{
+			Cortex_SetDataHandlerFunc(NULL);
+			pCallbackInstance = NULL;
+		}
 	}
 	return initialised;
 }
@@ -168,7 +220,7 @@ void MoCapCortex::setRunning(bool running)
 {
 	void  *pResponse = NULL;
 	int   iResponseSize = 0;
-	char* czCommand = running ? "LiveMode" : "Pause";
+	char* czCommand = running ? (char*) "LiveMode" : (char*) "Pause";
 	if (Cortex_Request(czCommand, &pResponse, &iResponseSize) == RC_Okay)
 	{
 		isPlaying = running;
@@ -183,23 +235,138 @@ bool MoCapCortex::update()
 }
 
 
+bool MoCapCortex::isEventDriven()
+{
+	// frames arrive through the data callback
+	return true;
+}
+
+
+void MoCapCortex::handleFrame(sFrameOfData& refFrame)
+{
+	framesReceived++;
+	if (refFrame.iFrame == lastFrameNumber)
+	{
+		// already streamed this frame
+		framesDuplicated++;
+		return;
+	}
+	if ((lastFrameNumber >= 0) && (refFrame.iFrame > lastFrameNumber + 1))
+	{
+		framesSkipped += refFrame.iFrame - lastFrameNumber - 1;
+	}
+	lastFrameNumber = refFrame.iFrame;
+
+	{
+		// only a copy into the recorder queue, the file is written on the recorder thread
+		TRACE_SCOPE("capture frame");
+		std::lock_guard<std::mutex> lock(mtxCapture);
+		if (pCaptureRecorder)
+		{
+			pCaptureRecorder->addFrame(refFrame);
+		}
+	}
+
+	// hand the frame over to the streaming thread without waiting for any lock
+	{
+		TRACE_SCOPE("copy frame");
+		arrFrameSlots[writeSlot].copyFrom(refFrame);
+	}
+	int previousSlot = publishedSlot.exchange(writeSlot | FRAME_SLOT_FRESH);
+	if (previousSlot & FRAME_SLOT_FRESH)
+	{
+		// streaming thread is still busy with an older frame > it only gets the latest one
+		framesReplaced++;
+	}
+	writeSlot = previousSlot & ~FRAME_SLOT_FRESH;
+
+	{
+		std::lock_guard<std::mutex> lock(mtxFrameSignal);
+	}
+	cvFrameSignal.notify_one();
+}
+
+
+void MoCapCortex::frameStreamingThread()
+{
+	TraceRecorder::setThreadName("Cortex streaming");
+
+	while (frameStreamingRunning)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mtxFrameSignal);
+			cvFrameSignal.wait(lock, [this] { return !frameStreamingRunning || (publishedSlot.load() & FRAME_SLOT_FRESH); });
+		}
+		if (!frameStreamingRunning) break;
+
+		readSlot = publishedSlot.exchange(readSlot) & ~FRAME_SLOT_FRESH;
+
+		// convert exactly this frame when the main system calls getFrameData(...)/writeFrameData(...)
+		pStreamingFrame = &arrFrameSlots[readSlot].get();
+		signalNewFrame();
+		pStreamingFrame = NULL;
+	}
+}
+
+
+void MoCapCortex::stop()
+{
+	if (pCallbackInstance == this)
+	{
+		// no more frames from Cortex
+		Cortex_SetDataHandlerFunc(NULL);
+		pCallbackInstance = NULL;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mtxFrameSignal);
+		frameStreamingRunning = false;
+	}
+	cvFrameSignal.notify_one();
+
+	if (frameThread.joinable())
+	{
+		frameThread.join();
+	}
+}
+
+
+sFrameOfData* MoCapCortex::acquireFrame(bool& releaseFrame)
+{
+	if (pStreamingFrame != NULL)
+	{
+		// called from the streaming thread > no need to request a copy from the SDK
+		releaseFrame = false;
+		return pStreamingFrame;
+	}
+
+	// called from somewhere else (e.g., printing a frame)
+	releaseFrame = true;
+	return Cortex_GetCurrentFrame();
+}
+
+
 bool MoCapCortex::getSceneDescription(MoCapData& refData)
 {
 	bool success = false;
 	if (initialised)
 	{
 		LOG_INFO("Requesting scene description")
-		sBodyDefs* pBodyDefs = Cortex_GetBodyDefs();
 
-		if (pBodyDefs != NULL)
+		// a background update would be based on the old scene > discard it
+		stopSceneUpdate();
+
+		std::vector<sBodyLayout> arrCurrent;
+		for (const sBody& refBody : arrScene)
 		{
-			convertCortexDescriptionToNatNet(*pBodyDefs, refData.description, refData.frame);
-			Cortex_FreeBodyDefs(pBodyDefs);
-			success = true;
+			arrCurrent.push_back(refBody.layout);
 		}
-		else
+
+		std::unique_ptr<sSceneUpdate> pUpdate = prepareSceneUpdate(arrCurrent, sceneGeneration);
+		if (pUpdate)
 		{
-			LOG_ERROR("Could not retrieve scene information from Cortex");
+			applySceneUpdate(*pUpdate, refData);
+			success = true;
 		}
 	}
 
@@ -210,23 +377,38 @@ bool MoCapCortex::getSceneDescription(MoCapData& refData)
 bool MoCapCortex::getFrameData(MoCapData& refData)
 {
 	bool success = false;
+	frameSkipped = false;
 
 	if (initialised)
 	{
-		// only request data from Cortex when not getting it via callback
-		sFrameOfData* pFrame = Cortex_GetCurrentFrame();
+		// scene changes are prepared in the background and applied here, between two frames
+		applyPendingSceneUpdate(refData);
+
+		bool          releaseFrame;
+		sFrameOfData* pFrame = acquireFrame(releaseFrame);
 
 		if (pFrame != NULL)
 		{
-			if (!convertCortexFrameToNatNet(*pFrame, refData.frame))
+			TRACE_SCOPE("convert frame");
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			if (convertCortexFrameToNatNet(*pFrame, refData.frame))
 			{
-				// conversion failed - scene was updated?
-				getSceneDescription(refData);
-				// now try converting the frame again
-				convertCortexFrameToNatNet(*pFrame, refData.frame);
+				updateConversionStatistics(start);
+				sceneRequestBackoff = SCENE_REQUEST_BACKOFF_MIN; // scene matches again
+				success = true;
+			}
+			else
+			{
+				// conversion failed - scene was updated > skip frames until the new scene is ready
+				requestSceneUpdate();
+				frameSkipped = true;
+				framesSkippedForScene++;
+			}
+			if (releaseFrame)
+			{
+				Cortex_FreeFrame(pFrame);
+				pFilteredFrame = NULL; // the SDK can reuse the memory for another frame
 			}
-			Cortex_FreeFrame(pFrame);
-			success = true;
 		}
 		else
 		{
@@ -238,6 +420,43 @@ bool MoCapCortex::getFrameData(MoCapData& refData)
 }
 
 
+bool MoCapCortex::isFrameSkipped()
+{
+	return frameSkipped;
+}
+
+
+bool MoCapCortex::writeFrameData(const MoCapData& refData, FramePacketWriter& refWriter)
+{
+	bool success = false;
+
+	// a prepared scene update needs to be applied through getFrameData() first
+	if (initialised && !sceneUpdateReady)
+	{
+		bool          releaseFrame;
+		sFrameOfData* pFrame = acquireFrame(releaseFrame);
+		if (pFrame != NULL)
+		{
+			TRACE_SCOPE("write frame packet");
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			success = writeCortexFrame(*pFrame, refData.frame, refWriter);
+			if (success)
+			{
+				updateConversionStatistics(start);
+				sceneRequestBackoff = SCENE_REQUEST_BACKOFF_MIN;
+			}
+			if (releaseFrame)
+			{
+				Cortex_FreeFrame(pFrame);
+				pFilteredFrame = NULL; // the SDK can reuse the memory for another frame
+			}
+		}
+	}
+
+	return success;
+}
+
+
 bool MoCapCortex::isHandlingUnknownMarkers()
 {
 	return handleUnknownMarkers;
@@ -251,6 +470,29 @@ void MoCapCortex::setHandleUnknownMarkers(bool enable)
 }
 
 
+void MoCapCortex::setUnknownMarkerVoxelSize(float voxelSize)
+{
+	unknownMarkerFilter.setVoxelSize(voxelSize);
+	pFilteredFrame = NULL;
+	if (unknownMarkerFilter.getVoxelSize() > 0)
+	{
+		LOG_INFO("Unknown marker deduplication: " << unknownMarkerFilter.getVoxelSize() << "m");
+	}
+	else
+	{
+		LOG_INFO("Unknown marker deduplication: disabled");
+	}
+}
+
+
+void MoCapCortex::setUnknownMarkerLimit(int maxMarkers)
+{
+	unknownMarkerFilter.setMarkerLimit(maxMarkers);
+	pFilteredFrame = NULL;
+	LOG_INFO("Unknown marker limit: " << unknownMarkerFilter.getMarkerLimit());
+}
+
+
 bool MoCapCortex::processCommand(const std::string& strCommand)
 {
 	bool processed = false;
@@ -269,16 +511,130 @@ bool MoCapCortex::processCommand(const std::string& strCommand)
 		setHandleUnknownMarkers(false);
 		processed = true;
 	}
+	else if (strCmdLowerCase.find("unknownmarkervoxel ") == 0)
+	{
+		size_t paramPos = strCmdLowerCase.find_first_of(" ");
+		setUnknownMarkerVoxelSize((float) atof(strCmdLowerCase.c_str() + paramPos));
+		processed = true;
+	}
+	else if (strCmdLowerCase.find("unknownmarkerlimit ") == 0)
+	{
+		size_t paramPos = strCmdLowerCase.find_first_of(" ");
+		setUnknownMarkerLimit(atoi(strCmdLowerCase.c_str() + paramPos));
+		processed = true;
+	}
+	else if (strCmdLowerCase == "unknownmarkerstats")
+	{
+		std::stringstream strm;
+		unknownMarkerFilter.printStatistics(strm);
+		std::cout << strm.str() << std::endl;
+		processed = true;
+	}
+	else if (strCmdLowerCase.find("record ") == 0)
+	{
+		// filename keeps its case
+		processed = startRecording(strCommand.substr(strCommand.find_first_of(" ") + 1));
+	}
+	else if (strCmdLowerCase == "stoprecord")
+	{
+		stopRecording();
+		processed = true;
+	}
+	else if (strCmdLowerCase == "conversionstats")
+	{
+		std::stringstream strm;
+		printConversionStatistics(strm);
+		std::cout << strm.str() << std::endl;
+		processed = true;
+	}
 
 	return processed;
 }
 
 
+bool MoCapCortex::startRecording(const std::string& strFilename)
+{
+	bool success = false;
+	if (initialised)
+	{
+		stopRecording();
+
+		// replay needs to start with the body definitions
+		// (requesting them can take a while > not while holding the capture lock)
+		sBodyDefs* pBodyDefs = Cortex_GetBodyDefs();
+		if (pBodyDefs != NULL)
+		{
+			std::unique_ptr<CortexCaptureRecorder> pRecorder(new CortexCaptureRecorder());
+			success = pRecorder->start(strFilename, updateRate, unitScaleFactor * 1000.0f, *pBodyDefs);
+			Cortex_FreeBodyDefs(pBodyDefs);
+
+			if (success)
+			{
+				std::lock_guard<std::mutex> lock(mtxCapture);
+				pCaptureRecorder.swap(pRecorder);
+			}
+		}
+		else
+		{
+			LOG_ERROR("Could not retrieve scene information from Cortex");
+		}
+	}
+	return success;
+}
+
+
+void MoCapCortex::stopRecording()
+{
+	std::unique_ptr<CortexCaptureRecorder> pRecorder;
+	{
+		std::lock_guard<std::mutex> lock(mtxCapture);
+		pCaptureRecorder.swap(pRecorder);
+	}
+
+	// writing the remaining frames doesn't block the Cortex callback
+	if (pRecorder)
+	{
+		pRecorder->stop();
+	}
+}
+
+
+void MoCapCortex::updateConversionStatistics(std::chrono::steady_clock::time_point start)
+{
+	std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - start;
+	conversionCount++;
+	conversionTimeTotal += duration;
+	conversionTimeMax    = std::max(conversionTimeMax, duration);
+}
+
+
+void MoCapCortex::printConversionStatistics(std::ostream& refOutput)
+{
+	refOutput << "Cortex Conversion Statistics" << std::endl
+		<< "\tFrames:        " << conversionCount << std::endl
+		<< "\tBodies:        " << arrScene.size() << std::endl;
+	if (conversionCount > 0)
+	{
+		refOutput
+			<< "\tAverage time:  " << (conversionTimeTotal.count() / conversionCount) << "ns/frame" << std::endl
+			<< "\tMaximum time:  " << conversionTimeMax.count() << "ns" << std::endl;
+	}
+}
+
+
 bool MoCapCortex::deinitialise()
 {
 	if (initialised)
 	{
-		Cortex_SetDataHandlerFunc(NULL);
+		stop();
+		stopSceneUpdate();
+		arrScene.clear(); // structures are owned by the MoCap data
+		stopRecording();
+
+		LOG_INFO("Frames received: " << framesReceived
+			<< " (duplicates: " << framesDuplicated
+			<< ", skipped: " << framesSkipped
+			<< ", replaced before streaming: " << framesReplaced << ", the latest frame wins)");
 
 		delete pCortexInfo;
 		pCortexInfo = NULL;
@@ -300,127 +656,441 @@ MoCapCortex::~MoCapCortex()
 }
 
 
-void MoCapCortex::convertCortexDescriptionToNatNet(sBodyDefs& refCortex, sDataDescriptions& refDescr, sFrameOfMocapData& refFrame)
+bool MoCapCortex::sBodyLayout::operator==(const sBodyLayout& refOther) const
 {
-	int idxDataBlock = 0;
-	int idxMarkerSet = 0;
-	int idxRigidBody = 0;
-	int idxSkeleton = 0;
+	return (strName         == refOther.strName)         &&
+	       (arrMarkerNames  == refOther.arrMarkerNames)  &&
+	       (arrSegmentNames == refOther.arrSegmentNames) &&
+	       (arrParents      == refOther.arrParents);
+}
 
-	for (int iBodyIdx = 0; iBodyIdx < refCortex.nBodyDefs; iBodyIdx++)
-	{
-		sBodyDef& bodyDef = refCortex.BodyDefs[iBodyIdx];
 
-		// create markerset description and markerset data
-		sMarkerSetDescription* pMarkerSetDescr = new sMarkerSetDescription;
-		sMarkerSetData&        refMarkerSetData = refFrame.MocapData[idxMarkerSet];
+std::unique_ptr<MoCapCortex::sSceneUpdate> MoCapCortex::prepareSceneUpdate(const std::vector<sBodyLayout>& arrCurrent, int generation)
+{
+	std::unique_ptr<sSceneUpdate> pUpdate;
+
+	// this call can take a while > not to be done on the streaming thread
+	sBodyDefs* pBodyDefs = Cortex_GetBodyDefs();
+	if (pBodyDefs != NULL)
+	{
+		pUpdate.reset(new sSceneUpdate());
+		pUpdate->generation = generation;
 
-		// markerset name
-		strncpy_s(pMarkerSetDescr->szName, bodyDef.szName, sizeof(pMarkerSetDescr->szName));
-		strncpy_s(refMarkerSetData.szName, bodyDef.szName, sizeof(refMarkerSetData.szName));
+		{
+			// a changed scene needs to go into the capture as well
+			std::lock_guard<std::mutex> lock(mtxCapture);
+			if (pCaptureRecorder)
+			{
+				pCaptureRecorder->addBodyDefs(*pBodyDefs);
+			}
+		}
 
-		// number of markers
-		int nMarkers = bodyDef.nMarkers;
-		pMarkerSetDescr->nMarkers = nMarkers;
-		refMarkerSetData.nMarkers = nMarkers;
+		int nBodies = pBodyDefs->nBodyDefs;
+		pUpdate->arrBodies.resize(nBodies);
+		pUpdate->arrPreviousIdx.assign(nBodies, -1);
 
-		// array of marker names
-		pMarkerSetDescr->szMarkerNames = new char*[nMarkers];
-		for (int mIdx = 0; mIdx < bodyDef.nMarkers; mIdx++)
+		std::vector<bool> arrUsed(arrCurrent.size(), false);
+		for (int bIdx = 0; bIdx < nBodies; bIdx++)
 		{
-			pMarkerSetDescr->szMarkerNames[mIdx] = _strdup(bodyDef.szMarkerNames[mIdx]);
+			sBodyDef&    refBodyDef = pBodyDefs->BodyDefs[bIdx];
+			sBody&       refBody    = pUpdate->arrBodies[bIdx];
+			sBodyLayout& refLayout  = refBody.layout;
+
+			refLayout.strName = refBodyDef.szName;
+			refLayout.arrMarkerNames.assign(refBodyDef.szMarkerNames, refBodyDef.szMarkerNames + refBodyDef.nMarkers);
+			sHierarchy& refHierarchy = refBodyDef.Hierarchy;
+			refLayout.arrSegmentNames.assign(refHierarchy.szSegmentNames, refHierarchy.szSegmentNames + refHierarchy.nSegments);
+			refLayout.arrParents.assign(refHierarchy.iParents, refHierarchy.iParents + refHierarchy.nSegments);
+
+			// is there an identical body in the current scene?
+			for (size_t cIdx = 0; cIdx < arrCurrent.size(); cIdx++)
+			{
+				if (!arrUsed[cIdx] && (arrCurrent[cIdx] == refLayout))
+				{
+					arrUsed[cIdx] = true;
+					pUpdate->arrPreviousIdx[bIdx] = (int) cIdx;
+					break;
+				}
+			}
+
+			if (pUpdate->arrPreviousIdx[bIdx] < 0)
+			{
+				// new or changed body
+				createBody(refBodyDef, refBody);
+			}
 		}
 
-		// array of marker data
-		refMarkerSetData.Markers = new MarkerData[nMarkers];
+		Cortex_FreeBodyDefs(pBodyDefs);
+	}
+	else
+	{
+		LOG_ERROR("Could not retrieve scene information from Cortex");
+	}
 
-		// add to description block
-		refDescr.arrDataDescriptions[idxDataBlock].type = Descriptor_MarkerSet;
-		refDescr.arrDataDescriptions[idxDataBlock].Data.MarkerSetDescription = pMarkerSetDescr;
-		idxDataBlock++;
-		idxMarkerSet++;
+	return pUpdate;
+}
 
-		sHierarchy& refSkeleton = bodyDef.Hierarchy;
-		if (refSkeleton.nSegments == 1)
+
+void MoCapCortex::createBody(sBodyDef& refBodyDef, sBody& refBody)
+{
+	// create markerset description and markerset data
+	sMarkerSetDescription* pMarkerSetDescr = new sMarkerSetDescription;
+	sMarkerSetData&        refMarkerSetData = refBody.markerSetData;
+
+	// markerset name
+	strncpy_s(pMarkerSetDescr->szName, refBodyDef.szName, sizeof(pMarkerSetDescr->szName));
+	strncpy_s(refMarkerSetData.szName, refBodyDef.szName, sizeof(refMarkerSetData.szName));
+
+	// number of markers
+	int nMarkers = refBodyDef.nMarkers;
+	pMarkerSetDescr->nMarkers = nMarkers;
+	refMarkerSetData.nMarkers = nMarkers;
+
+	// array of marker names
+	pMarkerSetDescr->szMarkerNames = new char*[nMarkers];
+	for (int mIdx = 0; mIdx < nMarkers; mIdx++)
+	{
+		size_t length = strlen(refBodyDef.szMarkerNames[mIdx]) + 1;
+		pMarkerSetDescr->szMarkerNames[mIdx] = new char[length];
+		memcpy(pMarkerSetDescr->szMarkerNames[mIdx], refBodyDef.szMarkerNames[mIdx], length);
+	}
+
+	// array of marker data
+	refMarkerSetData.Markers = new MarkerData[nMarkers];
+	refBody.pMarkerSetDescr  = pMarkerSetDescr;
+
+	refBody.bodyDescr.type = -1; // markers only
+	refBody.bodyDescr.Data.MarkerSetDescription = NULL;
+
+	sHierarchy& refSkeleton = refBodyDef.Hierarchy;
+	if (refSkeleton.nSegments == 1)
+	{
+		// one bone skeleton -> treat as rigid body
+		// create rigid body description (ID is assigned when the scene is applied)
+		sRigidBodyDescription* pRigidBodyDescr = new sRigidBodyDescription;
+		strncpy_s(pRigidBodyDescr->szName, refBodyDef.szName, sizeof(pRigidBodyDescr->szName)); // rigid body name
+		pRigidBodyDescr->parentID = -1; // no parent
+		pRigidBodyDescr->offsetx = 0;   // the offset does not exist in Cortex data
+		pRigidBodyDescr->offsety = 0;
+		pRigidBodyDescr->offsetz = 0;
+
+		// pre-fill rigid body frame data structure
+		sRigidBodyData& refRigidBodyData = refBody.rigidBodyData;
+		refRigidBodyData.nMarkers = 0;
+		refRigidBodyData.Markers = NULL;
+		refRigidBodyData.MarkerIDs = NULL;
+		refRigidBodyData.MarkerSizes = NULL;
+		refRigidBodyData.MeanError = 0;
+
+		refBody.bodyDescr.type = Descriptor_RigidBody;
+		refBody.bodyDescr.Data.RigidBodyDescription = pRigidBodyDescr;
+	}
+	else if (refSkeleton.nSegments > 0)
+	{
+		// skeleton data included as well
+		// create skeleton description and skeleton data (ID is assigned when the scene is applied)
+		sSkeletonDescription* pSkeletonDescr = new sSkeletonDescription;
+		sSkeletonData&        refSkeletonData = refBody.skeletonData;
+		strncpy_s(pSkeletonDescr->szName, refBodyDef.szName, sizeof(pSkeletonDescr->szName)); // markerset name = skeleton name
+		int nSegments = refSkeleton.nSegments;
+		pSkeletonDescr->nRigidBodies = nSegments; // number of segments
+		refSkeletonData.nRigidBodies = nSegments;
+		refSkeletonData.RigidBodyData = new sRigidBodyData[nSegments];  // array of skeleton data
+		for (int sIdx = 0; sIdx < nSegments; sIdx++)
 		{
-			// one bone skeleton -> treat as rigid body
-			// create rigid body description
-			sRigidBodyDescription* pRigidBodyDescr = new sRigidBodyDescription;
-			strncpy_s(pRigidBodyDescr->szName, bodyDef.szName, sizeof(pRigidBodyDescr->szName)); // rigid body name
-			pRigidBodyDescr->ID = iBodyIdx; // rigid body ID = actor ID
-			pRigidBodyDescr->parentID = -1; // no parent
-			pRigidBodyDescr->offsetx = 0;   // the offset does not exist in Cortex data
-			pRigidBodyDescr->offsety = 0;
-			pRigidBodyDescr->offsetz = 0;
-
-			// pre-fill rigid body frame data structure
-			sRigidBodyData& refRigidBodyData = refFrame.RigidBodies[idxRigidBody];
-			refRigidBodyData.ID = iBodyIdx;
+			// create skeleton segment description
+			sRigidBodyDescription& refRigidBodyDescr = pSkeletonDescr->RigidBodies[sIdx];
+			strncpy_s(refRigidBodyDescr.szName, refSkeleton.szSegmentNames[sIdx], sizeof(refRigidBodyDescr.szName)); // segment name
+			refRigidBodyDescr.ID = sIdx; // segment ID
+			refRigidBodyDescr.parentID = refSkeleton.iParents[sIdx]; // segment parent
+			refRigidBodyDescr.offsetx = 0;   // the offset does not exist in Cortex data
+			refRigidBodyDescr.offsety = 0;
+			refRigidBodyDescr.offsetz = 0;
+
+			// pre-fill skeleton segment frame data structure
+			sRigidBodyData&  refRigidBodyData = refSkeletonData.RigidBodyData[sIdx];
+			refRigidBodyData.ID = sIdx;
 			refRigidBodyData.nMarkers = 0;
 			refRigidBodyData.Markers = NULL;
 			refRigidBodyData.MarkerIDs = NULL;
 			refRigidBodyData.MarkerSizes = NULL;
 			refRigidBodyData.MeanError = 0;
+		}
 
-			// add to scene description
-			refDescr.arrDataDescriptions[idxDataBlock].type = Descriptor_RigidBody;
-			refDescr.arrDataDescriptions[idxDataBlock].Data.RigidBodyDescription = pRigidBodyDescr;
-			idxDataBlock++;
-			idxRigidBody++;
+		refBody.bodyDescr.type = Descriptor_Skeleton;
+		refBody.bodyDescr.Data.SkeletonDescription = pSkeletonDescr;
+	}
+}
+
+
+void MoCapCortex::freeBody(sBody& refBody)
+{
+	if (refBody.pMarkerSetDescr != NULL)
+	{
+		MoCapData::freeNatNetMarkerSetDescription(refBody.pMarkerSetDescr);
+		refBody.pMarkerSetDescr = NULL;
+	}
+	MoCapData::freeNatNetMarkerSetData(refBody.markerSetData);
+
+	switch (refBody.bodyDescr.type)
+	{
+		case Descriptor_RigidBody:
+			MoCapData::freeNatNetRigidBodyDescription(refBody.bodyDescr.Data.RigidBodyDescription);
+			MoCapData::freeNatNetRigidBodySetData(refBody.rigidBodyData);
+			break;
+
+		case Descriptor_Skeleton:
+			MoCapData::freeNatNetSkeletonDescription(refBody.bodyDescr.Data.SkeletonDescription);
+			MoCapData::freeNatNetSkeletonData(refBody.skeletonData);
+			break;
+
+		default:
+			// markers only
+			break;
+	}
+	refBody.bodyDescr.type = -1;
+	refBody.bodyDescr.Data.MarkerSetDescription = NULL;
+}
+
+
+void MoCapCortex::freeSceneUpdate(sSceneUpdate& refUpdate)
+{
+	for (size_t bIdx = 0; bIdx < refUpdate.arrBodies.size(); bIdx++)
+	{
+		if (refUpdate.arrPreviousIdx[bIdx] < 0)
+		{
+			freeBody(refUpdate.arrBodies[bIdx]);
 		}
-		else if (refSkeleton.nSegments > 0)
+	}
+	refUpdate.arrBodies.clear();
+	refUpdate.arrPreviousIdx.clear();
+}
+
+
+void MoCapCortex::applySceneUpdate(sSceneUpdate& refUpdate, MoCapData& refData)
+{
+	sDataDescriptions& refDescr = refData.description;
+	sFrameOfMocapData& refFrame = refData.frame;
+
+	// take over unchanged bodies from the current scene
+	int nUnchanged = 0;
+	std::vector<bool> arrReused(arrScene.size(), false);
+	for (size_t bIdx = 0; bIdx < refUpdate.arrBodies.size(); bIdx++)
+	{
+		int prevIdx = refUpdate.arrPreviousIdx[bIdx];
+		if (prevIdx >= 0)
 		{
-			// skeleton data included as well
-			// create skeleton description and skeleton data
-			sSkeletonDescription* pSkeletonDescr = new sSkeletonDescription;
-			sSkeletonData&        refSkeletonData = refFrame.Skeletons[idxSkeleton];
-			strncpy_s(pSkeletonDescr->szName, bodyDef.szName, sizeof(pSkeletonDescr->szName)); // markerset name = skeleton name
-			pSkeletonDescr->skeletonID = iBodyIdx; // skeleton ID
-			refSkeletonData.skeletonID = iBodyIdx;
-			int nSegments = refSkeleton.nSegments;
-			pSkeletonDescr->nRigidBodies = nSegments; // number of segments
-			refSkeletonData.nRigidBodies = nSegments;
-			refSkeletonData.RigidBodyData = new sRigidBodyData[nSegments];  // array of skeleton data
-			for (int sIdx = 0; sIdx < nSegments; sIdx++)
+			refUpdate.arrBodies[bIdx] = arrScene[prevIdx];
+			arrReused[prevIdx] = true;
+			nUnchanged++;
+		}
+	}
+
+	// keep descriptions that don't belong to Cortex bodies (e.g., force plates of the interaction system)
+	std::vector<sDataDescription> arrOtherDescr;
+	for (int dIdx = 0; dIdx < refDescr.nDataDescriptions; dIdx++)
+	{
+		const sDataDescription& refDescription = refDescr.arrDataDescriptions[dIdx];
+		bool isCortexDescription = false;
+		for (const sBody& refBody : arrScene)
+		{
+			if ((refDescription.Data.MarkerSetDescription == refBody.pMarkerSetDescr) ||
+			    ((refBody.bodyDescr.type >= 0) && (refDescription.Data.MarkerSetDescription == refBody.bodyDescr.Data.MarkerSetDescription)))
 			{
-				// create skeleton segment description
-				sRigidBodyDescription& refRigidBodyDescr = pSkeletonDescr->RigidBodies[sIdx];
-				strncpy_s(refRigidBodyDescr.szName, refSkeleton.szSegmentNames[sIdx], sizeof(refRigidBodyDescr.szName)); // segment name
-				refRigidBodyDescr.ID = sIdx; // segment ID
-				refRigidBodyDescr.parentID = refSkeleton.iParents[sIdx]; // segment parent
-				refRigidBodyDescr.offsetx = 0;   // the offset does not exist in Cortex data
-				refRigidBodyDescr.offsety = 0;
-				refRigidBodyDescr.offsetz = 0;
-
-				// pre-fill skeleton segment frame data structure
-				sRigidBodyData&  refRigidBodyData = refSkeletonData.RigidBodyData[sIdx];
-				refRigidBodyData.ID = sIdx;
-				refRigidBodyData.nMarkers = 0;
-				refRigidBodyData.Markers = NULL;
-				refRigidBodyData.MarkerIDs = NULL;
-				refRigidBodyData.MarkerSizes = NULL;
-				refRigidBodyData.MeanError = 0;
+				isCortexDescription = true;
+				break;
 			}
-			// add to description
-			refDescr.arrDataDescriptions[idxDataBlock].type = Descriptor_Skeleton;
-			refDescr.arrDataDescriptions[idxDataBlock].Data.SkeletonDescription = pSkeletonDescr;
+		}
+		if (!isCortexDescription)
+		{
+			arrOtherDescr.push_back(refDescription);
+		}
+	}
+
+	// release bodies that have changed or have been removed
+	int nRemoved = 0;
+	for (size_t bIdx = 0; bIdx < arrScene.size(); bIdx++)
+	{
+		if (!arrReused[bIdx])
+		{
+			freeBody(arrScene[bIdx]);
+			nRemoved++;
+		}
+	}
+
+	// rebuild description and frame arrays
+	int idxDataBlock = 0;
+	int idxMarkerSet = 0;
+	int idxRigidBody = 0;
+	int idxSkeleton  = 0;
+	arrRigidBodySource.clear();
+	arrSkeletonSource.clear();
+
+	for (size_t bIdx = 0; bIdx < refUpdate.arrBodies.size(); bIdx++)
+	{
+		sBody& refBody = refUpdate.arrBodies[bIdx];
+
+		// IDs stay the same for bodies with the same name
+		auto iterId = mapBodyIds.find(refBody.layout.strName);
+		if (iterId == mapBodyIds.end())
+		{
+			iterId = mapBodyIds.insert(std::make_pair(refBody.layout.strName, nextBodyId++)).first;
+		}
+		refBody.id = iterId->second;
+
+		refDescr.arrDataDescriptions[idxDataBlock].type = Descriptor_MarkerSet;
+		refDescr.arrDataDescriptions[idxDataBlock].Data.MarkerSetDescription = refBody.pMarkerSetDescr;
+		idxDataBlock++;
+		refFrame.MocapData[idxMarkerSet] = refBody.markerSetData;
+		idxMarkerSet++;
+
+		if (refBody.bodyDescr.type == Descriptor_RigidBody)
+		{
+			refBody.bodyDescr.Data.RigidBodyDescription->ID = refBody.id;
+			refBody.rigidBodyData.ID = refBody.id;
+			refDescr.arrDataDescriptions[idxDataBlock] = refBody.bodyDescr;
+			idxDataBlock++;
+			refFrame.RigidBodies[idxRigidBody] = refBody.rigidBodyData;
+			idxRigidBody++;
+			arrRigidBodySource.push_back((int) bIdx);
+		}
+		else if (refBody.bodyDescr.type == Descriptor_Skeleton)
+		{
+			refBody.bodyDescr.Data.SkeletonDescription->skeletonID = refBody.id;
+			refBody.skeletonData.skeletonID = refBody.id;
+			refDescr.arrDataDescriptions[idxDataBlock] = refBody.bodyDescr;
 			idxDataBlock++;
+			refFrame.Skeletons[idxSkeleton] = refBody.skeletonData;
 			idxSkeleton++;
+			arrSkeletonSource.push_back((int) bIdx);
+		}
+	}
+
+	for (const sDataDescription& refDescription : arrOtherDescr)
+	{
+		if (idxDataBlock < MAX_MODELS)
+		{
+			refDescr.arrDataDescriptions[idxDataBlock] = refDescription;
+			idxDataBlock++;
+		}
+		else
+		{
+			LOG_ERROR("Too many descriptions, dropping description of type " << refDescription.type);
 		}
 	}
-	// store amount of data blocks
-	refDescr.nDataDescriptions = idxDataBlock;
 
-	// prepare amount of items in frame data
-	refFrame.nMarkerSets = idxMarkerSet;
-	refFrame.nOtherMarkers = 0;
-	refFrame.OtherMarkers = new MarkerData[MAX_UNKNOWN_MARKERS];
+	// store amount of data blocks and items in frame data
+	refDescr.nDataDescriptions = idxDataBlock;
+	refFrame.nMarkerSets  = idxMarkerSet;
 	refFrame.nRigidBodies = idxRigidBody;
-	refFrame.nSkeletons = idxSkeleton;
-	refFrame.nLabeledMarkers = 0;
-	refFrame.nForcePlates = 0;
-	refFrame.Timecode = 0;
-	refFrame.TimecodeSubframe = 0;
+	refFrame.nSkeletons   = idxSkeleton;
+	if (refFrame.OtherMarkers == NULL)
+	{
+		// array is allocated on demand when unknown markers arrive
+		refFrame.nOtherMarkers = 0;
+		otherMarkerCapacity    = 0;
+	}
+
+	int nNew = (int) refUpdate.arrBodies.size() - nUnchanged;
+	arrScene.swap(refUpdate.arrBodies);
+	refUpdate.arrBodies.clear();
+	refUpdate.arrPreviousIdx.clear();
+	sceneGeneration++;
+
+	LOG_INFO("Scene updated (" << nUnchanged << " unchanged, "
+		<< nNew << " new/changed, " << nRemoved << " removed/changed bodies)");
+
+	signalSceneChange();
+}
+
+
+bool MoCapCortex::applyPendingSceneUpdate(MoCapData& refData)
+{
+	if (!sceneUpdateReady) return false;
+
+	std::unique_ptr<sSceneUpdate> pUpdate;
+	{
+		std::lock_guard<std::mutex> lock(mtxSceneUpdate);
+		pUpdate = std::move(pPendingUpdate);
+		sceneUpdateReady = false;
+	}
+
+	if (!pUpdate) return false;
+
+	if (pUpdate->generation != sceneGeneration)
+	{
+		// scene has been replaced while the update was prepared > outdated
+		freeSceneUpdate(*pUpdate);
+		return false;
+	}
+
+	applySceneUpdate(*pUpdate, refData);
+	LOG_INFO(framesSkippedForScene << " frames skipped while the scene was updated");
+	framesSkippedForScene = 0;
+	return true;
+}
+
+
+void MoCapCortex::requestSceneUpdate()
+{
+	if (sceneUpdateRunning || sceneUpdateReady) return;
+
+	// frames that keep mismatching the scene Cortex reports must not request it again for every frame
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now < nextSceneRequest) return;
+	nextSceneRequest    = now + sceneRequestBackoff;
+	sceneRequestBackoff = std::min(sceneRequestBackoff * 2, SCENE_REQUEST_BACKOFF_MAX);
+
+	LOG_INFO("Scene change detected > updating scene in the background");
+
+	if (sceneThread.joinable())
+	{
+		// previous update thread has already finished
+		sceneThread.join();
+	}
+
+	std::vector<sBodyLayout> arrCurrent;
+	for (const sBody& refBody : arrScene)
+	{
+		arrCurrent.push_back(refBody.layout);
+	}
+
+	sceneUpdateRunning = true;
+	sceneThread = std::thread(&MoCapCortex::sceneUpdateThread, this, std::move(arrCurrent), sceneGeneration);
+}
+
+
+void MoCapCortex::sceneUpdateThread(std::vector<sBodyLayout> arrCurrent, int generation)
+{
+	std::unique_ptr<sSceneUpdate> pUpdate = prepareSceneUpdate(arrCurrent, generation);
+	if (pUpdate)
+	{
+		std::lock_guard<std::mutex> lock(mtxSceneUpdate);
+		if (pPendingUpdate)
+		{
+			freeSceneUpdate(*pPendingUpdate);
+		}
+		pPendingUpdate   = std::move(pUpdate);
+		sceneUpdateReady = true;
+	}
+	sceneUpdateRunning = false;
+}
+
+
+void MoCapCortex::stopSceneUpdate()
+{
+	if (sceneThread.joinable())
+	{
+		sceneThread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(mtxSceneUpdate);
+	if (pPendingUpdate)
+	{
+		freeSceneUpdate(*pPendingUpdate);
+		pPendingUpdate.reset();
+	}
+	sceneUpdateReady = false;
 }
 
 
@@ -429,50 +1099,132 @@ bool MoCapCortex::convertCortexFrameToNatNet(sFrameOfData& refCortex, sFrameOfMo
 	refNatNet.iFrame = refCortex.iFrame;
 	refNatNet.fLatency = refCortex.fDelay;
 
-	if (refCortex.nBodies != refNatNet.nMarkerSets)
+	if ((refCortex.nBodies != refNatNet.nMarkerSets) ||
+	    (refNatNet.nRigidBodies != (int) arrRigidBodySource.size()) ||
+	    (refNatNet.nSkeletons   != (int) arrSkeletonSource.size()))
 	{
-		LOG_ERROR("Mismatch in actor count");
+		// mismatch in actor count
 		return false;
 	}
 
 	// copy marker data per actor
 	for (int mIdx = 0; mIdx < refCortex.nBodies; mIdx++)
 	{
-		convertCortexMarkerSetToNatNet(refCortex.BodyData[mIdx], refNatNet.MocapData[mIdx]);
+		if (!convertCortexMarkerSetToNatNet(refCortex.BodyData[mIdx], refNatNet.MocapData[mIdx])) return false;
 	}
 
 	// copy rigid body data
 	for (int rIdx = 0; rIdx < refNatNet.nRigidBodies; rIdx++)
 	{
-		int sourceIdx = refNatNet.RigidBodies[rIdx].ID;
+		int sourceIdx = arrRigidBodySource[rIdx];
 		convertCortexSegmentToNatNet(refCortex.BodyData[sourceIdx].Segments[0], refNatNet.RigidBodies[rIdx]);
 	}
 
 	if (handleUnknownMarkers)
 	{
-		// copy unidentified marker data
-		refNatNet.nOtherMarkers = refCortex.nUnidentifiedMarkers;
-		for (int mIdx = 0; mIdx < refNatNet.nOtherMarkers; mIdx++)
+		// copy unidentified marker data, growing the array only when a frame has more markers than ever before
+		filterCortexUnknownMarkers(refCortex);
+		int nMarkers = unknownMarkerFilter.getMarkerCount();
+		if ((refNatNet.OtherMarkers == NULL) || (nMarkers > otherMarkerCapacity))
 		{
-			convertCortexMarkerToNatNet(refCortex.UnidentifiedMarkers[mIdx], refNatNet.OtherMarkers[mIdx]);
+			otherMarkerCapacity = std::max(MIN_UNKNOWN_MARKER_CAPACITY, std::max(nMarkers, otherMarkerCapacity * 2));
+			delete[] refNatNet.OtherMarkers;
+			refNatNet.OtherMarkers = new MarkerData[otherMarkerCapacity];
 		}
+		memcpy(refNatNet.OtherMarkers, unknownMarkerFilter.getMarkers(), nMarkers * sizeof(MarkerData));
+		refNatNet.nOtherMarkers = nMarkers;
 	}
 	else
 	{
-		refNatNet.OtherMarkers = 0;
+		refNatNet.nOtherMarkers = 0;
 	}
 
 	// copy skeleton data
 	for (int sIdx = 0; sIdx < refNatNet.nSkeletons; sIdx++)
 	{
-		int sourceIdx = refNatNet.Skeletons[sIdx].skeletonID;
-		convertCortexSegmentsToNatNet(refCortex.BodyData[sourceIdx], refNatNet.Skeletons[sIdx]);
+		int sourceIdx = arrSkeletonSource[sIdx];
+		if (!convertCortexSegmentsToNatNet(refCortex.BodyData[sourceIdx], refNatNet.Skeletons[sIdx])) return false;
 	}
 
 	return true;
 }
 
 
+bool MoCapCortex::writeCortexFrame(sFrameOfData& refCortex, const sFrameOfMocapData& refLayout, FramePacketWriter& refWriter)
+{
+	if ((refCortex.nBodies != refLayout.nMarkerSets) ||
+	    (refLayout.nRigidBodies != (int) arrRigidBodySource.size()) ||
+	    (refLayout.nSkeletons   != (int) arrSkeletonSource.size()))
+	{
+		// scene was updated > let getFrameData() deal with it
+		return false;
+	}
+
+	refWriter.beginFrame(refCortex.iFrame);
+
+	// marker data per actor
+	refWriter.beginMarkerSets(refCortex.nBodies);
+	for (int msIdx = 0; msIdx < refCortex.nBodies; msIdx++)
+	{
+		sBodyData& refBody = refCortex.BodyData[msIdx];
+		if (refBody.nMarkers != refLayout.MocapData[msIdx].nMarkers) return false;
+
+		refWriter.beginMarkerSet(refLayout.MocapData[msIdx].szName, refBody.nMarkers);
+		for (int mIdx = 0; mIdx < refBody.nMarkers; mIdx++)
+		{
+			MarkerData marker;
+			convertCortexMarkerToNatNet(refBody.Markers[mIdx], marker);
+			refWriter.writeMarker(marker);
+		}
+	}
+
+	// unidentified marker data
+	int nOtherMarkers = 0;
+	if (handleUnknownMarkers)
+	{
+		filterCortexUnknownMarkers(refCortex);
+		nOtherMarkers = unknownMarkerFilter.getMarkerCount();
+	}
+	refWriter.beginOtherMarkers(nOtherMarkers);
+	for (int mIdx = 0; mIdx < nOtherMarkers; mIdx++)
+	{
+		refWriter.writeMarker(unknownMarkerFilter.getMarkers()[mIdx]);
+	}
+
+	// rigid body data (the layout provides the IDs and the empty marker lists)
+	refWriter.beginRigidBodies(refLayout.nRigidBodies);
+	for (int rIdx = 0; rIdx < refLayout.nRigidBodies; rIdx++)
+	{
+		sRigidBodyData rigidBody = refLayout.RigidBodies[rIdx];
+		convertCortexSegmentToNatNet(refCortex.BodyData[arrRigidBodySource[rIdx]].Segments[0], rigidBody);
+		refWriter.writeRigidBody(rigidBody);
+	}
+
+	// skeleton data
+	refWriter.beginSkeletons(refLayout.nSkeletons);
+	for (int sIdx = 0; sIdx < refLayout.nSkeletons; sIdx++)
+	{
+		const sSkeletonData& refSkeleton = refLayout.Skeletons[sIdx];
+		sBodyData&           refBody     = refCortex.BodyData[arrSkeletonSource[sIdx]];
+		if (refBody.nSegments != refSkeleton.nRigidBodies) return false;
+
+		refWriter.beginSkeleton(refSkeleton.skeletonID, refSkeleton.nRigidBodies);
+		for (int bIdx = 0; bIdx < refSkeleton.nRigidBodies; bIdx++)
+		{
+			sRigidBodyData bone = refSkeleton.RigidBodyData[bIdx];
+			convertCortexSegmentToNatNet(refBody.Segments[bIdx], bone);
+			refWriter.writeRigidBody(bone);
+		}
+	}
+
+	// Cortex provides no labeled markers and no force plates
+	refWriter.beginLabeledMarkers(0);
+	refWriter.beginForcePlates(0);
+
+	return refWriter.endFrame(refCortex.fDelay, refLayout.Timecode, refLayout.TimecodeSubframe, refLayout.fTimestamp, refLayout.params);
+}
+
+
 void MoCapCortex::convertCortexMarkerToNatNet(tMarkerData& refCortex, MarkerData& refNatNet)
 {
 	if (refCortex[0] < XEMPTY)
@@ -491,18 +1243,49 @@ void MoCapCortex::convertCortexMarkerToNatNet(tMarkerData& refCortex, MarkerData
 }
 
 
-void MoCapCortex::convertCortexMarkerSetToNatNet(sBodyData& refCortex, sMarkerSetData& refNatNet)
+void MoCapCortex::filterCortexUnknownMarkers(sFrameOfData& refCortex)
 {
-	if (refCortex.nMarkers != refNatNet.nMarkers)
+	if ((pFilteredFrame == &refCortex) && (filteredFrameNumber == refCortex.iFrame))
 	{
-		LOG_ERROR("Mismatch in marker count");
+		// already filtered, e.g., by writeFrameData(...) before falling back to getFrameData(...)
 		return;
 	}
+	pFilteredFrame      = &refCortex;
+	filteredFrameNumber = refCortex.iFrame;
+
+	unknownMarkerFilter.beginFrame();
+	for (int mIdx = 0; mIdx < refCortex.nUnidentifiedMarkers; mIdx++)
+	{
+		tMarkerData& refMarker = refCortex.UnidentifiedMarkers[mIdx];
+		if (refMarker[0] < XEMPTY)
+		{
+			MarkerData marker;
+			convertCortexMarkerToNatNet(refMarker, marker);
+			unknownMarkerFilter.addMarker(marker);
+		}
+		else
+		{
+			// vanished markers carry no information
+			unknownMarkerFilter.addInvalidMarker();
+		}
+	}
+	unknownMarkerFilter.process();
+}
+
+
+bool MoCapCortex::convertCortexMarkerSetToNatNet(sBodyData& refCortex, sMarkerSetData& refNatNet)
+{
+	if (refCortex.nMarkers != refNatNet.nMarkers)
+	{
+		// mismatch in marker count
+		return false;
+	}
 
 	for (int mIdx = 0; mIdx < refCortex.nMarkers; mIdx++)
 	{
 		convertCortexMarkerToNatNet(refCortex.Markers[mIdx], refNatNet.Markers[mIdx]);
 	}
+	return true;
 }
 
 
@@ -546,18 +1329,19 @@ void MoCapCortex::convertCortexSegmentToNatNet(double refCortex[], sRigidBodyDat
 }
 
 
-void MoCapCortex::convertCortexSegmentsToNatNet(sBodyData& refCortex, sSkeletonData& refNatNet)
+bool MoCapCortex::convertCortexSegmentsToNatNet(sBodyData& refCortex, sSkeletonData& refNatNet)
 {
 	if (refCortex.nSegments != refNatNet.nRigidBodies)
 	{
-		LOG_ERROR("Mismatch in segment count");
-		return;
+		// mismatch in segment count
+		return false;
 	}
 
 	for (int sIdx = 0; sIdx < refCortex.nSegments; sIdx++)
 	{
 		convertCortexSegmentToNatNet(refCortex.Segments[sIdx], refNatNet.RigidBodyData[sIdx]);
 	}
+	return true;
 }
 
 
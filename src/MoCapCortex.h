@@ -8,10 +8,23 @@
 
 #ifdef USE_CORTEX
 
+#ifndef USE_CORTEX_STUB
 #pragma comment(lib, "Cortex_SDK.lib")
+#endif
 
 #include "MoCapSystem.h"
 #include "Cortex.h"
+#include "CortexCapture.h"
+#include "UnknownMarkerFilter.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 
 class MoCapCortex : public MoCapSystem
@@ -27,9 +40,13 @@ public:
 	virtual bool  isRunning();
 	virtual void  setRunning(bool running);
 	virtual bool  update();
+	virtual bool  isEventDriven();
 	virtual bool  getSceneDescription(MoCapData& refData);
 	virtual bool  getFrameData(MoCapData& refData);
+	virtual bool  isFrameSkipped();
+	virtual bool  writeFrameData(const MoCapData& refData, FramePacketWriter& refWriter);
 	virtual bool  processCommand(const std::string& strCommand);
+	virtual void  stop();
 	virtual bool  deinitialise();
 
 	/**
@@ -46,22 +63,183 @@ public:
 	 */
 	void  setHandleUnknownMarkers(bool enable);
 
+	/**
+	 * Handles a frame delivered by the Cortex data callback.
+	 * The frame is only copied and handed over to the streaming thread, which converts it.
+	 *
+	 * @param refFrame  the frame from Cortex (only valid during the callback)
+	 */
+	void  handleFrame(sFrameOfData& refFrame);
+
+	/**
+	 * Starts recording body definitions and frames into a capture file.
+	 *
+	 * @param strFilename  the name of the capture file
+	 *
+	 * @return <code>true</code> if the recording was started
+	 */
+	bool  startRecording(const std::string& strFilename);
+
+	/**
+	 * Stops recording into a capture file.
+	 */
+	void  stopRecording();
+
+	/**
+	 * Prints statistics about the time the conversion of frames takes.
+	 *
+	 * @param refOutput  the stream to print to
+	 */
+	void  printConversionStatistics(std::ostream& refOutput);
+
+	/**
+	 * Sets the size of the voxels for merging near-duplicate unknown markers.
+	 *
+	 * @param voxelSize  the edge length of a voxel in m (0: no deduplication)
+	 */
+	void  setUnknownMarkerVoxelSize(float voxelSize);
+
+	/**
+	 * Sets the maximum amount of unknown markers per frame.
+	 * Markers closest to the origin are kept when there are more.
+	 *
+	 * @param maxMarkers  the maximum amount of unknown markers
+	 */
+	void  setUnknownMarkerLimit(int maxMarkers);
+
 
 private:
 
 	/**
-	 * Converts the scene description from Cortex to NatNet.
+	 * Structure of a Cortex body as far as it matters for the NatNet description.
+	 */
+	struct sBodyLayout
+	{
+		std::string              strName;
+		std::vector<std::string> arrMarkerNames;
+		std::vector<std::string> arrSegmentNames;
+		std::vector<int>         arrParents;
+
+		bool operator==(const sBodyLayout& refOther) const;
+	};
+
+	/**
+	 * A Cortex body and the NatNet structures it is mapped to.
+	 * The structures are owned by the MoCapData instance once the scene is applied.
+	 */
+	struct sBody
+	{
+		sBodyLayout            layout;
+		int                    id;              // stable ID of the rigid body/skeleton
+		sMarkerSetDescription* pMarkerSetDescr;
+		sMarkerSetData         markerSetData;
+		sDataDescription       bodyDescr;       // rigid body or skeleton description (type -1: markers only)
+		sRigidBodyData         rigidBodyData;
+		sSkeletonData          skeletonData;
+	};
+
+	/**
+	 * Difference between the current scene and a new Cortex scene.
+	 * Only new and changed bodies have NatNet structures allocated,
+	 * unchanged bodies refer to their index in the current scene.
+	 */
+	struct sSceneUpdate
+	{
+		int                generation;      // scene generation the update was compared against
+		std::vector<sBody> arrBodies;
+		std::vector<int>   arrPreviousIdx;  // index in the current scene, -1: new or changed body
+	};
+
+	/**
+	 * Reads the Cortex scene and compares it against the current scene.
+	 *
+	 * @param arrCurrent  the layout of the current scene
+	 * @param generation  the generation of the current scene
+	 *
+	 * @return the scene update or <code>NULL</code> if the scene could not be read
+	 */
+	std::unique_ptr<sSceneUpdate> prepareSceneUpdate(const std::vector<sBodyLayout>& arrCurrent, int generation);
+
+	/**
+	 * Creates the NatNet structures for a new or changed body.
+	 */
+	void createBody(sBodyDef& refBodyDef, sBody& refBody);
+
+	/**
+	 * Releases the NatNet structures of a body.
+	 */
+	void freeBody(sBody& refBody);
+
+	/**
+	 * Releases the NatNet structures of a scene update that is not going to be applied.
+	 */
+	void freeSceneUpdate(sSceneUpdate& refUpdate);
+
+	/**
+	 * Replaces the current scene by the updated scene,
+	 * reusing the structures of unchanged bodies and keeping non-Cortex descriptions.
+	 * Needs to be called with the MoCap data locked.
+	 */
+	void applySceneUpdate(sSceneUpdate& refUpdate, MoCapData& refData);
+
+	/**
+	 * Applies a scene update that was prepared in the background.
+	 *
+	 * @return <code>true</code> if an update was applied
+	 */
+	bool applyPendingSceneUpdate(MoCapData& refData);
+
+	/**
+	 * Starts reading and comparing the Cortex scene in the background.
+	 */
+	void requestSceneUpdate();
+
+	/**
+	 * Thread that prepares a scene update.
+	 */
+	void sceneUpdateThread(std::vector<sBodyLayout> arrCurrent, int generation);
+
+	/**
+	 * Waits for the scene update thread and discards any pending update.
+	 */
+	void stopSceneUpdate();
+
+	/**
+	 * Thread that converts and streams the frames handed over by the Cortex callback.
+	 */
+	void frameStreamingThread();
+
+	/**
+	 * Adds the duration of a frame conversion to the statistics.
+	 *
+	 * @param start  the time the conversion started
+	 */
+	void updateConversionStatistics(std::chrono::steady_clock::time_point start);
+
+	/**
+	 * Gets the frame to convert: the handed over frame when called from the streaming thread,
+	 * otherwise the current frame requested from Cortex.
+	 *
+	 * @param releaseFrame  set to <code>true</code> if the frame needs to be freed with Cortex_FreeFrame()
+	 *
+	 * @return the frame or <code>NULL</code> if no frame is available
 	 */
-	void convertCortexDescriptionToNatNet(sBodyDefs& refCortex, sDataDescriptions& refDescr, sFrameOfMocapData& refFrame);
+	sFrameOfData* acquireFrame(bool& releaseFrame);
 
 	/**
 	 * Converts frame data from Cortex to NatNet.
 	 */
 	bool convertCortexFrameToNatNet(sFrameOfData& refCortex, sFrameOfMocapData& refFrame);
 	void convertCortexMarkerToNatNet(tMarkerData& refCortex, MarkerData& refNatNet);
-	void convertCortexMarkerSetToNatNet(sBodyData& refCortex, sMarkerSetData& refNatNet);
+	void filterCortexUnknownMarkers(sFrameOfData& refCortex);
+	bool convertCortexMarkerSetToNatNet(sBodyData& refCortex, sMarkerSetData& refNatNet);
 	void convertCortexSegmentToNatNet(double refCortex[], sRigidBodyData& refNatNet);
-	void convertCortexSegmentsToNatNet(sBodyData& refCortex, sSkeletonData& refNatNet);
+	bool convertCortexSegmentsToNatNet(sBodyData& refCortex, sSkeletonData& refNatNet);
+
+	/**
+	 * Writes frame data from Cortex directly into a NatNet packet.
+	 */
+	bool writeCortexFrame(sFrameOfData& refCortex, const sFrameOfMocapData& refLayout, FramePacketWriter& refWriter);
 
 private:
 
@@ -76,6 +254,59 @@ private:
 	float        updateRate;
 	bool         handleUnknownMarkers;
 
+	UnknownMarkerFilter unknownMarkerFilter;
+	int                 otherMarkerCapacity; // allocated size of the frame's unknown marker array
+	sFrameOfData*       pFilteredFrame;      // frame the filter currently holds the markers of
+	int                 filteredFrameNumber;
+
+	int          lastFrameNumber;
+	uint64_t     framesReceived;
+	uint64_t     framesDuplicated;
+	uint64_t     framesSkipped;
+	uint64_t     framesReplaced;   // frames replaced by a newer one before they were streamed (latest frame wins)
+	bool         frameSkipped;     // last frame was skipped because the scene is being updated
+	uint64_t     framesSkippedForScene;
+
+	// current scene
+	std::vector<sBody>             arrScene;
+	int                            sceneGeneration;
+	std::vector<int>               arrRigidBodySource; // Cortex body index per NatNet rigid body
+	std::vector<int>               arrSkeletonSource;  // Cortex body index per NatNet skeleton
+	std::map<std::string, int>     mapBodyIds;         // stable IDs by body name
+	int                            nextBodyId;
+
+	// capture recording (the lock only guards the recorder pointer, the recorder writes on its own thread)
+	std::mutex                     mtxCapture;
+	std::unique_ptr<CortexCaptureRecorder> pCaptureRecorder;
+
+	// hand-over of frames from the Cortex callback to the streaming thread (triple buffer):
+	// the callback copies into its slot and swaps it with the published one,
+	// the streaming thread swaps its slot with the published one when that holds a fresh frame
+	static const int               FRAME_SLOT_COUNT = 3;
+	static const int               FRAME_SLOT_FRESH = 0x04; // flag on the published slot index
+	CortexFrame                    arrFrameSlots[FRAME_SLOT_COUNT];
+	int                            writeSlot;              // only used by the Cortex callback
+	int                            readSlot;               // only used by the streaming thread
+	std::atomic<int>               publishedSlot;
+	std::thread                    frameThread;
+	std::atomic<bool>              frameStreamingRunning;
+	std::mutex                     mtxFrameSignal;
+	std::condition_variable        cvFrameSignal;
+
+	// conversion timing
+	uint64_t                       conversionCount;
+	std::chrono::nanoseconds       conversionTimeTotal;
+	std::chrono::nanoseconds       conversionTimeMax;
+
+	// background scene update
+	std::thread                    sceneThread;
+	std::atomic<bool>              sceneUpdateRunning;
+	std::atomic<bool>              sceneUpdateReady;
+	std::mutex                     mtxSceneUpdate;
+	std::unique_ptr<sSceneUpdate>  pPendingUpdate;
+	std::chrono::steady_clock::time_point nextSceneRequest; // earliest time for requesting the scene again
+	std::chrono::milliseconds      sceneRequestBackoff;
+
 };
 
 #endif // #ifdef USE_CORTEX
\ No newline at end of file
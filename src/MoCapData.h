@@ -19,20 +19,23 @@ public:
 	sSkeletonDescription*   findSkeletonDescription(  const sSkeletonData&   refSkeletonData) const;
 	sForcePlateDescription* findForcePlateDescription(const sForcePlateData& refForcePlateData) const;
 
+	// Methods for freeing single dynamically allocated data structures,
+	// e.g., when a MoCap system replaces parts of the scene
+	static void freeNatNetMarkerSetDescription(sMarkerSetDescription* pMarkerSet);
+	static void freeNatNetRigidBodyDescription(sRigidBodyDescription* pRigidBody);
+	static void freeNatNetSkeletonDescription(sSkeletonDescription* pSkeleton);
+	static void freeNatNetForcePlateDescription(sForcePlateDescription* pForcePlate);
+
+	static void freeNatNetMarkerSetData(sMarkerSetData& refMarkerSetData);
+	static void freeNatNetRigidBodySetData(sRigidBodyData& refBodySetData);
+	static void freeNatNetSkeletonData(sSkeletonData& refSkeleton);
+	static void freeNatNetForcePlateData(sForcePlateData& refForcePlate);
+
 private:
 
-	// Internal methods for freeing dynamically allocated data structures
+	// Internal methods for freeing all dynamically allocated data structures
 	void freeNatNetDescription();
-	void freeNatNetMarkerSetDescription(sMarkerSetDescription* pMarkerSet);
-	void freeNatNetRigidBodyDescription(sRigidBodyDescription* pRigidBody);
-	void freeNatNetSkeletonDescription(sSkeletonDescription* pSkeleton);
-	void freeNatNetForcePlateDescription(sForcePlateDescription* pForcePlate);
-
 	void freeNatNetFrameData();
-	void freeNatNetMarkerSetData(sMarkerSetData& refMarkerSetData);
-	void freeNatNetRigidBodySetData(sRigidBodyData& refBodySetData);
-	void freeNatNetSkeletonData(sSkeletonData& refSkeleton);
-	void freeNatNetForcePlateData(sForcePlateData& refForcePlate);
 
 public:
 	sDataDescriptions description;
@@ -414,8 +414,9 @@ void MoCapFileWriter::writeForcePlateData(const sForcePlateData& data)
 	write(data.nChannels);
 	for (int cIdx = 0; cIdx < data.nChannels; cIdx++)
 	{
-		// file stores only one frame per tick, 
-		write(data.ChannelData[cIdx].Values[0]);
+		// file stores only one frame per tick > use the latest subframe
+		const sAnalogChannelData& refChannel = data.ChannelData[cIdx];
+		write(refChannel.Values[(refChannel.nFrames > 0) ? (refChannel.nFrames - 1) : 0]);
 	}
 }
 
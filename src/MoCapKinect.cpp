@@ -6,80 +6,105 @@
 #undef   LOG_CLASS
 #define  LOG_CLASS "MoCapKinect"
 
-#include "VectorMath.h"
+#include "KinectNuiSensor.h"
 
 #include <algorithm>
+#include <iostream>
 #include <iterator>
+#include <sstream>
 #include <string>
 
-struct SKELETON_POSITIONS {
-	char* PositionName;
-	NUI_SKELETON_POSITION_INDEX index;
-	float x;
-	float y;
-	float z;
-};
-
-const SKELETON_POSITIONS SKELETON_POSTIONS_PARAM[]{
-	{ "HEAD", NUI_SKELETON_POSITION_HEAD },{ "SHOULDER_CENTER",NUI_SKELETON_POSITION_SHOULDER_CENTER },
-	{ "SHOULDER_RIGHT", NUI_SKELETON_POSITION_SHOULDER_RIGHT },{ "ELBOW_RIGHT", NUI_SKELETON_POSITION_ELBOW_RIGHT },
-	{ "WRIST_RIGHT", NUI_SKELETON_POSITION_WRIST_RIGHT },{ "HAND_RIGHT", NUI_SKELETON_POSITION_HAND_RIGHT },
-	{ "SHOULDER_LEFT", NUI_SKELETON_POSITION_SHOULDER_LEFT },{ "ELBOW_LEFT", NUI_SKELETON_POSITION_ELBOW_LEFT },
-	{ "WRIST_LEFT",NUI_SKELETON_POSITION_WRIST_LEFT },{ "HAND_LEFT", NUI_SKELETON_POSITION_HAND_LEFT },
-	{ "SPINE", NUI_SKELETON_POSITION_SPINE },{ "HIP_CENTER", NUI_SKELETON_POSITION_HIP_CENTER },
-	{ "HIP_RIGHT", NUI_SKELETON_POSITION_HIP_RIGHT },{ "HIP_LEFT", NUI_SKELETON_POSITION_HIP_LEFT },
-	{ "KNEE_RIGHT", NUI_SKELETON_POSITION_KNEE_RIGHT },{ "KNEE_LEFT", NUI_SKELETON_POSITION_KNEE_LEFT },
-	{ "ANKLE_RIGHT", NUI_SKELETON_POSITION_ANKLE_RIGHT },{ "ANKLE_LEFT", NUI_SKELETON_POSITION_ANKLE_LEFT },
-	{ "FOOT_RIGHT", NUI_SKELETON_POSITION_FOOT_RIGHT },{ "FOOT_LEFT",NUI_SKELETON_POSITION_FOOT_LEFT },
-};
-
-const int SKELETON_POSITION_INDEX_COUNT = sizeof(SKELETON_POSTIONS_PARAM) / 2;
-
-MoCapKinect::MoCapKinect() :
+
+#undef  LOG_JOINTS // define to print the joint positions of every captured frame
+
+#define CAPTURE_TIMEOUT_MS 100 // time after which the capture thread checks if it needs to stop
+
+
+MoCapKinect::MoCapKinect(const std::string& strRecording) :
 	initialised(false),
-	isPlaying(true)
+	isPlaying(true),
+	strRecording(strRecording),
+	captureRunning(false),
+	framesCaptured(0),
+	framesEmpty(0)
 {
-	this->strKinectAddress = strKinectAddress;
+	// nothing else to do
 }
 
 bool MoCapKinect::initialise() {
-	initialised = true;
-
-	LOG_INFO("Kinect SDK version v 1.8");
+	if (initialised) return initialised;
 
-	HRESULT result;
-	result = findKinectSensor();
-
-
-	if (FAILED(result)) {
-		LOG_INFO("Cannot find connected kinect.");
-		initialised = false;
-		return initialised;
+	if (strRecording.empty())
+	{
+		pSensor.reset(new KinectNuiSensor());
+	}
+	else
+	{
+		pSensor.reset(new KinectRecordedSensor(strRecording));
 	}
 
-	LOG_INFO("Connected to Kinect server ");
-
-	result = pNuiSensor->NuiInitialize(NUI_INITIALIZE_FLAG_USES_SKELETON);
-
-	if (FAILED(result)) {
-		LOG_INFO("Cannot open kinect.");
-		deinitialise();
+	if (!pSensor->open()) {
+		LOG_INFO("Cannot open " << pSensor->getName() << ".");
+		pSensor.reset();
 		return initialised;
 	}
 
-	kinectHandel = CreateEventW(NULL, TRUE, FALSE, NULL);
-	result = pNuiSensor->NuiSkeletonTrackingEnable(kinectHandel, NUI_SKELETON_TRACKING_FLAG_ENABLE_SEATED_SUPPORT);
+	LOG_INFO("Connected to " << pSensor->getName());
+	initialised = true;
 
-	if (FAILED(result)) {
-		LOG_INFO("Cannot enable skeleton tracking.");
-		deinitialise();
-		return initialised;
-	}
+	// frames are captured as soon as the sensor delivers them
+	captureRunning = true;
+	captureLoop    = std::thread(&MoCapKinect::captureThread, this);
 
 	LOG_INFO("Kinect Initialized.");
 	return initialised;
 }
 
+
+void MoCapKinect::captureThread()
+{
+	KinectFrame frame;
+	while (captureRunning)
+	{
+		if (!pSensor->waitForFrame(frame, CAPTURE_TIMEOUT_MS))
+		{
+			continue;
+		}
+		framesCaptured++;
+		if (frame.nUsers == 0) framesEmpty++;
+
+#ifdef LOG_JOINTS
+		for (int uIdx = 0; uIdx < frame.nUsers; uIdx++)
+		{
+			for (int jIdx = 0; jIdx < KINECT_JOINT_COUNT; jIdx++)
+			{
+				const KinectJoint& refJoint = frame.users[uIdx].joints[jIdx];
+				std::cout << frame.users[uIdx].trackingId << " " << KinectSkeletonMapper::getJointName(jIdx)
+					<< ": x" << refJoint.x << " y" << refJoint.y << " z" << refJoint.z << std::endl;
+			}
+		}
+#endif
+
+		{
+			std::lock_guard<std::mutex> lock(mtxRecorder);
+			recorder.write(frame);
+		}
+
+		bool newData;
+		{
+			std::lock_guard<std::mutex> lock(mtxSkeletons);
+			newData = skeletonMapper.update(frame);
+		}
+
+		// nobody in front of the sensor > nothing new to stream
+		if (newData && isPlaying)
+		{
+			signalNewFrame();
+		}
+	}
+}
+
+
 bool MoCapKinect::isActive()
 {
 	return initialised;
@@ -88,29 +113,51 @@ bool MoCapKinect::isActive()
 
 float MoCapKinect::getUpdateRate()
 {
-	return 60;
+	return 30;
 }
 
 bool  MoCapKinect::getFrameData(MoCapData& refData) {
-	// update marker data
-	sMarkerSetData& msData = refData.frame.MocapData[0];
+	// copy the latest users into the preallocated frame
+	std::lock_guard<std::mutex> lock(mtxSkeletons);
+	skeletonMapper.writeFrame(refData.frame);
+	return true;
+}
+
+bool  MoCapKinect::processCommand(const std::string& strCommand) {
+	bool processed = false;
 
-	if (WAIT_OBJECT_0 == WaitForSingleObject(kinectHandel, 0)) {
-		NUI_SKELETON_FRAME skeletonFrame = { 0 };
+	// convert command to lowercase
+	std::string strCmdLowerCase;
+	std::transform(strCommand.begin(), strCommand.end(), std::back_inserter(strCmdLowerCase), ::tolower);
 
-		if (SUCCEEDED(pNuiSensor->NuiSkeletonGetNextFrame(0, &skeletonFrame)))
+	if (strCmdLowerCase.find("record ") == 0)
+	{
+		// filename keeps its case
+		std::lock_guard<std::mutex> lock(mtxRecorder);
+		processed = recorder.open(strCommand.substr(strCommand.find_first_of(" ") + 1));
+	}
+	else if (strCmdLowerCase == "stoprecord")
+	{
+		std::lock_guard<std::mutex> lock(mtxRecorder);
+		recorder.close();
+		processed = true;
+	}
+	else if (strCmdLowerCase == "users")
+	{
+		std::lock_guard<std::mutex> lock(mtxSkeletons);
+		std::stringstream strm;
+		strm << "Kinect users: " << skeletonMapper.getActiveUserCount();
+		for (int sIdx = 0; sIdx < KINECT_MAX_USERS; sIdx++)
 		{
-			SkeletonFrameReady(&skeletonFrame, &msData);
+			strm << std::endl << "\tSkeleton " << (sIdx + 1) << ": ";
+			uint32_t trackingId = skeletonMapper.getTrackingId(sIdx);
+			if (trackingId != 0) strm << "user " << trackingId; else strm << "-";
 		}
+		std::cout << strm.str() << std::endl;
+		processed = true;
 	}
 
-	Sleep(1000/120);
-
-	return true;
-}
-
-bool  MoCapKinect::processCommand(const std::string& strCommand) {
-	return true;
+	return processed;
 }
 
 bool MoCapKinect::isRunning()
@@ -126,113 +173,52 @@ void MoCapKinect::setRunning(bool running)
 
 bool MoCapKinect::update()
 {
-	//update is done by kinect itself, no menu update required	
-	signalNewFrame();
+	//update is done by the capture thread, no timer update required
 	return true;
 }
 
-void MoCapKinect::SkeletonFrameReady(NUI_SKELETON_FRAME *pSkeletonFrame, sMarkerSetData* msData)
+bool MoCapKinect::isEventDriven()
 {
-	for (int i = 0; i < NUI_SKELETON_COUNT; i++)
-	{
-		const NUI_SKELETON_DATA &skeleton = pSkeletonFrame->SkeletonData[i];
+	// the capture thread signals frames when the sensor delivers them
+	return true;
+}
 
-		switch (skeleton.eTrackingState)
-		{
-		case NUI_SKELETON_TRACKED:
-			GetSkeleton(skeleton, msData);
-			break;
-		case NUI_SKELETON_POSITION_ONLY:
-			GetSkeleton(skeleton, msData);
-			break;
-		}
-	}
+bool MoCapKinect::getSceneDescription(MoCapData& refData)
+{
+	// fixed layout for all possible users > no reallocation when users come and go
+	std::lock_guard<std::mutex> lock(mtxSkeletons);
+	skeletonMapper.createSceneDescription(refData);
+	skeletonMapper.writeFrame(refData.frame);
+	return true;
 }
 
-void MoCapKinect::GetSkeleton(const NUI_SKELETON_DATA &skeleton, sMarkerSetData *msData)
+void MoCapKinect::stop()
 {
-	//sample to show the position
-	for (int m = 0; m < msData->nMarkers; m++)
+	// the capture thread might be waiting for the MoCap data lock in signalNewFrame()
+	// > main calls this without the lock before deinitialise()
+	captureRunning = false;
+	if (captureLoop.joinable())
 	{
-		const Vector4 &point = skeleton.SkeletonPositions[SKELETON_POSTIONS_PARAM[m].index];
-
-		std::cout << "x" << point.x << "y" << point.y << "z" << point.z << "\n" << std::endl;
-		msData->Markers[m][0] = point.x;
-		msData->Markers[m][1] = point.y;
-		msData->Markers[m][2] = point.z;
+		captureLoop.join();
+		LOG_INFO("Frames captured: " << framesCaptured << " (without users: " << framesEmpty << ")");
 	}
 }
 
-bool MoCapKinect::getSceneDescription(MoCapData& refData)
-{
-	int descrIdx = 0;
-
-	// create markerset description and frame
-	sMarkerSetDescription* pMarkerDesc = new sMarkerSetDescription();
-	sMarkerSetData&        msData = refData.frame.MocapData[0];
-
-	// name of marker set
-	strcpy_s(pMarkerDesc->szName, sizeof(pMarkerDesc->szName), "user 1");
-	strcpy_s(msData.szName, sizeof(msData.szName), pMarkerDesc->szName);
-
-	// number of markers
-	pMarkerDesc->nMarkers = 20;
-	msData.nMarkers = 20;
-
-	pMarkerDesc->szMarkerNames = new char*[20];
-	msData.Markers = new MarkerData[20];
-
+bool MoCapKinect::deinitialise() {
+	// stop capturing before the sensor goes away
+	stop();
 
-	for (int m = 0; m < 20; m++)
 	{
-		pMarkerDesc->szMarkerNames[m] = SKELETON_POSTIONS_PARAM[m].PositionName;
+		std::lock_guard<std::mutex> lock(mtxRecorder);
+		recorder.close();
 	}
 
-
-	// add to description list
-	refData.description.arrDataDescriptions[descrIdx].type = Descriptor_MarkerSet;
-	refData.description.arrDataDescriptions[descrIdx].Data.MarkerSetDescription = pMarkerDesc;
-	descrIdx++;
-
-	sRigidBodyDescription* pBodyDesc = new sRigidBodyDescription();
-	// fill in description structure
-	pBodyDesc->ID = 0; // needs to be equal to array index
-	pBodyDesc->parentID = -1;
-	pBodyDesc->offsetx = 0;
-	pBodyDesc->offsety = 0;
-	pBodyDesc->offsetz = 0;
-	strcpy_s(pBodyDesc->szName, sizeof(pBodyDesc->szName), pMarkerDesc->szName);
-
-	refData.description.arrDataDescriptions[descrIdx].type = Descriptor_RigidBody;
-	refData.description.arrDataDescriptions[descrIdx].Data.RigidBodyDescription = pBodyDesc;
-	descrIdx++;
-
-	refData.description.nDataDescriptions = descrIdx;
-
-	// pre-fill in frame data
-	refData.frame.nMarkerSets = 1;
-	refData.frame.nRigidBodies = 1;
-	refData.frame.nSkeletons = 0;
-
-	refData.frame.nOtherMarkers = 0;
-	refData.frame.OtherMarkers = NULL;
-
-	refData.frame.nLabeledMarkers = 0;
-
-	refData.frame.nForcePlates = 0;
-
-	refData.frame.fLatency = 0.01f; // simulate 10ms
-	refData.frame.Timecode = 0;
-	refData.frame.TimecodeSubframe = 0;
-
-	return true;
-}
-
-bool MoCapKinect::deinitialise() {
-	if (initialised) {
-		NuiShutdown();
-		initialised = false;
+	if (pSensor)
+	{
+		pSensor->close();
+		pSensor.reset();
 	}
+	initialised = false;
 	return !initialised;
 }
 
@@ -241,9 +227,4 @@ MoCapKinect::~MoCapKinect()
 	deinitialise();
 }
 
-HRESULT	MoCapKinect::findKinectSensor()
-{
-	return NuiCreateSensorByIndex(0, &pNuiSensor);
-}
-
 #endif
@@ -2,33 +2,87 @@
 
 #ifdef USE_PIECEMETA
 
+#include "Portability.h"
+
 #include "Logging.h"
 #undef   LOG_CLASS
 #define  LOG_CLASS "MoCapPieceMeta"
 
-#include <windows.h>
-#include <WinInet.h>
 #include <algorithm>
+#include <atomic>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
 #include <iostream>
 #include <iomanip>
 #include <string>
+#include <thread>
 #include <locale>
 
 #include "json11.hpp"
 
-#pragma comment(lib,"Wininet.lib")
+#define PIECEMETA_BASE_URL        "http://api.piecemeta.com/"
+#define PIECEMETA_CACHE_DIRECTORY "PieceMetaCache"
+#define DEFAULT_THREAD_COUNT      4
+#define PROGRESS_INTERVAL_MS      100 // interval for updating the loading progress
 
-#define PIECEMETA_BASE_URL "http://api.piecemeta.com/"
+
+/**
+ * Handler for the stream data JSON that writes the numbers of the "frames" array
+ * straight into the stream data without creating a document tree.
+ */
+class StreamDataHandler : public JsonStreamHandler
+{
+public:
+	StreamDataHandler(std::vector<float>& refData) :
+		data(refData), depth(0), framesKey(false), inFrames(false), frames(0)
+	{}
+
+	virtual void startObject()                  { depth++; framesKey = false; }
+	virtual void endObject()                    { depth--; }
+	virtual void startArray()                   { depth++; inFrames = framesKey && (depth == 2); framesKey = false; }
+	virtual void endArray()                     { depth--; inFrames = false; }
+	virtual void key(const std::string& strKey) { framesKey = (depth == 1) && (strKey == "frames"); }
+	virtual void number(double value)
+	{
+		if (inFrames && (depth == 2))
+		{
+			data.push_back((float) value);
+			frames++;
+		}
+		framesKey = false;
+	}
+	virtual void string(const std::string& strValue) { framesKey = false; }
+	virtual void boolean(bool value)                 { framesKey = false; }
+	virtual void null()                              { framesKey = false; }
+
+public:
+	std::vector<float>& data;
+	int                 depth;
+	bool                framesKey;  // the next value belongs to the "frames" key
+	bool                inFrames;
+	long                frames;     // frames read from this document
+};
 
 
 MoCapPieceMetaConfiguration::MoCapPieceMetaConfiguration() :
 	SystemConfiguration("PieceMeta"),
 	usePieceMeta(false),
 	packageFilter(""),
-	channelFilter("")
+	channelFilter(""),
+	source(PIECEMETA_BASE_URL),
+	cacheDirectory(PIECEMETA_CACHE_DIRECTORY),
+	threadCount(DEFAULT_THREAD_COUNT),
+	outputRate(0)
 {
 	addParameter("-pieceMetaPackage", "<package name>",    "Load a PieceMeta package");
 	addParameter("-channelFilter",    "<channel filter>",  "Filter to select channels with");
+	addParameter("-pieceMetaSource",  "<URL or folder>",   "PieceMeta API URL or local folder with the same structure");
+	addParameter("-pieceMetaCache",   "<folder>",          "Folder for caching PieceMeta stream data (default: " PIECEMETA_CACHE_DIRECTORY ")");
+	addOption(   "-pieceMetaNoCache",                      "Do not cache PieceMeta stream data");
+	addParameter("-pieceMetaThreads", "<count>",           "Maximum number of PieceMeta streams to load in parallel");
+	addParameter("-pieceMetaRate",    "<fps>",             "Rate to resample PieceMeta streams to (default: highest stream rate)");
 }
 
 
@@ -44,6 +98,27 @@ bool MoCapPieceMetaConfiguration::handleParameter(int idx, const std::string& va
 
 		case 1:
 			channelFilter = value;
+			break;
+
+		case 2:
+			source = value;
+			break;
+
+		case 3:
+			cacheDirectory = value;
+			break;
+
+		case 4:
+			cacheDirectory = "";
+			break;
+
+		case 5:
+			threadCount = std::max(1, atoi(value.c_str()));
+			break;
+
+		case 6:
+			outputRate = std::max(0.0f, (float) atof(value.c_str()));
+			break;
 
 		default: 
 			success = false;
@@ -59,7 +134,10 @@ MoCapPieceMeta::MoCapPieceMeta(MoCapPieceMetaConfiguration configuration) :
 	configuration(configuration),
 	initialised(false),
 	isPlaying(true),
-	updateRate(100.0f)
+	updateRate(100.0f),
+	playbackFrameSize(0),
+	playbackFrameCount(0),
+	playbackFrame(0)
 {
 	
 }
@@ -71,6 +149,10 @@ bool MoCapPieceMeta::initialise()
 	{
 		LOG_INFO("Initialising");
 
+		pSource.reset(PieceMetaSource::create(configuration.source));
+		cache = PieceMetaStreamCache(configuration.cacheDirectory);
+		LOG_INFO("Source: " << pSource->getName());
+
 		// query packages
 		std::vector<sPackage> packages = readPackages();
 		int packageCount = packages.size();
@@ -101,7 +183,6 @@ bool MoCapPieceMeta::initialise()
 			LOG_INFO("Found " << numChannelsUnfiltered << " channels, " << numChannels << " filtered:");
 
 			updateRate = 0;
-			int totalStreams = 0;
 			for (int cIdx = 0; cIdx < numChannels; cIdx++)
 			{
 				sChannel& channel = activePackage.channels[cIdx];
@@ -109,16 +190,15 @@ bool MoCapPieceMeta::initialise()
 
 				// gather stream stats
 				int   numStreams = channel.streams.size();
-				int   maxFrameCount = 0;
+				long  maxFrameCount = 0;
 				float maxFPS = 0;
-				totalStreams += numStreams;
 				std::vector<std::string> groups;
 				std::vector<std::string> names;
 				for (int sIdx = 0; sIdx < numStreams; sIdx++)
 				{
 					sStream& stream = channel.streams[sIdx];
-					maxFrameCount = max(stream.frameCount, maxFrameCount);
-					maxFPS        = max(stream.fps, maxFPS);
+					maxFrameCount = std::max(stream.frameCount, maxFrameCount);
+					maxFPS        = std::max(stream.fps, maxFPS);
 
 					// if not existing, add stream group to list of groups
 					if (!stream.group.empty() && std::find(groups.begin(), groups.end(), stream.group) == groups.end())
@@ -150,26 +230,16 @@ bool MoCapPieceMeta::initialise()
 				LOG_INFO_END();
 
 				// determine maximum FPS
-				updateRate = max(updateRate, maxFPS);
+				updateRate = std::max(updateRate, maxFPS);
 			}
 
 			// read frames
-			LOG_INFO("Loading Stream Data:");
-			int streamCount = 0;
-			for (int cIdx = 0; cIdx < numChannels; cIdx++)
-			{
-				LOG_INFO_START("- Channel " << (cIdx + 1) << "   0% ");
-				sChannel& channel = activePackage.channels[cIdx];
-				int numStreams = channel.streams.size();
-				for (int sIdx = 0; sIdx < numStreams; sIdx++)
-				{
-					streamCount++;
-					LOG_INFO_MID("\b\b\b\b\b" << std::setw(3) << std::right << (streamCount * 100 / totalStreams) << "% ");
-					sStream& stream = channel.streams[sIdx];
-					readStreamData(stream);
-				}
-				LOG_INFO_END();
-			}
+			loadStreamData();
+
+			// align all streams at one rate for playback
+			if (configuration.outputRate > 0) updateRate = configuration.outputRate;
+			if (updateRate <= 0)              updateRate = 100.0f;
+			buildPlaybackBuffer(updateRate);
 
 			initialised = true;
 		}
@@ -204,6 +274,14 @@ void MoCapPieceMeta::setRunning(bool running)
 
 bool MoCapPieceMeta::update()
 {
+	if (initialised && (playbackFrameCount > 0))
+	{
+		if (isPlaying)
+		{
+			playbackFrame = (playbackFrame + 1) % playbackFrameCount;
+		}
+		signalNewFrame();
+	}
 	return true;
 }
 
@@ -213,8 +291,40 @@ bool MoCapPieceMeta::getSceneDescription(MoCapData& refData)
 	bool success = false;
 	if (initialised)
 	{
-		success = true;
 		LOG_INFO("Requesting scene description")
+
+		// one marker set with all markers > one copy per frame
+		size_t markerCount = playbackMarkerNames.size();
+		sMarkerSetDescription* pMarkerDesc = new sMarkerSetDescription();
+		sMarkerSetData&        msData      = refData.frame.MocapData[0];
+		strncpy_s(pMarkerDesc->szName, activePackage.title.c_str(), sizeof(pMarkerDesc->szName));
+		strncpy_s(msData.szName,       pMarkerDesc->szName,         sizeof(msData.szName));
+		pMarkerDesc->nMarkers      = (int) markerCount;
+		pMarkerDesc->szMarkerNames = new char*[markerCount];
+		msData.nMarkers            = (int) markerCount;
+		msData.Markers             = new MarkerData[markerCount];
+		for (size_t mIdx = 0; mIdx < markerCount; mIdx++)
+		{
+			size_t length = playbackMarkerNames[mIdx].length() + 1;
+			pMarkerDesc->szMarkerNames[mIdx] = new char[length];
+			memcpy(pMarkerDesc->szMarkerNames[mIdx], playbackMarkerNames[mIdx].c_str(), length);
+		}
+		refData.description.arrDataDescriptions[0].type = Descriptor_MarkerSet;
+		refData.description.arrDataDescriptions[0].Data.MarkerSetDescription = pMarkerDesc;
+		refData.description.nDataDescriptions = 1;
+
+		refData.frame.nMarkerSets     = 1;
+		refData.frame.nOtherMarkers   = 0;
+		refData.frame.OtherMarkers    = NULL;
+		refData.frame.nRigidBodies    = 0;
+		refData.frame.nSkeletons      = 0;
+		refData.frame.nLabeledMarkers = 0;
+		refData.frame.nForcePlates    = 0;
+		refData.frame.fLatency        = 0;
+		refData.frame.Timecode        = 0;
+		refData.frame.TimecodeSubframe = 0;
+
+		success = getFrameData(refData);
 	}
 
 	return success;
@@ -227,6 +337,16 @@ bool MoCapPieceMeta::getFrameData(MoCapData& refData)
 
 	if (initialised)
 	{
+		// update() runs on the timer thread without mtxMoCap > read the frame index once
+		size_t          frame  = playbackFrame;
+		sMarkerSetData& msData = refData.frame.MocapData[0];
+		if ((refData.frame.nMarkerSets > 0) && (msData.nMarkers * 3 == (int) playbackFrameSize) && (playbackFrameCount > 0))
+		{
+			// the buffer rows have exactly the layout of the marker array
+			memcpy(msData.Markers, &playbackBuffer[frame * playbackFrameSize], playbackFrameSize * sizeof(float));
+		}
+		refData.frame.iFrame     = (int) frame;
+		refData.frame.fTimestamp = frame / updateRate;
 		success = true;
 	}
 
@@ -260,54 +380,11 @@ MoCapPieceMeta::~MoCapPieceMeta()
 }
 
 
-bool MoCapPieceMeta::readURL(const std::string& url, std::string &content)
-{
-	bool success = false;
-	
-	// prepare request:
-
-	HINTERNET hInt = InternetOpen(
-		TEXT("Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:54.0) Gecko/20100101 Firefox/54.0"), 
-		INTERNET_OPEN_TYPE_PRECONFIG, 
-		NULL, NULL, 0);
-	DWORD dwRequestFlags = INTERNET_FLAG_NO_UI   // no UI please
-		| INTERNET_FLAG_NO_AUTH           // don't authenticate
-		| INTERNET_FLAG_PRAGMA_NOCACHE    // do not try the cache or proxy
-		| INTERNET_FLAG_NO_CACHE_WRITE;   // don't add this to the IE cache
-
-	// convert URL into WChar
-	std::wstring wURL;
-	wURL.assign(url.begin(), url.end());
-
-	// open URL
-	HINTERNET hUrl = InternetOpenUrl(hInt, wURL.c_str(), NULL, 0, dwRequestFlags, NULL);
-	if (hUrl)
-	{
-		// success: read content
-		DWORD dwBytesRead = 0;
-		content.clear();
-		while (InternetReadFile(hUrl, readBuffer, sizeof(readBuffer) - 1, &dwBytesRead) && (dwBytesRead > 0))
-		{
-			readBuffer[dwBytesRead] = '\0';
-			content += readBuffer;
-		}
-		InternetCloseHandle(hUrl);
-		success = true;
-	}
-	else
-	{
-		LOG_ERROR("Could not open " << url);
-	}
-	InternetCloseHandle(hInt);
-	return success;
-}
-
-
 std::vector<MoCapPieceMeta::sPackage> MoCapPieceMeta::readPackages()
 {
 	std::vector<sPackage> packages;
 	std::string response;
-	if (readURL(PIECEMETA_BASE_URL "packages.json", response))
+	if (pSource->read("packages.json", response))
 	{
 		std::string errorMsg;
 		json11::Json json = json11::Json::parse(response, errorMsg);
@@ -335,9 +412,9 @@ bool MoCapPieceMeta::readChannels(sPackage& package)
 	bool success = false;
 	package.channels.clear();
 
-	std::string request = PIECEMETA_BASE_URL "/packages/" + package.uuid + "/channels.json";
+	std::string request = "packages/" + package.uuid + "/channels.json";
 	std::string response;
-	if (MoCapPieceMeta::readURL(request, response))
+	if (pSource->read(request, response))
 	{
 		std::string errorMsg;
 		json11::Json json = json11::Json::parse(response, errorMsg);
@@ -360,47 +437,215 @@ bool MoCapPieceMeta::readChannels(sPackage& package)
 }
 
 
-bool MoCapPieceMeta::readStreamData(sStream& stream)
+bool MoCapPieceMeta::loadStreamData()
 {
-	const char rotSymbol[]  = { '|', '/', '-', '\\'};
-	int        rotSymbolIdx = 0;
+	// collect all streams so the workers can pick them one by one
+	std::vector<sStream*> streams;
+	for (auto c = activePackage.channels.begin(); c != activePackage.channels.end(); c++)
+	{
+		for (auto s = (*c).streams.begin(); s != (*c).streams.end(); s++)
+		{
+			streams.push_back(&(*s));
+		}
+	}
+	if (streams.empty()) return true;
+
+	std::atomic<size_t> nextStream(0);
+	std::atomic<size_t> streamsLoaded(0);
+	std::atomic<size_t> streamsFailed(0);
+	std::atomic<size_t> streamsCached(0);
+
+	// the threads are bounded, so a large package does not open hundreds of connections at once
+	size_t threadCount = std::min((size_t) configuration.threadCount, streams.size());
+	std::vector<std::thread> workers;
+	for (size_t tIdx = 0; tIdx < threadCount; tIdx++)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			size_t idx;
+			while ((idx = nextStream++) < streams.size())
+			{
+				sStream& stream = *streams[idx];
+				if (cache.load(stream.uuid, stream.frameCount, stream.data))
+				{
+					streamsCached++;
+				}
+				else if (readStreamData(stream))
+				{
+					cache.store(stream.uuid, stream.frameCount, stream.data);
+				}
+				else
+				{
+					streamsFailed++;
+				}
+				streamsLoaded++;
+			}
+		}));
+	}
+
+	LOG_INFO_START("Loading stream data with " << threadCount << " threads:   0% ");
+	while (streamsLoaded < streams.size())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(PROGRESS_INTERVAL_MS));
+		LOG_INFO_MID("\b\b\b\b\b" << std::setw(3) << std::right << (streamsLoaded * 100 / streams.size()) << "% ");
+	}
+	LOG_INFO_MID("\b\b\b\b\b100% ");
+	LOG_INFO_END();
+
+	for (auto i = workers.begin(); i != workers.end(); i++)
+	{
+		(*i).join();
+	}
+
+	LOG_INFO("Loaded " << streams.size() << " streams (" << streamsCached << " from cache, " << streamsFailed << " failed)");
+	return streamsFailed == 0;
+}
 
+
+bool MoCapPieceMeta::readStreamData(sStream& stream)
+{
 	bool success = true;
 	stream.data.clear();
+	stream.data.reserve(stream.frameCount);
+
+	// the numbers are parsed into the stream data while the response arrives
+	StreamDataHandler handler(stream.data);
+	JsonStreamParser  parser(handler);
 
-	int idxFrom  = 0;
 	int stepsize = 6000;
-	while ((idxFrom < stream.frameCount) && success)
+	while (((long) stream.data.size() < stream.frameCount) && success)
 	{
-		LOG_INFO_MID(rotSymbol[rotSymbolIdx] << "\b");
-		rotSymbolIdx = (rotSymbolIdx + 1) % sizeof(rotSymbol);
-
-		int idxTo = min(idxFrom + stepsize, stream.frameCount);
+		int idxFrom = (int) stream.data.size();
+		int idxTo   = (int) std::min((long) (idxFrom + stepsize), stream.frameCount);
 		std::stringstream request;
-		request << PIECEMETA_BASE_URL "/streams/" << stream.uuid << ".json"
+		request << "streams/" << stream.uuid << ".json"
 		        << "?from=" << idxFrom << "&to=" << idxTo;
-		std::string response;
-		if (MoCapPieceMeta::readURL(request.str(), response))
+
+		long requested = idxTo - idxFrom;
+
+		parser.reset();
+		handler.frames = 0;
+		success = pSource->read(request.str(), [&parser](const char* pData, size_t length)
+		{
+			return parser.parse(pData, length);
+		});
+		success = success && parser.finish();
+
+		if (!success)
 		{
-			std::string errorMsg;
-			json11::Json json = json11::Json::parse(response, errorMsg);
-			if (errorMsg.empty() && json.is_object())
+			LOG_ERROR("Could not read stream data (" << parser.getError() << ")");
+		}
+		else if (handler.frames != requested)
+		{
+			// the stream ends early, or the source ignores the range (e.g., a folder delivers the whole file)
+			// > requesting the next range would deliver the same frames again
+			break;
+		}
+	}
+
+	if (success && ((long) stream.data.size() < stream.frameCount))
+	{
+		// source delivered less data than announced
+		LOG_WARNING("Stream " << stream.uuid << " ends after " << stream.data.size() << " of " << stream.frameCount << " frames");
+	}
+	return success;
+}
+
+
+void MoCapPieceMeta::buildPlaybackBuffer(float outputRate)
+{
+	// assign up to three streams of a group to one marker, e.g., "position" x/y/z
+	std::vector<const sStream*> columns; // NULL: unused component
+	playbackMarkerNames.clear();
+	float duration = 0;
+	for (auto c = activePackage.channels.cbegin(); c != activePackage.channels.cend(); c++)
+	{
+		std::vector<std::string> groups;
+		for (auto s = (*c).streams.cbegin(); s != (*c).streams.cend(); s++)
+		{
+			std::string group = (*s).group.empty() ? (*s).title : (*s).group;
+			if (std::find(groups.begin(), groups.end(), group) == groups.end())
 			{
-				const std::vector<json11::Json>& channelJson = json["frames"].array_items();
-				for (std::vector<json11::Json>::const_iterator i = channelJson.cbegin(); i != channelJson.cend(); ++i)
-				{
-					stream.data.push_back((float) (*i).number_value());
-				}
-				idxFrom = idxTo;
+				groups.push_back(group);
 			}
-			else
+			if ((*s).fps > 0)
 			{
-				LOG_ERROR("Could not read stream data (" << errorMsg << ")");
-				success = false;
+				duration = std::max(duration, (*s).data.size() / (*s).fps);
+			}
+		}
+
+		for (auto g = groups.cbegin(); g != groups.cend(); g++)
+		{
+			std::vector<const sStream*> groupStreams;
+			for (auto s = (*c).streams.cbegin(); s != (*c).streams.cend(); s++)
+			{
+				if (((*s).group.empty() ? (*s).title : (*s).group) == *g) groupStreams.push_back(&(*s));
+			}
+
+			for (size_t sIdx = 0; sIdx < groupStreams.size(); sIdx += 3)
+			{
+				std::stringstream name;
+				name << (*c).title << "/" << *g;
+				if (sIdx > 0) name << "_" << (sIdx / 3 + 1);
+				playbackMarkerNames.push_back(name.str());
+
+				for (size_t cIdx = sIdx; cIdx < sIdx + 3; cIdx++)
+				{
+					columns.push_back((cIdx < groupStreams.size()) ? groupStreams[cIdx] : NULL);
+				}
 			}
 		}
 	}
-	return success;
+
+	playbackFrameSize  = columns.size();
+	playbackFrameCount = (size_t) ceil(duration * outputRate);
+	playbackFrame      = 0;
+	playbackBuffer.assign(playbackFrameSize * playbackFrameCount, 0.0f);
+
+	for (size_t cIdx = 0; cIdx < playbackFrameSize; cIdx++)
+	{
+		if (columns[cIdx] != NULL)
+		{
+			resampleStream(*columns[cIdx], outputRate, &playbackBuffer[cIdx], playbackFrameSize, playbackFrameCount);
+		}
+	}
+
+	// the original stream data is not needed for playback any more
+	for (auto c = activePackage.channels.begin(); c != activePackage.channels.end(); c++)
+	{
+		for (auto s = (*c).streams.begin(); s != (*c).streams.end(); s++)
+		{
+			std::vector<float>().swap((*s).data);
+		}
+	}
+
+	LOG_INFO("Playback buffer: " << playbackMarkerNames.size() << " markers, " <<
+		playbackFrameCount << " frames at " << outputRate << " FPS");
+}
+
+
+void MoCapPieceMeta::resampleStream(const sStream& stream, float outputRate, float* pDest, size_t stride, size_t frameCount)
+{
+	const std::vector<float>& data = stream.data;
+	if (data.empty() || (stream.fps <= 0)) return;
+
+	double step = stream.fps / outputRate; // source frames per output frame
+	size_t last = data.size() - 1;
+	for (size_t fIdx = 0; fIdx < frameCount; fIdx++, pDest += stride)
+	{
+		double pos  = fIdx * step;
+		size_t idx0 = (size_t) pos;
+		if (idx0 >= last)
+		{
+			// shorter streams hold their last value
+			*pDest = data[last];
+		}
+		else
+		{
+			float frac = (float) (pos - idx0);
+			*pDest = data[idx0] + (data[idx0 + 1] - data[idx0]) * frac;
+		}
+	}
 }
 
 
@@ -409,9 +654,9 @@ bool MoCapPieceMeta::readStreams(sChannel& channel)
 	bool success = false;
 	channel.streams.clear();
 
-	std::string request = PIECEMETA_BASE_URL "/channels/" + channel.uuid + "/streams.json";
+	std::string request = "channels/" + channel.uuid + "/streams.json";
 	std::string response;
-	if (MoCapPieceMeta::readURL(request, response))
+	if (pSource->read(request, response))
 	{
 		std::string errorMsg;
 		json11::Json json = json11::Json::parse(response, errorMsg);
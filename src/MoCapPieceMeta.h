@@ -10,11 +10,15 @@
 
 #include "MoCapSystem.h"
 #include "SystemConfiguration.h"
+#include "PieceMetaSource.h"
 
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "json11.hpp"
+#include "JsonStreamParser.h"
 
 
 class MoCapPieceMetaConfiguration : public SystemConfiguration
@@ -29,6 +33,10 @@ public:
 	bool        usePieceMeta;
 	std::string packageFilter;
 	std::string channelFilter;
+	std::string source;         // base URL of the API or local directory with the same structure
+	std::string cacheDirectory; // folder for caching stream data (empty: no caching)
+	int         threadCount;    // maximum number of streams to load in parallel
+	float       outputRate;     // rate the streams are resampled to (0: highest stream rate)
 };
 
 
@@ -105,25 +113,40 @@ private:
 	};
 
 
-	/**
-	* Reads a URL into a string.
-	*
-	* @param url     the URL to read
-	* @param content the string to read the URL into
-	*
-	* @return <code>true</code> when read was successful, <code>false</code> if not.
-	*/
-	bool readURL(const std::string& url, std::string& content);
-
-
 	std::vector<sPackage> readPackages();
 
 	bool readChannels(sPackage& package);
 
 	bool readStreams(sChannel& channel);
 
+	/**
+	 * Loads the data of all streams of the active package on a pool of worker threads.
+	 *
+	 * @return <code>true</code> when all streams were loaded, <code>false</code> if not.
+	 */
+	bool loadStreamData();
+
 	bool readStreamData(sStream& stream);
 
+	/**
+	 * Resamples all streams of the active package to the output rate and
+	 * interleaves them into one frame buffer with three values per marker.
+	 *
+	 * @param outputRate  the rate of the frames in the buffer
+	 */
+	void buildPlaybackBuffer(float outputRate);
+
+	/**
+	 * Resamples a stream by linear interpolation into every <code>stride</code>th value of a buffer.
+	 *
+	 * @param stream      the stream to resample
+	 * @param outputRate  the rate to resample the stream to
+	 * @param pDest       the first value to write
+	 * @param stride      the distance between two values to write
+	 * @param frameCount  the amount of values to write
+	 */
+	static void resampleStream(const sStream& stream, float outputRate, float* pDest, size_t stride, size_t frameCount);
+
 
 private:
 
@@ -135,7 +158,15 @@ private:
 
 	sPackage activePackage;
 
-	char readBuffer[65536];
+	std::unique_ptr<PieceMetaSource> pSource;
+	PieceMetaStreamCache             cache;
+
+	// all streams as one marker set with one row of interleaved marker positions per frame
+	std::vector<std::string> playbackMarkerNames;
+	std::vector<float>       playbackBuffer;
+	size_t                   playbackFrameSize;  // values per frame
+	size_t                   playbackFrameCount;
+	std::atomic<size_t>      playbackFrame;      // index of the current frame, advanced by update() on the timer thread
 };
 
 #endif // #ifdef USE_PIECEMETA
\ No newline at end of file
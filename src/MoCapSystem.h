@@ -5,12 +5,16 @@
 #pragma once
 
 #include "MoCapData.h"
+#include "FramePacketWriter.h"
 #include <string>
 
 
 // this function can be used by the class to stream frames
 extern void signalNewFrame();
 
+// this function needs to be called by the class when the scene description has changed
+extern void signalSceneChange();
+
 /**
  * Pure virtual base class for the minimum MoCap system methods.
  */
@@ -62,6 +66,14 @@ public:
 	*/
 	virtual bool update() = 0;
 
+	/**
+	 * Checks if the MoCap system delivers frames on its own by calling signalNewFrame().
+	 * Event driven systems are not polled through update().
+	 *
+	 * @return <code>true</code> if the system is event driven
+	 */
+	virtual bool isEventDriven() { return false; }
+
 	/**
 	 * Gets a scene description for the NatNet data structure.
 	 *
@@ -80,6 +92,27 @@ public:
 	 */
 	virtual bool getFrameData(MoCapData& refData) = 0;
 
+	/**
+	 * Checks if the last call of getFrameData() skipped the frame on purpose,
+	 * e.g., while the scene is being updated, instead of failing.
+	 *
+	 * @return <code>true</code> if the frame was skipped
+	 */
+	virtual bool isFrameSkipped() { return false; }
+
+	/**
+	 * Writes the data for a single frame directly into a NatNet packet,
+	 * bypassing the frame data structure.
+	 * This is an optional optimisation, systems that don't support it keep the default implementation.
+	 *
+	 * @param refData    the data structure with the scene layout (names, IDs, counts)
+	 * @param refWriter  the writer for the packet
+	 *
+	 * @return <code>true</code> when the frame was written completely,
+	 *         <code>false</code> when the frame needs to be retrieved through getFrameData()
+	 */
+	virtual bool writeFrameData(const MoCapData& refData, FramePacketWriter& refWriter) { return false; }
+
 	/**
 	 * Processes a custom string command.
 	 *
@@ -89,6 +122,13 @@ public:
 	 */
 	virtual bool processCommand(const std::string& strCommand) = 0;
 
+	/**
+	 * Stops the threads of the MoCap system that deliver frames by calling signalNewFrame().
+	 * This is called before deinitialise() without the MoCap data being locked,
+	 * because those threads might be waiting for that lock.
+	 */
+	virtual void stop() { }
+
 	/**
 	 * Deinitialises the MoCap system.
 	 *
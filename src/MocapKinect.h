@@ -3,22 +3,26 @@
 
 #ifdef USE_KINECT
 
-#pragma comment(lib, "Kinect10.lib")
-
-#include <Windows.h>
 #include "MoCapSystem.h"
-#include "NuiApi.h"
-
-#include "VectorMath.h"
+#include "KinectSkeleton.h"
+#include "KinectRecording.h"
 
-#include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 class MoCapKinect : public MoCapSystem
 {
 public:
-		MoCapKinect();
+		/**
+		 * Creates a Kinect MoCap system.
+		 *
+		 * @param strRecording  name of a recording to replay instead of using the sensor (empty: use the sensor)
+		 */
+		MoCapKinect(const std::string& strRecording = "");
 		virtual ~MoCapKinect();
-	
+
 public:
 		virtual bool  initialise();
 		virtual bool  isActive();
@@ -26,33 +30,33 @@ public:
 		virtual bool  isRunning();
 		virtual void  setRunning(bool running);
 		virtual bool  update();
+		virtual bool  isEventDriven();
 		virtual bool  getSceneDescription(MoCapData& refData);
 		virtual bool  getFrameData(MoCapData& refData);
 		virtual bool  processCommand(const std::string& strCommand);
+		virtual void  stop();
 		virtual bool  deinitialise();
 
 private:
-		HRESULT findKinectSensor();
-		bool initialiseKinect();
-		void SkeletonFrameReady(NUI_SKELETON_FRAME *pSkeletonframe, sMarkerSetData* msData);
-		void GetSkeleton(const NUI_SKELETON_DATA &skeleton, sMarkerSetData* msData);
+		void captureThread();
 
 private:
 		bool         initialised;
 		bool         isPlaying;
-		std::string  strKinectAddress;
-		std::string  strLocalAddress;
-		INuiSensor *pNuiSensor;
-		HANDLE kinectHandel;
+		std::string  strRecording;
 
-		int                     iFrame;
-		float                   fTime;
-		std::vector<Vector3D>   arrPos;
-		std::vector<Quaternion> arrRot;
+		std::unique_ptr<KinectSensor> pSensor;
 
-		bool                    trackingUnreliable;
-		std::vector<int>        arrTrackingLostCounter;
+		// capture thread and the mapping it publishes the latest users into
+		std::thread             captureLoop;
+		std::atomic<bool>       captureRunning;
+		std::mutex              mtxSkeletons;
+		KinectSkeletonMapper    skeletonMapper;
+		uint64_t                framesCaptured;
+		uint64_t                framesEmpty;     // frames without a tracked user
 
+		std::mutex              mtxRecorder;
+		KinectFrameRecorder     recorder;
 };
 
 #endif
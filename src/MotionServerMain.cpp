@@ -31,11 +31,14 @@ const int arrServerVersion[4] = { 1, 9, 0, 0 };
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 #include <mutex>
 
 #include <tchar.h>
@@ -45,11 +48,18 @@ const int arrServerVersion[4] = { 1, 9, 0, 0 };
 #include "NatNetTypes.h"
 #include "NatNetServer.h"
 #include "MoCapData.h"
+#include "FrameSender.h"
+#include "FrameFragmentation.h"
+#include "FramePacketWriter.h"
+#include "TraceRecorder.h"
 
 #include "Logging.h"
 #undef   LOG_CLASS
 #define  LOG_CLASS "MotionServer" 
 
+#define LOG_FILE_MAX_SIZE  (10 * 1024 * 1024) // size at which the log file is rotated
+#define LOG_FILE_COUNT     5                  // amount of old log files to keep
+
 #ifdef USE_CORTEX
 #include "MoCapCortex.h"
 #endif
@@ -76,6 +86,8 @@ struct sConfiguration
 	std::string strNatNetServerMulticastAddress;
 	int         iNatNetCommandPort;
 	int         iNatNetDataPort;
+	int         iSendPacingInterval;
+	int         iMaxPacketSize;
 
 	bool        writeData;
 	std::string dataFilename;
@@ -85,8 +97,13 @@ struct sConfiguration
 	std::string strLocalCortexAddress;
 
 	int         iInteractionControllerPort;
+	std::string strInteractionControllerDevice;
+	int         iInteractionControllerTimeout;
+	int         iInteractionDiscoveryInterval;
+	std::string strInteractionProfileFolder;
 
 	bool        useKinect;
+	std::string strKinectRecording;
 
 	sConfiguration()
 	{
@@ -104,7 +121,14 @@ struct sConfiguration
 		iNatNetCommandPort = 1508;
 		iNatNetDataPort    = 1509;
 
-		iInteractionControllerPort = 0;
+		iSendPacingInterval = 0;
+		iMaxPacketSize      = DEFAULT_MAX_FRAME_PACKET_SIZE;
+
+		iInteractionControllerPort     = 0;
+		strInteractionControllerDevice = "";
+		iInteractionControllerTimeout  = 2000;
+		iInteractionDiscoveryInterval  = 10000;
+		strInteractionProfileFolder    = "Hardware";
 
 		writeData    = false;
 		dataFilename = "";
@@ -113,7 +137,8 @@ struct sConfiguration
 		strRemoteCortexAddress = "127.0.0.1";
 		strLocalCortexAddress  = strRemoteCortexAddress;
 
-		useKinect = false;
+		useKinect          = false;
+		strKinectRecording = "";
 	}
 
 } config;
@@ -125,7 +150,9 @@ struct sConfiguration
 
 // Server variables
 NatNetServer* pServer          = NULL;
-std::mutex    mtxServer;
+FrameSender*  pFrameSender     = NULL;
+std::mutex    mtxServer;        // protects the server pointers and packetising (sending is done without it)
+std::string   strDataDestination; // where the server sends the frames to (for the statistics)
 bool          serverStarting   = true;
 bool          serverRunning    = false;
 bool          serverRestarting = false;
@@ -135,12 +162,25 @@ uint8_t       arrServerNatNetVersion[4]; // filled in later
 MoCapSystem*  pMoCapSystem;
 std::mutex    mtxMoCap;
 MoCapData*    pMocapData;
-sPacket       packetOut;
+bool          frameDataStale = false; // frame was written directly into a packet, pMocapData->frame is outdated
+
+// Frame packet variables
+
+FrameFragmenter                        frameFragmenter;     // splits large frames into several packets
+std::vector<std::shared_ptr<sPacket>>  arrFramePackets;     // pool of packets for serialising frames
+std::shared_ptr<const FramePacketList> pLatestFramePackets; // last streamed frame (only use std::atomic_load/store)
 
 MoCapFileWriter* pMoCapFileWriter;
 
+// Scene description variables
+std::mutex       mtxDescription;
+sPacket          packetDescription;                // cached serialised scene description
+int              packetDescriptionVersion = -1;    // scene version the cached packet was built from
+std::atomic<int> descriptionVersion(0);            // incremented with every scene change
+
 // Interaction system variables
 InteractionSystem* pInteractionSystem;
+std::string        strLastInteractionPort; // where the controller was found last time, tried first when scanning
 
 // Miscellaneous
 // 
@@ -158,6 +198,12 @@ void parseCommandLine(int nArguments, _TCHAR* arrArguments[]);
 bool createServer();
 bool isServerRunning();
 void signalNewFrame();
+void signalSceneChange();
+bool writeFramePacketDirectly();
+std::shared_ptr<sPacket> acquireFramePacket();
+void publishFramePackets(const std::shared_ptr<const FramePacketList>& pPackets);
+bool copyPolledFramePacket(int frameNumber, int packetIdx, sPacket& refDestination);
+void copyPacket(const sPacket& refSource, sPacket& refDestination);
 bool destroyServer();
 
 
@@ -181,16 +227,26 @@ void printUsage()
 		<< "-serverName <name>                    Name of MoCap Server (default: 'MotionServer')" << std::endl
 		<< "-serverAddr <address>                 IP Address of MotionServer (default: 127.0.0.1)" << std::endl
 		<< "-multicastAddr <address>              IP Address of multicast MotionServer (default: Unicast)" << std::endl
+		<< "-sendPacing <microseconds>            Minimum time between two sent frames (default: 0=disabled)" << std::endl
+		<< "-maxPacketSize <bytes>                Maximum frame packet size before splitting (default: " << DEFAULT_MAX_FRAME_PACKET_SIZE << ")" << std::endl
 #ifdef USE_KINECT
 		<< "-kinect                               Kinect sensor detection" << std::endl
+		<< "-kinectFile <filename>                Replay a Kinect joint recording instead of using the sensor" << std::endl
 #endif
 #ifdef USE_CORTEX
 		<< "-cortexRemoteAddr <address>           IP Address of remote interface to connect to Cortex" << std::endl
 		<< "-cortexLocalAddr <address>            IP Address of local interface to connect to Cortex" << std::endl
 #endif
 		<< "-interactionControllerPort <number>   COM port of XBee interaction controller (-1: scan)" << std::endl
+		<< "-interactionControllerDevice <name>   Serial device of XBee interaction controller (e.g., /dev/pts/4)" << std::endl
+		<< "-interactionControllerTimeout <ms>    Time to wait for the XBee interaction controller to answer" << std::endl
+		<< "-interactionProfiles <folder>         Folder with the XML interaction device profiles" << std::endl
+		<< "-interactionDiscoveryInterval <ms>    Time between discoveries of XBee interaction devices (0: only once)" << std::endl
+		<< "-logLevel <level>                     Minimum level of log messages: info, warning, error, off (default: info)" << std::endl
+		<< "-logFile <filename>                   Write log messages into a rotating file as well" << std::endl
 		<< "-readFile <filename>                  Read and loop MoCap Data from a file" << std::endl
 		<< "-writeFile                            Write MoCap Data into timestamped files" << std::endl
+		<< "-trace                                Record thread activity from the start (see command 't')" << std::endl
 		;
 }
 
@@ -230,6 +286,11 @@ void parseCommandLine(int nArguments, _TCHAR* arrArguments[])
 			{
 				config.writeData = true;
 			}
+			else if (strArg == "-trace")
+			{
+				// record thread activity right from the start
+				TraceRecorder::setEnabled(true);
+			}
 		}
 		// check arguments with one additional parameter
 		if (argIdx + 1 < nArguments)
@@ -253,12 +314,73 @@ void parseCommandLine(int nArguments, _TCHAR* arrArguments[])
 				// COM port number for XBee interaction controller
 				config.iInteractionControllerPort = atoi(strParam1.c_str());
 			}
+			else if (strArg == "-interactioncontrollerdevice")
+			{
+				// serial device name for XBee interaction controller, e.g., an emulator
+				config.strInteractionControllerDevice = strParam1;
+			}
+			else if (strArg == "-interactioncontrollertimeout")
+			{
+				// maximum time to wait for the XBee interaction controller to answer
+				config.iInteractionControllerTimeout = atoi(strParam1.c_str());
+			}
+			else if (strArg == "-interactiondiscoveryinterval")
+			{
+				// time between discoveries of XBee interaction devices
+				config.iInteractionDiscoveryInterval = atoi(strParam1.c_str());
+			}
+			else if (strArg == "-interactionprofiles")
+			{
+				// folder with the interaction device profiles
+				config.strInteractionProfileFolder = strParam1;
+			}
+			else if (strArg == "-sendpacing")
+			{
+				// minimum time between two frame packets
+				config.iSendPacingInterval = atoi(strParam1.c_str());
+			}
+			else if (strArg == "-maxpacketsize")
+			{
+				// maximum size of a frame packet before it is split into fragments
+				int maxPacketSize = atoi(strParam1.c_str());
+				if (maxPacketSize > 0)
+				{
+					config.iMaxPacketSize = maxPacketSize;
+				}
+				else
+				{
+					LOG_ERROR("Invalid maximum packet size '" << strParam1 << "'");
+				}
+			}
 			else if (strArg == "-multicastaddr")
 			{
 				// Server multicast address
 				config.strNatNetServerMulticastAddress = strParam1;
 				config.useMulticast = true;
 			}
+			else if (strArg == "-loglevel")
+			{
+				// minimum level of log messages
+				std::string   strLevel;
+				Logger::Level level;
+				std::transform(strParam1.begin(), strParam1.end(), std::back_inserter(strLevel), ::tolower);
+				if (Logger::parseLevel(strLevel, level))
+				{
+					Logger::setLevel(level);
+				}
+				else
+				{
+					LOG_ERROR("Invalid log level '" << strParam1 << "'");
+				}
+			}
+			else if (strArg == "-logfile")
+			{
+				// log file in addition to the console
+				if (!Logger::openFile(strParam1, LOG_FILE_MAX_SIZE, LOG_FILE_COUNT))
+				{
+					LOG_ERROR("Could not open log file '" << strParam1 << "'");
+				}
+			}
 			else if (strArg == "-readfile")
 			{
 				// file to read
@@ -284,6 +406,12 @@ void parseCommandLine(int nArguments, _TCHAR* arrArguments[])
 				config.useKinect = true;
 				config.strNatNetServerAddress = strParam1;
 			}
+			else if (strArg == "-kinectfile")
+			{
+				// Kinect recording instead of sensor
+				config.useKinect = true;
+				config.strKinectRecording = strParam1;
+			}
 #endif
 		}
 
@@ -345,7 +473,7 @@ MoCapSystem* detectMoCapSystem()
 		// query Kinect sensors
 		LOG_INFO("Querying Kinect sensors");
 
-		MoCapKinect* pKinect = new MoCapKinect();
+		MoCapKinect* pKinect = new MoCapKinect(config.strKinectRecording);
 		if (pKinect->initialise())
 		{
 			LOG_INFO("Kinect sensor found");
@@ -388,50 +516,65 @@ MoCapSystem* detectMoCapSystem()
 InteractionSystem* detectInteractionSystem()
 {
 	InteractionSystem* pSystem = NULL;
-	
-	if (config.iInteractionControllerPort > 255)
+	int                timeout = config.iInteractionControllerTimeout;
+
+	if (!config.strInteractionControllerDevice.empty())
 	{
-		// invalid > don't use
-		config.iInteractionControllerPort = 0;
+		// specific device given
+		LOG_INFO("Searching Interaction System on " << config.strInteractionControllerDevice);
+		pSystem = InteractionSystem::findController(
+			std::vector<std::string>(1, config.strInteractionControllerDevice), timeout);
 	}
-
-	int scanFrom = config.iInteractionControllerPort;
-	int scanTo   = config.iInteractionControllerPort + 1;
-	if (config.iInteractionControllerPort < 0)
+	else if ((config.iInteractionControllerPort > 0) && (config.iInteractionControllerPort <= 255))
+	{
+		// specific port given
+		std::string strPort = SerialPort(config.iInteractionControllerPort).getName();
+		LOG_INFO("Searching Interaction System on " << strPort);
+		pSystem = InteractionSystem::findController(std::vector<std::string>(1, strPort), timeout);
+	}
+	else if (config.iInteractionControllerPort < 0)
 	{
-		scanFrom = 1;
-		scanTo = 256;
-		LOG_INFO("Scanning for Interaction System...");
+		// try the last known port first...
+		if (!strLastInteractionPort.empty())
+		{
+			LOG_INFO("Searching Interaction System on " << strLastInteractionPort);
+			pSystem = InteractionSystem::findController(std::vector<std::string>(1, strLastInteractionPort), timeout);
+		}
+		// ...then all other ports at the same time
+		if (pSystem == NULL)
+		{
+			std::vector<std::string> arrPorts = SerialPort::listPorts();
+			arrPorts.erase(std::remove(arrPorts.begin(), arrPorts.end(), strLastInteractionPort), arrPorts.end());
+			LOG_INFO("Scanning for Interaction System on " << arrPorts.size() << " ports...");
+			pSystem = InteractionSystem::findController(arrPorts, timeout);
+		}
 	}
-	else if (config.iInteractionControllerPort > 0)
+	else
 	{
-		LOG_INFO("Searching Interaction System on COM" << config.iInteractionControllerPort);
+		// disabled
+		return NULL;
 	}
 
-	// scan ports 
-	for (int iPort = scanFrom; iPort < scanTo; iPort++)
+	// controller found > prepare recognising its devices
+	if (pSystem != NULL)
 	{
-		if (iPort == 10) continue; // TODO: remove later (hack to avoid getting stuck on COM10 on my laptop)
-
-		std::unique_ptr<SerialPort> pSerialPort(new SerialPort(iPort));
-		if (pSerialPort->exists() && pSerialPort->open())
+		std::vector<InteractionDeviceProfile> arrProfiles;
+		if (InteractionDeviceProfile::loadFolder(config.strInteractionProfileFolder, arrProfiles) == 0)
 		{
-			pSystem = new InteractionSystem(pSerialPort);
-			if (pSystem->initialise())
-			{
-				LOG_INFO("Found Interaction System on COM" << iPort);
-			} 
-			else
-			{
-				pSystem->deinitialise();
-				delete pSystem;
-				pSystem = NULL;
-			}
+			LOG_WARNING("No interaction device profiles in '" << config.strInteractionProfileFolder << "', using built-in profiles");
 		}
+		pSystem->setProfiles(arrProfiles);
+		pSystem->setDiscoveryInterval(config.iInteractionDiscoveryInterval);
 	}
-
-	if (!pSystem)
+	if ((pSystem != NULL) && pSystem->initialise())
 	{
+		strLastInteractionPort = pSystem->getPortName();
+		LOG_INFO("Found Interaction System on " << strLastInteractionPort);
+	}
+	else
+	{
+		delete pSystem;
+		pSystem = NULL;
 		LOG_INFO("Cound not find Interaction System");
 	}
 
@@ -494,10 +637,17 @@ bool createServer()
 		                       szMulticastIP_Address, &iMulticastPort);
 		LOG_INFO("Command adress   : " << szCommandIP_Address << ":" << iCommandPort);
 		LOG_INFO("Data adress      : " << szDataIP_Address    << ":" << iDataPort);
+		std::stringstream destination;
 		if (iConnectionType == ConnectionType_Multicast)
 		{
 			LOG_INFO("Multicast address: " << szMulticastIP_Address << ":" << iMulticastPort);
+			destination << "multicast " << szMulticastIP_Address << ":" << iMulticastPort;
+		}
+		else
+		{
+			destination << "unicast clients of " << szDataIP_Address << ":" << iDataPort;
 		}
+		strDataDestination = destination.str();
 	}
 	else
 	{
@@ -530,30 +680,66 @@ bool isServerRunning()
  */
 void signalNewFrame()
 {
-	mtxMoCap.lock();
+	TRACE_SCOPE("signalNewFrame");
+	{
+		TRACE_SCOPE("wait mtxMoCap");
+		mtxMoCap.lock();
+	}
 	if (pMoCapSystem && pMoCapSystem->isActive() && pMocapData)
 	{
-		if (pMoCapSystem->getFrameData(*pMocapData))
+		if (writeFramePacketDirectly())
 		{
+			// MoCap system has already serialised the frame
+		}
+		else if (pMoCapSystem->getFrameData(*pMocapData))
+		{
+			frameDataStale = false;
+
 			if (pInteractionSystem)
 			{
 				pInteractionSystem->getFrameData(*pMocapData);
 			}
 
-			mtxServer.lock();
-			if (pServer)
+			// large frames are split into several packets
+			const std::vector<const sFrameOfMocapData*>& arrFragments = frameFragmenter.fragment(pMocapData->frame);
+			std::shared_ptr<FramePacketList> pPackets = std::make_shared<FramePacketList>();
+			for (size_t fIdx = 0; fIdx < arrFragments.size(); fIdx++)
+			{
+				pPackets->push_back(acquireFramePacket());
+			}
+
+			bool packetised = false;
 			{
-				pServer->PacketizeFrameOfMocapData(&(pMocapData->frame), &packetOut);
-				pServer->SendPacket(&packetOut);
+				TRACE_SCOPE("wait mtxServer");
+				mtxServer.lock();
+			}
+			if (pServer && pFrameSender)
+			{
+				TRACE_SCOPE("packetise frame");
+				for (size_t fIdx = 0; fIdx < arrFragments.size(); fIdx++)
+				{
+					sPacket* pPacket = const_cast<sPacket*>((*pPackets)[fIdx].get());
+					pServer->PacketizeFrameOfMocapData(const_cast<sFrameOfMocapData*>(arrFragments[fIdx]), pPacket);
+				}
+				// sending happens on the sender thread, all fragments together
+				pFrameSender->enqueue(pPackets);
+				packetised = true;
 			}
 			mtxServer.unlock();
 
+			if (packetised)
+			{
+				// make packets available to polling clients
+				publishFramePackets(pPackets);
+			}
+
 			if (pMoCapFileWriter)
 			{
+				TRACE_SCOPE("write frame file");
 				pMoCapFileWriter->writeFrameData(*pMocapData);
 			}
 		}
-		else
+		else if (!pMoCapSystem->isFrameSkipped())
 		{
 			LOG_ERROR("Could not retrieve signalled frame");
 		}
@@ -570,6 +756,150 @@ void signalNewFrame()
 }
 
 
+/**
+ * Called when the scene description in the MoCap data structure has changed,
+ * e.g., after a provider (re)loaded its scene, or interaction devices were added.
+ * The serialised description is rebuilt with the next client request.
+ */
+void signalSceneChange()
+{
+	descriptionVersion++;
+}
+
+
+/**
+ * Lets the MoCap system write the frame straight into a packet, skipping the frame data structure.
+ * This is only possible when no local consumer (interaction system, file writer) needs the structure.
+ * Only to be called from the streaming path (protected by mtxMoCap).
+ *
+ * @return <code>true</code> if the frame was written and queued for sending,
+ *         <code>false</code> if the frame needs to be retrieved through getFrameData()
+ */
+bool writeFramePacketDirectly()
+{
+	if (pInteractionSystem || pMoCapFileWriter || !FramePacketWriter::isSupportedVersion(arrServerNatNetVersion))
+	{
+		return false;
+	}
+
+	std::shared_ptr<sPacket> pPacket = acquireFramePacket();
+	FramePacketWriter writer(*pPacket, arrServerNatNetVersion, frameFragmenter.getMaxPacketSize());
+	if (!pMoCapSystem->writeFrameData(*pMocapData, writer))
+	{
+		// not supported, scene has changed, or frame needs to be split
+		return false;
+	}
+	frameDataStale = true;
+
+	std::shared_ptr<const FramePacketList> pPackets = std::make_shared<FramePacketList>(1, pPacket);
+	bool queued = false;
+	{
+		TRACE_SCOPE("wait mtxServer");
+		mtxServer.lock();
+	}
+	if (pFrameSender)
+	{
+		pFrameSender->enqueue(pPackets);
+		queued = true;
+	}
+	mtxServer.unlock();
+
+	if (queued)
+	{
+		publishFramePackets(pPackets);
+	}
+	return true;
+}
+
+
+/**
+ * Gets a frame packet from the pool that is neither the published frame packet
+ * nor still being copied by a polling client.
+ * Only to be called from the streaming path (protected by mtxMoCap).
+ *
+ * @return a frame packet that can be written to
+ */
+std::shared_ptr<sPacket> acquireFramePacket()
+{
+	for (auto& pPacket : arrFramePackets)
+	{
+		if (pPacket.use_count() == 1)
+		{
+			// only the pool references this packet > free to reuse
+			// (fence: make sure that any reader has finished with it)
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return pPacket;
+		}
+	}
+
+	// all packets in use > grow pool (rarely happens after the first few frames)
+	arrFramePackets.push_back(std::make_shared<sPacket>());
+	return arrFramePackets.back();
+}
+
+
+/**
+ * Publishes the serialised fragments of a frame as the latest frame for polling clients.
+ * The packets must not be modified afterwards.
+ *
+ * @param pPackets  the frame packets to publish
+ */
+void publishFramePackets(const std::shared_ptr<const FramePacketList>& pPackets)
+{
+	std::atomic_store(&pLatestFramePackets, pPackets);
+}
+
+
+/**
+ * Copies a packet of the latest streamed frame for a polling client.
+ * The client keeps track of the fragments itself,
+ * so several clients can poll the fragments of a frame at the same time.
+ *
+ * @param frameNumber     the number of the frame to get a packet of (-1: latest frame)
+ * @param packetIdx       the index of the packet (fragment) within the frame
+ * @param refDestination  the packet to copy to
+ *
+ * @return <code>true</code> if the packet was copied,
+ *         <code>false</code> if the frame is no longer the latest one or the index is invalid
+ */
+bool copyPolledFramePacket(int frameNumber, int packetIdx, sPacket& refDestination)
+{
+	std::shared_ptr<const FramePacketList> pPackets = std::atomic_load(&pLatestFramePackets);
+	if (!pPackets || (packetIdx < 0) || (packetIdx >= (int) pPackets->size()))
+	{
+		return false;
+	}
+
+	const sPacket& refPacket = *(*pPackets)[packetIdx];
+	if (frameNumber >= 0)
+	{
+		// the payload of a frame packet starts with the frame number
+		int packetFrameNumber;
+		memcpy(&packetFrameNumber, refPacket.Data.cData, sizeof(packetFrameNumber));
+		if (packetFrameNumber != frameNumber)
+		{
+			return false;
+		}
+	}
+
+	copyPacket(refPacket, refDestination);
+	return true;
+}
+
+
+/**
+ * Copies a NatNet packet, but only the header and the actually used part of the payload.
+ *
+ * @param refSource       the packet to copy from
+ * @param refDestination  the packet to copy to
+ */
+void copyPacket(const sPacket& refSource, sPacket& refDestination)
+{
+	size_t headerSize = sizeof(refSource) - sizeof(refSource.Data);
+	memcpy(&refDestination, &refSource, headerSize + refSource.nDataBytes);
+}
+
+
 /**
  * Stops the NatNet server thread.
  */
@@ -639,6 +969,9 @@ void __cdecl callbackNatNetServerMessageHandler(int iMessageType, char* czMessag
  */
 int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPacketOut, void* pUserData)
 {
+	TraceRecorder::setThreadName("NatNet requests");
+	TRACE_SCOPE("NatNet request");
+
 	bool requestHandled = false;
 
 	std::cout << "callback" << std::endl;
@@ -677,15 +1010,48 @@ int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPac
 
 		case NAT_REQUEST_MODELDEF:
 		{
-			std::cout << "scene start" << std::endl;
 			LOG_INFO("Requested scene description");
-			mtxServer.lock();
-			if (pServer)
 			{
-				pServer->PacketizeDataDescriptions(&(pMocapData->description), pPacketOut);
+				TRACE_SCOPE("wait mtxDescription");
+				mtxDescription.lock();
+			}
+			int version = descriptionVersion;
+			if (packetDescriptionVersion != version)
+			{
+				// scene has changed since the packet was built > serialise again
+				// (same locking order as in signalNewFrame: MoCap data first, then server)
+				{
+					TRACE_SCOPE("wait mtxMoCap");
+					mtxMoCap.lock();
+				}
+				{
+					TRACE_SCOPE("wait mtxServer");
+					mtxServer.lock();
+				}
+				if (pServer && pMocapData)
+				{
+					TRACE_SCOPE("serialise description");
+					pServer->PacketizeDataDescriptions(&(pMocapData->description), &packetDescription);
+					packetDescriptionVersion = version;
+					LOG_INFO("Scene description v" << version << " serialised (" << packetDescription.nDataBytes << " bytes)");
+				}
+				mtxServer.unlock();
+				mtxMoCap.unlock();
+			}
+			if (packetDescriptionVersion >= 0)
+			{
+				copyPacket(packetDescription, *pPacketOut);
+			}
+			else
+			{
+				// no scene serialised yet > answer with an empty description (dataset count 0)
+				int nDescriptions = 0;
+				pPacketOut->iMessage   = NAT_MODELDEF;
+				pPacketOut->nDataBytes = sizeof(nDescriptions);
+				memcpy(pPacketOut->Data.cData, &nDescriptions, sizeof(nDescriptions));
 			}
-			mtxServer.unlock();
 			requestHandled = true;
+			mtxDescription.unlock();
 			break;
 		}
 
@@ -696,14 +1062,20 @@ int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPac
 
 			// This function does not call pMoCapSystem->getFrameData()
 			// because the streaming thread does that.
-			// Additional polling might mess up the timing
-			mtxServer.lock();
-			if (pServer && pMocapData)
+			// Additional polling might mess up the timing.
+			// Instead, the last packet that was streamed is returned without locking.
+			// Of a fragmented frame, the first fragment is returned,
+			// the client requests the others with "getFrameFragment <frame> <index>".
+			if (copyPolledFramePacket(-1, 0, *pPacketOut))
 			{
-				pServer->PacketizeFrameOfMocapData(&(pMocapData->frame), pPacketOut);
+				requestHandled = true;
+			}
+			else
+			{
+				// nothing streamed yet
+				pPacketOut->iMessage   = NAT_UNRECOGNIZED_REQUEST;
+				pPacketOut->nDataBytes = 0;
 			}
-			mtxServer.unlock();
-			requestHandled = true;
 			break;
 		}
 
@@ -733,6 +1105,26 @@ int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPac
 				sprintf_s(pPacketOut->Data.szData, "%.0f", rate);
 				pPacketOut->nDataBytes = (unsigned short)strlen(pPacketOut->Data.szData) + 1;
 			}
+			else if (strRequestL == "getdescriptionversion")
+			{
+				sprintf_s(pPacketOut->Data.szData, "%d", (int) descriptionVersion);
+				pPacketOut->nDataBytes = (unsigned short)strlen(pPacketOut->Data.szData) + 1;
+			}
+			else if (strRequestL.find("getframefragment ") == 0)
+			{
+				// fragment of the latest frame for a polling client
+				std::stringstream strmParameters(strRequestL.substr(strRequestL.find_first_of(" ") + 1));
+				int frameNumber = -1;
+				int packetIdx   = -1;
+				if (!(strmParameters >> frameNumber >> packetIdx) ||
+				    !copyPolledFramePacket(frameNumber, packetIdx, *pPacketOut))
+				{
+					// frame has been replaced by a newer one meanwhile
+					pPacketOut->iMessage   = NAT_UNRECOGNIZED_REQUEST;
+					pPacketOut->nDataBytes = 0;
+					requestHandled = false;
+				}
+			}
 			else if (strRequestL == "getdatastreamaddress")
 			{
 				std::cout << "data" << std::endl;
@@ -749,7 +1141,10 @@ int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPac
 			else
 			{
 				// last resort: MoCap subsytem can handle this?
-				mtxMoCap.lock();
+				{
+					TRACE_SCOPE("wait mtxMoCap");
+					mtxMoCap.lock();
+				}
 				if (pMoCapSystem && pMoCapSystem->processCommand(strRequestL))
 				{ 
 					// success
@@ -784,6 +1179,8 @@ int __cdecl callbackNatNetServerRequestHandler(sPacket* pPacketIn, sPacket* pPac
  */
 void mocapTimerThread()
 {
+	TraceRecorder::setThreadName("Streaming");
+
 	// create variables to keep track of timing
 	std::chrono::system_clock::time_point nextTick(std::chrono::system_clock::now() + std::chrono::milliseconds(100));
 
@@ -797,8 +1194,10 @@ void mocapTimerThread()
 		nextTick += intervalTime;
 
 		// mtxMoCap.lock(); < this would collide with the lock in signalNewFrame that is probably being called
-		if (serverRunning && pMoCapSystem)
+		// event driven systems signal their frames themselves
+		if (serverRunning && pMoCapSystem && !pMoCapSystem->isEventDriven())
 		{
+			TRACE_SCOPE("update");
 			pMoCapSystem->update();
 		}
 		// mtxMoCap.unlock();
@@ -853,7 +1252,10 @@ int _tmain(int nArguments, _TCHAR* arrArguments[])
 				{
 					if (pMocapData->frame.nForcePlates == 0)
 					{
+						// devices are added/removed by the streaming thread from now on
+						mtxMoCap.lock();
 						pInteractionSystem->getSceneDescription(*pMocapData);
+						mtxMoCap.unlock();
 					}
 					else
 					{
@@ -862,12 +1264,31 @@ int _tmain(int nArguments, _TCHAR* arrArguments[])
 					}
 				}
 				
+				// scene description is complete > invalidate any serialised version
+				signalSceneChange();
+
 				// if enabled, write description to file
 				if (pMoCapFileWriter)
 				{
 					pMoCapFileWriter->writeSceneDescription(*pMocapData);
 				}
 
+				mtxMoCap.lock();
+				frameFragmenter.setMaxPacketSize(config.iMaxPacketSize);
+				if (frameFragmenter.getMaxPacketSize() != (size_t) config.iMaxPacketSize)
+				{
+					LOG_WARNING("Maximum packet size limited to " << frameFragmenter.getMaxPacketSize() << " bytes");
+				}
+				mtxMoCap.unlock();
+
+				// start sending thread
+				FrameSender* pSender = new FrameSender(*pServer, strDataDestination);
+				pSender->setPacingInterval(std::chrono::microseconds(config.iSendPacingInterval));
+				pSender->start();
+				mtxServer.lock();
+				pFrameSender = pSender;
+				mtxServer.unlock();
+
 				// start responding to packets
 				pServer->SetMessageResponseCallback(callbackNatNetServerRequestHandler);
 
@@ -887,7 +1308,10 @@ int _tmain(int nArguments, _TCHAR* arrArguments[])
 					<< std::endl << "\tr:Restart"
 					<< std::endl << "\tp:Pause/Unpause"
 					<< std::endl << "\td:Print Model Definitions"
-					<< std::endl << "\tf:Print Frame Data";
+					<< std::endl << "\tf:Print Frame Data"
+					<< std::endl << "\ts:Print Streaming Statistics"
+					<< std::endl << "\tt:Start/Stop Trace Recording"
+					<< std::endl << "\tt <file>:Write Trace Recording (Chrome trace_event JSON)";
 				LOG_INFO("Commands:" << commands.str())
 
 				do
@@ -931,16 +1355,59 @@ int _tmain(int nArguments, _TCHAR* arrArguments[])
 					{
 						// print frame
 						std::stringstream strm;
+						mtxMoCap.lock();
+						if (frameDataStale && pMoCapSystem->getFrameData(*pMocapData))
+						{
+							// frames are streamed without the data structure > fetch one explicitly
+							frameDataStale = false;
+						}
 						printFrameOfData(strm, pMocapData->frame);
+						mtxMoCap.unlock();
+						std::cout << strm.str() << std::endl;
+					}
+					else if (strCmdLowerCase == "s")
+					{
+						// print streaming statistics
+						std::stringstream strm;
+						pFrameSender->printStatistics(strm);
+						if (pInteractionSystem)
+						{
+							mtxMoCap.lock();
+							pInteractionSystem->printLatencyStatistics(strm);
+							mtxMoCap.unlock();
+						}
 						std::cout << strm.str() << std::endl;
 					}
-					else if (pMoCapSystem->processCommand(strCommand) == true)
+					else if (strCmdLowerCase == "t")
 					{
-						// MoCap susbsytem was able to handle command
+						// start/stop recording thread activity
+						TraceRecorder::setEnabled(!TraceRecorder::isEnabled());
+						LOG_INFO((TraceRecorder::isEnabled() ? "Trace recording started" : "Trace recording stopped"));
+					}
+					else if (strCmdLowerCase.find("t ") == 0)
+					{
+						// write recorded thread activity (keeps recording)
+						std::string strFilename = strCommand.substr(2);
+						size_t      eventCount;
+						if (TraceRecorder::writeChromeTrace(strFilename, eventCount))
+						{
+							LOG_INFO("Wrote " << eventCount << " trace events to '" << strFilename << "'");
+						}
+						else
+						{
+							LOG_ERROR("Could not write trace file '" << strFilename << "'");
+						}
 					}
 					else
 					{
-						LOG_ERROR("Unknown command: '" << strCommand << "'");
+						// MoCap subsystem able to handle command? (locked, the frame conversion may use its settings)
+						mtxMoCap.lock();
+						bool processed = pMoCapSystem->processCommand(strCommand);
+						mtxMoCap.unlock();
+						if (!processed)
+						{
+							LOG_ERROR("Unknown command: '" << strCommand << "'");
+						}
 					}
 				} while (serverRunning);
 
@@ -953,12 +1420,28 @@ int _tmain(int nArguments, _TCHAR* arrArguments[])
 				streamingThread.join();
 
 				LOG_INFO("Streaming thread stopped");
+
+				// stop MoCap threads that signal frames (not locked, they might be waiting for the lock)
+				pMoCapSystem->stop();
+
+				// stop sending thread (MoCap callbacks might still be signalling frames)
+				mtxServer.lock();
+				pFrameSender = NULL;
+				mtxServer.unlock();
+				pSender->stop();
+				std::stringstream statistics;
+				pSender->printStatistics(statistics);
+				LOG_INFO(statistics.str());
+				delete pSender;
 			}
 
 			destroyServer();
 
 			if (pInteractionSystem)
 			{
+				std::stringstream statistics;
+				pInteractionSystem->printLatencyStatistics(statistics);
+				LOG_INFO(statistics.str());
 				pInteractionSystem->deinitialise();
 				delete pInteractionSystem;
 				pInteractionSystem = NULL;
@@ -984,6 +1467,10 @@ int _tmain(int nArguments, _TCHAR* arrArguments[])
 				delete pMocapData;
 				pMocapData = NULL;
 			}
+
+			// frame packets of this scene are not valid any more
+			std::atomic_store(&pLatestFramePackets, std::shared_ptr<const FramePacketList>());
+			arrFramePackets.clear();
 			mtxMoCap.unlock();
 
 			if (serverRestarting)
@@ -994,5 +1481,11 @@ int _tmain(int nArguments, _TCHAR* arrArguments[])
 		while (serverRestarting);
 	}
 
+	// interaction controller probes that were still busy at the end of a scan
+	InteractionSystem::finishProbes();
+
+	// write the remaining log messages
+	Logger::shutdown();
+
 	return 0;
 }
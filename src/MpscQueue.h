@@ -0,0 +1,106 @@
+/**
+ * Fixed size lock-free queue for passing values from any number of producer threads
+ * to exactly one consumer thread. Neither side ever blocks:
+ * when the queue is full, new values are rejected.
+ * Every slot carries a sequence number that tells whether it is free for the producer
+ * of a specific round or ready for the consumer (bounded queue after D. Vyukov).
+ * The capacity needs to be a power of 2.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+
+template<typename T, size_t N> class MpscQueue
+{
+	static_assert((N > 1) && ((N & (N - 1)) == 0), "MpscQueue capacity needs to be a power of 2");
+
+public:
+
+	MpscQueue() :
+		m_head(0),
+		m_tail(0)
+	{
+		for (size_t idx = 0; idx < N; idx++)
+		{
+			m_arrSlots[idx].sequence.store(idx, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * Adds a value to the queue. Can be called from any thread.
+	 *
+	 * @param refValue  the value to add
+	 *
+	 * @return <code>true</code> if the value was added,
+	 *         <code>false</code> if the queue was full
+	 */
+	bool push(const T& refValue)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		while (true)
+		{
+			sSlot&    refSlot  = m_arrSlots[tail & (N - 1)];
+			size_t    sequence = refSlot.sequence.load(std::memory_order_acquire);
+			ptrdiff_t diff     = (ptrdiff_t) sequence - (ptrdiff_t) tail;
+			if (diff == 0)
+			{
+				// slot is free > claim it (tail is reloaded by the failing exchange)
+				if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed))
+				{
+					refSlot.value = refValue;
+					refSlot.sequence.store(tail + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				// slot still holds a value of the previous round > full
+				return false;
+			}
+			else
+			{
+				// another producer was quicker
+				tail = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/**
+	 * Removes the oldest value from the queue. Must only be called from the consumer thread.
+	 *
+	 * @param refValue  the variable to move the value into
+	 *
+	 * @return <code>true</code> if there was a value,
+	 *         <code>false</code> if the queue was empty
+	 *         (or the oldest value is still being written)
+	 */
+	bool pop(T& refValue)
+	{
+		size_t head     = m_head.load(std::memory_order_relaxed);
+		sSlot& refSlot  = m_arrSlots[head & (N - 1)];
+		size_t sequence = refSlot.sequence.load(std::memory_order_acquire);
+		if (sequence != head + 1)
+		{
+			return false;
+		}
+		refValue = refSlot.value;
+		refSlot.sequence.store(head + N, std::memory_order_release); // free for the next round
+		m_head.store(head + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+private:
+
+	struct sSlot
+	{
+		std::atomic<size_t> sequence;
+		T                   value;
+	};
+
+	sSlot               m_arrSlots[N];
+	std::atomic<size_t> m_head; // next value to pop (only used by the consumer)
+	std::atomic<size_t> m_tail; // next free slot    (claimed by the producers)
+};
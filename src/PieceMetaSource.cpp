@@ -0,0 +1,283 @@
+#include "PieceMetaSource.h"
+
+#ifdef USE_PIECEMETA
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "PieceMetaSource"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <WinInet.h>
+#pragma comment(lib,"Wininet.lib")
+#else
+#include <sys/stat.h>
+#endif
+
+#include <stdint.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <fstream>
+
+#define READ_BUFFER_SIZE 65536
+#define CACHE_FILE_ID    0x43534D50 // "PMSC"
+
+
+PieceMetaSource* PieceMetaSource::create(const std::string& location)
+{
+	if ((location.find("http://") == 0) || (location.find("https://") == 0))
+	{
+		return new PieceMetaWebSource(location);
+	}
+	return new PieceMetaDirectorySource(location);
+}
+
+
+bool PieceMetaSource::read(const std::string& url, std::string& content)
+{
+	content.clear();
+	return read(url, [&content](const char* pData, size_t length)
+	{
+		content.append(pData, length);
+		return true;
+	});
+}
+
+
+
+
+#ifdef _WIN32
+
+PieceMetaWebSource::PieceMetaWebSource(const std::string& baseURL) :
+	baseURL(baseURL)
+{
+	hInternet = InternetOpen(
+		TEXT("Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:54.0) Gecko/20100101 Firefox/54.0"),
+		INTERNET_OPEN_TYPE_PRECONFIG,
+		NULL, NULL, 0);
+}
+
+
+PieceMetaWebSource::~PieceMetaWebSource()
+{
+	if (hInternet != NULL)
+	{
+		InternetCloseHandle(hInternet);
+	}
+}
+
+
+bool PieceMetaWebSource::read(const std::string& url, const ContentConsumer& consumer)
+{
+	bool success = false;
+
+	// prepare request:
+	DWORD dwRequestFlags = INTERNET_FLAG_NO_UI   // no UI please
+		| INTERNET_FLAG_NO_AUTH           // don't authenticate
+		| INTERNET_FLAG_PRAGMA_NOCACHE    // do not try the cache or proxy
+		| INTERNET_FLAG_NO_CACHE_WRITE;   // don't add this to the IE cache
+
+	// convert URL into WChar
+	std::string  fullURL = baseURL + url;
+	std::wstring wURL;
+	wURL.assign(fullURL.begin(), fullURL.end());
+
+	// open URL
+	HINTERNET hUrl = InternetOpenUrl(hInternet, wURL.c_str(), NULL, 0, dwRequestFlags, NULL);
+	if (hUrl)
+	{
+		// success: pass on content as it arrives
+		std::vector<char> buffer(READ_BUFFER_SIZE);
+		DWORD dwBytesRead = 0;
+		success = true;
+		while (success && InternetReadFile(hUrl, buffer.data(), (DWORD) buffer.size(), &dwBytesRead) && (dwBytesRead > 0))
+		{
+			success = consumer(buffer.data(), dwBytesRead);
+		}
+		InternetCloseHandle(hUrl);
+	}
+	else
+	{
+		LOG_ERROR("Could not open " << fullURL);
+	}
+	return success;
+}
+
+#else
+
+// the web API is read through WinInet, other systems can only use local folders
+
+PieceMetaWebSource::PieceMetaWebSource(const std::string& baseURL) :
+	baseURL(baseURL),
+	hInternet(NULL)
+{
+	// nothing else to do
+}
+
+
+PieceMetaWebSource::~PieceMetaWebSource()
+{
+	// nothing to do
+}
+
+
+bool PieceMetaWebSource::read(const std::string& url, const ContentConsumer& consumer)
+{
+	LOG_ERROR("Could not open " << baseURL << url << " (web sources are only supported on Windows)");
+	return false;
+}
+
+#endif // #ifdef _WIN32
+
+
+std::string PieceMetaWebSource::getName() const
+{
+	return baseURL;
+}
+
+
+
+
+PieceMetaDirectorySource::PieceMetaDirectorySource(const std::string& directory) :
+	directory(directory)
+{
+	// nothing else to do
+}
+
+
+bool PieceMetaDirectorySource::read(const std::string& url, const ContentConsumer& consumer)
+{
+	// map "/streams/<uuid>.json?from=0&to=100" to "<directory>/streams/<uuid>.json"
+	std::string path = url.substr(0, url.find('?'));
+	path.erase(0, path.find_first_not_of('/'));
+	std::string filename = directory + "/" + path;
+
+	std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Could not open " << filename);
+		return false;
+	}
+
+	std::vector<char> buffer(READ_BUFFER_SIZE);
+	bool success = true;
+	while (success && file)
+	{
+		file.read(buffer.data(), buffer.size());
+		if (file.gcount() > 0)
+		{
+			success = consumer(buffer.data(), (size_t) file.gcount());
+		}
+	}
+	return success;
+}
+
+
+std::string PieceMetaDirectorySource::getName() const
+{
+	return "folder " + directory;
+}
+
+
+
+
+PieceMetaStreamCache::PieceMetaStreamCache(const std::string& directory) :
+	directory(directory)
+{
+	if (!directory.empty())
+	{
+		// fails harmlessly if the folder already exists
+#ifdef _WIN32
+		CreateDirectoryA(directory.c_str(), NULL);
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+}
+
+
+bool PieceMetaStreamCache::isEnabled() const
+{
+	return !directory.empty();
+}
+
+
+bool PieceMetaStreamCache::load(const std::string& uuid, long frameCount, std::vector<float>& data) const
+{
+	if (!isEnabled()) return false;
+
+	std::ifstream file(getFilename(uuid).c_str(), std::ios::in | std::ios::binary);
+	if (!file.is_open()) return false;
+
+	// header: ID, announced frame count, stored frame count
+	uint32_t header[3];
+	if (!file.read((char*) header, sizeof(header)) ||
+	    (header[0] != CACHE_FILE_ID) || (header[1] != (uint32_t) frameCount))
+	{
+		// unknown format or the stream has changed since
+		return false;
+	}
+
+	// the stored frame count has to match the data in the file (e.g., not truncated)
+	std::streamoff dataStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff dataSize = file.tellg() - dataStart;
+	file.seekg(dataStart);
+	if (dataSize != (std::streamoff) header[2] * (std::streamoff) sizeof(float))
+	{
+		LOG_WARNING("Ignoring damaged cache file " << getFilename(uuid));
+		return false;
+	}
+
+	data.resize(header[2]);
+	if (!file.read((char*) data.data(), data.size() * sizeof(float)))
+	{
+		data.clear();
+		return false;
+	}
+	return true;
+}
+
+
+bool PieceMetaStreamCache::store(const std::string& uuid, long frameCount, const std::vector<float>& data) const
+{
+	if (!isEnabled()) return false;
+
+	// write into a temporary file first so an interrupted write never leaves a valid looking file
+	std::string filename = getFilename(uuid);
+	std::string tmpFilename = filename + ".tmp";
+	{
+		std::ofstream file(tmpFilename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			LOG_WARNING("Could not write " << tmpFilename);
+			return false;
+		}
+
+		uint32_t header[3] = { CACHE_FILE_ID, (uint32_t) frameCount, (uint32_t) data.size() };
+		file.write((const char*) header, sizeof(header));
+		file.write((const char*) data.data(), data.size() * sizeof(float));
+		if (!file)
+		{
+			LOG_WARNING("Could not write " << tmpFilename);
+			return false;
+		}
+	}
+
+	remove(filename.c_str());
+	return rename(tmpFilename.c_str(), filename.c_str()) == 0;
+}
+
+
+std::string PieceMetaStreamCache::getFilename(const std::string& uuid) const
+{
+	// only keep characters that are safe in a filename
+	std::string name;
+	for (char c : uuid)
+	{
+		if (isalnum((unsigned char) c) || (c == '-') || (c == '_')) name += c;
+	}
+	return directory + "/" + name + ".bin";
+}
+
+#endif // #ifdef USE_PIECEMETA
@@ -0,0 +1,158 @@
+/**
+ * Sources for PieceMeta data (web API or a local folder with the same structure)
+ * and an on-disk cache for downloaded stream data.
+ */
+
+#pragma once
+
+#include "Config.h"
+
+#ifdef USE_PIECEMETA
+
+#include <functional>
+#include <string>
+#include <vector>
+
+
+class PieceMetaSource
+{
+public:
+
+	/**
+	 * Function receiving the content of a URL chunk by chunk.
+	 * Returns <code>false</code> to stop reading.
+	 */
+	typedef std::function<bool(const char* pData, size_t length)> ContentConsumer;
+
+	/**
+	 * Creates the source matching a location.
+	 *
+	 * @param location  base URL of the API ("http://..." or "https://...") or a local folder
+	 *
+	 * @return the new source
+	 */
+	static PieceMetaSource* create(const std::string& location);
+
+	virtual ~PieceMetaSource() { }
+
+	/**
+	 * Reads a URL and passes the content to a consumer as it arrives.
+	 * Can be called from several threads at the same time.
+	 *
+	 * @param url       the URL to read, relative to the source location
+	 * @param consumer  the function receiving the content
+	 *
+	 * @return <code>true</code> when read was successful, <code>false</code> if not.
+	 */
+	virtual bool read(const std::string& url, const ContentConsumer& consumer) = 0;
+
+	/**
+	 * Reads a URL into a string.
+	 *
+	 * @param url      the URL to read, relative to the source location
+	 * @param content  the string to read the URL into
+	 *
+	 * @return <code>true</code> when read was successful, <code>false</code> if not.
+	 */
+	bool read(const std::string& url, std::string& content);
+
+	/**
+	 * Gets a description of the source for log output.
+	 *
+	 * @return the description of the source
+	 */
+	virtual std::string getName() const = 0;
+};
+
+
+/**
+ * Source reading from the PieceMeta web API.
+ */
+class PieceMetaWebSource : public PieceMetaSource
+{
+public:
+	PieceMetaWebSource(const std::string& baseURL);
+	virtual ~PieceMetaWebSource();
+
+	virtual bool        read(const std::string& url, const ContentConsumer& consumer);
+	virtual std::string getName() const;
+
+	using PieceMetaSource::read;
+
+private:
+	std::string baseURL;
+	void*       hInternet; // session shared by all requests
+};
+
+
+/**
+ * Source reading from a local folder, e.g., for working offline.
+ * "streams/<uuid>.json?from=0&to=100" is mapped to "<folder>/streams/<uuid>.json",
+ * the range is ignored and the whole file is delivered.
+ */
+class PieceMetaDirectorySource : public PieceMetaSource
+{
+public:
+	PieceMetaDirectorySource(const std::string& directory);
+
+	virtual bool        read(const std::string& url, const ContentConsumer& consumer);
+	virtual std::string getName() const;
+
+	using PieceMetaSource::read;
+
+private:
+	std::string directory;
+};
+
+
+/**
+ * On-disk cache for stream data, keyed by the stream UUID.
+ */
+class PieceMetaStreamCache
+{
+public:
+
+	/**
+	 * Creates a stream cache.
+	 *
+	 * @param directory  the folder for the cache files (empty: cache is disabled)
+	 */
+	PieceMetaStreamCache(const std::string& directory = "");
+
+	/**
+	 * Checks if the cache is used.
+	 *
+	 * @return <code>true</code> if the cache is enabled
+	 */
+	bool isEnabled() const;
+
+	/**
+	 * Loads the data of a stream from the cache.
+	 *
+	 * @param uuid        the UUID of the stream
+	 * @param frameCount  the frame count the source announces for the stream
+	 * @param data        the vector to load the data into
+	 *
+	 * @return <code>true</code> if the stream was in the cache and matches the frame count
+	 */
+	bool load(const std::string& uuid, long frameCount, std::vector<float>& data) const;
+
+	/**
+	 * Stores the data of a stream in the cache.
+	 *
+	 * @param uuid        the UUID of the stream
+	 * @param frameCount  the frame count the source announces for the stream
+	 * @param data        the data of the stream
+	 *
+	 * @return <code>true</code> if the stream was stored
+	 */
+	bool store(const std::string& uuid, long frameCount, const std::vector<float>& data) const;
+
+private:
+	std::string getFilename(const std::string& uuid) const;
+
+private:
+	std::string directory;
+};
+
+#endif // #ifdef USE_PIECEMETA
@@ -0,0 +1,35 @@
+/**
+ * Definitions for compiling the platform independent parts of the server
+ * (e.g., the XBee interaction system) on non-Windows systems.
+ */
+
+#pragma once
+
+#ifndef _WIN32
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint32_t DWORD;
+
+// calling convention of SDK callbacks
+#define __cdecl
+
+
+/**
+ * Replacement for the secure string copy of the Microsoft CRT.
+ * Copies at most <code>count</code> characters and always terminates the string,
+ * truncating it if necessary.
+ */
+template<size_t N> inline int strncpy_s(char (&dst)[N], const char* src, size_t count)
+{
+	size_t length = strlen(src);
+	if (length > count)   length = count;
+	if (length > (N - 1)) length = N - 1;
+	memcpy(dst, src, length);
+	dst[length] = '\0';
+	return 0;
+}
+
+#endif // #ifndef _WIN32
@@ -0,0 +1,65 @@
+/**
+ * Sequence lock for publishing a value from one writer thread to any number of reader threads
+ * without blocking either side. Readers always get a consistent copy and retry
+ * if the writer changed the value while it was being copied.
+ * The value type needs to be trivially copyable.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+
+template<typename T> class SeqLock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+public:
+
+	SeqLock() :
+		m_sequence(0),
+		m_value()
+	{
+		// nothing else to do
+	}
+
+	/**
+	 * Publishes a new value. Must only be called from one thread.
+	 *
+	 * @param refValue  the value to publish
+	 */
+	void write(const T& refValue)
+	{
+		uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+		// odd sequence number: write in progress
+		m_sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		memcpy(&m_value, &refValue, sizeof(T));
+		m_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	/**
+	 * Reads a consistent copy of the last published value.
+	 *
+	 * @param refValue  the variable to copy the value into
+	 */
+	void read(T& refValue) const
+	{
+		uint32_t before, after;
+		do
+		{
+			before = m_sequence.load(std::memory_order_acquire);
+			memcpy(&refValue, &m_value, sizeof(T));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = m_sequence.load(std::memory_order_relaxed);
+		} while ((before != after) || (before & 1));
+	}
+
+private:
+
+	std::atomic<uint32_t> m_sequence;
+	T                     m_value;
+};
@@ -1,5 +1,9 @@
 
 #include "SerialPort.h"
+
+#ifdef _WIN32
+
+#include <algorithm>
 #include <ios>
 #include <locale>
 
@@ -24,6 +28,64 @@ SerialPort::SerialPort(int portNumber) :
 }
 
 
+SerialPort::SerialPort(const std::string& strDeviceName) :
+	m_iPortNumber(-1),
+	m_strPortName(strDeviceName),
+	m_strFileName(strDeviceName),
+	m_hPort(0)
+{
+	// "COMx" needs the device namespace prefix to work for port numbers > 9
+	if (strDeviceName.find("COM") == 0)
+	{
+		m_strFileName = "\\\\.\\" + strDeviceName;
+	}
+}
+
+
+const std::string& SerialPort::getName() const
+{
+	return m_strPortName;
+}
+
+
+std::vector<std::string> SerialPort::listPorts()
+{
+	std::vector<std::string> arrPorts;
+
+	// the registry lists the present ports, so there is no need to probe COM1..COM255
+	HKEY hKey;
+	if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, "HARDWARE\\DEVICEMAP\\SERIALCOMM", 0, KEY_READ, &hKey) == ERROR_SUCCESS)
+	{
+		char  valueName[256];
+		BYTE  portName[256];
+		DWORD index = 0;
+		while (true)
+		{
+			DWORD nameSize = sizeof(valueName);
+			DWORD dataSize = sizeof(portName) - 1;
+			DWORD type;
+			LONG  result = RegEnumValueA(hKey, index, valueName, &nameSize, NULL, &type, portName, &dataSize);
+			if (result == ERROR_NO_MORE_ITEMS) break;
+			if ((result == ERROR_SUCCESS) && (type == REG_SZ))
+			{
+				portName[dataSize] = '\0';
+				arrPorts.push_back(std::string((const char*) portName));
+			}
+			index++;
+		}
+		RegCloseKey(hKey);
+	}
+
+	// sort by port number (COM2 before COM10)
+	std::sort(arrPorts.begin(), arrPorts.end(), [](const std::string& a, const std::string& b)
+	{
+		return (a.length() != b.length()) ? (a.length() < b.length()) : (a < b);
+	});
+
+	return arrPorts;
+}
+
+
 bool SerialPort::exists() const
 {
 	// source: http://stackoverflow.com/questions/1205383/listing-serial-com-ports-on-windows
@@ -167,7 +229,11 @@ bool SerialPort::setTimeout(DWORD timeout)
 		if (::GetCommTimeouts(m_hPort, &timeouts))
 		{
 			// success > change timeout
-			timeouts.ReadTotalTimeoutConstant = timeout;
+			// (interval and multiplier MAXDWORD: return as soon as any data has arrived,
+			//  wait up to the constant timeout if nothing has)
+			timeouts.ReadIntervalTimeout        = MAXDWORD;
+			timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+			timeouts.ReadTotalTimeoutConstant   = timeout;
 		}
 		else
 		{
@@ -236,3 +302,4 @@ void SerialPort::handleError(const char* strFunction) const
 	LocalFree(lpMsgBuf);
 }
 
+#endif // #ifdef _WIN32
@@ -1,10 +1,17 @@
 /**
  * Class for managing serial port connections and packet based communication.
+ * Implemented for Windows (SerialPort.cpp) and POSIX systems (SerialPortPosix.cpp).
  */
 #pragma once
 
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include "Portability.h"
+#endif
+
 #include <string>
+#include <vector>
 
 
 class SerialPort
@@ -12,12 +19,35 @@ class SerialPort
 public:
 
 	/**
-	 * Creates a serial port COMx with the port number x.
+	 * Creates a serial port COMx with the port number x
+	 * (/dev/ttyUSBx on POSIX systems).
 	 *
 	 * @param portNumber  the number of the COM port
 	 */
 	SerialPort(int portNumber);
 
+	/**
+	 * Creates a serial port with a device name, e.g., "COM3" or "/dev/pts/4".
+	 *
+	 * @param strDeviceName  the name of the port device
+	 */
+	SerialPort(const std::string& strDeviceName);
+
+	/**
+	 * Lists the serial ports that are present in the system,
+	 * without having to open or probe each possible port number.
+	 *
+	 * @return the names of the ports, e.g., "COM1", "COM4" (or "/dev/ttyUSB0" on POSIX systems)
+	 */
+	static std::vector<std::string> listPorts();
+
+	/**
+	 * Gets the name of the serial port.
+	 *
+	 * @return the name of the port, e.g., "COM3"
+	 */
+	const std::string& getName() const;
+
 	/**
 	 * Checks if the COM port exists at all.
 	 * Note: This does not automatically mean that it can be opened.
@@ -84,12 +114,13 @@ public:
 
 	/**
 	 * Receives data from the serial port.
+	 * Returns as soon as any data has arrived, or when the timeout has passed without data.
 	 *
 	 * @param pBuffer          pointer to the data to receive to (needs to be large enough)
-	 * @param nBytesToReceive  the amount of bytes to receive
+	 * @param nBytesToReceive  the maximum amount of bytes to receive
 	 *
 	 * @return the amount of bytes actually received. 
-	 *         May be less than <code>nBytesToReceive</code> (or even 0) when a timeout happened
+	 *         May be less than <code>nBytesToReceive</code> (or even 0 when a timeout happened)
 	 */
 	DWORD receive(void* pBuffer, DWORD nBytesToReceive) const;
 
@@ -111,10 +142,15 @@ private:
 
 private:
 
-	int          m_iPortNumber;  //< port number from the constructor
+	int          m_iPortNumber;  //< port number from the constructor (-1: created by name)
 	std::string  m_strPortName;  //< short name, e.g., "COM1"
-	std::string  m_strFileName;  //< Windows filename, e.g., "\\.\COM1"
+	std::string  m_strFileName;  //< filename, e.g., "\\.\COM1" or "/dev/ttyUSB1"
+#ifdef _WIN32
 	HANDLE       m_hPort;        //< Windows file handle to the serial port
+#else
+	int          m_fdPort;       //< file descriptor of the serial port (-1: closed)
+	DWORD        m_timeout;      //< read timeout in milliseconds
+#endif
 };
 
 
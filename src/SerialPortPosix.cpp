@@ -0,0 +1,262 @@
+#include "SerialPort.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "SerialPort"
+
+
+SerialPort::SerialPort(int portNumber) :
+	m_iPortNumber(portNumber),
+	m_fdPort(-1),
+	m_timeout(0)
+{
+	// USB serial adapters (e.g., XBee explorer boards) show up as /dev/ttyUSBx
+	std::stringstream strFileName;
+	strFileName << "/dev/ttyUSB" << m_iPortNumber;
+	m_strFileName = strFileName.str();
+	m_strPortName = m_strFileName;
+}
+
+
+SerialPort::SerialPort(const std::string& strDeviceName) :
+	m_iPortNumber(-1),
+	m_strPortName(strDeviceName),
+	m_strFileName(strDeviceName),
+	m_fdPort(-1),
+	m_timeout(0)
+{
+	// nothing else to do
+}
+
+
+const std::string& SerialPort::getName() const
+{
+	return m_strPortName;
+}
+
+
+std::vector<std::string> SerialPort::listPorts()
+{
+	std::vector<std::string> arrPorts;
+
+	// USB serial adapters and CDC devices
+	const char* arrPatterns[] = { "/dev/ttyUSB*", "/dev/ttyACM*" };
+	for (auto pattern : arrPatterns)
+	{
+		glob_t result;
+		if (glob(pattern, 0, NULL, &result) == 0)
+		{
+			for (size_t idx = 0; idx < result.gl_pathc; idx++)
+			{
+				arrPorts.push_back(result.gl_pathv[idx]);
+			}
+		}
+		globfree(&result);
+	}
+
+	return arrPorts;
+}
+
+
+bool SerialPort::exists() const
+{
+	return (access(m_strFileName.c_str(), F_OK) == 0);
+}
+
+
+bool SerialPort::open()
+{
+	if (!isOpen())
+	{
+		// non-blocking: timeouts are handled with poll()
+		m_fdPort = ::open(m_strFileName.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+		if (m_fdPort < 0)
+		{
+			handleError("opening serial port");
+			m_fdPort = -1;
+		}
+		else
+		{
+			// raw 8N1 without any line processing
+			struct termios tio;
+			if (tcgetattr(m_fdPort, &tio) == 0)
+			{
+				cfmakeraw(&tio);
+				tio.c_cflag |= (CLOCAL | CREAD);
+				tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+				tio.c_cc[VMIN]  = 0;
+				tio.c_cc[VTIME] = 0;
+				if (tcsetattr(m_fdPort, TCSANOW, &tio) != 0)
+				{
+					handleError("setting serial port state");
+				}
+			}
+			else
+			{
+				handleError("getting serial port state");
+			}
+		}
+	}
+
+	return isOpen();
+}
+
+
+bool SerialPort::isOpen() const
+{
+	return (m_fdPort >= 0);
+}
+
+
+bool SerialPort::close()
+{
+	if (isOpen())
+	{
+		if (::close(m_fdPort) == 0)
+		{
+			m_fdPort = -1;
+		}
+		else
+		{
+			handleError("closing serial port");
+		}
+	}
+	return !isOpen();
+}
+
+
+bool SerialPort::setBaudrate(DWORD baudRate)
+{
+	bool success = false;
+
+	if (isOpen())
+	{
+		speed_t speed;
+		switch (baudRate)
+		{
+			case   9600: speed =   B9600; break;
+			case  19200: speed =  B19200; break;
+			case  38400: speed =  B38400; break;
+			case  57600: speed =  B57600; break;
+			case 115200: speed = B115200; break;
+			case 230400: speed = B230400; break;
+			default:
+				LOG_ERROR("Unsupported baudrate " << baudRate);
+				return false;
+		}
+
+		struct termios tio;
+		if ((tcgetattr(m_fdPort, &tio) == 0) &&
+		    (cfsetispeed(&tio, speed) == 0) && (cfsetospeed(&tio, speed) == 0) &&
+		    (tcsetattr(m_fdPort, TCSANOW, &tio) == 0))
+		{
+			success = true;
+		}
+		else
+		{
+			handleError("setting serial port state");
+		}
+	}
+
+	return success;
+}
+
+
+DWORD SerialPort::getTimeout() const
+{
+	return isOpen() ? m_timeout : 0;
+}
+
+
+bool SerialPort::setTimeout(DWORD timeout)
+{
+	bool success = false;
+	if (isOpen())
+	{
+		m_timeout = timeout;
+		success   = true;
+	}
+	return success;
+}
+
+
+DWORD SerialPort::send(const void* pBuffer, DWORD nBytesToSend) const
+{
+	const uint8_t* pData = (const uint8_t*) pBuffer;
+	DWORD nBytesSent = 0;
+	while (nBytesSent < nBytesToSend)
+	{
+		ssize_t written = ::write(m_fdPort, pData + nBytesSent, nBytesToSend - nBytesSent);
+		if (written > 0)
+		{
+			nBytesSent += (DWORD) written;
+		}
+		else if ((written < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+		{
+			// output buffer full > wait until there is space again
+			struct pollfd pfd = { m_fdPort, POLLOUT, 0 };
+			if (poll(&pfd, 1, (int) m_timeout) <= 0) break;
+		}
+		else
+		{
+			handleError("sending data");
+			break;
+		}
+	}
+	return nBytesSent;
+}
+
+
+DWORD SerialPort::receive(void* pBuffer, DWORD nBytesToReceive) const
+{
+	DWORD nBytesReceived = 0;
+
+	// wait for data to arrive, then read whatever is there
+	struct pollfd pfd = { m_fdPort, POLLIN, 0 };
+	int ready;
+	do
+	{
+		ready = poll(&pfd, 1, (int) m_timeout);
+	} while ((ready < 0) && (errno == EINTR));
+
+	if ((ready > 0) && (pfd.revents & POLLIN))
+	{
+		ssize_t received = ::read(m_fdPort, pBuffer, nBytesToReceive);
+		if (received > 0)
+		{
+			nBytesReceived = (DWORD) received;
+		}
+		else if ((received < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK))
+		{
+			handleError("receiving data");
+		}
+	}
+	return nBytesReceived;
+}
+
+
+SerialPort::~SerialPort()
+{
+	if (isOpen())
+	{
+		close();
+	}
+}
+
+
+void SerialPort::handleError(const char* strFunction) const
+{
+	LOG_ERROR("Error while " << strFunction << " (" << m_strPortName << "): " << strerror(errno));
+}
+
+#endif // #ifndef _WIN32
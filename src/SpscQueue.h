@@ -0,0 +1,72 @@
+/**
+ * Fixed size lock-free queue for passing values from exactly one producer thread
+ * to exactly one consumer thread. Neither side ever blocks:
+ * when the queue is full, new values are rejected.
+ * The capacity needs to be a power of 2.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+
+template<typename T, size_t N> class SpscQueue
+{
+	static_assert((N > 1) && ((N & (N - 1)) == 0), "SpscQueue capacity needs to be a power of 2");
+
+public:
+
+	SpscQueue() :
+		m_head(0),
+		m_tail(0)
+	{
+		// nothing else to do
+	}
+
+	/**
+	 * Adds a value to the queue. Must only be called from the producer thread.
+	 *
+	 * @param refValue  the value to add
+	 *
+	 * @return <code>true</code> if the value was added,
+	 *         <code>false</code> if the queue was full
+	 */
+	bool push(const T& refValue)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) >= N)
+		{
+			return false;
+		}
+		m_arrValues[tail & (N - 1)] = refValue;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Removes the oldest value from the queue. Must only be called from the consumer thread.
+	 *
+	 * @param refValue  the variable to move the value into
+	 *
+	 * @return <code>true</code> if there was a value,
+	 *         <code>false</code> if the queue was empty
+	 */
+	bool pop(T& refValue)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		refValue = m_arrValues[head & (N - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+
+	T                   m_arrValues[N];
+	std::atomic<size_t> m_head; // next value to pop (written by the consumer)
+	std::atomic<size_t> m_tail; // next free slot    (written by the producer)
+};
@@ -0,0 +1,277 @@
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "TraceRecorder"
+
+
+#define TRACE_PROCESS_ID 1
+
+
+static_assert((TraceRecorder::EVENTS_PER_THREAD & (TraceRecorder::EVENTS_PER_THREAD - 1)) == 0, "EVENTS_PER_THREAD needs to be a power of 2");
+
+
+std::atomic<bool> TraceRecorder::s_enabled(false);
+
+
+/**
+ * A recorded section.
+ * The fields are atomic so that the events can be read while the thread overwrites them,
+ * relaxed atomic stores are plain stores on the target platforms.
+ */
+struct sTraceEvent
+{
+	std::atomic<const char*> name;
+	std::atomic<int64_t>     start;
+	std::atomic<int64_t>     end;
+};
+
+
+/**
+ * Ring buffer of the events of one thread. Only written by that thread.
+ */
+struct sTraceBuffer
+{
+	int                      threadID;
+	std::atomic<const char*> threadName;
+	std::atomic<uint64_t>    count;   // amount of events recorded so far
+	sTraceEvent              events[TraceRecorder::EVENTS_PER_THREAD];
+};
+
+
+/**
+ * Copy of an event for writing the trace.
+ */
+struct sTraceEventCopy
+{
+	const char* name;
+	int64_t     start;
+	int64_t     end;
+};
+
+
+/**
+ * Recording state of a thread.
+ */
+struct sThreadState
+{
+	sTraceBuffer* pBuffer;
+	const char*   strName;
+	bool          unregistered; // no buffer left for this thread
+};
+
+
+// buffers of all threads that have recorded something
+// (never deleted, so the events of finished threads can still be written)
+static std::atomic<sTraceBuffer*> arrBuffers[TraceRecorder::MAX_THREADS];
+static std::atomic<size_t>        bufferCount(0);
+
+static thread_local sThreadState threadState = { NULL, NULL, false };
+
+
+/**
+ * Creates the buffer of the calling thread.
+ *
+ * @return the buffer or <code>NULL</code> if all buffers are taken
+ */
+static sTraceBuffer* registerThread()
+{
+	size_t idx = bufferCount.fetch_add(1);
+	if (idx >= TraceRecorder::MAX_THREADS)
+	{
+		if (idx == TraceRecorder::MAX_THREADS)
+		{
+			LOG_WARNING("More than " << TraceRecorder::MAX_THREADS << " threads, further threads are not recorded");
+		}
+		threadState.unregistered = true;
+		return NULL;
+	}
+
+	sTraceBuffer* pBuffer = new sTraceBuffer;
+	pBuffer->threadID = (int) idx + 1;
+	pBuffer->threadName.store(threadState.strName, std::memory_order_relaxed);
+	pBuffer->count.store(0, std::memory_order_relaxed);
+	for (sTraceEvent& refEvent : pBuffer->events)
+	{
+		refEvent.name.store(NULL, std::memory_order_relaxed);
+		refEvent.start.store(0, std::memory_order_relaxed);
+		refEvent.end.store(0, std::memory_order_relaxed);
+	}
+	arrBuffers[idx].store(pBuffer, std::memory_order_release);
+
+	threadState.pBuffer = pBuffer;
+	return pBuffer;
+}
+
+
+/**
+ * Copies the events of a thread that are not being overwritten.
+ *
+ * @param refBuffer  the buffer of the thread
+ * @param arrEvents  the list to add the events to
+ */
+static void copyEvents(const sTraceBuffer& refBuffer, std::vector<sTraceEventCopy>& arrEvents)
+{
+	const uint64_t capacity = TraceRecorder::EVENTS_PER_THREAD;
+
+	uint64_t end   = refBuffer.count.load(std::memory_order_acquire);
+	uint64_t begin = (end > capacity) ? (end - capacity) : 0;
+	size_t   first = arrEvents.size();
+	for (uint64_t idx = begin; idx < end; idx++)
+	{
+		const sTraceEvent& refEvent = refBuffer.events[idx & (capacity - 1)];
+		sTraceEventCopy event;
+		event.name  = refEvent.name.load(std::memory_order_relaxed);
+		event.start = refEvent.start.load(std::memory_order_relaxed);
+		event.end   = refEvent.end.load(std::memory_order_relaxed);
+		arrEvents.push_back(event);
+	}
+
+	// the thread might have overwritten the oldest events meanwhile:
+	// with count at N, events up to N - capacity are overwritten (or being overwritten)
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t current = refBuffer.count.load(std::memory_order_relaxed);
+	if (current >= begin + capacity)
+	{
+		size_t invalid = (size_t) std::min(current - capacity + 1 - begin, end - begin);
+		arrEvents.erase(arrEvents.begin() + first, arrEvents.begin() + first + invalid);
+	}
+}
+
+
+/**
+ * Writes a string literal as JSON string.
+ */
+static void writeJsonString(std::ostream& refOutput, const char* strText)
+{
+	refOutput << '"';
+	for (const char* pChar = strText; *pChar != '\0'; pChar++)
+	{
+		if ((*pChar == '"') || (*pChar == '\\'))
+		{
+			refOutput << '\\';
+		}
+		refOutput << *pChar;
+	}
+	refOutput << '"';
+}
+
+
+void TraceRecorder::setEnabled(bool enabled)
+{
+	s_enabled.store(enabled);
+}
+
+
+void TraceRecorder::setThreadName(const char* strName)
+{
+	threadState.strName = strName;
+	if (threadState.pBuffer != NULL)
+	{
+		threadState.pBuffer->threadName.store(strName, std::memory_order_relaxed);
+	}
+}
+
+
+int64_t TraceRecorder::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void TraceRecorder::record(const char* strName, int64_t start, int64_t end)
+{
+	sTraceBuffer* pBuffer = threadState.pBuffer;
+	if (pBuffer == NULL)
+	{
+		if (threadState.unregistered) return;
+		pBuffer = registerThread();
+		if (pBuffer == NULL) return;
+	}
+
+	// only this thread writes the count
+	uint64_t     idx      = pBuffer->count.load(std::memory_order_relaxed);
+	sTraceEvent& refEvent = pBuffer->events[idx & (EVENTS_PER_THREAD - 1)];
+	// a reader that sees any of the following stores also sees the count of the previous event
+	std::atomic_thread_fence(std::memory_order_release);
+	refEvent.name.store(strName, std::memory_order_relaxed);
+	refEvent.start.store(start, std::memory_order_relaxed);
+	refEvent.end.store(end, std::memory_order_relaxed);
+	pBuffer->count.store(idx + 1, std::memory_order_release);
+}
+
+
+bool TraceRecorder::writeChromeTrace(const std::string& strFilename, size_t& refEventCount)
+{
+	refEventCount = 0;
+
+	std::ofstream output(strFilename.c_str());
+	if (!output.is_open())
+	{
+		return false;
+	}
+
+	// collect the events of all threads
+	std::vector<const sTraceBuffer*>          arrThreads;
+	std::vector<std::vector<sTraceEventCopy>> arrThreadEvents;
+	size_t count = bufferCount.load();
+	if (count > MAX_THREADS) count = MAX_THREADS;
+	for (size_t idx = 0; idx < count; idx++)
+	{
+		const sTraceBuffer* pBuffer = arrBuffers[idx].load(std::memory_order_acquire);
+		if (pBuffer == NULL) continue; // thread is just registering
+
+		arrThreads.push_back(pBuffer);
+		arrThreadEvents.push_back(std::vector<sTraceEventCopy>());
+		copyEvents(*pBuffer, arrThreadEvents.back());
+	}
+
+	// timestamps relative to the oldest event
+	int64_t origin = INT64_MAX;
+	for (auto& arrEvents : arrThreadEvents)
+	{
+		for (auto& event : arrEvents)
+		{
+			origin = std::min(origin, event.start);
+		}
+	}
+
+	output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::endl;
+	bool first = true;
+	for (size_t tIdx = 0; tIdx < arrThreads.size(); tIdx++)
+	{
+		const sTraceBuffer& refThread = *arrThreads[tIdx];
+		const char* strThreadName = refThread.threadName.load(std::memory_order_relaxed);
+		if (strThreadName != NULL)
+		{
+			output << (first ? "" : ",\n")
+				<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << TRACE_PROCESS_ID
+				<< ",\"tid\":" << refThread.threadID << ",\"args\":{\"name\":";
+			writeJsonString(output, strThreadName);
+			output << "}}";
+			first = false;
+		}
+
+		output << std::fixed << std::setprecision(3);
+		for (auto& event : arrThreadEvents[tIdx])
+		{
+			output << (first ? "" : ",\n") << "{\"name\":";
+			writeJsonString(output, event.name);
+			output
+				<< ",\"ph\":\"X\",\"pid\":" << TRACE_PROCESS_ID << ",\"tid\":" << refThread.threadID
+				<< ",\"ts\":"  << ((event.start - origin) / 1000.0)
+				<< ",\"dur\":" << ((event.end - event.start) / 1000.0) << "}";
+			first = false;
+		}
+		refEventCount += arrThreadEvents[tIdx].size();
+	}
+	output << std::endl << "]}" << std::endl;
+
+	return output.good();
+}
@@ -0,0 +1,129 @@
+/**
+ * Recorder for timed sections of the hot paths (e.g., waiting for and holding a mutex),
+ * to analyse how the streaming, Cortex callback, interaction receiver and NatNet request threads interleave.
+ *
+ * Every thread records into its own ring buffer, so recording a section never locks:
+ * it takes two clock readings and a few stores. When a buffer is full, its oldest events are overwritten.
+ * The events of all threads can be written as Chrome trace_event JSON,
+ * which can be viewed in chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Recording is disabled by default, then a TRACE_SCOPE only checks a flag.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+
+class TraceRecorder
+{
+public:
+
+	static const size_t EVENTS_PER_THREAD = 16384; // needs to be a power of 2
+	static const size_t MAX_THREADS       = 32;    // threads beyond this are not recorded
+
+public:
+
+	/**
+	 * Checks if sections are being recorded.
+	 *
+	 * @return <code>true</code> if sections are recorded
+	 */
+	static bool isEnabled()
+	{
+		return s_enabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Starts or stops recording sections.
+	 * Events that were recorded before are kept.
+	 *
+	 * @param enabled  <code>true</code> to start recording, <code>false</code> to stop
+	 */
+	static void setEnabled(bool enabled);
+
+	/**
+	 * Sets the name of the calling thread in the trace.
+	 * Can be called repeatedly, e.g., at the beginning of a callback from a foreign thread.
+	 *
+	 * @param strName  the name of the thread (string literal)
+	 */
+	static void setThreadName(const char* strName);
+
+	/**
+	 * Gets the current time of the trace clock.
+	 *
+	 * @return the time in nanoseconds (steady clock)
+	 */
+	static int64_t now();
+
+	/**
+	 * Records a section of the calling thread.
+	 *
+	 * @param strName  the name of the section (string literal)
+	 * @param start    the start time of the section (from now())
+	 * @param end      the end time of the section (from now())
+	 */
+	static void record(const char* strName, int64_t start, int64_t end);
+
+	/**
+	 * Writes the recorded events of all threads into a Chrome trace_event JSON file.
+	 * Threads can keep recording while the events are written.
+	 *
+	 * @param strFilename    the name of the file to write
+	 * @param refEventCount  the variable to store the amount of written events in
+	 *
+	 * @return <code>true</code> if the file was written
+	 */
+	static bool writeChromeTrace(const std::string& strFilename, size_t& refEventCount);
+
+private:
+
+	static std::atomic<bool> s_enabled;
+};
+
+
+
+/**
+ * Records the time between its construction and destruction as a section.
+ * Use through the TRACE_SCOPE macro.
+ */
+class TraceScope
+{
+public:
+
+	explicit TraceScope(const char* strName) :
+		m_strName(strName),
+		m_start(TraceRecorder::isEnabled() ? TraceRecorder::now() : -1)
+	{
+		// nothing else to do
+	}
+
+	~TraceScope()
+	{
+		if (m_start >= 0)
+		{
+			TraceRecorder::record(m_strName, m_start, TraceRecorder::now());
+		}
+	}
+
+private:
+
+	TraceScope(const TraceScope&);
+	TraceScope& operator=(const TraceScope&);
+
+private:
+
+	const char* m_strName;
+	int64_t     m_start;
+};
+
+
+#define TRACE_SCOPE_NAME2(line) traceScope##line
+#define TRACE_SCOPE_NAME(line)  TRACE_SCOPE_NAME2(line)
+
+// records the rest of the enclosing block as a section (name needs to be a string literal)
+#define TRACE_SCOPE(name) TraceScope TRACE_SCOPE_NAME(__LINE__)(name)
@@ -0,0 +1,241 @@
+#include "UnknownMarkerFilter.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+#define DEFAULT_MARKER_LIMIT 1000 // default maximum amount of unknown markers per frame
+
+// voxel coordinates have 21 bits per axis, offset to keep negative coordinates apart
+#define VOXEL_BITS       21
+#define VOXEL_OFFSET     (1 << (VOXEL_BITS - 1))
+#define VOXEL_MAX        ((1 << VOXEL_BITS) - 1)
+#define EMPTY_VOXEL_KEY  UINT64_MAX // 3 * 21 bits never reach this
+
+
+UnknownMarkerFilter::UnknownMarkerFilter() :
+	voxelSize(0),
+	markerLimit(DEFAULT_MARKER_LIMIT)
+{
+	centre[0] = centre[1] = centre[2] = 0;
+	resetStatistics();
+}
+
+
+void UnknownMarkerFilter::setVoxelSize(float voxelSize)
+{
+	this->voxelSize = std::max(0.0f, voxelSize);
+}
+
+
+float UnknownMarkerFilter::getVoxelSize() const
+{
+	return voxelSize;
+}
+
+
+void UnknownMarkerFilter::setMarkerLimit(int maxMarkers)
+{
+	markerLimit = std::max(0, maxMarkers);
+}
+
+
+int UnknownMarkerFilter::getMarkerLimit() const
+{
+	return markerLimit;
+}
+
+
+void UnknownMarkerFilter::setPriorityCentre(float x, float y, float z)
+{
+	centre[0] = x;
+	centre[1] = y;
+	centre[2] = z;
+}
+
+
+void UnknownMarkerFilter::beginFrame()
+{
+	// buffers keep their capacity > no allocations once the largest frame has been seen
+	arrInput.clear();
+	arrOutput.clear();
+}
+
+
+void UnknownMarkerFilter::addMarker(const MarkerData& refMarker)
+{
+	arrInput.insert(arrInput.end(), refMarker, refMarker + 3);
+}
+
+
+void UnknownMarkerFilter::addInvalidMarker()
+{
+	markersInvalid++;
+}
+
+
+int UnknownMarkerFilter::process()
+{
+	int count = (int) (arrInput.size() / 3);
+	frames++;
+	markersIn   += count;
+	maxMarkersIn = std::max(maxMarkersIn, count);
+
+	if (voxelSize > 0)
+	{
+		deduplicate();
+	}
+	else
+	{
+		arrOutput.swap(arrInput);
+	}
+
+	if (getMarkerCount() > markerLimit)
+	{
+		limit();
+	}
+
+	markersOut += getMarkerCount();
+	return getMarkerCount();
+}
+
+
+const MarkerData* UnknownMarkerFilter::getMarkers() const
+{
+	return (const MarkerData*) arrOutput.data();
+}
+
+
+int UnknownMarkerFilter::getMarkerCount() const
+{
+	return (int) (arrOutput.size() / 3);
+}
+
+
+void UnknownMarkerFilter::printStatistics(std::ostream& refOutput) const
+{
+	refOutput << "Unknown Marker Statistics" << std::endl
+		<< "\tVoxel size:      " << voxelSize << (voxelSize > 0 ? "" : " (no deduplication)") << std::endl
+		<< "\tMarker limit:    " << markerLimit << std::endl
+		<< "\tFrames:          " << frames << std::endl
+		<< "\tMarkers in:      " << markersIn << " (max. " << maxMarkersIn << " per frame)" << std::endl
+		<< "\tMarkers invalid: " << markersInvalid << std::endl
+		<< "\tMarkers merged:  " << markersMerged << std::endl
+		<< "\tMarkers dropped: " << markersDropped << std::endl
+		<< "\tMarkers out:     " << markersOut << std::endl;
+}
+
+
+void UnknownMarkerFilter::resetStatistics()
+{
+	frames         = 0;
+	markersIn      = 0;
+	markersInvalid = 0;
+	markersMerged  = 0;
+	markersDropped = 0;
+	markersOut     = 0;
+	maxMarkersIn   = 0;
+}
+
+
+void UnknownMarkerFilter::deduplicate()
+{
+	arrVoxels.clear();
+
+	// hash table at most half full, the buffers keep their capacity between frames
+	size_t count = arrInput.size() / 3;
+	int    bits  = 4;
+	while (((size_t) 1 << bits) < count * 2) bits++;
+	size_t tableSize = (size_t) 1 << bits;
+	size_t tableMask = tableSize - 1;
+	arrVoxelKeys.assign(tableSize, EMPTY_VOXEL_KEY);
+	arrVoxelIndex.resize(tableSize);
+
+	float scale = 1.0f / voxelSize;
+	for (size_t mIdx = 0; mIdx < count; mIdx++)
+	{
+		const float* pMarker = &arrInput[mIdx * 3];
+
+		uint64_t key     = 0;
+		bool     inRange = true;
+		for (int axis = 0; (axis < 3) && inRange; axis++)
+		{
+			float cell = std::floor(pMarker[axis] * scale) + VOXEL_OFFSET;
+			// coordinates beyond the grid (or NaN) would wrap into another voxel
+			inRange = (cell >= 0) && (cell <= VOXEL_MAX);
+			key = (key << VOXEL_BITS) | (inRange ? (uint64_t) cell : 0);
+		}
+
+		size_t slot = tableSize;
+		if (inRange)
+		{
+			// linear probing
+			slot = (size_t) ((key * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+			while ((arrVoxelKeys[slot] != EMPTY_VOXEL_KEY) && (arrVoxelKeys[slot] != key))
+			{
+				slot = (slot + 1) & tableMask;
+			}
+		}
+
+		if ((slot < tableSize) && (arrVoxelKeys[slot] == key))
+		{
+			float* pVoxel = &arrVoxels[arrVoxelIndex[slot] * 4];
+			pVoxel[0] += pMarker[0];
+			pVoxel[1] += pMarker[1];
+			pVoxel[2] += pMarker[2];
+			pVoxel[3] += 1.0f;
+			markersMerged++;
+		}
+		else
+		{
+			// new voxel (markers outside of the grid are never merged)
+			if (slot < tableSize)
+			{
+				arrVoxelKeys[slot]  = key;
+				arrVoxelIndex[slot] = (int) (arrVoxels.size() / 4);
+			}
+			arrVoxels.insert(arrVoxels.end(), { pMarker[0], pMarker[1], pMarker[2], 1.0f });
+		}
+	}
+
+	// merged markers are at the average position of their voxel
+	size_t nVoxels = arrVoxels.size() / 4;
+	arrOutput.resize(nVoxels * 3);
+	for (size_t vIdx = 0; vIdx < nVoxels; vIdx++)
+	{
+		const float* pVoxel = &arrVoxels[vIdx * 4];
+		arrOutput[vIdx * 3 + 0] = pVoxel[0] / pVoxel[3];
+		arrOutput[vIdx * 3 + 1] = pVoxel[1] / pVoxel[3];
+		arrOutput[vIdx * 3 + 2] = pVoxel[2] / pVoxel[3];
+	}
+}
+
+
+void UnknownMarkerFilter::limit()
+{
+	// keep the markers closest to the centre of the volume
+	int count = getMarkerCount();
+	arrPriority.resize(count);
+	for (int mIdx = 0; mIdx < count; mIdx++)
+	{
+		const float* pMarker = &arrOutput[mIdx * 3];
+		float dx = pMarker[0] - centre[0];
+		float dy = pMarker[1] - centre[1];
+		float dz = pMarker[2] - centre[2];
+		arrPriority[mIdx] = std::make_pair(dx * dx + dy * dy + dz * dz, mIdx);
+	}
+	std::nth_element(arrPriority.begin(), arrPriority.begin() + markerLimit, arrPriority.end());
+
+	// keep original order of the remaining markers
+	std::sort(arrPriority.begin(), arrPriority.begin() + markerLimit,
+		[](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.second < b.second; });
+
+	// compact in place: indices are ascending, so no marker is overwritten before it is read
+	for (int mIdx = 0; mIdx < markerLimit; mIdx++)
+	{
+		int srcIdx = arrPriority[mIdx].second;
+		std::copy(&arrOutput[srcIdx * 3], &arrOutput[srcIdx * 3] + 3, &arrOutput[mIdx * 3]);
+	}
+	arrOutput.resize(markerLimit * 3);
+	markersDropped += count - markerLimit;
+}
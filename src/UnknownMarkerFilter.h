@@ -0,0 +1,141 @@
+/**
+ * Class for filtering unidentified markers before they are streamed:
+ * removal of near-duplicate markers on a voxel grid and limiting the amount of markers per frame.
+ */
+
+#pragma once
+
+#include "NatNetTypes.h"
+
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+
+class UnknownMarkerFilter
+{
+public:
+
+	/**
+	 * Creates an unknown marker filter without deduplication and the default marker limit.
+	 */
+	UnknownMarkerFilter();
+
+	/**
+	 * Sets the size of the voxels for merging near-duplicate markers.
+	 * All markers within the same voxel are merged into one marker at their average position.
+	 *
+	 * @param voxelSize  the edge length of a voxel in units (0: no deduplication)
+	 */
+	void setVoxelSize(float voxelSize);
+
+	/**
+	 * Gets the size of the voxels for merging near-duplicate markers.
+	 *
+	 * @return the edge length of a voxel in units (0: no deduplication)
+	 */
+	float getVoxelSize() const;
+
+	/**
+	 * Sets the maximum amount of markers per frame.
+	 * When there are more markers, the ones closest to the priority centre are kept.
+	 *
+	 * @param maxMarkers  the maximum amount of markers
+	 */
+	void setMarkerLimit(int maxMarkers);
+
+	/**
+	 * Gets the maximum amount of markers per frame.
+	 *
+	 * @return the maximum amount of markers
+	 */
+	int getMarkerLimit() const;
+
+	/**
+	 * Sets the centre of the capture volume.
+	 * Markers close to the centre have priority over markers far away when the marker limit is reached.
+	 *
+	 * @param x  X coordinate of the centre
+	 * @param y  Y coordinate of the centre
+	 * @param z  Z coordinate of the centre
+	 */
+	void setPriorityCentre(float x, float y, float z);
+
+	/**
+	 * Starts a new frame and clears the input.
+	 */
+	void beginFrame();
+
+	/**
+	 * Adds a marker to the input of the current frame.
+	 *
+	 * @param refMarker  the marker to add
+	 */
+	void addMarker(const MarkerData& refMarker);
+
+	/**
+	 * Counts a marker that was not added because it is invalid (e.g., vanished).
+	 */
+	void addInvalidMarker();
+
+	/**
+	 * Filters the markers of the current frame.
+	 *
+	 * @return the amount of markers after filtering
+	 */
+	int process();
+
+	/**
+	 * Gets the filtered markers of the current frame.
+	 * The array is valid until the next call to beginFrame().
+	 *
+	 * @return the filtered markers
+	 */
+	const MarkerData* getMarkers() const;
+
+	/**
+	 * Gets the amount of filtered markers of the current frame.
+	 *
+	 * @return the amount of filtered markers
+	 */
+	int getMarkerCount() const;
+
+	/**
+	 * Prints the filter settings and counters into an output stream.
+	 *
+	 * @param refOutput  the stream to print to
+	 */
+	void printStatistics(std::ostream& refOutput) const;
+
+	/**
+	 * Resets the counters.
+	 */
+	void resetStatistics();
+
+private:
+
+	void deduplicate();
+	void limit();
+
+private:
+
+	float                        voxelSize;
+	int                          markerLimit;
+	float                        centre[3];
+
+	std::vector<float>           arrInput;    // 3 floats per marker
+	std::vector<float>           arrOutput;   // 3 floats per marker
+	std::vector<float>           arrVoxels;   // sum of X, Y, Z and count per voxel
+	std::vector<uint64_t>        arrVoxelKeys;  // open addressing table of voxel keys, reused between frames
+	std::vector<int>             arrVoxelIndex; // index in voxel array per table entry
+	std::vector<std::pair<float, int>> arrPriority; // distance, marker index
+
+	// statistics
+	uint64_t                     frames;
+	uint64_t                     markersIn;
+	uint64_t                     markersInvalid;
+	uint64_t                     markersMerged;
+	uint64_t                     markersDropped;
+	uint64_t                     markersOut;
+	int                          maxMarkersIn;
+};
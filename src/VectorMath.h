@@ -60,6 +60,38 @@ public:
 		this->w = cosf(angle / 2);
 	}
 
+	/**
+	 * Sets the quaternion to the shortest rotation that turns one direction into another.
+	 * The directions don't need to be normalised.
+	 */
+	void fromVectors(const Vector3D& from, const Vector3D& to)
+	{
+		float lenFrom = sqrtf(from.x*from.x + from.y*from.y + from.z*from.z);
+		float lenTo   = sqrtf(to.x*to.x + to.y*to.y + to.z*to.z);
+		if (lenFrom <= 0 || lenTo <= 0)
+		{
+			x = y = z = 0; w = 1;
+			return;
+		}
+		float dot = (from.x*to.x + from.y*to.y + from.z*to.z) / (lenFrom * lenTo);
+		if (dot < -0.999999f)
+		{
+			// opposite directions: rotate by 180 degrees around any perpendicular axis
+			float ax = 0, ay = -from.z, az = from.y;
+			if (ay * ay + az * az < 1e-12f) { ax = from.z; ay = 0; az = -from.x; }
+			float len = sqrtf(ax*ax + ay*ay + az*az);
+			x = ax / len; y = ay / len; z = az / len; w = 0;
+			return;
+		}
+		// half-way quaternion: (cross, 1 + dot) normalised
+		float cx = (from.y*to.z - from.z*to.y) / (lenFrom * lenTo);
+		float cy = (from.z*to.x - from.x*to.z) / (lenFrom * lenTo);
+		float cz = (from.x*to.y - from.y*to.x) / (lenFrom * lenTo);
+		float cw = 1 + dot;
+		float len = sqrtf(cx*cx + cy*cy + cz*cz + cw*cw);
+		x = cx / len; y = cy / len; z = cz / len; w = cw / len;
+	}
+
 	Quaternion& mult(const Quaternion& q)
 	{
 		float _w = q.w*w - q.x*x - q.y*y - q.z*z;
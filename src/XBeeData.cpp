@@ -11,7 +11,7 @@ uint8_t* XBeeReadBuffer::prepareBuffer(uint16_t length)
 	m_read = m_buffer.cbegin();
 
 	// reconstruct the header
-	m_buffer.push_back(XBeePacket::START_DELIMITER);
+	m_buffer.push_back((uint8_t) XBeePacket::START_DELIMITER); // by value, the constant has no definition to reference
 	m_buffer.push_back((uint8_t) ((length >> 8) & 0xFF));
 	m_buffer.push_back((uint8_t) ((length     ) & 0xFF));
 
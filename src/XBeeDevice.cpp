@@ -71,7 +71,9 @@ XBeeCoordinator::XBeeCoordinator(SerialPort& refPort) :
 	XBeeDevice(),
 	m_serialPort(refPort),
 	m_frameCounter(1),
-	m_numOfRetries(3)
+	m_numOfRetries(3),
+	m_skippedBytes(0),
+	m_discoveryTimeout(6000)
 {
 	// prepare serial port
 	if (!m_serialPort.isOpen())
@@ -90,6 +92,11 @@ XBeeCoordinator::XBeeCoordinator(SerialPort& refPort) :
 	{
 		m_serialNumber = ((uint64_t)response.getInt32()) << 32;
 	}
+	else
+	{
+		// no answer > not a coordinator, don't wait for the timeouts of the other commands
+		return;
+	}
 	// ...and low
 	command.setCommand("SL");
 	if (process(command, response))
@@ -124,14 +131,18 @@ XBeeCoordinator::XBeeCoordinator(SerialPort& refPort) :
 	{
 		m_versionHW = response.getInt16();
 	}
+
+	// read discovery timeout (in 100ms)
+	command.setCommand("NT");
+	if (process(command, response))
+	{
+		m_discoveryTimeout = response.getInt16() * 100;
+	}
 }
 
 
 XBeeCoordinator::~XBeeCoordinator()
 {
-	// clean up the list of nodes
-	m_arrNodes.clear();
-
 	// no need to hug the serial port any longer
 	m_serialPort.close();
 }
@@ -181,36 +192,37 @@ bool XBeeCoordinator::send(XBeePacket_Send& refPacket)
 }
 
 
-std::unique_ptr<XBeePacket_Receive> XBeeCoordinator::receive()
+const XBeePacket_Receive* XBeeCoordinator::receive()
 {
-	// create corresponding packet class instance
-	std::unique_ptr<XBeePacket_Receive> pPacket = NULL;
+	// fill the reused instance of the corresponding packet class
+	XBeePacket_Receive* pPacket = NULL;
 
 	if (receivePacket())
 	{
-		// create specific packet subclass
 		auto frameTypeID = m_bufIn.getByteAt(3);
 		switch (frameTypeID)
 		{
 		case XBeePacket_AT_CommandResponse::FRAME_TYPE_ID:
-			pPacket = std::make_unique<XBeePacket_AT_CommandResponse>();
-			pPacket->unmarshal(m_bufIn);
+			pPacket = &m_rcvATResponse;
 			break;
 
 		case XBeePacket_RemoteAT_CommandResponse::FRAME_TYPE_ID:
-			pPacket = std::make_unique<XBeePacket_RemoteAT_CommandResponse>();
-			pPacket->unmarshal(m_bufIn);
+			pPacket = &m_rcvRemoteATResponse;
 			break;
 
 		case XBeePacket_IO_DataSample::FRAME_TYPE_ID:
-			pPacket = std::make_unique<XBeePacket_IO_DataSample>();
-			pPacket->unmarshal(m_bufIn);
+			pPacket = &m_rcvIODataSample;
 			break;
 
 		default:
 			LOG_ERROR("Unhandled frame type 0x" << std::hex << (int)frameTypeID);
 			break;
 		}
+
+		if (pPacket && !pPacket->unmarshal(m_bufIn))
+		{
+			pPacket = NULL;
+		}
 	}
 
 	return pPacket;
@@ -281,93 +293,49 @@ bool XBeeCoordinator::process(XBeePacket_Send& refSend, XBeePacket_Receive& refR
 
 void XBeeCoordinator::setNumberOfRetries(int retries)
 {
-	m_numOfRetries = max(1, retries);
+	m_numOfRetries = (retries > 1) ? retries : 1;
 }
 
 
-int XBeeCoordinator::scanDevices()
+bool XBeeCoordinator::startDiscovery()
 {
-	m_arrNodes.clear();
-	DWORD oldTimeout = m_serialPort.getTimeout();
-
-	XBeePacket_AT_Command         command("NT"); // read discovery timeout
-	XBeePacket_AT_CommandResponse response;
-	if (process(command, response))
-	{
-		// returned discovery timeout in in 100mx
-		m_serialPort.setTimeout(response.getInt16() * 100);
-	}
-
-	// start discovery
-	command.setCommand("ND");
-	if (process(command, response))
-	{
-		// parse discovery results
-		m_arrNodes.push_back(
-			std::unique_ptr<XBeeRemoteDevice>(
-				new XBeeRemoteDevice(*this, response.getRawData())));
-	}
-
-	m_serialPort.setTimeout(oldTimeout);
-
-	return (int) m_arrNodes.size();
+	// the answers are received by whoever is reading packets
+	XBeePacket_AT_Command command("ND");
+	return send(command);
 }
 
 
-const std::vector<std::unique_ptr<XBeeRemoteDevice>>&  XBeeCoordinator::getConnectedDevices() const
+int XBeeCoordinator::getDiscoveryTimeout() const
 {
-	return m_arrNodes;
+	return m_discoveryTimeout;
 }
 
 
 bool XBeeCoordinator::receivePacket()
 {
-	uint8_t start = 0;
-	DWORD   rcvLen = 0;
-
-	// is there anything at all?
-	rcvLen = m_serialPort.receive(&start, 1);
-	if (rcvLen < 1)
-	{
-		return false; // nope > get out
-	}
-
-	// is the first byte correct?
-	if (start != XBeePacket::START_DELIMITER)
-	{
-		LOG_ERROR("Received response has invalid start delimiter (0x" << std::hex << (int)start << ")");
-		return false;
-	}
-
-	// receive the length
-	uint8_t len[2] = { 0, 0 };
-	if (m_serialPort.receive(len, 2) != 2)
+	// a complete frame may already be buffered from an earlier read
+	while (!m_decoder.nextFrame(m_bufIn))
 	{
-		LOG_ERROR("Response without data length");
-		return false;
+		// read whatever has arrived in one go
+		size_t   space  = 0;
+		uint8_t* pWrite = m_decoder.getWriteBuffer(space);
+		DWORD    rcvLen = m_serialPort.receive(pWrite, (DWORD) space);
+		if (rcvLen < 1)
+		{
+			return false; // nothing (more) received > get out
+		}
+		m_decoder.commit(rcvLen);
 	}
 
-	// what is the size of the data?
-	uint16_t dataLen = (((uint16_t)len[0]) << 8) | ((uint16_t)len[1]);
-	// prepare receive buffer: data length +4: +1x delimiter +2x length bytes
-	uint8_t* pBuffer = m_bufIn.prepareBuffer(dataLen);
-	// receive (+3: receive the rest, +1: also receive checksum)
-	rcvLen = m_serialPort.receive(pBuffer + 3, dataLen + 1);
-
 #ifdef LOG_DATA
-	printMemory(std::cout, m_bufIn.data(), rcvLen + 3);
+	printMemory(std::cout, m_bufIn.data(), m_bufIn.size());
 #endif
 
-	if (rcvLen != (dataLen + 1))
-	{
-		LOG_ERROR("Received packet incomplete (expected: " << dataLen << ", received " << rcvLen << ")");
-		return false;
-	}
-
-	if (m_bufIn.calculateChecksum() != 255)
+	// report noise once per frame instead of once per byte
+	if (m_decoder.getSkippedBytes() != m_skippedBytes)
 	{
-		LOG_ERROR("Invalid checksum");
-		return false;
+		LOG_WARNING("Skipped " << (m_decoder.getSkippedBytes() - m_skippedBytes) << " bytes of invalid data");
+		m_skippedBytes = m_decoder.getSkippedBytes();
 	}
 
 	return true;
@@ -381,7 +349,8 @@ bool XBeeCoordinator::receivePacket()
 
 XBeeRemoteDevice::XBeeRemoteDevice(XBeeCoordinator& refCoordinator, const XBeeReadBuffer& refBuffer) :
 	XBeeDevice(),
-	m_coordinator(refCoordinator)
+	m_coordinator(refCoordinator),
+	m_batteryVoltage(0)
 {
 	// Network discovery response (ND) comes in the following order:
 	m_networkAddress = refBuffer.getUInt16At(0);  // MY (network address)
@@ -392,18 +361,9 @@ XBeeRemoteDevice::XBeeRemoteDevice(XBeeCoordinator& refCoordinator, const XBeeRe
 	//	STATUS<CR>(1 Byte: Reserved)
 	//	PROFILE_ID<CR>(2 Bytes)
 	//	MANUFACTURER_ID<CR>(2 Bytes)
-
-	// read battery voltage
-	XBeePacket_RemoteAT_Command         command("%V");
-	XBeePacket_RemoteAT_CommandResponse response;
-	if (m_coordinator.process(command, response))
-	{
-		int voltageEncoded = response.getInt16();
-		// convert from 10 bit A/D value with 1.2V as reference to voltage
-		m_batteryVoltage = voltageEncoded / 1024.0f * 1.2f; 
-	}
 }
 
+
 uint16_t XBeeRemoteDevice::getParentAddress() const
 {
 	return m_parentAddress;
@@ -421,3 +381,34 @@ float XBeeRemoteDevice::getBatteryVoltage() const
 	return m_batteryVoltage;
 }
 
+
+void XBeeRemoteDevice::setNetworkAddress(uint16_t networkAddress)
+{
+	m_networkAddress = networkAddress;
+}
+
+
+bool XBeeRemoteDevice::requestBatteryVoltage()
+{
+	XBeePacket_RemoteAT_Command command("%V");
+	command.setSerialNumber(m_serialNumber);
+	command.setNetworkAddress(m_networkAddress);
+	return m_coordinator.send(command);
+}
+
+
+bool XBeeRemoteDevice::update(const XBeePacket_RemoteAT_CommandResponse& refResponse)
+{
+	if (refResponse.getSerialNumber() != m_serialNumber)
+	{
+		return false;
+	}
+
+	if ((refResponse.getCommand() == "%V") && refResponse.isOK())
+	{
+		int voltageEncoded = refResponse.getInt16();
+		// convert from 10 bit A/D value with 1.2V as reference to voltage
+		m_batteryVoltage = voltageEncoded / 1024.0f * 1.2f; 
+	}
+	return true;
+}
@@ -9,6 +9,7 @@
 
 #include "SerialPort.h"
 #include "XBeePacket.h"
+#include "XBeeFrameDecoder.h"
 
 
 // forward declarations
@@ -129,10 +130,12 @@ public:
 
 	/**
 	 * Receives an unspecific packet from an XBee device.
+	 * The packet instances are reused, so receiving does not allocate memory.
 	 *
 	 * @return received packet or <code>NULL</code> if an error occured
+	 *         (only valid until the next call)
 	 */
-	std::unique_ptr<XBeePacket_Receive> receive();
+	const XBeePacket_Receive* receive();
 
 	/**
 	 * Sends a packet to an XBee device and waits for the reply.
@@ -152,26 +155,29 @@ public:
 	void setNumberOfRetries(int retries);
 
 	/**
-	 * Scans for any other connected devices.
+	 * Starts a discovery of the other devices in the network without waiting for the answers.
+	 * Each device answers with an AT command response for "ND" within the discovery timeout,
+	 * which the caller receives like any other packet and passes to XBeeRemoteDevice.
 	 *
-	 * @return  number of connected devices found
+	 * @return <code>true</code> if the discovery command was sent
 	 */
-	int scanDevices();
+	bool startDiscovery();
 
 	/**
-	 * Gets the list of connected devices.
+	 * Gets the time within which devices answer a discovery.
 	 *
-	 * @return  the list of connected devices
+	 * @return the discovery timeout in milliseconds
 	 */
-	const std::vector<std::unique_ptr<XBeeRemoteDevice>>& getConnectedDevices() const;
+	int getDiscoveryTimeout() const;
 
 
 protected:
 
 	/**
-	 * Receives a specific packet from an XBee device.
+	 * Receives the next valid frame from an XBee device into the input buffer.
+	 * Data that does not form a valid frame is skipped.
 	 *
-	 * @return <code>true</code> if reception was successful and fata is in the buffer
+	 * @return <code>true</code> if reception was successful and data is in the buffer
 	 */
 	bool receivePacket();
 
@@ -180,10 +186,16 @@ protected:
 	SerialPort&      m_serialPort;   // the serial port to use for this device
 	uint8_t          m_frameCounter; // current frame ID for command/response pairs
 	int              m_numOfRetries; // the number of receive retries
+	XBeeFrameDecoder m_decoder;      // extracts frames from the received bytes
+	uint64_t         m_skippedBytes; // skipped bytes already reported
+	int              m_discoveryTimeout; // in milliseconds
 	XBeeReadBuffer   m_bufIn;        // buffer for incoming data
 	XBeeWriteBuffer  m_bufOut;       // buffer for outgoing data
 
-	std::vector<std::unique_ptr<XBeeRemoteDevice>> m_arrNodes;  // connected XBee nodes
+	// reused instances for receive()
+	XBeePacket_AT_CommandResponse       m_rcvATResponse;
+	XBeePacket_RemoteAT_CommandResponse m_rcvRemoteATResponse;
+	XBeePacket_IO_DataSample            m_rcvIODataSample;
 
 };
 
@@ -208,6 +220,8 @@ public:
 	/**
 	 * Creates a XBee remote device class for a specific coordinator.
 	 *
+	 * Nothing is sent to the device, so this can be done while receiving packets.
+	 *
 	 * @param refCoordinator  the coordinator for this device
 	 * @param refBuffer       the buffer to extract information from (generated by a "ND" command)
 	 */
@@ -236,6 +250,30 @@ public:
 	 */
 	float getBatteryVoltage() const;
 
+	/**
+	 * Sets the network address, which can change when the device rejoins the network.
+	 *
+	 * @param networkAddress  the new network address
+	 */
+	void setNetworkAddress(uint16_t networkAddress);
+
+	/**
+	 * Asks the device for its battery voltage without waiting for the answer.
+	 * The answer needs to be passed to update().
+	 *
+	 * @return <code>true</code> if the request was sent
+	 */
+	bool requestBatteryVoltage();
+
+	/**
+	 * Takes over the information of a remote AT command response of this device.
+	 *
+	 * @param refResponse  the received response
+	 *
+	 * @return <code>true</code> if the response was from this device
+	 */
+	bool update(const XBeePacket_RemoteAT_CommandResponse& refResponse);
+
 protected:
 
 	XBeeCoordinator&  m_coordinator;
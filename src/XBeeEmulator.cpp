@@ -0,0 +1,388 @@
+#include "XBeeEmulator.h"
+
+#ifndef _WIN32
+
+#include "XBeePacket.h"
+
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "Logging.h"
+#undef   LOG_CLASS
+#define  LOG_CLASS "XBeeEmulator"
+
+
+// values the emulated coordinator reports
+#define COORDINATOR_SERIAL   0x0013A20040000001ULL
+#define COORDINATOR_NAME     "Emulator"
+#define VERSION_SOFTWARE     0x21A7
+#define VERSION_HARDWARE     0x1E46
+#define DISCOVERY_TIMEOUT    10     // in 100ms
+#define BATTERY_VOLTAGE      2816   // 3.3V as 10 bit A/D value with 1.2V reference
+
+#define POLL_INTERVAL_MS     10     // maximum time between checks for stopping
+
+
+XBeeEmulator::XBeeEmulator() :
+	m_fdMaster(-1),
+	m_fdSlave(-1),
+	m_strDevice(""),
+	m_absentDevices(0),
+	m_speed(1.0f),
+	m_running(false),
+	m_replaying(false),
+	m_replayedFrames(0)
+{
+	// nothing else to do
+}
+
+
+XBeeEmulator::~XBeeEmulator()
+{
+	stop();
+}
+
+
+bool XBeeEmulator::loadCapture(const std::string& strFilename)
+{
+	std::ifstream file(strFilename.c_str());
+	if (!file.is_open())
+	{
+		LOG_ERROR("Could not open capture file " << strFilename);
+		return false;
+	}
+
+	m_arrFrames.clear();
+	m_arrDevices.clear();
+
+	std::string strLine;
+	while (std::getline(file, strLine))
+	{
+		if (strLine.empty() || (strLine[0] == '#')) continue;
+
+		std::istringstream strm(strLine);
+		sCapturedFrame frame;
+		frame.device = -1;
+		strm >> frame.delay;
+		unsigned int value;
+		while (strm >> std::hex >> value)
+		{
+			frame.data.push_back((uint8_t) value);
+		}
+		if (frame.data.size() < 5) continue;
+
+		// senders of IO samples become remote devices
+		const std::vector<uint8_t>& d = frame.data;
+		if ((d[3] == XBeePacket_IO_DataSample::FRAME_TYPE_ID) && (d.size() >= 14))
+		{
+			uint64_t serial = 0;
+			for (int idx = 4; idx < 12; idx++) serial = (serial << 8) | d[idx];
+			uint16_t address = (uint16_t) ((d[12] << 8) | d[13]);
+
+			for (size_t devIdx = 0; devIdx < m_arrDevices.size(); devIdx++)
+			{
+				if (m_arrDevices[devIdx].serialNumber == serial) frame.device = (int) devIdx;
+			}
+			if (frame.device < 0)
+			{
+				std::stringstream name;
+				name << "Joystick " << (m_arrDevices.size() + 1);
+				sRemoteDevice device = { serial, address, name.str() };
+				frame.device = (int) m_arrDevices.size();
+				m_arrDevices.push_back(device);
+			}
+		}
+		m_arrFrames.push_back(frame);
+	}
+
+	LOG_INFO("Loaded " << m_arrFrames.size() << " frames from " << m_arrDevices.size() << " devices");
+	return true;
+}
+
+
+void XBeeEmulator::setSpeed(float speed)
+{
+	m_speed = (speed > 0) ? speed : 0;
+}
+
+
+size_t XBeeEmulator::getDeviceCount() const
+{
+	return m_arrDevices.size();
+}
+
+
+void XBeeEmulator::setDevicePresent(size_t deviceIdx, bool present)
+{
+	if (deviceIdx >= 64) return;
+	if (present)
+	{
+		m_absentDevices &= ~(1ULL << deviceIdx);
+	}
+	else
+	{
+		m_absentDevices |= (1ULL << deviceIdx);
+	}
+}
+
+
+bool XBeeEmulator::isDevicePresent(int deviceIdx) const
+{
+	return (deviceIdx < 0) || (deviceIdx >= 64) || !(m_absentDevices & (1ULL << deviceIdx));
+}
+
+
+bool XBeeEmulator::start()
+{
+	if (m_running) return true;
+
+	m_fdMaster = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((m_fdMaster < 0) || (grantpt(m_fdMaster) != 0) || (unlockpt(m_fdMaster) != 0))
+	{
+		LOG_ERROR("Could not create pseudo terminal");
+		stop();
+		return false;
+	}
+	m_strDevice = ptsname(m_fdMaster);
+	// never block the emulator thread in write() when the server stops reading
+	fcntl(m_fdMaster, F_SETFL, fcntl(m_fdMaster, F_GETFL) | O_NONBLOCK);
+
+	// raw mode on the slave side, and keep it open so the master does not see a hangup
+	// when the server closes and reopens the port
+	m_fdSlave = ::open(m_strDevice.c_str(), O_RDWR | O_NOCTTY);
+	struct termios tio;
+	if ((m_fdSlave >= 0) && (tcgetattr(m_fdSlave, &tio) == 0))
+	{
+		cfmakeraw(&tio);
+		tcsetattr(m_fdSlave, TCSANOW, &tio);
+	}
+
+	m_running   = true;
+	m_replaying = false;
+	m_thread    = std::thread(&XBeeEmulator::emulatorThread, this);
+	LOG_INFO("Emulating XBee coordinator on " << m_strDevice);
+	return true;
+}
+
+
+void XBeeEmulator::stop()
+{
+	m_running = false;
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	if (m_fdSlave >= 0)
+	{
+		::close(m_fdSlave);
+		m_fdSlave = -1;
+	}
+	if (m_fdMaster >= 0)
+	{
+		::close(m_fdMaster);
+		m_fdMaster = -1;
+	}
+}
+
+
+const std::string& XBeeEmulator::getDeviceName() const
+{
+	return m_strDevice;
+}
+
+
+uint64_t XBeeEmulator::getReplayedFrames() const
+{
+	return m_replayedFrames;
+}
+
+
+void XBeeEmulator::emulatorThread()
+{
+	typedef std::chrono::steady_clock clock;
+
+	size_t            frameIdx = 0;
+	clock::time_point nextFrame = clock::now();
+
+	while (m_running)
+	{
+		// wait for commands, but not beyond the time of the next frame to replay
+		int timeout = POLL_INTERVAL_MS;
+		if (m_replaying && !m_arrFrames.empty())
+		{
+			auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(nextFrame - clock::now()).count();
+			timeout = (wait < 0) ? 0 : ((wait < timeout) ? (int) wait : timeout);
+		}
+
+		struct pollfd pfd = { m_fdMaster, POLLIN, 0 };
+		if ((poll(&pfd, 1, timeout) > 0) && (pfd.revents & POLLIN))
+		{
+			size_t   space  = 0;
+			uint8_t* pWrite = m_decoder.getWriteBuffer(space);
+			ssize_t  length = ::read(m_fdMaster, pWrite, space);
+			if (length > 0)
+			{
+				m_decoder.commit((size_t) length);
+				while (m_decoder.nextFrame(m_bufIn))
+				{
+					handleFrame(m_bufIn);
+				}
+			}
+		}
+
+		// replay captured frames in a loop
+		while (m_replaying && !m_arrFrames.empty() && (clock::now() >= nextFrame))
+		{
+			const sCapturedFrame& frame = m_arrFrames[frameIdx];
+			if (isDevicePresent(frame.device))
+			{
+				sendRaw(frame.data.data(), frame.data.size());
+				m_replayedFrames++;
+			}
+
+			frameIdx  = (frameIdx + 1) % m_arrFrames.size();
+			nextFrame = (m_speed > 0) ?
+				(nextFrame + std::chrono::microseconds((long long) (m_arrFrames[frameIdx].delay * 1000 / m_speed))) :
+				clock::now();
+			if (m_speed == 0) break; // give commands a chance between frames
+		}
+	}
+}
+
+
+void XBeeEmulator::handleFrame(const XBeeReadBuffer& refFrame)
+{
+	uint8_t frameTypeID = refFrame.getByteAt(3);
+	uint8_t frameID     = refFrame.getNextByte();
+
+	if (frameTypeID == XBeePacket_AT_Command::FRAME_TYPE_ID)
+	{
+		handleCommand(frameID, refFrame.getNextString(2));
+	}
+	else if (frameTypeID == XBeePacket_RemoteAT_Command::FRAME_TYPE_ID)
+	{
+		uint64_t serialNumber   = refFrame.getNextUInt64();
+		uint16_t networkAddress = refFrame.getNextUInt16();
+		refFrame.getNextByte(); // options
+		handleRemoteCommand(frameID, serialNumber, networkAddress, refFrame.getNextString(2));
+	}
+	else
+	{
+		LOG_WARNING("Ignoring frame type 0x" << std::hex << (int) frameTypeID);
+	}
+}
+
+
+void XBeeEmulator::handleCommand(uint8_t frameID, const std::string& strCommand)
+{
+	if (strCommand == "ND")
+	{
+		// one response per remote device that is switched on
+		for (size_t devIdx = 0; devIdx < m_arrDevices.size(); devIdx++)
+		{
+			if (!isDevicePresent((int) devIdx)) continue;
+			const sRemoteDevice& device = m_arrDevices[devIdx];
+			beginFrame(XBeePacket_AT_CommandResponse::FRAME_TYPE_ID, frameID);
+			m_bufOut.addString(strCommand, 2);
+			m_bufOut.addByte(0); // status OK
+			m_bufOut.addUInt16(device.networkAddress);
+			m_bufOut.addUInt64(device.serialNumber);
+			m_bufOut.addString(device.name);
+			m_bufOut.addByte(0);       // end of name
+			m_bufOut.addUInt16(0xFFFE); // parent address
+			m_bufOut.addByte(0x02);    // end device
+			m_bufOut.addByte(0);       // status
+			m_bufOut.addUInt16(0xC105); // profile ID
+			m_bufOut.addUInt16(0x101E); // manufacturer ID
+			sendFrame();
+		}
+		m_replaying = true;
+		return;
+	}
+
+	beginFrame(XBeePacket_AT_CommandResponse::FRAME_TYPE_ID, frameID);
+	m_bufOut.addString(strCommand, 2);
+	m_bufOut.addByte(0); // status OK
+	if (strCommand == "SH")
+	{
+		m_bufOut.addUInt16((uint16_t) (COORDINATOR_SERIAL >> 48));
+		m_bufOut.addUInt16((uint16_t) (COORDINATOR_SERIAL >> 32));
+	}
+	else if (strCommand == "SL")
+	{
+		m_bufOut.addUInt16((uint16_t) (COORDINATOR_SERIAL >> 16));
+		m_bufOut.addUInt16((uint16_t) (COORDINATOR_SERIAL));
+	}
+	else if (strCommand == "MY") m_bufOut.addUInt16(0x0000);
+	else if (strCommand == "NI") m_bufOut.addString(COORDINATOR_NAME);
+	else if (strCommand == "VR") m_bufOut.addUInt16(VERSION_SOFTWARE);
+	else if (strCommand == "HV") m_bufOut.addUInt16(VERSION_HARDWARE);
+	else if (strCommand == "NT") m_bufOut.addUInt16(DISCOVERY_TIMEOUT);
+	sendFrame();
+}
+
+
+void XBeeEmulator::handleRemoteCommand(uint8_t frameID, uint64_t serialNumber, uint16_t networkAddress, const std::string& strCommand)
+{
+	beginFrame(XBeePacket_RemoteAT_CommandResponse::FRAME_TYPE_ID, frameID);
+	m_bufOut.addUInt64(serialNumber);
+	m_bufOut.addUInt16(networkAddress);
+	m_bufOut.addString(strCommand, 2);
+	m_bufOut.addByte(0); // status OK
+	if (strCommand == "%V")
+	{
+		m_bufOut.addUInt16(BATTERY_VOLTAGE);
+	}
+	sendFrame();
+}
+
+
+void XBeeEmulator::beginFrame(uint8_t frameTypeID, uint8_t frameID)
+{
+	m_bufOut.clear();
+	m_bufOut.addByte(XBeePacket::START_DELIMITER);
+	m_bufOut.addUInt16(0); // length placeholder
+	m_bufOut.addByte(frameTypeID);
+	m_bufOut.addByte(frameID);
+}
+
+
+void XBeeEmulator::sendFrame()
+{
+	m_bufOut.setUInt16At(1, (uint16_t) (m_bufOut.size() - 3));
+	m_bufOut.addByte((uint8_t) 255 - m_bufOut.calculateChecksum());
+	sendRaw((const uint8_t*) m_bufOut.data(), m_bufOut.size());
+}
+
+
+void XBeeEmulator::sendRaw(const uint8_t* pData, size_t length)
+{
+	while ((length > 0) && m_running)
+	{
+		ssize_t written = ::write(m_fdMaster, pData, length);
+		if (written > 0)
+		{
+			pData  += written;
+			length -= (size_t) written;
+		}
+		else if ((written < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+		{
+			// nobody is reading fast enough > wait, but keep checking for stopping
+			struct pollfd pfd = { m_fdMaster, POLLOUT, 0 };
+			poll(&pfd, 1, POLL_INTERVAL_MS);
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+#endif // #ifndef _WIN32
@@ -0,0 +1,143 @@
+/**
+ * Emulation of an XBee coordinator and its remote devices on a pseudo terminal (POSIX only).
+ * Answers the AT commands that XBeeCoordinator sends during initialisation and discovery,
+ * and replays captured API frames, e.g., IO samples of joysticks.
+ * The interaction system can use it through a SerialPort opened with getDeviceName().
+ *
+ * Capture file format: one frame per line as "<delay in ms> <frame bytes in hex>", e.g.,
+ *   20 7E 00 12 92 00 13 A2 00 40 A1 B2 C3 12 34 01 01 00 FC 00 00 FC 22
+ * Lines starting with '#' are comments.
+ * Every sender of an IO sample frame (0x92) in the capture is reported as a remote device.
+ * Devices can be switched off and on to emulate devices joining and leaving the network.
+ */
+
+#pragma once
+
+#ifndef _WIN32
+
+#include "XBeeData.h"
+#include "XBeeFrameDecoder.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+class XBeeEmulator
+{
+public:
+
+	XBeeEmulator();
+
+	/**
+	 * Stops the emulator and closes the pseudo terminal.
+	 */
+	~XBeeEmulator();
+
+	/**
+	 * Loads the frames to replay.
+	 *
+	 * @param strFilename  the name of the capture file
+	 *
+	 * @return <code>true</code> if the file was loaded
+	 */
+	bool loadCapture(const std::string& strFilename);
+
+	/**
+	 * Sets the replay speed.
+	 *
+	 * @param speed  factor for the replay speed (1: original timing, 0: as fast as possible)
+	 */
+	void setSpeed(float speed);
+
+	/**
+	 * Gets the amount of remote devices in the capture.
+	 *
+	 * @return the amount of remote devices
+	 */
+	size_t getDeviceCount() const;
+
+	/**
+	 * Switches a remote device on or off.
+	 * Devices that are off neither answer discoveries nor send their frames.
+	 *
+	 * @param deviceIdx  the index of the device (in the order of appearance in the capture)
+	 * @param present    <code>true</code> to switch the device on
+	 */
+	void setDevicePresent(size_t deviceIdx, bool present);
+
+	/**
+	 * Creates the pseudo terminal and starts the emulation.
+	 * Replaying starts after the first device discovery.
+	 *
+	 * @return <code>true</code> if the emulator was started
+	 */
+	bool start();
+
+	/**
+	 * Stops the emulation.
+	 */
+	void stop();
+
+	/**
+	 * Gets the name of the device to open as a serial port, e.g., "/dev/pts/4".
+	 *
+	 * @return the name of the pseudo terminal device
+	 */
+	const std::string& getDeviceName() const;
+
+	/**
+	 * Gets the amount of replayed frames.
+	 *
+	 * @return the amount of replayed frames
+	 */
+	uint64_t getReplayedFrames() const;
+
+private:
+
+	struct sCapturedFrame
+	{
+		uint32_t             delay;  // milliseconds before sending the frame
+		std::vector<uint8_t> data;   // the complete frame
+		int                  device; // index of the sending device (-1: none)
+	};
+
+	struct sRemoteDevice
+	{
+		uint64_t    serialNumber;
+		uint16_t    networkAddress;
+		std::string name;
+	};
+
+	bool isDevicePresent(int deviceIdx) const;
+	void emulatorThread();
+	void handleFrame(const XBeeReadBuffer& refFrame);
+	void handleCommand(uint8_t frameID, const std::string& strCommand);
+	void handleRemoteCommand(uint8_t frameID, uint64_t serialNumber, uint16_t networkAddress, const std::string& strCommand);
+	void beginFrame(uint8_t frameTypeID, uint8_t frameID);
+	void sendFrame();
+	void sendRaw(const uint8_t* pData, size_t length);
+
+private:
+
+	int                          m_fdMaster;   // our end of the pseudo terminal
+	int                          m_fdSlave;    // kept open so the server can reopen the port
+	std::string                  m_strDevice;
+	std::vector<sCapturedFrame>  m_arrFrames;
+	std::vector<sRemoteDevice>   m_arrDevices;
+	std::atomic<uint64_t>        m_absentDevices; // bit per device that is switched off
+	float                        m_speed;
+
+	std::thread                  m_thread;
+	std::atomic<bool>            m_running;
+	std::atomic<bool>            m_replaying;
+	std::atomic<uint64_t>        m_replayedFrames;
+
+	XBeeFrameDecoder             m_decoder;
+	XBeeReadBuffer               m_bufIn;
+	XBeeWriteBuffer              m_bufOut;
+};
+
+#endif // #ifndef _WIN32
@@ -0,0 +1,154 @@
+#include "XBeeFrameDecoder.h"
+#include "XBeePacket.h"
+
+#include <string.h>
+
+
+#define HEADER_SIZE    3   // start delimiter + 2 bytes length
+#define MAX_FRAME_DATA 300 // longest API frames: 256 bytes of RF data plus up to 18 bytes of frame header
+
+
+XBeeFrameDecoder::XBeeFrameDecoder(size_t capacity) :
+	m_read(0),
+	m_write(0),
+	m_skippedBytes(0),
+	m_rejectedFrames(0)
+{
+	// power of 2 > positions wrap with a simple mask
+	size_t size = 16;
+	while (size < capacity) size <<= 1;
+	m_buffer.resize(size);
+	m_mask = size - 1;
+}
+
+
+uint8_t* XBeeFrameDecoder::getWriteBuffer(size_t& refSpace)
+{
+	size_t pos   = m_write & m_mask;
+	size_t free  = m_buffer.size() - getAvailable();
+	// contiguous space up to the end of the ring
+	refSpace = (free < m_buffer.size() - pos) ? free : (m_buffer.size() - pos);
+	return m_buffer.data() + pos;
+}
+
+
+void XBeeFrameDecoder::commit(size_t length)
+{
+	m_write += length;
+}
+
+
+size_t XBeeFrameDecoder::addData(const uint8_t* pData, size_t length)
+{
+	size_t added = 0;
+	while (added < length)
+	{
+		size_t   space;
+		uint8_t* pWrite = getWriteBuffer(space);
+		if (space == 0) break;
+		if (space > length - added) space = length - added;
+		memcpy(pWrite, pData + added, space);
+		commit(space);
+		added += space;
+	}
+	return added;
+}
+
+
+bool XBeeFrameDecoder::nextFrame(XBeeReadBuffer& refFrame)
+{
+	while (getAvailable() > 0)
+	{
+		// search for the start of a frame
+		if (peek(0) != XBeePacket::START_DELIMITER)
+		{
+			consume(1);
+			m_skippedBytes++;
+			continue;
+		}
+
+		if (getAvailable() < HEADER_SIZE) return false;
+
+		uint16_t dataLen   = (((uint16_t) peek(1)) << 8) | ((uint16_t) peek(2));
+		size_t   frameSize = HEADER_SIZE + dataLen + 1; // +1: checksum
+		if ((dataLen == 0) || (dataLen > MAX_FRAME_DATA) || (frameSize > m_buffer.size()))
+		{
+			// impossible length > this was not a real start delimiter
+			// (without the limit, noise could make the decoder wait for up to a buffer of data)
+			consume(1);
+			m_skippedBytes++;
+			m_rejectedFrames++;
+			continue;
+		}
+
+		if (getAvailable() < frameSize) return false; // wait for the rest
+
+		uint8_t checksum = 0;
+		for (size_t idx = HEADER_SIZE; idx < frameSize; idx++)
+		{
+			checksum += peek(idx);
+		}
+		if (checksum != 0xFF)
+		{
+			// the next frame may start within the corrupted one > only skip the delimiter
+			consume(1);
+			m_skippedBytes++;
+			m_rejectedFrames++;
+			continue;
+		}
+
+		// valid frame > copy payload and checksum behind the reconstructed header
+		uint8_t* pData = refFrame.prepareBuffer(dataLen) + HEADER_SIZE;
+		size_t   pos   = (m_read + HEADER_SIZE) & m_mask;
+		size_t   first = m_buffer.size() - pos;
+		size_t   count = dataLen + 1;
+		if (first >= count)
+		{
+			memcpy(pData, m_buffer.data() + pos, count);
+		}
+		else
+		{
+			memcpy(pData,         m_buffer.data() + pos, first);
+			memcpy(pData + first, m_buffer.data(),       count - first);
+		}
+		consume(frameSize);
+		return true;
+	}
+	return false;
+}
+
+
+void XBeeFrameDecoder::reset()
+{
+	m_read = m_write;
+}
+
+
+size_t XBeeFrameDecoder::getAvailable() const
+{
+	return m_write - m_read;
+}
+
+
+uint64_t XBeeFrameDecoder::getSkippedBytes() const
+{
+	return m_skippedBytes;
+}
+
+
+uint64_t XBeeFrameDecoder::getRejectedFrames() const
+{
+	return m_rejectedFrames;
+}
+
+
+uint8_t XBeeFrameDecoder::peek(size_t offset) const
+{
+	return m_buffer[(m_read + offset) & m_mask];
+}
+
+
+void XBeeFrameDecoder::consume(size_t length)
+{
+	m_read += length;
+}
@@ -0,0 +1,102 @@
+/**
+ * Class for extracting XBee API frames from a stream of received bytes.
+ * Data is read in large chunks into a ring buffer. Noise and corrupted frames
+ * are skipped by searching for the next start delimiter.
+ */
+
+#pragma once
+
+#include "XBeeData.h"
+
+#include <stdint.h>
+#include <vector>
+
+
+class XBeeFrameDecoder
+{
+public:
+
+	/**
+	 * Creates a frame decoder.
+	 *
+	 * @param capacity  the size of the ring buffer (rounded up to a power of 2),
+	 *                  frames longer than this or than the longest XBee API frame are treated as corrupted
+	 */
+	XBeeFrameDecoder(size_t capacity = 1024);
+
+	/**
+	 * Gets the free space in the ring buffer to receive data into.
+	 *
+	 * @param refSpace  receives the amount of bytes that can be written in one go
+	 *
+	 * @return pointer to the space to write into
+	 */
+	uint8_t* getWriteBuffer(size_t& refSpace);
+
+	/**
+	 * Marks data as received after writing into the space returned by getWriteBuffer.
+	 *
+	 * @param length  the amount of bytes that were written
+	 */
+	void commit(size_t length);
+
+	/**
+	 * Copies received data into the ring buffer.
+	 *
+	 * @param pData   the data to add
+	 * @param length  the amount of bytes to add
+	 *
+	 * @return the amount of bytes that fitted into the buffer
+	 */
+	size_t addData(const uint8_t* pData, size_t length);
+
+	/**
+	 * Extracts the next complete frame with a valid checksum.
+	 *
+	 * @param refFrame  the buffer to copy the frame into (including delimiter, length, and checksum)
+	 *
+	 * @return <code>true</code> if a frame was extracted,
+	 *         <code>false</code> if more data is needed
+	 */
+	bool nextFrame(XBeeReadBuffer& refFrame);
+
+	/**
+	 * Removes all buffered data.
+	 */
+	void reset();
+
+	/**
+	 * Gets the amount of buffered bytes.
+	 *
+	 * @return the amount of buffered bytes
+	 */
+	size_t getAvailable() const;
+
+	/**
+	 * Gets the amount of bytes skipped while searching for a valid frame.
+	 *
+	 * @return the amount of skipped bytes since the decoder was created
+	 */
+	uint64_t getSkippedBytes() const;
+
+	/**
+	 * Gets the amount of frames rejected because of an invalid length or checksum.
+	 *
+	 * @return the amount of rejected frames since the decoder was created
+	 */
+	uint64_t getRejectedFrames() const;
+
+private:
+
+	uint8_t peek(size_t offset) const;
+	void    consume(size_t length);
+
+private:
+
+	std::vector<uint8_t> m_buffer;
+	size_t               m_mask;           // capacity - 1
+	size_t               m_read;           // total bytes consumed
+	size_t               m_write;          // total bytes received
+	uint64_t             m_skippedBytes;
+	uint64_t             m_rejectedFrames;
+};
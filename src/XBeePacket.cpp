@@ -1,6 +1,8 @@
 #include "XBeePacket.h"
 #include "XBeeDevice.h"
 
+#include <string.h>
+
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -260,9 +262,10 @@ XBeePacket_IO_DataSample::XBeePacket_IO_DataSample() :
 	m_serialNumber(0),
 	m_networkAddress(0),
 	m_digitalInputMask(0),
-	m_digitalInputState(0)
+	m_digitalInputState(0),
+	m_analogInputMask(0)
 {
-	// nothing else to do
+	memset(m_arrAnalogInputValues, 0, sizeof(m_arrAnalogInputValues));
 }
 
 
@@ -275,9 +278,22 @@ bool XBeePacket_IO_DataSample::unmarshal(const XBeeReadBuffer& refBuffer)
 		m_networkAddress = refBuffer.getNextUInt16();   // pos 12: 16 bit address
 
 		m_digitalInputMask = refBuffer.getUInt16At(16); // pos 16: channel mask
+		m_analogInputMask  = refBuffer.getByteAt(18);   // pos 18: analog channel mask
+		size_t pos = 19;
 		if (m_digitalInputMask > 0)
 		{
-			m_digitalInputState = refBuffer.getUInt16At(19); // pos 19: channel state
+			m_digitalInputState = refBuffer.getUInt16At(pos); // pos 19: channel state
+			pos += 2;
+		}
+		// followed by one 16 bit value per sampled analog input
+		for (int idx = 0; idx < MAX_ANALOG_INPUTS; idx++)
+		{
+			m_arrAnalogInputValues[idx] = 0;
+			if ((m_analogInputMask & (1 << idx)) && (pos + 2 < refBuffer.size()))
+			{
+				m_arrAnalogInputValues[idx] = refBuffer.getUInt16At(pos);
+				pos += 2;
+			}
 		}
 
 		success = true;
@@ -309,3 +325,15 @@ uint16_t XBeePacket_IO_DataSample::getDigitalInputState() const
 	return m_digitalInputState;
 }
 
+
+uint8_t XBeePacket_IO_DataSample::getAnalogInputMask() const
+{
+	return m_analogInputMask;
+}
+
+
+uint16_t XBeePacket_IO_DataSample::getAnalogInputValue(int index) const
+{
+	return ((index >= 0) && (index < MAX_ANALOG_INPUTS)) ? m_arrAnalogInputValues[index] : 0;
+}
+
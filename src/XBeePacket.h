@@ -451,6 +451,25 @@ public:
 	 */
 	uint16_t getDigitalInputState() const;
 
+	/**
+	 * Gets the bitmask for the sampled analog inputs
+	 * (bits 0-3: AD0-AD3, bit 7: supply voltage).
+	 *
+	 * @return bitmask for sampled analog inputs
+	 */
+	uint8_t getAnalogInputMask() const;
+
+	/**
+	 * Gets the value of an analog input.
+	 *
+	 * @param index  the index of the input (0-3: AD0-AD3, 7: supply voltage)
+	 *
+	 * @return the 10 bit value of the input (0 if it was not sampled)
+	 */
+	uint16_t getAnalogInputValue(int index) const;
+
+
+	static const int MAX_ANALOG_INPUTS = 8;
 
 private:
 
@@ -460,5 +479,8 @@ private:
 	uint16_t  m_digitalInputMask;
 	uint16_t  m_digitalInputState;
 
+	uint8_t   m_analogInputMask;
+	uint16_t  m_arrAnalogInputValues[MAX_ANALOG_INPUTS];
+
 };
 
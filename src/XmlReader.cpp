@@ -0,0 +1,304 @@
+#include "XmlReader.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+
+const XmlElement* XmlElement::getChild(const std::string& strName) const
+{
+	for (auto& child : children)
+	{
+		if (child.name == strName) return &child;
+	}
+	return NULL;
+}
+
+
+std::string XmlElement::getAttribute(const std::string& strName, const std::string& strDefault) const
+{
+	auto iAttribute = attributes.find(strName);
+	return (iAttribute != attributes.end()) ? iAttribute->second : strDefault;
+}
+
+
+float XmlElement::getAttribute(const std::string& strName, float defaultValue) const
+{
+	auto iAttribute = attributes.find(strName);
+	return (iAttribute != attributes.end()) ? (float) atof(iAttribute->second.c_str()) : defaultValue;
+}
+
+
+
+bool XmlReader::parse(const std::string& strXml, XmlElement& refRoot)
+{
+	m_pXml = &strXml;
+	m_pos  = 0;
+	m_strError.clear();
+	refRoot = XmlElement();
+
+	// UTF-8 byte order mark
+	if (startsWith("\xEF\xBB\xBF")) m_pos += 3;
+
+	if (!skipMisc()) return false;
+	if (!startsWith("<")) return fail("Root element expected");
+	if (!parseElement(refRoot)) return false;
+	if (!skipMisc()) return false;
+	if (m_pos < strXml.size()) return fail("Content after the root element");
+	return true;
+}
+
+
+bool XmlReader::load(const std::string& strFilename, XmlElement& refRoot)
+{
+	std::ifstream file(strFilename.c_str(), std::ios::binary);
+	if (!file.is_open())
+	{
+		m_strError = "Could not open " + strFilename;
+		return false;
+	}
+	std::stringstream content;
+	content << file.rdbuf();
+	if (!parse(content.str(), refRoot))
+	{
+		m_strError = strFilename + ": " + m_strError;
+		return false;
+	}
+	return true;
+}
+
+
+const std::string& XmlReader::getError() const
+{
+	return m_strError;
+}
+
+
+bool XmlReader::parseElement(XmlElement& refElement)
+{
+	m_pos++; // '<'
+	if (!parseName(refElement.name)) return false;
+
+	// attributes
+	while (true)
+	{
+		skipWhitespace();
+		if (startsWith("/>"))
+		{
+			m_pos += 2;
+			return true; // empty element
+		}
+		if (startsWith(">"))
+		{
+			m_pos++;
+			break;
+		}
+
+		std::string strName, strValue;
+		if (!parseName(strName)) return false;
+		skipWhitespace();
+		if (!startsWith("=")) return fail("'=' expected after attribute " + strName);
+		m_pos++;
+		skipWhitespace();
+		if (!parseAttributeValue(strValue)) return false;
+		refElement.attributes[strName] = strValue;
+	}
+
+	return parseContent(refElement);
+}
+
+
+bool XmlReader::parseContent(XmlElement& refElement)
+{
+	const std::string& xml = *m_pXml;
+	while (m_pos < xml.size())
+	{
+		size_t next = xml.find('<', m_pos);
+		if (next == std::string::npos) break;
+		appendText(refElement.text, m_pos, next);
+		m_pos = next;
+
+		if (startsWith("</"))
+		{
+			m_pos += 2;
+			std::string strName;
+			if (!parseName(strName)) return false;
+			if (strName != refElement.name) return fail("</" + refElement.name + "> expected");
+			skipWhitespace();
+			if (!startsWith(">")) return fail("'>' expected");
+			m_pos++;
+			return true;
+		}
+		else if (startsWith("<!--"))
+		{
+			if (!skipUntil("-->")) return false;
+		}
+		else if (startsWith("<![CDATA["))
+		{
+			size_t end = xml.find("]]>", m_pos);
+			if (end == std::string::npos) return fail("Unterminated CDATA section");
+			refElement.text.append(xml, m_pos + 9, end - m_pos - 9);
+			m_pos = end + 3;
+		}
+		else if (startsWith("<?"))
+		{
+			if (!skipUntil("?>")) return false;
+		}
+		else
+		{
+			refElement.children.push_back(XmlElement());
+			if (!parseElement(refElement.children.back())) return false;
+		}
+	}
+	return fail("</" + refElement.name + "> missing");
+}
+
+
+bool XmlReader::parseName(std::string& strName)
+{
+	const std::string& xml   = *m_pXml;
+	size_t             start = m_pos;
+	while ((m_pos < xml.size()) &&
+	       (isalnum((unsigned char) xml[m_pos]) || ((xml[m_pos] != '\0') && (strchr("_-.:", xml[m_pos]) != NULL)) || ((unsigned char) xml[m_pos] >= 0x80)))
+	{
+		m_pos++;
+	}
+	if (m_pos == start) return fail("Name expected");
+	strName.assign(xml, start, m_pos - start);
+	return true;
+}
+
+
+bool XmlReader::parseAttributeValue(std::string& strValue)
+{
+	const std::string& xml = *m_pXml;
+	if ((m_pos >= xml.size()) || ((xml[m_pos] != '"') && (xml[m_pos] != '\'')))
+	{
+		return fail("Quoted attribute value expected");
+	}
+	char   quote = xml[m_pos];
+	size_t end   = xml.find(quote, m_pos + 1);
+	if (end == std::string::npos) return fail("Unterminated attribute value");
+	strValue.clear();
+	appendText(strValue, m_pos + 1, end);
+	m_pos = end + 1;
+	return true;
+}
+
+
+bool XmlReader::skipMisc()
+{
+	while (true)
+	{
+		skipWhitespace();
+		if (startsWith("<?"))
+		{
+			if (!skipUntil("?>")) return false;
+		}
+		else if (startsWith("<!--"))
+		{
+			if (!skipUntil("-->")) return false;
+		}
+		else if (startsWith("<!"))
+		{
+			if (!skipUntil(">")) return false; // e.g., DOCTYPE without internal subset
+		}
+		else
+		{
+			return true;
+		}
+	}
+}
+
+
+bool XmlReader::skipUntil(const char* strEnd)
+{
+	size_t end = m_pXml->find(strEnd, m_pos);
+	if (end == std::string::npos) return fail(std::string("'") + strEnd + "' missing");
+	m_pos = end + strlen(strEnd);
+	return true;
+}
+
+
+void XmlReader::skipWhitespace()
+{
+	const std::string& xml = *m_pXml;
+	while ((m_pos < xml.size()) && isspace((unsigned char) xml[m_pos])) m_pos++;
+}
+
+
+bool XmlReader::startsWith(const char* str) const
+{
+	return m_pXml->compare(m_pos, strlen(str), str) == 0;
+}
+
+
+void XmlReader::appendText(std::string& strText, size_t start, size_t end)
+{
+	const std::string& xml = *m_pXml;
+	while (start < end)
+	{
+		// copy runs of plain characters in one go
+		size_t amp = xml.find('&', start);
+		if ((amp == std::string::npos) || (amp >= end))
+		{
+			strText.append(xml, start, end - start);
+			return;
+		}
+		strText.append(xml, start, amp - start);
+
+		size_t semicolon = xml.find(';', amp);
+		if ((semicolon == std::string::npos) || (semicolon >= end))
+		{
+			// not an entity > keep as it is
+			strText.append(xml, amp, end - amp);
+			return;
+		}
+		std::string entity(xml, amp + 1, semicolon - amp - 1);
+		if      (entity == "lt")   strText += '<';
+		else if (entity == "gt")   strText += '>';
+		else if (entity == "amp")  strText += '&';
+		else if (entity == "quot") strText += '"';
+		else if (entity == "apos") strText += '\'';
+		else if (!entity.empty() && (entity[0] == '#'))
+		{
+			// character reference, encoded as UTF-8
+			unsigned long code = (entity.size() > 1 && (entity[1] == 'x')) ?
+				strtoul(entity.c_str() + 2, NULL, 16) :
+				strtoul(entity.c_str() + 1, NULL, 10);
+			if (code < 0x80)
+			{
+				strText += (char) code;
+			}
+			else if (code < 0x800)
+			{
+				strText += (char) (0xC0 | (code >> 6));
+				strText += (char) (0x80 | (code & 0x3F));
+			}
+			else
+			{
+				strText += (char) (0xE0 | ((code >> 12) & 0x0F));
+				strText += (char) (0x80 | ((code >> 6) & 0x3F));
+				strText += (char) (0x80 | (code & 0x3F));
+			}
+		}
+		else
+		{
+			strText.append(xml, amp, semicolon + 1 - amp); // unknown entity
+		}
+		start = semicolon + 1;
+	}
+}
+
+
+bool XmlReader::fail(const std::string& strMessage)
+{
+	size_t line = 1 + std::count(m_pXml->begin(), m_pXml->begin() + std::min(m_pos, m_pXml->size()), '\n');
+	std::stringstream error;
+	error << strMessage << " (line " << line << ")";
+	m_strError = error.str();
+	return false;
+}
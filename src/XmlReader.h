@@ -0,0 +1,102 @@
+/**
+ * Minimal XML reader for small configuration files, e.g., the hardware profiles.
+ * Builds a tree of elements with their attributes and text.
+ * Supports comments, processing instructions, CDATA and the predefined entities,
+ * but no DTDs or namespaces.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+struct XmlElement
+{
+	std::string                        name;
+	std::map<std::string, std::string> attributes;
+	std::string                        text;       // concatenated character data
+	std::vector<XmlElement>            children;
+
+	/**
+	 * Finds the first child element with a specific name.
+	 *
+	 * @param strName  the name of the child element
+	 *
+	 * @return the child element (or <code>NULL</code> if there is none)
+	 */
+	const XmlElement* getChild(const std::string& strName) const;
+
+	/**
+	 * Gets the value of an attribute.
+	 *
+	 * @param strName     the name of the attribute
+	 * @param strDefault  the value to return if the attribute does not exist
+	 *
+	 * @return the attribute value
+	 */
+	std::string getAttribute(const std::string& strName, const std::string& strDefault = "") const;
+
+	/**
+	 * Gets the numerical value of an attribute.
+	 *
+	 * @param strName       the name of the attribute
+	 * @param defaultValue  the value to return if the attribute does not exist
+	 *
+	 * @return the attribute value
+	 */
+	float getAttribute(const std::string& strName, float defaultValue) const;
+};
+
+
+class XmlReader
+{
+public:
+
+	/**
+	 * Parses an XML document.
+	 *
+	 * @param strXml   the document
+	 * @param refRoot  the element to parse the root element into
+	 *
+	 * @return <code>true</code> if the document was parsed, <code>false</code> on syntax errors
+	 */
+	bool parse(const std::string& strXml, XmlElement& refRoot);
+
+	/**
+	 * Reads and parses an XML file.
+	 *
+	 * @param strFilename  the name of the file
+	 * @param refRoot      the element to parse the root element into
+	 *
+	 * @return <code>true</code> if the file was read and parsed
+	 */
+	bool load(const std::string& strFilename, XmlElement& refRoot);
+
+	/**
+	 * Gets a description of the last error.
+	 *
+	 * @return the error description, including the line number
+	 */
+	const std::string& getError() const;
+
+private:
+
+	bool parseElement(XmlElement& refElement);
+	bool parseContent(XmlElement& refElement);
+	bool parseName(std::string& strName);
+	bool parseAttributeValue(std::string& strValue);
+	bool skipMisc();
+	bool skipUntil(const char* strEnd);
+	void skipWhitespace();
+	bool startsWith(const char* str) const;
+	void appendText(std::string& strText, size_t start, size_t end);
+	bool fail(const std::string& strMessage);
+
+private:
+
+	const std::string* m_pXml;
+	size_t             m_pos;
+	std::string        m_strError;
+};
@@ -23,6 +23,7 @@
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
+#include <cstdint>
 #include <cstdio>
 #include <limits>
 
@@ -498,7 +499,13 @@ struct JsonParser final {
             if (ch != '\\') {
                 encode_utf8(last_escaped_codepoint, out);
                 last_escaped_codepoint = -1;
-                out += ch;
+                // Append the whole run of plain characters at once
+                size_t run_end = i;
+                while (run_end < str.size() && str[run_end] != '"' && str[run_end] != '\\'
+                        && !in_range(str[run_end], 0, 0x1f))
+                    run_end++;
+                out.append(str, i - 1, run_end - i + 1);
+                i = run_end;
                 continue;
             }
 
@@ -572,26 +579,35 @@ struct JsonParser final {
      */
     Json parse_number() {
         size_t start_pos = i;
+        bool negative = false;
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int fraction_digits = 0;
 
-        if (str[i] == '-')
+        if (str[i] == '-') {
+            negative = true;
             i++;
+        }
 
         // Integer part
         if (str[i] == '0') {
             i++;
+            digits++;
             if (in_range(str[i], '0', '9'))
                 return fail("leading 0s not permitted in numbers");
         } else if (in_range(str[i], '1', '9')) {
-            i++;
-            while (in_range(str[i], '0', '9'))
+            while (in_range(str[i], '0', '9')) {
+                mantissa = mantissa * 10 + (str[i] - '0');
+                digits++;
                 i++;
+            }
         } else {
             return fail("invalid " + esc(str[i]) + " in number");
         }
 
         if (str[i] != '.' && str[i] != 'e' && str[i] != 'E'
                 && (i - start_pos) <= static_cast<size_t>(std::numeric_limits<int>::digits10)) {
-            return std::atoi(str.c_str() + start_pos);
+            return negative ? -static_cast<int>(mantissa) : static_cast<int>(mantissa);
         }
 
         // Decimal part
@@ -600,8 +616,12 @@ struct JsonParser final {
             if (!in_range(str[i], '0', '9'))
                 return fail("at least one digit required in fractional part");
 
-            while (in_range(str[i], '0', '9'))
+            while (in_range(str[i], '0', '9')) {
+                mantissa = mantissa * 10 + (str[i] - '0');
+                digits++;
+                fraction_digits++;
                 i++;
+            }
         }
 
         // Exponent part
@@ -616,6 +636,18 @@ struct JsonParser final {
 
             while (in_range(str[i], '0', '9'))
                 i++;
+
+            return std::strtod(str.c_str() + start_pos, nullptr);
+        }
+
+        // Fast path: with up to 15 digits the mantissa and the power of ten are exact doubles,
+        // so the single division is correctly rounded, just like strtod.
+        if (digits <= 15) {
+            static const double powers_of_ten[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+            };
+            double value = static_cast<double>(mantissa) / powers_of_ten[fraction_digits];
+            return negative ? -value : value;
         }
 
         return std::strtod(str.c_str() + start_pos, nullptr);
@@ -0,0 +1,531 @@
+/**
+ * Tests for streaming Cortex frames, replayed from a capture file through the Cortex stand-in (CortexStub.cpp),
+ * including shutting down while frames are streamed, and a benchmark of the frame hand-over and conversion.
+ */
+
+#include "TestFramework.h"
+
+#include "MoCapCortex.h"
+#include "CortexCapture.h"
+#include "FramePacketWriter.h"
+#include "Portability.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+TEST_MAIN_VARIABLES
+
+
+#define CAPTURE_FILENAME   "CortexReplayTest.cap"
+#define RECORD_FILENAME    "CortexReplayTestRecord.cap"
+#define MISMATCH_FILENAME  "CortexReplayTestMismatch.cap"
+#define REPLAY_FRAME_RATE  500.0f
+#define REPLAY_FRAMES      1000
+#define BODY_COUNT         8
+#define MARKERS_PER_BODY   20
+#define SEGMENTS_PER_BODY  10
+#define UNKNOWN_MARKERS    100
+
+
+// the parts of the main program that the Cortex module uses (see MotionServerMain.cpp)
+static std::mutex       mtxMoCap;
+static MoCapCortex*     pCortex    = NULL;
+static MoCapData*       pMocapData = NULL;
+static std::atomic<int> framesStreamed(0);
+static std::atomic<int> framesFailed(0);
+static std::atomic<int> framesWrong(0);
+static std::atomic<int> framesSignalled(0);
+static std::atomic<bool> writeDirectly(false);
+
+
+/**
+ * Gets the recorded X coordinate of a marker (in mm).
+ */
+static float getMarkerX(int iFrame, int bIdx)
+{
+	return iFrame + bIdx * 0.5f;
+}
+
+
+/**
+ * Checks that a converted frame contains the recorded marker positions (in m).
+ */
+static bool isFrameCorrect(const sFrameOfMocapData& refFrame)
+{
+	if (refFrame.nMarkerSets != BODY_COUNT) return false;
+	for (int bIdx = 0; bIdx < BODY_COUNT; bIdx++)
+	{
+		const sMarkerSetData& refMarkerSet = refFrame.MocapData[bIdx];
+		if (refMarkerSet.nMarkers != MARKERS_PER_BODY) return false;
+		for (int mIdx = 0; mIdx < MARKERS_PER_BODY; mIdx++)
+		{
+			if ((std::fabs(refMarkerSet.Markers[mIdx][0] - getMarkerX(refFrame.iFrame, bIdx) / 1000.0f) > 1e-5f) ||
+			    (std::fabs(refMarkerSet.Markers[mIdx][1] - mIdx / 1000.0f) > 1e-5f))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+void signalNewFrame()
+{
+	std::lock_guard<std::mutex> lock(mtxMoCap);
+	if (pCortex && pMocapData)
+	{
+		framesSignalled++;
+		if (writeDirectly)
+		{
+			// like the main program: try writing the packet directly first,
+			// the packet is too small for the frame, so this fails after the unknown markers are filtered
+			static sPacket    packet;
+			const uint8_t     arrNatNetVersion[4] = { 2, 9, 0, 0 };
+			FramePacketWriter writer(packet, arrNatNetVersion, 64);
+			if (pCortex->writeFrameData(*pMocapData, writer)) framesWrong++;
+		}
+
+		if (pCortex->getFrameData(*pMocapData))
+		{
+			framesStreamed++;
+			if (!isFrameCorrect(pMocapData->frame)) framesWrong++;
+		}
+		else if (!pCortex->isFrameSkipped())
+		{
+			framesFailed++;
+		}
+	}
+}
+
+
+void signalSceneChange()
+{
+	// nothing to do
+}
+
+
+/**
+ * Synthetic Cortex scene: skeletons with markers, and unidentified markers.
+ */
+struct sTestScene
+{
+	std::unique_ptr<sBodyDefs>    pBodyDefs;
+	std::unique_ptr<sFrameOfData> pFrame;
+	std::vector<std::string>      arrNames;
+	std::vector<std::vector<char*>> arrNameLists;
+	std::vector<int>              arrParents;
+	std::vector<std::vector<float>>  arrMarkers;
+	std::vector<std::vector<double>> arrSegments;
+	std::vector<float>            arrUnknownMarkers;
+
+	sTestScene() :
+		pBodyDefs(new sBodyDefs()),
+		pFrame(new sFrameOfData())
+	{
+		memset(pBodyDefs.get(), 0, sizeof(sBodyDefs));
+		memset(pFrame.get(),    0, sizeof(sFrameOfData));
+
+		// all strings first, so that their pointers stay valid
+		arrNames.reserve(BODY_COUNT * (1 + MARKERS_PER_BODY + SEGMENTS_PER_BODY));
+		arrNameLists.resize(BODY_COUNT * 2);
+		for (int sIdx = 0; sIdx < SEGMENTS_PER_BODY; sIdx++)
+		{
+			arrParents.push_back(sIdx - 1);
+		}
+
+		pBodyDefs->nBodyDefs = BODY_COUNT;
+		pFrame->nBodies      = BODY_COUNT;
+		arrMarkers.resize(BODY_COUNT);
+		arrSegments.resize(BODY_COUNT);
+		for (int bIdx = 0; bIdx < BODY_COUNT; bIdx++)
+		{
+			sBodyDef& refDef = pBodyDefs->BodyDefs[bIdx];
+			arrNames.push_back("Actor" + std::to_string(bIdx + 1));
+			refDef.szName = (char*) arrNames.back().c_str();
+
+			std::vector<char*>& refMarkerNames = arrNameLists[bIdx * 2];
+			for (int mIdx = 0; mIdx < MARKERS_PER_BODY; mIdx++)
+			{
+				arrNames.push_back("Marker" + std::to_string(mIdx + 1));
+				refMarkerNames.push_back((char*) arrNames.back().c_str());
+			}
+			refDef.nMarkers      = MARKERS_PER_BODY;
+			refDef.szMarkerNames = refMarkerNames.data();
+
+			std::vector<char*>& refSegmentNames = arrNameLists[bIdx * 2 + 1];
+			for (int sIdx = 0; sIdx < SEGMENTS_PER_BODY; sIdx++)
+			{
+				arrNames.push_back("Bone" + std::to_string(sIdx + 1));
+				refSegmentNames.push_back((char*) arrNames.back().c_str());
+			}
+			refDef.Hierarchy.nSegments      = SEGMENTS_PER_BODY;
+			refDef.Hierarchy.szSegmentNames = refSegmentNames.data();
+			refDef.Hierarchy.iParents       = arrParents.data();
+
+			sBodyData& refBody = pFrame->BodyData[bIdx];
+			strncpy_s(refBody.szName, refDef.szName, sizeof(refBody.szName));
+			arrMarkers[bIdx].resize(MARKERS_PER_BODY * 3);
+			refBody.nMarkers  = MARKERS_PER_BODY;
+			refBody.Markers   = (tMarkerData*) arrMarkers[bIdx].data();
+			arrSegments[bIdx].resize(SEGMENTS_PER_BODY * 7);
+			refBody.nSegments = SEGMENTS_PER_BODY;
+			refBody.Segments  = (tSegmentData*) arrSegments[bIdx].data();
+		}
+
+		arrUnknownMarkers.resize(UNKNOWN_MARKERS * 3);
+		pFrame->nUnidentifiedMarkers = UNKNOWN_MARKERS;
+		pFrame->UnidentifiedMarkers  = (tMarkerData*) arrUnknownMarkers.data();
+	}
+
+	/**
+	 * Fills in the data of a frame.
+	 */
+	void setFrame(int iFrame)
+	{
+		pFrame->iFrame = iFrame;
+		for (int bIdx = 0; bIdx < BODY_COUNT; bIdx++)
+		{
+			sBodyData& refBody = pFrame->BodyData[bIdx];
+			for (int mIdx = 0; mIdx < MARKERS_PER_BODY; mIdx++)
+			{
+				refBody.Markers[mIdx][0] = getMarkerX(iFrame, bIdx);
+				refBody.Markers[mIdx][1] = (float) mIdx;
+				refBody.Markers[mIdx][2] = 1000.0f;
+			}
+			for (int sIdx = 0; sIdx < SEGMENTS_PER_BODY; sIdx++)
+			{
+				double* pSegment = refBody.Segments[sIdx];
+				pSegment[0] = iFrame;
+				pSegment[1] = sIdx * 100.0;
+				pSegment[2] = bIdx * 100.0;
+				pSegment[3] = 10.0;
+				pSegment[4] = 20.0;
+				pSegment[5] = iFrame % 360;
+				pSegment[6] = 100.0;
+			}
+		}
+		for (int mIdx = 0; mIdx < UNKNOWN_MARKERS; mIdx++)
+		{
+			pFrame->UnidentifiedMarkers[mIdx][0] = mIdx * 10.0f;
+			pFrame->UnidentifiedMarkers[mIdx][1] = 0.0f;
+			pFrame->UnidentifiedMarkers[mIdx][2] = iFrame % 100 * 1.0f;
+		}
+	}
+};
+
+
+/**
+ * Waits until a condition is met.
+ *
+ * @return <code>true</code> if the condition was met within the timeout
+ */
+template<typename Condition> static bool waitFor(Condition condition, int timeoutMs)
+{
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	while (!condition())
+	{
+		if (std::chrono::steady_clock::now() > end) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+
+/**
+ * Gets the number of the latest streamed frame.
+ */
+static int getStreamedFrameNumber()
+{
+	std::lock_guard<std::mutex> lock(mtxMoCap);
+	return pMocapData->frame.iFrame;
+}
+
+
+static void testRecordCapture()
+{
+	sTestScene scene;
+	CortexCaptureWriter writer;
+	TEST_REQUIRE(writer.open(CAPTURE_FILENAME, REPLAY_FRAME_RATE, 1.0f));
+	writer.writeBodyDefs(*scene.pBodyDefs);
+	for (int iFrame = 0; iFrame < REPLAY_FRAMES; iFrame++)
+	{
+		scene.setFrame(iFrame);
+		writer.writeFrame(*scene.pFrame);
+	}
+	writer.close();
+}
+
+
+/**
+ * Frames replayed by the stand-in are converted and streamed.
+ */
+static void testReplayIsStreamed()
+{
+	TEST_REQUIRE(pCortex->initialise());
+	pCortex->setHandleUnknownMarkers(true);
+	{
+		std::lock_guard<std::mutex> lock(mtxMoCap);
+		TEST_REQUIRE(pCortex->getSceneDescription(*pMocapData));
+	}
+
+	TEST_REQUIRE(waitFor([] { return framesStreamed >= 100; }, 5000));
+	TEST_CHECK(framesFailed == 0);
+	TEST_CHECK(framesWrong  == 0);
+
+	std::lock_guard<std::mutex> lock(mtxMoCap);
+	TEST_CHECK(pMocapData->frame.nSkeletons == BODY_COUNT);
+	TEST_CHECK(pMocapData->frame.nOtherMarkers > 0);
+}
+
+
+/**
+ * The Cortex callback does not wait while the MoCap data is locked (e.g., by a client request),
+ * it keeps handing over frames, and the newest one is streamed when the lock is released.
+ */
+static void testLockDoesNotBlockCallback()
+{
+	int iFrameBefore;
+	{
+		std::lock_guard<std::mutex> lock(mtxMoCap);
+		iFrameBefore = pMocapData->frame.iFrame;
+		// ~100 frames at the replay rate
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	}
+
+	TEST_CHECK(waitFor([&] { return getStreamedFrameNumber() >= iFrameBefore + 50; }, 1000));
+	TEST_CHECK(framesFailed == 0);
+	TEST_CHECK(framesWrong  == 0);
+}
+
+
+/**
+ * Recording while streaming writes the body definitions and the frames in order,
+ * without disturbing the streaming.
+ */
+static void testRecordWhileStreaming()
+{
+	TEST_REQUIRE(pCortex->startRecording(RECORD_FILENAME));
+	int streamedBefore = framesStreamed;
+	TEST_CHECK(waitFor([&] { return framesStreamed >= streamedBefore + 100; }, 5000));
+	pCortex->stopRecording();
+	TEST_CHECK(framesFailed == 0);
+	TEST_CHECK(framesWrong  == 0);
+
+	CortexCaptureReader reader;
+	CortexBodyDefs      bodyDefs;
+	CortexFrame         frame;
+	TEST_REQUIRE(reader.open(RECORD_FILENAME));
+	TEST_REQUIRE(reader.readRecord(bodyDefs, frame) == CAPTURE_BODYDEFS);
+	TEST_CHECK(bodyDefs.get().nBodyDefs == BODY_COUNT);
+
+	int frames = 0, lastFrameNumber = -1;
+	int record;
+	while ((record = reader.readRecord(bodyDefs, frame)) == CAPTURE_FRAME)
+	{
+		TEST_CHECK(frame.get().iFrame != lastFrameNumber);
+		TEST_CHECK(frame.get().nUnidentifiedMarkers == UNKNOWN_MARKERS);
+		lastFrameNumber = frame.get().iFrame;
+		frames++;
+	}
+	TEST_CHECK(record == CAPTURE_END);
+	TEST_CHECK(frames >= 100);
+	reader.close();
+	std::remove(RECORD_FILENAME);
+}
+
+
+/**
+ * Gets the number of frames the unknown marker filter has processed.
+ */
+static uint64_t getFilteredFrameCount()
+{
+	std::stringstream strm;
+	std::streambuf*   pPrevious = std::cout.rdbuf(strm.rdbuf());
+	pCortex->processCommand("unknownMarkerStats");
+	std::cout.rdbuf(pPrevious);
+
+	std::string strStatistics = strm.str();
+	size_t      pos           = strStatistics.find("Frames:");
+	return (pos != std::string::npos) ? std::stoull(strStatistics.substr(pos + 7)) : 0;
+}
+
+
+/**
+ * When writing the packet directly fails, the fallback conversion of the same frame
+ * reuses the filtered unknown markers instead of filtering them again.
+ */
+static void testUnknownMarkersFilteredOncePerFrame()
+{
+	uint64_t filteredBefore;
+	int      signalledBefore, streamedBefore;
+	{
+		std::lock_guard<std::mutex> lock(mtxMoCap);
+		filteredBefore  = getFilteredFrameCount();
+		signalledBefore = framesSignalled;
+		streamedBefore  = framesStreamed;
+		writeDirectly   = true;
+	}
+
+	TEST_CHECK(waitFor([&] { return framesStreamed >= streamedBefore + 100; }, 5000));
+
+	std::lock_guard<std::mutex> lock(mtxMoCap);
+	writeDirectly = false;
+	uint64_t filtered  = getFilteredFrameCount() - filteredBefore;
+	int      signalled = framesSignalled - signalledBefore;
+	TEST_CHECK(filtered >= 100);
+	TEST_CHECK(filtered <= (uint64_t) signalled);
+	TEST_CHECK(framesFailed == 0);
+	TEST_CHECK(framesWrong  == 0);
+	TEST_CHECK(pMocapData->frame.nOtherMarkers > 0);
+}
+
+
+/**
+ * Shutting down like the main program does, while frames are streamed, finishes.
+ */
+static void testShutdownWhileStreaming()
+{
+	std::future<void> shutdown = std::async(std::launch::async, []
+	{
+		// stop the frame threads without the lock, then deinitialise with the lock (and the replay still running)
+		pCortex->stop();
+		std::lock_guard<std::mutex> lock(mtxMoCap);
+		pCortex->deinitialise();
+	});
+
+	if (shutdown.wait_for(std::chrono::seconds(5)) != std::future_status::ready)
+	{
+		std::cerr << "Shutdown is deadlocked" << std::endl;
+		std::_Exit(1); // the threads can't be joined
+	}
+	TEST_CHECK(!pCortex->isActive());
+
+	// no frames after the shutdown
+	int streamed = framesStreamed;
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	TEST_CHECK(framesStreamed == streamed);
+}
+
+
+/**
+ * Measures what the Cortex callback does per frame (copying into a slot)
+ * compared to the conversion on the streaming thread.
+ */
+static void benchmarkHandOverAndConversion()
+{
+	sTestScene  scene;
+	CortexFrame slot;
+	const int   iterations = 10000;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int iFrame = 0; iFrame < iterations; iFrame++)
+	{
+		scene.pFrame->iFrame = iFrame;
+		slot.copyFrom(*scene.pFrame);
+	}
+	std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - start;
+
+	std::cout << "Callback hand-over: " << (duration.count() / iterations) << "ns/frame ("
+		<< BODY_COUNT << " bodies, " << (BODY_COUNT * MARKERS_PER_BODY + UNKNOWN_MARKERS) << " markers)" << std::endl;
+	pCortex->printConversionStatistics(std::cout);
+}
+
+
+/**
+ * Frames that never match the scene Cortex reports don't request the scene for every frame:
+ * while recording, every scene request writes the body definitions into the capture.
+ */
+static void testPersistentMismatchIsRateLimited()
+{
+	// frames with one body less than the body definitions
+	{
+		sTestScene scene;
+		CortexCaptureWriter writer;
+		TEST_REQUIRE(writer.open(MISMATCH_FILENAME, REPLAY_FRAME_RATE, 1.0f));
+		writer.writeBodyDefs(*scene.pBodyDefs);
+		for (int iFrame = 0; iFrame < REPLAY_FRAMES; iFrame++)
+		{
+			scene.setFrame(iFrame);
+			scene.pFrame->nBodies = BODY_COUNT - 1;
+			writer.writeFrame(*scene.pFrame);
+		}
+		writer.close();
+	}
+
+	std::unique_ptr<MoCapCortex> pMismatched(new MoCapCortex(MISMATCH_FILENAME, ""));
+	int streamedBefore = framesStreamed;
+	{
+		std::lock_guard<std::mutex> lock(mtxMoCap);
+		pCortex = pMismatched.get();
+		TEST_REQUIRE(pCortex->initialise());
+		TEST_REQUIRE(pCortex->getSceneDescription(*pMocapData));
+	}
+	TEST_REQUIRE(pCortex->startRecording(RECORD_FILENAME));
+
+	// ~500 frames at the replay rate
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+
+	pCortex->stopRecording();
+	pCortex->stop();
+	{
+		std::lock_guard<std::mutex> lock(mtxMoCap);
+		pCortex->deinitialise();
+		pCortex = NULL;
+	}
+	TEST_CHECK(framesStreamed == streamedBefore);
+	TEST_CHECK(framesFailed == 0);
+
+	CortexCaptureReader reader;
+	CortexBodyDefs      bodyDefs;
+	CortexFrame         frame;
+	TEST_REQUIRE(reader.open(RECORD_FILENAME));
+	int frames = 0, requests = -1; // the first body definitions start the recording
+	int record;
+	while ((record = reader.readRecord(bodyDefs, frame)) != CAPTURE_END)
+	{
+		if (record == CAPTURE_BODYDEFS) requests++;
+		if (record == CAPTURE_FRAME)    frames++;
+	}
+	reader.close();
+	std::remove(RECORD_FILENAME);
+	std::remove(MISMATCH_FILENAME);
+
+	std::cout << requests << " scene requests for " << frames << " mismatching frames" << std::endl;
+	TEST_CHECK(frames >= 100);
+	TEST_CHECK(requests >= 1);
+	TEST_CHECK(requests <= 10); // 100ms, 200ms, 400ms, ... between the requests
+}
+
+
+int main()
+{
+	std::unique_ptr<MoCapData>   pData(new MoCapData());
+	std::unique_ptr<MoCapCortex> pSystem(new MoCapCortex(CAPTURE_FILENAME, ""));
+	pMocapData = pData.get();
+	pCortex    = pSystem.get();
+
+	TEST_RUN(testRecordCapture);
+	TEST_RUN(testReplayIsStreamed);
+	TEST_RUN(testLockDoesNotBlockCallback);
+	TEST_RUN(testRecordWhileStreaming);
+	TEST_RUN(testUnknownMarkersFilteredOncePerFrame);
+	TEST_RUN(benchmarkHandOverAndConversion);
+	TEST_RUN(testShutdownWhileStreaming);
+	TEST_RUN(testPersistentMismatchIsRateLimited);
+
+	pCortex    = NULL;
+	pMocapData = NULL;
+	std::remove(CAPTURE_FILENAME);
+	return testResult();
+}
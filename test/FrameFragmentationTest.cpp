@@ -0,0 +1,475 @@
+/**
+ * Tests for splitting large frames into fragments and reassembling them (FrameFragmentation.h).
+ */
+
+#include "TestFramework.h"
+
+#include "FrameFragmentation.h"
+#include "FramePacketWriter.h"
+#include "Portability.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string.h>
+#include <vector>
+
+TEST_MAIN_VARIABLES
+
+
+#define LARGE_MARKER_COUNT 10000
+
+
+/**
+ * A frame that owns the data its pointers refer to.
+ */
+struct sTestFrame
+{
+	std::unique_ptr<sFrameOfMocapData>   pFrame;
+	std::vector<std::vector<float>>      arrMarkerData;
+	std::vector<std::vector<int>>        arrMarkerIDs;
+	std::vector<std::vector<sRigidBodyData>> arrBones;
+
+	sTestFrame() :
+		pFrame(new sFrameOfMocapData())
+	{
+		memset(pFrame.get(), 0, sizeof(sFrameOfMocapData));
+	}
+
+	MarkerData* createMarkers(int count, float offset)
+	{
+		arrMarkerData.push_back(std::vector<float>(count * 3));
+		std::vector<float>& refData = arrMarkerData.back();
+		for (size_t idx = 0; idx < refData.size(); idx++)
+		{
+			refData[idx] = offset + idx * 0.001f;
+		}
+		return (MarkerData*) refData.data();
+	}
+
+	void createRigidBody(sRigidBodyData& refRigidBody, int id, int nMarkers)
+	{
+		memset(&refRigidBody, 0, sizeof(refRigidBody));
+		refRigidBody.ID       = id;
+		refRigidBody.x        = id * 1.0f;
+		refRigidBody.qw       = 1.0f;
+		refRigidBody.nMarkers = nMarkers;
+		refRigidBody.Markers  = createMarkers(nMarkers, id * 10.0f);
+		arrMarkerIDs.push_back(std::vector<int>(nMarkers));
+		for (int mIdx = 0; mIdx < nMarkers; mIdx++)
+		{
+			arrMarkerIDs.back()[mIdx] = id * 100 + mIdx;
+		}
+		refRigidBody.MarkerIDs = arrMarkerIDs.back().data();
+		refRigidBody.MeanError = 0.5f;
+	}
+};
+
+
+/**
+ * Creates a scene with large marker sets and many unidentified markers, plus some of every other element.
+ */
+static void createLargeFrame(sTestFrame& refTest, int iFrame)
+{
+	sFrameOfMocapData& refFrame = *refTest.pFrame;
+	refFrame.iFrame = iFrame;
+
+	const char* arrNames[] = { "Crowd", "Props", "all" };
+	const int   arrCounts[] = { LARGE_MARKER_COUNT, 1500, 20 };
+	refFrame.nMarkerSets = 3;
+	for (int msIdx = 0; msIdx < refFrame.nMarkerSets; msIdx++)
+	{
+		sMarkerSetData& refMarkerSet = refFrame.MocapData[msIdx];
+		strncpy_s(refMarkerSet.szName, arrNames[msIdx], sizeof(refMarkerSet.szName));
+		refMarkerSet.nMarkers = arrCounts[msIdx];
+		refMarkerSet.Markers  = refTest.createMarkers(arrCounts[msIdx], msIdx * 1000.0f);
+	}
+
+	refFrame.nOtherMarkers = LARGE_MARKER_COUNT;
+	refFrame.OtherMarkers  = refTest.createMarkers(LARGE_MARKER_COUNT, -500.0f);
+
+	refFrame.nRigidBodies = 50;
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		refTest.createRigidBody(refFrame.RigidBodies[rbIdx], rbIdx + 1, 6);
+	}
+
+	refFrame.nSkeletons = 20;
+	for (int skIdx = 0; skIdx < refFrame.nSkeletons; skIdx++)
+	{
+		sSkeletonData& refSkeleton = refFrame.Skeletons[skIdx];
+		refSkeleton.skeletonID   = skIdx + 1;
+		refSkeleton.nRigidBodies = 25;
+		refTest.arrBones.push_back(std::vector<sRigidBodyData>(refSkeleton.nRigidBodies));
+		refSkeleton.RigidBodyData = refTest.arrBones.back().data();
+		for (int bIdx = 0; bIdx < refSkeleton.nRigidBodies; bIdx++)
+		{
+			refTest.createRigidBody(refSkeleton.RigidBodyData[bIdx], (skIdx + 1) * 1000 + bIdx, 3);
+		}
+	}
+
+	refFrame.nLabeledMarkers = std::min(500, MAX_LABELED_MARKERS);
+	for (int mIdx = 0; mIdx < refFrame.nLabeledMarkers; mIdx++)
+	{
+		refFrame.LabeledMarkers[mIdx].ID = mIdx;
+		refFrame.LabeledMarkers[mIdx].x  = mIdx * 0.1f;
+	}
+
+	refFrame.nForcePlates = 2;
+	for (int fpIdx = 0; fpIdx < refFrame.nForcePlates; fpIdx++)
+	{
+		sForcePlateData& refPlate = refFrame.ForcePlates[fpIdx];
+		refPlate.ID        = fpIdx + 1;
+		refPlate.nChannels = 4;
+		for (int cIdx = 0; cIdx < refPlate.nChannels; cIdx++)
+		{
+			refPlate.ChannelData[cIdx].nFrames   = 1;
+			refPlate.ChannelData[cIdx].Values[0] = fpIdx + cIdx * 0.25f;
+		}
+	}
+
+	refFrame.fLatency   = 0.01f;
+	refFrame.Timecode   = 1234;
+	refFrame.fTimestamp = iFrame / 100.0;
+	refFrame.params     = 0x01;
+}
+
+
+/**
+ * Serialises a frame with the frame packet writer (NatNet 2.9 format).
+ *
+ * @return <code>true</code> if the frame fits into the packet size
+ */
+static bool serialiseFrame(const sFrameOfMocapData& refFrame, sPacket& refPacket, size_t maxPacketSize)
+{
+	const uint8_t arrVersion[4] = { 2, 9, 0, 0 };
+	FramePacketWriter writer(refPacket, arrVersion, maxPacketSize);
+
+	writer.beginFrame(refFrame.iFrame);
+	writer.beginMarkerSets(refFrame.nMarkerSets);
+	for (int msIdx = 0; msIdx < refFrame.nMarkerSets; msIdx++)
+	{
+		const sMarkerSetData& refMarkerSet = refFrame.MocapData[msIdx];
+		writer.beginMarkerSet(refMarkerSet.szName, refMarkerSet.nMarkers);
+		for (int mIdx = 0; mIdx < refMarkerSet.nMarkers; mIdx++)
+		{
+			writer.writeMarker(refMarkerSet.Markers[mIdx]);
+		}
+	}
+	writer.beginOtherMarkers(refFrame.nOtherMarkers);
+	for (int mIdx = 0; mIdx < refFrame.nOtherMarkers; mIdx++)
+	{
+		writer.writeMarker(refFrame.OtherMarkers[mIdx]);
+	}
+	writer.beginRigidBodies(refFrame.nRigidBodies);
+	for (int rbIdx = 0; rbIdx < refFrame.nRigidBodies; rbIdx++)
+	{
+		writer.writeRigidBody(refFrame.RigidBodies[rbIdx]);
+	}
+	writer.beginSkeletons(refFrame.nSkeletons);
+	for (int skIdx = 0; skIdx < refFrame.nSkeletons; skIdx++)
+	{
+		const sSkeletonData& refSkeleton = refFrame.Skeletons[skIdx];
+		writer.beginSkeleton(refSkeleton.skeletonID, refSkeleton.nRigidBodies);
+		for (int bIdx = 0; bIdx < refSkeleton.nRigidBodies; bIdx++)
+		{
+			writer.writeRigidBody(refSkeleton.RigidBodyData[bIdx]);
+		}
+	}
+	writer.beginLabeledMarkers(refFrame.nLabeledMarkers);
+	for (int mIdx = 0; mIdx < refFrame.nLabeledMarkers; mIdx++)
+	{
+		writer.writeLabeledMarker(refFrame.LabeledMarkers[mIdx]);
+	}
+	writer.beginForcePlates(refFrame.nForcePlates);
+	for (int fpIdx = 0; fpIdx < refFrame.nForcePlates; fpIdx++)
+	{
+		writer.writeForcePlate(refFrame.ForcePlates[fpIdx]);
+	}
+	return writer.endFrame(refFrame.fLatency, refFrame.Timecode, refFrame.TimecodeSubframe, refFrame.fTimestamp, refFrame.params);
+}
+
+
+static bool equalMarkers(const MarkerData* pMarkersA, const MarkerData* pMarkersB, int count)
+{
+	return (count == 0) || (memcmp(pMarkersA, pMarkersB, count * sizeof(MarkerData)) == 0);
+}
+
+
+static bool equalRigidBodies(const sRigidBodyData& refA, const sRigidBodyData& refB)
+{
+	return (refA.ID == refB.ID) && (refA.x == refB.x) && (refA.qw == refB.qw) &&
+	       (refA.nMarkers == refB.nMarkers) &&
+	       equalMarkers(refA.Markers, refB.Markers, refA.nMarkers) &&
+	       std::equal(refA.MarkerIDs, refA.MarkerIDs + refA.nMarkers, refB.MarkerIDs) &&
+	       (refA.MeanError == refB.MeanError);
+}
+
+
+/**
+ * Checks that a reassembled frame contains exactly the data of the original frame.
+ */
+static void checkEqualFrames(const sFrameOfMocapData& refOriginal, const sFrameOfMocapData& refResult)
+{
+	TEST_CHECK(refResult.iFrame == refOriginal.iFrame);
+	TEST_CHECK(refResult.params == refOriginal.params);
+	TEST_CHECK(refResult.Timecode == refOriginal.Timecode);
+	TEST_CHECK(refResult.fTimestamp == refOriginal.fTimestamp);
+
+	TEST_REQUIRE(refResult.nMarkerSets == refOriginal.nMarkerSets);
+	for (int msIdx = 0; msIdx < refOriginal.nMarkerSets; msIdx++)
+	{
+		const sMarkerSetData& refA = refOriginal.MocapData[msIdx];
+		const sMarkerSetData& refB = refResult.MocapData[msIdx];
+		TEST_CHECK(strcmp(refA.szName, refB.szName) == 0);
+		TEST_REQUIRE(refA.nMarkers == refB.nMarkers);
+		TEST_CHECK(equalMarkers(refA.Markers, refB.Markers, refA.nMarkers));
+	}
+
+	TEST_REQUIRE(refResult.nOtherMarkers == refOriginal.nOtherMarkers);
+	TEST_CHECK(equalMarkers(refOriginal.OtherMarkers, refResult.OtherMarkers, refOriginal.nOtherMarkers));
+
+	TEST_REQUIRE(refResult.nRigidBodies == refOriginal.nRigidBodies);
+	for (int rbIdx = 0; rbIdx < refOriginal.nRigidBodies; rbIdx++)
+	{
+		TEST_CHECK(equalRigidBodies(refOriginal.RigidBodies[rbIdx], refResult.RigidBodies[rbIdx]));
+	}
+
+	TEST_REQUIRE(refResult.nSkeletons == refOriginal.nSkeletons);
+	for (int skIdx = 0; skIdx < refOriginal.nSkeletons; skIdx++)
+	{
+		const sSkeletonData& refA = refOriginal.Skeletons[skIdx];
+		const sSkeletonData& refB = refResult.Skeletons[skIdx];
+		TEST_CHECK(refA.skeletonID == refB.skeletonID);
+		TEST_REQUIRE(refA.nRigidBodies == refB.nRigidBodies);
+		for (int bIdx = 0; bIdx < refA.nRigidBodies; bIdx++)
+		{
+			TEST_CHECK(equalRigidBodies(refA.RigidBodyData[bIdx], refB.RigidBodyData[bIdx]));
+		}
+	}
+
+	TEST_REQUIRE(refResult.nLabeledMarkers == refOriginal.nLabeledMarkers);
+	for (int mIdx = 0; mIdx < refOriginal.nLabeledMarkers; mIdx++)
+	{
+		TEST_CHECK((refResult.LabeledMarkers[mIdx].ID == refOriginal.LabeledMarkers[mIdx].ID) &&
+		           (refResult.LabeledMarkers[mIdx].x  == refOriginal.LabeledMarkers[mIdx].x));
+	}
+
+	TEST_REQUIRE(refResult.nForcePlates == refOriginal.nForcePlates);
+	for (int fpIdx = 0; fpIdx < refOriginal.nForcePlates; fpIdx++)
+	{
+		TEST_CHECK(memcmp(&refResult.ForcePlates[fpIdx], &refOriginal.ForcePlates[fpIdx], sizeof(sForcePlateData)) == 0);
+	}
+}
+
+
+/**
+ * A frame that fits into a packet is not split and passes the assembler unchanged.
+ */
+static void testSmallFrameIsNotSplit()
+{
+	sTestFrame test;
+	sFrameOfMocapData& refFrame = *test.pFrame;
+	refFrame.iFrame        = 7;
+	refFrame.nOtherMarkers = 10;
+	refFrame.OtherMarkers  = test.createMarkers(10, 0.0f);
+
+	FrameFragmenter fragmenter;
+	const std::vector<const sFrameOfMocapData*>& arrFragments = fragmenter.fragment(refFrame);
+	TEST_REQUIRE(arrFragments.size() == 1);
+	TEST_CHECK(arrFragments[0] == &refFrame);
+	TEST_CHECK((arrFragments[0]->params & FRAME_PARAMS_FRAGMENTED) == 0);
+
+	FrameAssembler assembler;
+	TEST_REQUIRE(assembler.addFragment(*arrFragments[0]));
+	checkEqualFrames(refFrame, assembler.getFrame());
+}
+
+
+/**
+ * A frame with 10k markers is split into fragments that each fit into a packet.
+ */
+static void testLargeFrameFragmentsFitIntoPackets()
+{
+	sTestFrame test;
+	createLargeFrame(test, 100);
+	const sFrameOfMocapData& refFrame = *test.pFrame;
+
+	std::unique_ptr<sPacket> pPacket(new sPacket());
+	TEST_CHECK(!serialiseFrame(refFrame, *pPacket, DEFAULT_MAX_FRAME_PACKET_SIZE));
+	TEST_CHECK(estimateFramePacketSize(refFrame) > DEFAULT_MAX_FRAME_PACKET_SIZE);
+
+	FrameFragmenter fragmenter(DEFAULT_MAX_FRAME_PACKET_SIZE);
+	const std::vector<const sFrameOfMocapData*>& arrFragments = fragmenter.fragment(refFrame);
+	TEST_REQUIRE(arrFragments.size() > 1);
+
+	int totalOtherMarkers = 0;
+	for (size_t fIdx = 0; fIdx < arrFragments.size(); fIdx++)
+	{
+		const sFrameOfMocapData& refFragment = *arrFragments[fIdx];
+		TEST_CHECK(refFragment.iFrame == refFrame.iFrame);
+		TEST_CHECK((refFragment.params & FRAME_PARAMS_FRAGMENTED) != 0);
+		TEST_CHECK((refFragment.TimecodeSubframe >> 16) == fIdx);
+		TEST_CHECK((refFragment.TimecodeSubframe & 0xFFFF) == arrFragments.size());
+		// the estimate is an upper bound of the real packet size
+		TEST_CHECK(estimateFramePacketSize(refFragment) <= DEFAULT_MAX_FRAME_PACKET_SIZE);
+		TEST_CHECK(serialiseFrame(refFragment, *pPacket, DEFAULT_MAX_FRAME_PACKET_SIZE));
+		TEST_CHECK(pPacket->nDataBytes <= estimateFramePacketSize(refFragment));
+		totalOtherMarkers += refFragment.nOtherMarkers;
+	}
+	TEST_CHECK(totalOtherMarkers == LARGE_MARKER_COUNT);
+}
+
+
+/**
+ * The maximum packet size is limited to what a packet and its 16 bit length can hold,
+ * so fragments never overflow the packet, whatever size is configured.
+ */
+static void testMaxPacketSizeIsLimited()
+{
+	const size_t packetLimit = std::min<size_t>(MAX_PACKETSIZE, 0xFFFF);
+
+	FrameFragmenter fragmenter;
+	fragmenter.setMaxPacketSize(10);
+	TEST_CHECK(fragmenter.getMaxPacketSize() == 1024);
+	fragmenter.setMaxPacketSize(1000000);
+	TEST_CHECK(fragmenter.getMaxPacketSize() == packetLimit);
+	fragmenter.setMaxPacketSize((size_t) -1); // a negative size converted to size_t
+	TEST_CHECK(fragmenter.getMaxPacketSize() == packetLimit);
+	TEST_CHECK(FrameFragmenter(1000000).getMaxPacketSize() == packetLimit);
+
+	sTestFrame test;
+	createLargeFrame(test, 100);
+	std::unique_ptr<sPacket> pPacket(new sPacket());
+	const std::vector<const sFrameOfMocapData*>& arrFragments = fragmenter.fragment(*test.pFrame);
+	TEST_REQUIRE(arrFragments.size() > 1);
+	for (const sFrameOfMocapData* pFragment : arrFragments)
+	{
+		TEST_CHECK(serialiseFrame(*pFragment, *pPacket, fragmenter.getMaxPacketSize()));
+	}
+}
+
+
+/**
+ * Fragments arriving in order are reassembled into the original frame.
+ */
+static void testReassembleInOrder()
+{
+	sTestFrame test;
+	createLargeFrame(test, 200);
+
+	FrameFragmenter fragmenter;
+	const std::vector<const sFrameOfMocapData*>& arrFragments = fragmenter.fragment(*test.pFrame);
+	TEST_REQUIRE(arrFragments.size() > 1);
+
+	FrameAssembler assembler;
+	for (size_t fIdx = 0; fIdx < arrFragments.size(); fIdx++)
+	{
+		bool complete = assembler.addFragment(*arrFragments[fIdx]);
+		TEST_CHECK(complete == (fIdx == arrFragments.size() - 1));
+	}
+	checkEqualFrames(*test.pFrame, assembler.getFrame());
+	TEST_CHECK(assembler.getIncompleteFrameCount() == 0);
+}
+
+
+/**
+ * Fragments arriving in any order (and duplicated) are reassembled into the original frame.
+ */
+static void testReassembleOutOfOrder()
+{
+	sTestFrame test;
+	createLargeFrame(test, 300);
+
+	FrameFragmenter fragmenter(8000); // smaller packets > more fragments to shuffle
+	std::vector<const sFrameOfMocapData*> arrFragments = fragmenter.fragment(*test.pFrame);
+	TEST_REQUIRE(arrFragments.size() > 10);
+
+	std::mt19937 random(42);
+	for (int run = 0; run < 5; run++)
+	{
+		std::shuffle(arrFragments.begin(), arrFragments.end(), random);
+
+		FrameAssembler assembler;
+		size_t completions = 0;
+		for (size_t fIdx = 0; fIdx < arrFragments.size(); fIdx++)
+		{
+			if (assembler.addFragment(*arrFragments[fIdx])) completions++;
+			if (fIdx == 0)
+			{
+				// a duplicate must not count towards completion
+				TEST_CHECK(!assembler.addFragment(*arrFragments[fIdx]));
+			}
+		}
+		TEST_CHECK(completions == 1);
+		checkEqualFrames(*test.pFrame, assembler.getFrame());
+	}
+}
+
+
+/**
+ * A frame with a missing fragment is discarded when the next frame arrives, which is still reassembled.
+ */
+static void testMissingFragment()
+{
+	sTestFrame testA;
+	sTestFrame testB;
+	createLargeFrame(testA, 400);
+	createLargeFrame(testB, 401);
+
+	FrameFragmenter fragmenterA;
+	FrameFragmenter fragmenterB;
+	const std::vector<const sFrameOfMocapData*>& arrFragmentsA = fragmenterA.fragment(*testA.pFrame);
+	const std::vector<const sFrameOfMocapData*>& arrFragmentsB = fragmenterB.fragment(*testB.pFrame);
+	TEST_REQUIRE(arrFragmentsA.size() > 2);
+
+	FrameAssembler assembler;
+	for (size_t fIdx = 0; fIdx < arrFragmentsA.size(); fIdx++)
+	{
+		if (fIdx == 1) continue; // lost on the network
+		TEST_CHECK(!assembler.addFragment(*arrFragmentsA[fIdx]));
+	}
+
+	bool complete = false;
+	for (size_t fIdx = 0; fIdx < arrFragmentsB.size(); fIdx++)
+	{
+		complete = assembler.addFragment(*arrFragmentsB[fIdx]);
+	}
+	TEST_CHECK(complete);
+	TEST_CHECK(assembler.getIncompleteFrameCount() == 1);
+	checkEqualFrames(*testB.pFrame, assembler.getFrame());
+
+	// the late fragment of the discarded frame does not complete anything
+	TEST_CHECK(!assembler.addFragment(*arrFragmentsA[1]));
+}
+
+
+/**
+ * Fragments with an invalid index or count are rejected.
+ */
+static void testInvalidFragment()
+{
+	sTestFrame test;
+	sFrameOfMocapData& refFrame = *test.pFrame;
+	refFrame.iFrame = 5;
+	refFrame.params = FRAME_PARAMS_FRAGMENTED;
+
+	FrameAssembler assembler;
+	refFrame.TimecodeSubframe = (3 << 16) | 2; // index 3 of 2
+	TEST_CHECK(!assembler.addFragment(refFrame));
+	refFrame.TimecodeSubframe = 0;             // no fragments
+	TEST_CHECK(!assembler.addFragment(refFrame));
+}
+
+
+int main()
+{
+	TEST_RUN(testSmallFrameIsNotSplit);
+	TEST_RUN(testLargeFrameFragmentsFitIntoPackets);
+	TEST_RUN(testMaxPacketSizeIsLimited);
+	TEST_RUN(testReassembleInOrder);
+	TEST_RUN(testReassembleOutOfOrder);
+	TEST_RUN(testMissingFragment);
+	TEST_RUN(testInvalidFragment);
+	return testResult();
+}
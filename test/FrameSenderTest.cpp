@@ -0,0 +1,189 @@
+/**
+ * Tests for sending frame packets on a separate thread (FrameSender.h),
+ * using the NatNet server stand-in in fake/NatNetServer.h.
+ */
+
+#include "TestFramework.h"
+
+#include "FrameSender.h"
+
+#include <chrono>
+#include <memory>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+TEST_MAIN_VARIABLES
+
+
+#define PACKET_DATA_SIZE 4000
+
+
+/**
+ * Creates the packets of a frame, each with the frame sequence number, the fragment index,
+ * and the fragment count at the start of its data.
+ */
+static std::shared_ptr<const FramePacketList> createFrame(uint32_t sequence, uint32_t fragments = 1)
+{
+	std::shared_ptr<FramePacketList> pFrame = std::make_shared<FramePacketList>();
+	for (uint32_t fIdx = 0; fIdx < fragments; fIdx++)
+	{
+		std::shared_ptr<sPacket> pPacket(new sPacket());
+		const uint32_t arrHeader[] = { sequence, fIdx, fragments };
+		pPacket->iMessage   = NAT_FRAMEOFDATA;
+		pPacket->nDataBytes = PACKET_DATA_SIZE;
+		memset(pPacket->Data.cData, 0, PACKET_DATA_SIZE);
+		memcpy(pPacket->Data.cData, arrHeader, sizeof(arrHeader));
+		pFrame->push_back(pPacket);
+	}
+	return pFrame;
+}
+
+
+/**
+ * Gets the frame sequence number, fragment index, or fragment count of a sent packet.
+ */
+static uint32_t getHeader(const std::vector<unsigned char>& refPacket, int field)
+{
+	uint32_t value;
+	memcpy(&value, refPacket.data() + sizeof(sPacket) - sizeof(sPacket::Data) + field * sizeof(value), sizeof(value)); // behind the packet header
+	return value;
+}
+
+static uint32_t getSequence(const std::vector<unsigned char>& refPacket) { return getHeader(refPacket, 0); }
+static uint32_t getFragment(const std::vector<unsigned char>& refPacket) { return getHeader(refPacket, 1); }
+static uint32_t getFragments(const std::vector<unsigned char>& refPacket) { return getHeader(refPacket, 2); }
+
+
+/**
+ * Waits until the server has not sent anything for a while.
+ */
+static void waitUntilIdle(NatNetServer& refServer)
+{
+	size_t calls = refServer.getSendCalls();
+	do
+	{
+		calls = refServer.getSendCalls();
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	} while (calls != refServer.getSendCalls());
+}
+
+
+/**
+ * Measures how long the producer spends in enqueue() while the server sends every packet to 1 or 50 clients.
+ * The producer latency has to stay flat, the sending time per packet grows with the clients.
+ */
+static void benchmarkEnqueueLatency()
+{
+	const int                       arrClientCounts[] = { 1, 50 };
+	const int                       frames            = 300;
+	const std::chrono::microseconds sendTimePerClient(10);
+	const std::chrono::microseconds frameInterval(1000);
+
+	std::vector<std::shared_ptr<const FramePacketList>> packets;
+	for (int fIdx = 0; fIdx < frames; fIdx++)
+	{
+		packets.push_back(createFrame(fIdx));
+	}
+
+	for (int clients : arrClientCounts)
+	{
+		NatNetServer server(clients, sendTimePerClient);
+		FrameSender  sender(server, "test clients");
+		TEST_REQUIRE(sender.start());
+
+		std::chrono::nanoseconds total(0), maximum(0);
+		std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+		for (auto& pPacket : packets)
+		{
+			std::this_thread::sleep_until(next);
+			next += frameInterval;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			sender.enqueue(pPacket);
+			std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - start;
+			total  += duration;
+			maximum = std::max(maximum, duration);
+		}
+		waitUntilIdle(server);
+		sender.stop();
+
+		std::chrono::microseconds sendTime = sendTimePerClient * clients;
+		long long average = (long long) (total.count() / frames);
+		std::cout << clients << " client(s): enqueue " << average << "ns average, " << maximum.count() << "ns max"
+			<< " (SendPacket takes " << sendTime.count() << "us, " << server.getSendCalls() << " calls)" << std::endl;
+
+		// the producer never waits for the network (with 50 clients, a blocking send would take 500us)
+		TEST_CHECK(std::chrono::nanoseconds(average) < std::chrono::microseconds(100));
+
+		// one SendPacket call per packet, the server delivers it to each client
+		std::vector<std::vector<unsigned char>> sent = server.getSentPackets();
+		TEST_REQUIRE(!sent.empty());
+		TEST_CHECK(server.getDeliveries() == sent.size() * clients);
+		TEST_CHECK(getSequence(sent.back()) == frames - 1); // the newest frame is never dropped
+		for (size_t pIdx = 1; pIdx < sent.size(); pIdx++)
+		{
+			TEST_CHECK(getSequence(sent[pIdx - 1]) < getSequence(sent[pIdx]));
+		}
+	}
+}
+
+
+/**
+ * When the sender can't keep up, whole frames are dropped:
+ * every frame that is sent arrives with all its fragments, in order,
+ * including frames with more fragments than the queue holds frames.
+ */
+static void testOverloadDropsWholeFrames()
+{
+	NatNetServer server(1, std::chrono::microseconds(300)); // slower than the frames come in
+	FrameSender  sender(server, "slow client");
+	sender.setQueueSize(8);
+	TEST_REQUIRE(sender.start());
+
+	const uint32_t frames = 200;
+	for (uint32_t fIdx = 0; fIdx < frames; fIdx++)
+	{
+		uint32_t fragments = 1 + (fIdx % 4);
+		if (fIdx % 50 == 49) fragments = 20; // more fragments than frames in the queue
+		sender.enqueue(createFrame(fIdx, fragments));
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	waitUntilIdle(server);
+	sender.stop();
+
+	std::vector<std::vector<unsigned char>> sent = server.getSentPackets();
+	TEST_REQUIRE(!sent.empty());
+
+	size_t   framesSent   = 0;
+	uint32_t lastSequence = 0;
+	size_t   pIdx         = 0;
+	while (pIdx < sent.size())
+	{
+		// fragments of a frame are sent back to back and completely
+		uint32_t sequence  = getSequence(sent[pIdx]);
+		uint32_t fragments = getFragments(sent[pIdx]);
+		TEST_REQUIRE(pIdx + fragments <= sent.size());
+		for (uint32_t fIdx = 0; fIdx < fragments; fIdx++)
+		{
+			TEST_CHECK(getSequence(sent[pIdx + fIdx]) == sequence);
+			TEST_CHECK(getFragment(sent[pIdx + fIdx]) == fIdx);
+		}
+		TEST_CHECK((framesSent == 0) || (sequence > lastSequence));
+		lastSequence = sequence;
+		pIdx += fragments;
+		framesSent++;
+	}
+
+	std::cout << framesSent << " of " << frames << " frames sent completely, the others were dropped" << std::endl;
+	TEST_CHECK(framesSent < frames);        // the overload really dropped frames
+	TEST_CHECK(lastSequence == frames - 1); // the newest frame (with 20 fragments) is sent whole
+}
+
+
+int main()
+{
+	TEST_RUN(benchmarkEnqueueLatency);
+	TEST_RUN(testOverloadDropsWholeFrames);
+	return testResult();
+}
@@ -0,0 +1,277 @@
+/**
+ * Tests for reading XML files (XmlReader.h) and the interaction device profiles compiled from them (InteractionDeviceProfile.h).
+ */
+
+#include "TestFramework.h"
+
+#include "InteractionDeviceProfile.h"
+#include "XmlReader.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+TEST_MAIN_VARIABLES
+
+
+#define JOYSTICK_FILENAME  HARDWARE_DIRECTORY "/InteractionDevice_Joystick1.xml"
+#define JOYSTICK_CHANNELS  8
+#define MALFORMED_FILENAME "InteractionDeviceProfileTest.xml"
+
+
+/**
+ * Decodes the pin state of the joystick the way the MotionServer did before the device profiles,
+ * with button1-6 and axis1-2 in the channel order of the profile.
+ */
+static void decodeLegacyJoystick(uint16_t pins, float arrValues[JOYSTICK_CHANNELS])
+{
+	uint8_t pinState  = (uint8_t) (pins & 0x00FF); // only use lower 8 bits
+
+	bool btnPrimary   = (pinState & 0x04) == 0; // pin 2: Primary Fire pressed
+	bool btnSecondary = (pinState & 0x08) == 0; // pin 3: Secondary Fire pressed
+	bool btnThumb     = (pinState & 0x40) == 0; // pin 6: Thumb buttons pressed
+	bool btnStick     = (pinState & 0x80) == 0; // pin 7: Thumbstick moved
+	uint8_t bitsThumb = (pinState & 0x30) >> 4; // pins 4 and 5: encoded thumb button/stick direction
+
+	arrValues[0] = btnPrimary   ? 1.0f : 0;
+	arrValues[1] = btnSecondary ? 1.0f : 0;
+
+	arrValues[2] = (btnThumb & (bitsThumb == 3)) ? 1.0f : 0; // BL
+	arrValues[3] = (btnThumb & (bitsThumb == 2)) ? 1.0f : 0; // BR
+	arrValues[4] = (btnThumb & (bitsThumb == 1)) ? 1.0f : 0; // TL
+	arrValues[5] = (btnThumb & (bitsThumb == 0)) ? 1.0f : 0; // TR
+
+	float x = 0;
+	float y = 0;
+	if (btnStick)
+	{
+		switch (bitsThumb)
+		{
+			case 0: y = +1; break; // forward
+			case 1: x = -1; break; // left
+			case 2: x = +1; break; // right
+			case 3: y = -1; break; // backwards
+		}
+	}
+	arrValues[6] = x;
+	arrValues[7] = y;
+}
+
+
+/**
+ * Decodes a pin state with the digital rules of a profile, like InteractionDevice_XBee::update().
+ */
+static std::vector<float> decodeProfile(const InteractionDeviceProfile& refProfile, uint16_t pins)
+{
+	std::vector<float> arrValues(refProfile.getChannelNames().size(), 0.0f);
+	for (auto& rule : refProfile.getDigitalRules())
+	{
+		arrValues[rule.channel] += ((pins & rule.mask) == rule.pattern) ? rule.value : 0.0f;
+	}
+	return arrValues;
+}
+
+
+/**
+ * Checks that a profile decodes all 256 states of the lower pins like the legacy joystick code.
+ *
+ * @return <code>true</code> if all states decode the same
+ */
+static bool decodesLikeLegacyJoystick(const InteractionDeviceProfile& refProfile)
+{
+	if (refProfile.getChannelNames().size() != JOYSTICK_CHANNELS) return false;
+
+	size_t mismatches = 0;
+	for (uint16_t pins = 0; pins < 0x100; pins++)
+	{
+		float arrLegacy[JOYSTICK_CHANNELS];
+		decodeLegacyJoystick(pins, arrLegacy);
+
+		// the upper pins are not connected and must not make a difference
+		const uint16_t arrPinStates[] = { pins, (uint16_t) (pins | 0x1F00) };
+		for (uint16_t pinState : arrPinStates)
+		{
+			std::vector<float> arrDecoded = decodeProfile(refProfile, pinState);
+			for (size_t chnIdx = 0; chnIdx < JOYSTICK_CHANNELS; chnIdx++)
+			{
+				if (arrDecoded[chnIdx] != arrLegacy[chnIdx])
+				{
+					std::cout << "Pins " << std::hex << pinState << std::dec << ", " << refProfile.getChannelNames()[chnIdx]
+						<< ": " << arrDecoded[chnIdx] << " instead of " << arrLegacy[chnIdx] << std::endl;
+					mismatches++;
+				}
+			}
+		}
+	}
+	return mismatches == 0;
+}
+
+
+/**
+ * The joystick profile in the Hardware folder decodes every pin state like the legacy joystick code.
+ */
+static void testHardwareFileMatchesLegacyDecoding()
+{
+	std::vector<InteractionDeviceProfile> arrProfiles;
+	TEST_REQUIRE(InteractionDeviceProfile::loadFile(JOYSTICK_FILENAME, arrProfiles) == 1);
+
+	const InteractionDeviceProfile& profile = arrProfiles[0];
+	TEST_CHECK(profile.getType() == "Joystick");
+	TEST_CHECK(profile.matches("Joystick1"));
+	TEST_CHECK(!profile.matches("Coordinator"));
+	TEST_CHECK(profile.getAnalogRules().empty());
+
+	const char* arrNames[] = { "button1", "button2", "button3", "button4", "button5", "button6", "axis1", "axis2" };
+	TEST_REQUIRE(profile.getChannelNames().size() == JOYSTICK_CHANNELS);
+	for (size_t chnIdx = 0; chnIdx < JOYSTICK_CHANNELS; chnIdx++)
+	{
+		TEST_CHECK(profile.getChannelNames()[chnIdx] == arrNames[chnIdx]);
+	}
+
+	TEST_CHECK(decodesLikeLegacyJoystick(profile));
+}
+
+
+/**
+ * The built-in profiles are the same as the joystick profile in the Hardware folder.
+ */
+static void testDefaultProfilesMatchHardwareFile()
+{
+	std::vector<InteractionDeviceProfile> arrDefault, arrFile;
+	InteractionDeviceProfile::getDefaultProfiles(arrDefault);
+	TEST_REQUIRE(arrDefault.size() == 1);
+	TEST_REQUIRE(InteractionDeviceProfile::loadFile(JOYSTICK_FILENAME, arrFile) == 1);
+
+	const InteractionDeviceProfile& refDefault = arrDefault[0];
+	const InteractionDeviceProfile& refFile    = arrFile[0];
+	TEST_CHECK(refDefault.getType()          == refFile.getType());
+	TEST_CHECK(refDefault.matches("Joystick1"));
+	TEST_CHECK(refDefault.getChannelNames()  == refFile.getChannelNames());
+	TEST_CHECK(refDefault.getDebounceTimes() == refFile.getDebounceTimes());
+	TEST_CHECK(refDefault.getAnalogRules().size() == refFile.getAnalogRules().size());
+
+	TEST_REQUIRE(refDefault.getDigitalRules().size() == refFile.getDigitalRules().size());
+	for (size_t rIdx = 0; rIdx < refFile.getDigitalRules().size(); rIdx++)
+	{
+		const InteractionDeviceProfile::sDigitalRule& refA = refDefault.getDigitalRules()[rIdx];
+		const InteractionDeviceProfile::sDigitalRule& refB = refFile.getDigitalRules()[rIdx];
+		TEST_CHECK((refA.mask == refB.mask) && (refA.pattern == refB.pattern) && (refA.channel == refB.channel) && (refA.value == refB.value));
+	}
+
+	TEST_CHECK(decodesLikeLegacyJoystick(refDefault));
+}
+
+
+/**
+ * Malformed documents are rejected with an error message that names the problem and the line.
+ */
+static void testMalformedXml()
+{
+	struct sMalformed
+	{
+		const char* szXml;
+		const char* szError;
+	};
+
+	const sMalformed arrMalformed[] =
+	{
+		{ "",                                      "Root element expected (line 1)" },
+		{ "just text",                             "Root element expected (line 1)" },
+		{ "< a/>",                                 "Name expected (line 1)" },
+		{ "<a>",                                   "</a> missing (line 1)" },
+		{ "<a>\n<b>\n</a>",                        "</b> expected (line 3)" },
+		{ "<a></a",                                "'>' expected (line 1)" },
+		{ "<a x/>",                                "'=' expected after attribute x (line 1)" },
+		{ "<a x=1/>",                              "Quoted attribute value expected (line 1)" },
+		{ "<a x='1/>",                             "Unterminated attribute value (line 1)" },
+		{ "<a/>\n<b/>",                            "Content after the root element (line 2)" },
+		{ "<a>\n<!-- comment\n</a>",               "'-->' missing (line 2)" },
+		{ "<a><![CDATA[text</a>",                  "Unterminated CDATA section (line 1)" },
+		{ "<?xml version='1.0'",                   "'?>' missing (line 1)" },
+		{ "<!DOCTYPE a",                           "'>' missing (line 1)" },
+		{ "<a><b x='1' y='2'><c></b></a>",         "</c> expected (line 1)" },
+	};
+
+	XmlReader reader;
+	for (auto& malformed : arrMalformed)
+	{
+		XmlElement root;
+		TEST_CHECK(!reader.parse(malformed.szXml, root));
+		if (reader.getError() != malformed.szError)
+		{
+			std::cout << "'" << malformed.szXml << "': '" << reader.getError() << "' instead of '" << malformed.szError << "'" << std::endl;
+		}
+		TEST_CHECK(reader.getError() == malformed.szError);
+	}
+
+	// the reader can be used again after an error
+	XmlElement root;
+	TEST_REQUIRE(reader.parse("<a x='&lt;1&#x41;'><b/>text</a>", root));
+	TEST_CHECK(reader.getError().empty());
+	TEST_CHECK(root.getAttribute("x") == "<1A");
+	TEST_CHECK(root.text == "text");
+	TEST_REQUIRE(root.getChild("b") != NULL);
+}
+
+
+/**
+ * Every truncation of a valid file is rejected without reading beyond the end of the document.
+ */
+static void testTruncatedXml()
+{
+	std::ifstream file(JOYSTICK_FILENAME, std::ios::binary);
+	TEST_REQUIRE(file.is_open());
+	std::string strXml((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	XmlReader  reader;
+	XmlElement root;
+	TEST_REQUIRE(reader.parse(strXml, root));
+	TEST_CHECK(root.name == "data");
+
+	size_t end = strXml.rfind('>'); // the end of the root element
+	TEST_REQUIRE(end != std::string::npos);
+	size_t accepted = 0;
+	for (size_t length = 0; length <= end; length++)
+	{
+		if (reader.parse(strXml.substr(0, length), root)) accepted++;
+	}
+	TEST_CHECK(accepted == 0);
+}
+
+
+/**
+ * Files that can't be read or parsed add no profiles, and the error names the file.
+ */
+static void testMalformedProfileFile()
+{
+	std::vector<InteractionDeviceProfile> arrProfiles;
+	TEST_CHECK(InteractionDeviceProfile::loadFile("does not exist.xml", arrProfiles) == 0);
+
+	XmlReader  reader;
+	XmlElement root;
+	TEST_CHECK(!reader.load("does not exist.xml", root));
+	TEST_CHECK(reader.getError() == "Could not open does not exist.xml");
+
+	{
+		std::ofstream file(MALFORMED_FILENAME);
+		file << "<interaction>\n  <device type='Joystick'>\n    <channel name='button1'> <digital D2='0' value='1' />\n  </device>\n</interaction>\n";
+	}
+	TEST_CHECK(!reader.load(MALFORMED_FILENAME, root));
+	TEST_CHECK(reader.getError() == MALFORMED_FILENAME ": </channel> expected (line 4)");
+	TEST_CHECK(InteractionDeviceProfile::loadFile(MALFORMED_FILENAME, arrProfiles) == 0);
+	TEST_CHECK(arrProfiles.empty());
+
+	std::remove(MALFORMED_FILENAME);
+}
+
+
+int main()
+{
+	TEST_RUN(testHardwareFileMatchesLegacyDecoding);
+	TEST_RUN(testDefaultProfilesMatchHardwareFile);
+	TEST_RUN(testMalformedXml);
+	TEST_RUN(testTruncatedXml);
+	TEST_RUN(testMalformedProfileFile);
+	return testResult();
+}
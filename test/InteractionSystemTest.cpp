@@ -0,0 +1,590 @@
+/**
+ * Tests for finding the coordinator and for receiving, dispatching, and decoding XBee packets (XBeeDevice.h, InteractionSystem.h),
+ * talking to the XBee emulator (XBeeEmulator.h) through a pseudo terminal and the POSIX serial port.
+ */
+
+#include "TestFramework.h"
+
+#include "InteractionSystem.h"
+#include "XBeeEmulator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <poll.h>
+#include <stdlib.h>
+#include <sstream>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+TEST_MAIN_VARIABLES
+
+
+#define CAPTURE_FILENAME   "InteractionSystemTest.txt"
+#define COORDINATOR_SERIAL 0x0013A20040000001ULL // reported by the emulator
+
+#define SERIAL_A           0x0013A20040A1B2C3ULL
+#define ADDRESS_A          0x1234
+#define SERIAL_B           0x0013A20040D4E5F6ULL
+#define ADDRESS_B          0x5678
+#define ADDRESS_UNKNOWN    0x9999
+
+// joystick pins D2-D7, low active
+#define PINS_RELEASED      0x00FC
+#define PINS_BUTTON1       0x00F8 // D2 low
+#define PINS_BUTTON2       0x00F4 // D3 low
+#define PINS_ALL_LOW       0x0000
+
+
+typedef std::vector<uint8_t> Bytes;
+
+static std::atomic<int> sceneChanges(0);
+
+
+// the parts of the main program that the interaction system uses (see MotionServerMain.cpp)
+void signalSceneChange()
+{
+	sceneChanges++;
+}
+
+
+static void addUInt16(Bytes& refData, uint16_t value)
+{
+	refData.push_back((uint8_t) (value >> 8));
+	refData.push_back((uint8_t) (value & 0xFF));
+}
+
+
+static void addUInt64(Bytes& refData, uint64_t value)
+{
+	for (int shift = 56; shift >= 0; shift -= 8)
+	{
+		refData.push_back((uint8_t) (value >> shift));
+	}
+}
+
+
+/**
+ * Writes a frame (delimiter, length, payload, checksum) as a line of the capture file.
+ */
+static void writeFrame(std::ostream& refCapture, uint32_t delay, const Bytes& refPayload)
+{
+	Bytes frame;
+	frame.push_back((uint8_t) XBeePacket::START_DELIMITER);
+	addUInt16(frame, (uint16_t) refPayload.size());
+	uint8_t sum = 0;
+	for (uint8_t value : refPayload)
+	{
+		frame.push_back(value);
+		sum += value;
+	}
+	frame.push_back(0xFF - sum);
+
+	refCapture << std::dec << delay;
+	for (uint8_t value : frame)
+	{
+		refCapture << " " << std::hex << std::setw(2) << std::setfill('0') << (int) value;
+	}
+	refCapture << std::endl;
+}
+
+
+/**
+ * Creates an IO sample (frame type 0x92) with the state of the digital pins D2-D7.
+ */
+static Bytes createSample(uint64_t serial, uint16_t address, uint16_t pins)
+{
+	Bytes payload;
+	payload.push_back((uint8_t) XBeePacket_IO_DataSample::FRAME_TYPE_ID); // by value, the constant has no definition
+	addUInt64(payload, serial);
+	addUInt16(payload, address);
+	payload.push_back(0x01); // options
+	payload.push_back(0x01); // sample count
+	addUInt16(payload, PINS_RELEASED); // digital mask
+	payload.push_back(0x00);           // analog mask
+	addUInt16(payload, pins);
+	return payload;
+}
+
+
+/**
+ * Creates a response to an AT command of the coordinator, e.g., a late answer.
+ */
+static Bytes createResponse(const char* szCommand, uint16_t value)
+{
+	Bytes payload;
+	payload.push_back((uint8_t) XBeePacket_AT_CommandResponse::FRAME_TYPE_ID); // by value, the constant has no definition
+	payload.push_back(0x00); // frame ID
+	payload.push_back((uint8_t) szCommand[0]);
+	payload.push_back((uint8_t) szCommand[1]);
+	payload.push_back(0x00); // status OK
+	addUInt16(payload, value);
+	return payload;
+}
+
+
+/**
+ * Creates a response to an AT command sent to a remote device.
+ */
+static Bytes createRemoteResponse(uint64_t serial, uint16_t address, const char* szCommand, uint16_t value)
+{
+	Bytes payload;
+	payload.push_back((uint8_t) XBeePacket_RemoteAT_CommandResponse::FRAME_TYPE_ID); // by value, the constant has no definition
+	payload.push_back(0x00); // frame ID
+	addUInt64(payload, serial);
+	addUInt16(payload, address);
+	payload.push_back((uint8_t) szCommand[0]);
+	payload.push_back((uint8_t) szCommand[1]);
+	payload.push_back(0x00); // status OK
+	addUInt16(payload, value);
+	return payload;
+}
+
+
+/**
+ * Receives the next packet, skipping read timeouts and unhandled frame types.
+ *
+ * @return the packet or <code>NULL</code> if nothing arrived for a while
+ */
+static const XBeePacket_Receive* receivePacket(XBeeCoordinator& refCoordinator)
+{
+	for (int attempt = 0; attempt < 20; attempt++)
+	{
+		const XBeePacket_Receive* pPacket = refCoordinator.receive();
+		if (pPacket != NULL) return pPacket;
+	}
+	return NULL;
+}
+
+
+/**
+ * The coordinator receives IO samples with AT responses, remote AT responses, and unhandled frames in between,
+ * each as the packet class of its frame type.
+ */
+static void testCoordinatorReceive()
+{
+	{
+		std::ofstream capture(CAPTURE_FILENAME);
+		writeFrame(capture, 1, createSample(SERIAL_A, ADDRESS_A, PINS_BUTTON1));
+		writeFrame(capture, 1, createResponse("VR", 0x21A7));
+		writeFrame(capture, 1, Bytes{ 0x8A, 0x02 }); // modem status: not handled
+		writeFrame(capture, 1, createRemoteResponse(SERIAL_A, ADDRESS_A, "%V", 0x0B00));
+		writeFrame(capture, 1, createSample(SERIAL_A, ADDRESS_A, PINS_RELEASED));
+	}
+
+	XBeeEmulator emulator;
+	TEST_REQUIRE(emulator.loadCapture(CAPTURE_FILENAME));
+	TEST_REQUIRE(emulator.start());
+
+	SerialPort      port(emulator.getDeviceName());
+	XBeeCoordinator coordinator(port);
+	TEST_REQUIRE(coordinator.isValid());
+	TEST_CHECK(coordinator.getSerialNumber() == COORDINATOR_SERIAL);
+	TEST_CHECK(coordinator.getName() == "Emulator");
+
+	// the discovery answer comes first, then the capture is replayed in a loop
+	TEST_REQUIRE(coordinator.startDiscovery());
+	const XBeePacket_Receive* pPacket = receivePacket(coordinator);
+	TEST_REQUIRE(pPacket != NULL);
+	TEST_REQUIRE(pPacket->getFrameTypeID() == XBeePacket_AT_CommandResponse::FRAME_TYPE_ID);
+	TEST_CHECK(((const XBeePacket_AT_CommandResponse*) pPacket)->getCommand() == "ND");
+
+	for (int loop = 0; loop < 2; loop++)
+	{
+		pPacket = receivePacket(coordinator);
+		TEST_REQUIRE((pPacket != NULL) && (pPacket->getFrameTypeID() == XBeePacket_IO_DataSample::FRAME_TYPE_ID));
+		const XBeePacket_IO_DataSample* pSample = (const XBeePacket_IO_DataSample*) pPacket;
+		TEST_CHECK(pSample->getSerialNumber() == SERIAL_A);
+		TEST_CHECK(pSample->getNetworkAddress() == ADDRESS_A);
+		TEST_CHECK(pSample->getDigitalInputMask() == PINS_RELEASED);
+		TEST_CHECK(pSample->getDigitalInputState() == PINS_BUTTON1);
+
+		pPacket = receivePacket(coordinator);
+		TEST_REQUIRE((pPacket != NULL) && (pPacket->getFrameTypeID() == XBeePacket_AT_CommandResponse::FRAME_TYPE_ID));
+		const XBeePacket_AT_CommandResponse* pResponse = (const XBeePacket_AT_CommandResponse*) pPacket;
+		TEST_CHECK(pResponse->getCommand() == "VR");
+		TEST_CHECK(pResponse->isOK());
+		TEST_CHECK(pResponse->getInt16() == 0x21A7);
+
+		// the unhandled frame is skipped
+		pPacket = receivePacket(coordinator);
+		TEST_REQUIRE((pPacket != NULL) && (pPacket->getFrameTypeID() == XBeePacket_RemoteAT_CommandResponse::FRAME_TYPE_ID));
+		const XBeePacket_RemoteAT_CommandResponse* pRemote = (const XBeePacket_RemoteAT_CommandResponse*) pPacket;
+		TEST_CHECK(pRemote->getSerialNumber() == SERIAL_A);
+		TEST_CHECK(pRemote->getNetworkAddress() == ADDRESS_A);
+		TEST_CHECK(pRemote->getCommand() == "%V");
+		TEST_CHECK(pRemote->getInt16() == 0x0B00);
+
+		pPacket = receivePacket(coordinator);
+		TEST_REQUIRE((pPacket != NULL) && (pPacket->getFrameTypeID() == XBeePacket_IO_DataSample::FRAME_TYPE_ID));
+		TEST_CHECK(((const XBeePacket_IO_DataSample*) pPacket)->getDigitalInputState() == PINS_RELEASED);
+	}
+
+	// waiting for a specific packet skips the others
+	XBeePacket_RemoteAT_CommandResponse remote;
+	coordinator.setNumberOfRetries(10);
+	TEST_CHECK(coordinator.receive(remote));
+	TEST_CHECK(remote.getSerialNumber() == SERIAL_A);
+	TEST_CHECK(remote.getCommand() == "%V");
+
+	emulator.stop();
+	std::remove(CAPTURE_FILENAME);
+}
+
+
+/**
+ * Checks the channels of a joystick: all released, or only the given one pressed.
+ */
+static bool isJoystickState(const sForcePlateData& refPlate, size_t sample, int pressedChannel)
+{
+	bool released = true;
+	bool pressed  = true;
+	for (int chnIdx = 0; chnIdx < refPlate.nChannels; chnIdx++)
+	{
+		float value = refPlate.ChannelData[chnIdx].Values[sample];
+		released &= (value == 0);
+		pressed  &= (value == ((chnIdx == pressedChannel) ? 1 : 0));
+	}
+	return released || pressed;
+}
+
+
+/**
+ * The receiver thread hands IO samples to the device with the sender's address:
+ * samples from an address that was not discovered and AT responses in between change no device.
+ */
+static void testAddressDispatch()
+{
+	{
+		std::ofstream capture(CAPTURE_FILENAME);
+		for (int repeat = 0; repeat < 4; repeat++)
+		{
+			writeFrame(capture, 2, createSample(SERIAL_A, ADDRESS_A, PINS_BUTTON1));
+			writeFrame(capture, 2, createSample(SERIAL_B, ADDRESS_B, PINS_BUTTON2));
+			// e.g., device A after rejoining the network with a new address, before the next discovery
+			writeFrame(capture, 2, createSample(SERIAL_A, ADDRESS_UNKNOWN, PINS_ALL_LOW));
+			writeFrame(capture, 2, createResponse("VR", 0x21A7));
+			writeFrame(capture, 2, createRemoteResponse(SERIAL_B, ADDRESS_B, "IR", 0x0000));
+		}
+	}
+
+	XBeeEmulator emulator;
+	TEST_REQUIRE(emulator.loadCapture(CAPTURE_FILENAME));
+	TEST_REQUIRE(emulator.getDeviceCount() == 2);
+	TEST_REQUIRE(emulator.start());
+
+	std::unique_ptr<SerialPort> pPort(new SerialPort(emulator.getDeviceName()));
+	InteractionSystem system(pPort);
+	system.setDiscoveryInterval(0);
+	TEST_REQUIRE(system.initialise());
+
+	MoCapData data;
+	system.getSceneDescription(data);
+
+	// stream frames until both joysticks have sent plenty of samples
+	const int                  arrPressed[] = { 0, 1 }; // button1 for A, button2 for B
+	size_t                     arrSamples[] = { 0, 0 };
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (((arrSamples[0] < 50) || (arrSamples[1] < 50)) && (std::chrono::steady_clock::now() < end))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		system.getFrameData(data);
+		for (int plateIdx = 0; plateIdx < data.frame.nForcePlates; plateIdx++)
+		{
+			const sForcePlateData& refPlate = data.frame.ForcePlates[plateIdx];
+			TEST_REQUIRE((refPlate.ID == 1) || (refPlate.ID == 2));
+			int nSamples = refPlate.ChannelData[0].nFrames;
+			for (int sIdx = 0; sIdx < nSamples; sIdx++)
+			{
+				TEST_CHECK(isJoystickState(refPlate, sIdx, arrPressed[refPlate.ID - 1]));
+			}
+			arrSamples[refPlate.ID - 1] += nSamples;
+		}
+	}
+	TEST_CHECK(arrSamples[0] >= 50);
+	TEST_CHECK(arrSamples[1] >= 50);
+
+	// both joysticks were added to the scene
+	TEST_CHECK(sceneChanges > 0);
+	TEST_REQUIRE(data.description.nDataDescriptions == 2);
+	TEST_CHECK(strcmp(data.description.arrDataDescriptions[0].Data.ForcePlateDescription->strSerialNo, "Joystick 1") == 0);
+	TEST_CHECK(strcmp(data.description.arrDataDescriptions[1].Data.ForcePlateDescription->szChannelNames[1], "button2") == 0);
+
+	system.deinitialise();
+	emulator.stop();
+	std::remove(CAPTURE_FILENAME);
+}
+
+
+/**
+ * Samples that queued up while nobody was streaming are not streamed late:
+ * the first frame after a pause only carries the samples of the last frame period.
+ */
+static void testPauseDiscardsStaleSamples()
+{
+	{
+		std::ofstream capture(CAPTURE_FILENAME);
+		writeFrame(capture, 2, createSample(SERIAL_A, ADDRESS_A, PINS_BUTTON1));
+		writeFrame(capture, 2, createSample(SERIAL_A, ADDRESS_A, PINS_RELEASED));
+	}
+
+	XBeeEmulator emulator;
+	TEST_REQUIRE(emulator.loadCapture(CAPTURE_FILENAME));
+	TEST_REQUIRE(emulator.start());
+
+	std::unique_ptr<SerialPort> pPort(new SerialPort(emulator.getDeviceName()));
+	InteractionSystem system(pPort);
+	system.setDiscoveryInterval(0);
+	TEST_REQUIRE(system.initialise());
+
+	MoCapData data;
+	system.getSceneDescription(data);
+
+	// regular streaming until the joystick is there
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	size_t samples = 0;
+	while ((samples < 50) && (std::chrono::steady_clock::now() < end))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		system.getFrameData(data);
+		if (data.frame.nForcePlates > 0) samples += data.frame.ForcePlates[0].ChannelData[0].nFrames;
+	}
+	TEST_REQUIRE(samples >= 50);
+
+	// pause long enough for the sample queue to fill up
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	system.getFrameData(data);
+	TEST_REQUIRE(data.frame.nForcePlates == 1);
+	int nSamples = data.frame.ForcePlates[0].ChannelData[0].nFrames;
+	std::cout << nSamples << " samples in the first frame after the pause" << std::endl;
+	TEST_CHECK(nSamples >= 1);
+	TEST_CHECK(nSamples <= 10); // a frame period of about 10ms at one sample per 2ms
+
+	// none of the streamed samples waited through the pause
+	std::ostringstream statistics;
+	system.printLatencyStatistics(statistics);
+	std::string text = statistics.str();
+	size_t      pos  = text.find("Maximum latency: ");
+	TEST_REQUIRE(pos != std::string::npos);
+	long maxLatency = strtol(text.c_str() + pos + strlen("Maximum latency: "), NULL, 10);
+	std::cout << "Maximum latency: " << maxLatency << "us" << std::endl;
+	TEST_CHECK(maxLatency < 500000);
+
+	system.deinitialise();
+	emulator.stop();
+	std::remove(CAPTURE_FILENAME);
+}
+
+
+/**
+ * States of a joystick in the replayed session and how the joystick profile decodes them.
+ */
+struct sJoystickState
+{
+	uint16_t pins;
+	int      channel; // -1: all released
+	float    value;
+};
+
+static const sJoystickState JOYSTICK_SESSION[] =
+{
+	{ PINS_RELEASED, -1,  0 },
+	{ 0x00F8,         0,  1 }, // button1: D2 low
+	{ 0x00F4,         1,  1 }, // button2: D3 low
+	{ 0x00BC,         2,  1 }, // button3: D6 low, D4 high, D5 high
+	{ 0x00AC,         3,  1 }, // button4: D6 low, D4 low,  D5 high
+	{ 0x009C,         4,  1 }, // button5: D6 low, D4 high, D5 low
+	{ 0x008C,         5,  1 }, // button6: D6 low, D4 low,  D5 low
+	{ 0x005C,         6, -1 }, // axis1 left:  D7 low, D4 high, D5 low
+	{ 0x006C,         6,  1 }, // axis1 right: D7 low, D4 low,  D5 high
+	{ 0x004C,         7,  1 }, // axis2 up:    D7 low, D4 low,  D5 low
+	{ 0x007C,         7, -1 }, // axis2 down:  D7 low, D4 high, D5 high
+};
+
+#define JOYSTICK_STATES      (sizeof(JOYSTICK_SESSION) / sizeof(JOYSTICK_SESSION[0]))
+#define JOYSTICK_CHANNELS    8
+#define SAMPLES_PER_STATE    4
+
+
+/**
+ * Finds the state of the session that a sample of the force plate channels was decoded from.
+ *
+ * @return the index of the state or -1 if the values match no state
+ */
+static int findJoystickState(const sForcePlateData& refPlate, int sample)
+{
+	for (size_t stateIdx = 0; stateIdx < JOYSTICK_STATES; stateIdx++)
+	{
+		const sJoystickState& refState = JOYSTICK_SESSION[stateIdx];
+		bool matches = true;
+		for (int chnIdx = 0; chnIdx < refPlate.nChannels; chnIdx++)
+		{
+			float expected = (chnIdx == refState.channel) ? refState.value : 0;
+			matches &= (refPlate.ChannelData[chnIdx].Values[sample] == expected);
+		}
+		if (matches) return (int) stateIdx;
+	}
+	return -1;
+}
+
+
+/**
+ * A captured joystick session is replayed through the emulator into the initialised system:
+ * every sample streamed as a force plate subframe is decoded by the joystick profile,
+ * and the states come out in the order of the capture.
+ */
+static void testReplayedSession()
+{
+	{
+		std::ofstream capture(CAPTURE_FILENAME);
+		capture << "# joystick session: every button and axis direction, each held for a few samples" << std::endl;
+		for (const sJoystickState& refState : JOYSTICK_SESSION)
+		{
+			for (int sIdx = 0; sIdx < SAMPLES_PER_STATE; sIdx++)
+			{
+				writeFrame(capture, 5, createSample(SERIAL_A, ADDRESS_A, refState.pins));
+			}
+		}
+	}
+
+	XBeeEmulator emulator;
+	TEST_REQUIRE(emulator.loadCapture(CAPTURE_FILENAME));
+	TEST_REQUIRE(emulator.start());
+
+	std::unique_ptr<SerialPort> pPort(new SerialPort(emulator.getDeviceName()));
+	InteractionSystem system(pPort);
+	system.setDiscoveryInterval(0);
+	TEST_REQUIRE(system.initialise());
+	TEST_CHECK(system.getPortName() == emulator.getDeviceName());
+
+	MoCapData data;
+	system.getSceneDescription(data);
+
+	// stream until the session has been replayed twice
+	std::vector<int> arrStates; // sequence of the decoded states, without repetitions
+	size_t           samples = 0;
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while ((arrStates.size() < 2 * JOYSTICK_STATES + 1) && (std::chrono::steady_clock::now() < end))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		system.getFrameData(data);
+		if (data.frame.nForcePlates == 0) continue;
+
+		const sForcePlateData& refPlate = data.frame.ForcePlates[0];
+		TEST_REQUIRE(refPlate.ID == 1);
+		TEST_REQUIRE(refPlate.nChannels == JOYSTICK_CHANNELS);
+		for (int sIdx = 0; sIdx < refPlate.ChannelData[0].nFrames; sIdx++)
+		{
+			int state = findJoystickState(refPlate, sIdx);
+			TEST_CHECK(state >= 0);
+			if ((state >= 0) && (arrStates.empty() || (arrStates.back() != state)))
+			{
+				arrStates.push_back(state);
+			}
+			samples++;
+		}
+	}
+	TEST_REQUIRE(arrStates.size() >= 2 * JOYSTICK_STATES + 1);
+	TEST_CHECK(emulator.getReplayedFrames() >= 2 * JOYSTICK_STATES * SAMPLES_PER_STATE);
+	TEST_CHECK(samples >= 2 * JOYSTICK_STATES * SAMPLES_PER_STATE);
+
+	// no state is skipped (the first frames show all channels released until the first sample)
+	for (size_t idx = 1; idx < arrStates.size(); idx++)
+	{
+		TEST_CHECK(arrStates[idx] == (int) ((arrStates[idx - 1] + 1) % JOYSTICK_STATES));
+	}
+
+	// the force plate describes the channels of the profile
+	TEST_REQUIRE(data.description.nDataDescriptions == 1);
+	const sForcePlateDescription* pDescription = data.description.arrDataDescriptions[0].Data.ForcePlateDescription;
+	TEST_CHECK(pDescription->nChannels == JOYSTICK_CHANNELS);
+	TEST_CHECK(strcmp(pDescription->szChannelNames[0], "button1") == 0);
+	TEST_CHECK(strcmp(pDescription->szChannelNames[7], "axis2") == 0);
+
+	system.deinitialise();
+	emulator.stop();
+	std::remove(CAPTURE_FILENAME);
+}
+
+
+/**
+ * A scan returns at its timeout even when a probe is still busy, here with a port that only sends noise.
+ * The late probe does not hold up the scan of another port, closes its port when it is done,
+ * and is joined by finishProbes().
+ */
+static void testScanDeadline()
+{
+	// a port that keeps the coordinator reading, but never answers
+	int fdNoisy = posix_openpt(O_RDWR | O_NOCTTY);
+	TEST_REQUIRE((fdNoisy >= 0) && (grantpt(fdNoisy) == 0) && (unlockpt(fdNoisy) == 0));
+	std::string strNoisy = ptsname(fdNoisy);
+
+	std::atomic<bool> noisy(true);
+	std::thread noise([&]()
+	{
+		const uint8_t garbage = 0x55;
+		while (noisy)
+		{
+			if (::write(fdNoisy, &garbage, 1) < 0) break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+	});
+
+	typedef std::chrono::steady_clock clock;
+	clock::time_point  start   = clock::now();
+	InteractionSystem* pSystem = InteractionSystem::findController(std::vector<std::string>(1, strNoisy), 50);
+	std::chrono::milliseconds duration = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start);
+	std::cout << "Scan of the noisy port returned after " << duration.count() << "ms" << std::endl;
+	TEST_CHECK(pSystem == NULL);
+	TEST_CHECK(duration < std::chrono::milliseconds(500));
+
+	// the probe still has the noisy port open, but another port can be scanned
+	{
+		std::ofstream capture(CAPTURE_FILENAME);
+		writeFrame(capture, 5, createSample(SERIAL_A, ADDRESS_A, PINS_RELEASED));
+	}
+	XBeeEmulator emulator;
+	TEST_REQUIRE(emulator.loadCapture(CAPTURE_FILENAME));
+	TEST_REQUIRE(emulator.start());
+
+	start   = clock::now();
+	pSystem = InteractionSystem::findController(std::vector<std::string>(1, emulator.getDeviceName()), 2000);
+	duration = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start);
+	TEST_CHECK(pSystem != NULL);
+	TEST_CHECK(duration < std::chrono::milliseconds(1000));
+	if (pSystem != NULL)
+	{
+		TEST_CHECK(pSystem->getPortName() == emulator.getDeviceName());
+		delete pSystem;
+	}
+
+	struct pollfd pfd = { fdNoisy, 0, 0 };
+	TEST_CHECK((poll(&pfd, 1, 0) == 0) || !(pfd.revents & POLLHUP)); // still open on the other side
+
+	// without noise, the probe gives up and closes the port
+	noisy = false;
+	noise.join();
+	InteractionSystem::finishProbes();
+	pfd.revents = 0;
+	TEST_CHECK((poll(&pfd, 1, 1000) > 0) && (pfd.revents & POLLHUP));
+
+	::close(fdNoisy);
+	emulator.stop();
+	std::remove(CAPTURE_FILENAME);
+}
+
+
+int main()
+{
+	TEST_RUN(testCoordinatorReceive);
+	TEST_RUN(testAddressDispatch);
+	TEST_RUN(testPauseDiscardsStaleSamples);
+	TEST_RUN(testReplayedSession);
+	TEST_RUN(testScanDeadline);
+	return testResult();
+}
@@ -0,0 +1,160 @@
+/**
+ * Before/after benchmark of the json11 parser over PieceMeta payloads:
+ * the current json11 is compared with the reference version (see Json11Reference.cpp)
+ * in speed and in the parsed values, which have to be identical bit for bit.
+ *
+ * Recorded payloads can be given as arguments, otherwise payloads in the layout
+ * of a PieceMeta stream list and of PieceMeta stream data are generated.
+ */
+
+#include "TestFramework.h"
+
+#include "Json11Reference.h"
+#include "json11.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+TEST_MAIN_VARIABLES
+
+
+#define STREAM_LIST_ENTRIES  20000
+#define STREAM_DATA_NUMBERS  500000
+#define REPETITIONS          3
+
+
+struct sPayload
+{
+	std::string name;
+	std::string document;
+};
+
+
+/**
+ * Creates a stream list (streams.json) with many stream descriptions.
+ */
+static std::string createStreamList()
+{
+	std::ostringstream strList;
+	const char* arrGroups[] = { "position", "rotation", "velocity" };
+	strList << "[";
+	for (int nIdx = 0; nIdx < STREAM_LIST_ENTRIES; nIdx++)
+	{
+		if (nIdx > 0) strList << ",\n";
+		strList << "{\"uuid\":\"" << std::hex << (0x3f2a0000 + nIdx) << "-9c4e-4b1f-a6d2-6b1e" << std::dec << nIdx << "\","
+		        << "\"channel_uuid\":\"" << (nIdx / 24) << "-channel\","
+		        << "\"title\":\"Marker " << (nIdx % 24) << " \\u00e9\\t" << ((nIdx % 3 == 0) ? "x" : (nIdx % 3 == 1) ? "y" : "z") << "\","
+		        << "\"group\":\"" << arrGroups[(nIdx / 3) % 3] << "\","
+		        << "\"fps\":" << ((nIdx % 2 == 0) ? "100" : "29.97") << ","
+		        << "\"frameCount\":" << (1000 + nIdx) << "}";
+	}
+	strList << "]";
+	return strList.str();
+}
+
+
+/**
+ * Creates stream data with many sensor values in the notations of recordings.
+ */
+static std::string createStreamData()
+{
+	std::string strData = "{\"uuid\":\"3f2a0000-9c4e-4b1f-a6d2-6b1e0\",\"fps\":100,\"frameCount\":500000,\"frames\":[";
+	uint32_t random = 4711;
+	char     buffer[64];
+	for (int nIdx = 0; nIdx < STREAM_DATA_NUMBERS; nIdx++)
+	{
+		random = random * 1664525 + 1013904223;
+		double value = ((int32_t) random) / 2147483648.0 * 2.5;
+		switch (nIdx % 10)
+		{
+			case 9:  snprintf(buffer, sizeof(buffer), "%.8e",  value * 1e-4); break; // exponent
+			case 8:  snprintf(buffer, sizeof(buffer), "%.17g", value);        break; // full precision
+			case 7:  snprintf(buffer, sizeof(buffer), "%d",    (int) (value * 1000)); break;
+			default: snprintf(buffer, sizeof(buffer), "%.6f",  value);        break;
+		}
+		if (nIdx > 0) strData += ",";
+		strData += buffer;
+	}
+	strData += "]}";
+	return strData;
+}
+
+
+/**
+ * Measures the best time of several parses.
+ *
+ * @return the best time in milliseconds
+ */
+template<typename Parse> static double measure(Parse parse)
+{
+	double best = 0;
+	for (int nRepetition = 0; nRepetition < REPETITIONS; nRepetition++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		parse();
+		std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+		if ((nRepetition == 0) || (duration.count() < best)) best = duration.count();
+	}
+	return best;
+}
+
+
+static std::vector<sPayload> payloads;
+
+
+/**
+ * Both versions parse the payloads into the same values and the current one is reported against the reference.
+ */
+static void benchmarkParse()
+{
+	for (const sPayload& payload : payloads)
+	{
+		std::string strError;
+		std::string strDump, strReferenceDump;
+		json11::Json::parse(payload.document, strError).dump(strDump);
+		TEST_CHECK(strError.empty());
+		TEST_CHECK(parseJson11Reference(payload.document, &strReferenceDump));
+		TEST_CHECK(strDump == strReferenceDump); // dump() writes doubles with 17 digits, so equal means bit-identical
+
+		double before = measure([&]() { parseJson11Reference(payload.document, NULL); });
+		double after  = measure([&]() { std::string strError; json11::Json::parse(payload.document, strError); });
+
+		char buffer[256];
+		snprintf(buffer, sizeof(buffer), "%s (%.1f MB): before %.1fms, after %.1fms (%.2fx)",
+			payload.name.c_str(), payload.document.size() / 1048576.0, before, after, before / after);
+		std::cout << buffer << std::endl;
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	if (argc > 1)
+	{
+		for (int nArg = 1; nArg < argc; nArg++)
+		{
+			std::ifstream     file(argv[nArg], std::ios::in | std::ios::binary);
+			std::stringstream strContent;
+			strContent << file.rdbuf();
+			if (!file)
+			{
+				std::cerr << "Could not read " << argv[nArg] << std::endl;
+				return 1;
+			}
+			payloads.push_back(sPayload{ argv[nArg], strContent.str() });
+		}
+	}
+	else
+	{
+		payloads.push_back(sPayload{ "Stream list",  createStreamList() });
+		payloads.push_back(sPayload{ "Stream data",  createStreamData() });
+	}
+
+	TEST_RUN(benchmarkParse);
+	return testResult();
+}
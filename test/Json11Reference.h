@@ -0,0 +1,18 @@
+/**
+ * Access to the reference version of json11 (see Json11Reference.cpp).
+ */
+
+#pragma once
+
+#include <string>
+
+
+/**
+ * Parses a document with the reference version of json11.
+ *
+ * @param strDocument  the JSON document to parse
+ * @param pDump        where to write the parsed document as JSON again (can be <code>NULL</code>)
+ *
+ * @return <code>true</code> if the document was parsed
+ */
+bool parseJson11Reference(const std::string& strDocument, std::string* pDump);
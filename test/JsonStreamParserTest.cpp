@@ -0,0 +1,295 @@
+/**
+ * Tests for the streaming JSON parser (JsonStreamParser.h):
+ * documents read through the PieceMeta folder source are parsed in chunks of various sizes,
+ * and the result is compared with the document tree json11 creates from the complete document.
+ */
+
+#include "TestFramework.h"
+
+#include "JsonStreamParser.h"
+#include "PieceMetaSource.h"
+#include "json11.hpp"
+
+#include <algorithm>
+#include <clocale>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+TEST_MAIN_VARIABLES
+
+
+#define DOCUMENT_FILENAME "JsonStreamParserTest.json"
+#define STREAM_NUMBERS    20000 // enough for several read buffers of the folder source
+
+
+/**
+ * Handler that builds a json11 document tree from the parser events.
+ */
+class JsonTreeBuilder : public JsonStreamHandler
+{
+public:
+
+	virtual void startObject()                   { stack.push_back(sContainer(true)); }
+	virtual void endObject()                     { endContainer(); }
+	virtual void startArray()                    { stack.push_back(sContainer(false)); }
+	virtual void endArray()                      { endContainer(); }
+	virtual void key(const std::string& strName) { stack.back().strKey = strName; }
+	virtual void string(const std::string& strValue) { addValue(json11::Json(strValue)); }
+	virtual void number(double value)            { addValue(json11::Json(value)); }
+	virtual void boolean(bool value)             { addValue(json11::Json(value)); }
+	virtual void null()                          { addValue(json11::Json(nullptr)); }
+
+	/**
+	 * Prepares the builder for a new document.
+	 */
+	void clear()
+	{
+		stack.clear();
+		root = json11::Json();
+	}
+
+public:
+
+	json11::Json root;
+
+private:
+
+	struct sContainer
+	{
+		bool                 isObject;
+		json11::Json::array  arr;
+		json11::Json::object obj;
+		std::string          strKey;
+
+		explicit sContainer(bool isObject) : isObject(isObject) { }
+	};
+
+	void endContainer()
+	{
+		sContainer container = std::move(stack.back());
+		stack.pop_back();
+		addValue(container.isObject ? json11::Json(std::move(container.obj)) : json11::Json(std::move(container.arr)));
+	}
+
+	void addValue(const json11::Json& refValue)
+	{
+		if (stack.empty())
+		{
+			root = refValue;
+		}
+		else if (stack.back().isObject)
+		{
+			stack.back().obj[stack.back().strKey] = refValue;
+		}
+		else
+		{
+			stack.back().arr.push_back(refValue);
+		}
+	}
+
+private:
+
+	std::vector<sContainer> stack;
+};
+
+
+/**
+ * Stream metadata with all kinds of escapes and values, in the layout of PieceMeta stream data.
+ */
+static const char* STREAM_HEADER =
+	"{\"uuid\":\"0f8e-\\u00e9\\u4E2D\\ud83d\\ude00-x\",\n"
+	" \"title\":\"Tab\\tquote\\\"slash\\/backslash\\\\ newline\\n control\\b\\f\\r\",\n"
+	" \"fps\":100, \"negative\":-12.5e-3, \"big\":1.5E+10, \"zero\":0, \"fraction\":0.000001,\n"
+	" \"flags\":[true,false,null], \"nested\":{\"empty\":{},\"list\":[[],[{}]]},\n"
+	" \"frames\":[";
+
+
+/**
+ * Creates a stream document with many numbers in different notations.
+ */
+static std::string createStreamDocument()
+{
+	std::string strDocument(STREAM_HEADER);
+	uint32_t random = 12345;
+	char     buffer[64];
+	for (int nIdx = 0; nIdx < STREAM_NUMBERS; nIdx++)
+	{
+		random = random * 1664525 + 1013904223;
+		double value = ((int32_t) random) / 1000.0;
+		switch (nIdx % 5)
+		{
+			case 0: snprintf(buffer, sizeof(buffer), "%.3f",  value); break;
+			case 1: snprintf(buffer, sizeof(buffer), "%.17g", value / 7.0); break;    // beyond 15 digits
+			case 2: snprintf(buffer, sizeof(buffer), "%d",    (int) value); break;
+			case 3: snprintf(buffer, sizeof(buffer), "%.6e",  value); break;          // exponent
+			case 4: snprintf(buffer, sizeof(buffer), "%.4E",  value / 1e6); break;    // negative exponent
+		}
+		if (nIdx > 0) strDocument += ((nIdx % 10) == 0) ? ",\n" : ",";
+		strDocument += buffer;
+	}
+	strDocument += "]}\n";
+	return strDocument;
+}
+
+
+/**
+ * Parses a document in chunks of a fixed size.
+ *
+ * @return <code>true</code> if the document was parsed
+ */
+static bool parseInChunks(const std::string& strDocument, size_t chunkSize, JsonTreeBuilder& refBuilder)
+{
+	refBuilder.clear();
+	JsonStreamParser parser(refBuilder);
+	for (size_t pos = 0; pos < strDocument.size(); pos += chunkSize)
+	{
+		size_t length = std::min(chunkSize, strDocument.size() - pos);
+		if (!parser.parse(strDocument.data() + pos, length)) return false;
+	}
+	return parser.finish();
+}
+
+
+/**
+ * A stream document read through the folder source, as the PieceMeta module does,
+ * is parsed into the same values as json11 parses from the complete document.
+ * The chunks of the source are split further, so that chunk boundaries fall everywhere.
+ */
+static void testDirectorySourceInChunks()
+{
+	std::string strDocument = createStreamDocument();
+	{
+		std::ofstream file(DOCUMENT_FILENAME, std::ios::out | std::ios::binary | std::ios::trunc);
+		file << strDocument;
+	}
+
+	std::string  strError;
+	json11::Json expected = json11::Json::parse(strDocument, strError);
+	TEST_REQUIRE(strError.empty());
+	TEST_REQUIRE(expected["frames"].array_items().size() == STREAM_NUMBERS);
+
+	std::unique_ptr<PieceMetaSource> pSource(PieceMetaSource::create("."));
+	const size_t arrChunkSizes[] = { 1, 2, 3, 7, 13, 64, 1000, 65536 };
+	for (size_t chunkSize : arrChunkSizes)
+	{
+		JsonTreeBuilder  builder;
+		JsonStreamParser parser(builder);
+		size_t           chunks = 0;
+		bool success = pSource->read("/" DOCUMENT_FILENAME "?from=0&to=100", [&](const char* pData, size_t length)
+		{
+			for (size_t pos = 0; pos < length; pos += chunkSize)
+			{
+				chunks++;
+				if (!parser.parse(pData + pos, std::min(chunkSize, length - pos))) return false;
+			}
+			return true;
+		});
+		TEST_CHECK(success);
+		TEST_CHECK(parser.finish());
+		TEST_CHECK(parser.getError().empty());
+		TEST_CHECK(chunks > 1);
+		TEST_CHECK(builder.root == expected);
+	}
+
+	std::remove(DOCUMENT_FILENAME);
+}
+
+
+/**
+ * Splitting a document at any position (inside strings, escapes, \u escapes, numbers, literals)
+ * gives the same result.
+ */
+static void testEverySplitPosition()
+{
+	std::string strDocument = std::string(STREAM_HEADER) + "-0.5,1e-7,3.25E2,123456789012,-0]}";
+
+	std::string  strError;
+	json11::Json expected = json11::Json::parse(strDocument, strError);
+	TEST_REQUIRE(strError.empty());
+
+	JsonTreeBuilder builder;
+	for (size_t split = 1; split < strDocument.size(); split++)
+	{
+		builder.clear();
+		JsonStreamParser parser(builder);
+		bool success = parser.parse(strDocument.data(), split) &&
+		               parser.parse(strDocument.data() + split, strDocument.size() - split) &&
+		               parser.finish();
+		if (!success || !(builder.root == expected))
+		{
+			std::cerr << "Split at position " << split << ": " << parser.getError() << std::endl;
+			TEST_CHECK(false);
+		}
+	}
+
+	// a number at the very end of the document
+	TEST_CHECK(parseInChunks("42.5", 1, builder) && (builder.root == json11::Json(42.5)));
+}
+
+
+/**
+ * Syntax errors are detected, also when they are split across chunks.
+ */
+static void testSyntaxErrors()
+{
+	const char* arrInvalid[] =
+	{
+		"{\"a\":}", "[1,2", "{\"a\" 1}", "[1 2]", "\"\\x\"", "\"\\u12G4\"", "[tru]", "[01.5.3]", "{} {}", "[\"a\nb\"]",
+		// numbers strtod() accepts, but JSON doesn't
+		"[01]", "[-01]", "[1.]", "[-]", "[.5]", "[1e]", "[1.5e+]", "[1e5.5]", "[+1]", "[1-2]", "[--1]", "-",
+		// unpaired surrogates
+		"[\"\\ud83d\"]", "[\"\\ud83d\\n\"]", "[\"\\ud83dx\"]", "[\"\\ud83d\\u0041\"]", "[\"\\ud83d\\ud83d\"]", "[\"\\ude00\"]"
+	};
+	JsonTreeBuilder builder;
+	for (const char* strDocument : arrInvalid)
+	{
+		for (size_t chunkSize = 1; chunkSize <= 3; chunkSize++)
+		{
+			if (parseInChunks(strDocument, chunkSize, builder))
+			{
+				std::cerr << "Accepted invalid document '" << strDocument << "'" << std::endl;
+				TEST_CHECK(false);
+			}
+		}
+	}
+}
+
+
+/**
+ * Numbers are converted the same way in a locale with a decimal comma.
+ */
+static void testNumbersIgnoreLocale()
+{
+	const char* arrLocales[] = { "de_DE.UTF-8", "de_DE.utf8", "de_DE", "German_Germany.1252" };
+	const char* czLocale     = NULL;
+	for (const char* czName : arrLocales)
+	{
+		if ((czLocale == NULL) && (setlocale(LC_NUMERIC, czName) != NULL)) czLocale = czName;
+	}
+	if (czLocale == NULL)
+	{
+		std::cout << "No locale with a decimal comma installed, skipped" << std::endl;
+		return;
+	}
+
+	JsonTreeBuilder builder;
+	bool parsed = parseInChunks("[12.5,-0.25e1]", 3, builder);
+	setlocale(LC_NUMERIC, "C");
+	TEST_REQUIRE(parsed);
+	TEST_CHECK(builder.root[0].number_value() == 12.5);
+	TEST_CHECK(builder.root[1].number_value() == -2.5);
+}
+
+
+int main()
+{
+	TEST_RUN(testDirectorySourceInChunks);
+	TEST_RUN(testEverySplitPosition);
+	TEST_RUN(testSyntaxErrors);
+	TEST_RUN(testNumbersIgnoreLocale);
+	return testResult();
+}
@@ -0,0 +1,199 @@
+/**
+ * Tests for mapping Kinect users to NatNet skeletons (KinectSkeleton.h),
+ * fed from a recording that is replayed through the sensor stand-in (KinectRecording.h).
+ */
+
+#include "TestFramework.h"
+
+#include "KinectRecording.h"
+#include "KinectSkeleton.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+TEST_MAIN_VARIABLES
+
+
+#define RECORDING_FILENAME "KinectSkeletonTest.txt"
+#define LOST_FRAME_LIMIT   5
+
+// users of the recording: tracking ID and the frames they are visible in
+struct sRecordedUser
+{
+	uint32_t trackingId;
+	uint32_t firstFrame;
+	uint32_t lastFrame;
+};
+
+static const sRecordedUser USERS[] =
+{
+	{ 101,  0, 59 }, // leaves in the middle
+	{ 202, 10, 99 }, // enters after the first user and stays
+	{ 303, 70, 99 }, // enters after the first user's skeleton is free
+};
+
+static const uint32_t FRAME_COUNT = 100;
+
+
+/**
+ * Gets the recorded position of a joint of a user.
+ */
+static float getJointX(uint32_t trackingId, uint32_t frameNumber, int jIdx)
+{
+	return trackingId * 0.01f + frameNumber * 0.001f + jIdx * 0.1f;
+}
+
+
+/**
+ * Records frames with the users coming and going, 1ms apart so that the replay is quick.
+ */
+static bool createRecording()
+{
+	KinectFrameRecorder recorder;
+	if (!recorder.open(RECORDING_FILENAME)) return false;
+
+	for (uint32_t fIdx = 0; fIdx < FRAME_COUNT; fIdx++)
+	{
+		KinectFrame frame;
+		memset(&frame, 0, sizeof(frame));
+		frame.frameNumber = fIdx;
+		frame.timestamp   = fIdx;
+		for (const sRecordedUser& refRecorded : USERS)
+		{
+			if ((fIdx < refRecorded.firstFrame) || (fIdx > refRecorded.lastFrame)) continue;
+
+			KinectUser& refUser = frame.users[frame.nUsers++];
+			refUser.trackingId    = refRecorded.trackingId;
+			refUser.skeletonValid = true;
+			for (int jIdx = 0; jIdx < KINECT_JOINT_COUNT; jIdx++)
+			{
+				refUser.joints[jIdx].x       = getJointX(refRecorded.trackingId, fIdx, jIdx);
+				refUser.joints[jIdx].y       = 1.0f;
+				refUser.joints[jIdx].z       = 2.0f;
+				refUser.joints[jIdx].tracked = true;
+			}
+		}
+		recorder.write(frame);
+	}
+	recorder.close();
+	return true;
+}
+
+
+/**
+ * Finds the skeleton a user is assigned to.
+ *
+ * @return the index of the skeleton or -1 if the user has none
+ */
+static int findSkeleton(const KinectSkeletonMapper& refMapper, uint32_t trackingId)
+{
+	for (int sIdx = 0; sIdx < KINECT_MAX_USERS; sIdx++)
+	{
+		if (refMapper.getTrackingId(sIdx) == trackingId) return sIdx;
+	}
+	return -1;
+}
+
+
+/**
+ * Users keep their skeleton for as long as they are tracked, a free skeleton is reused,
+ * and the frame layout stays the same while users come and go.
+ */
+static void testReplayedUsersKeepTheirSkeleton()
+{
+	TEST_REQUIRE(createRecording());
+
+	KinectRecordedSensor sensor(RECORDING_FILENAME);
+	TEST_REQUIRE(sensor.open());
+
+	KinectSkeletonMapper mapper(LOST_FRAME_LIMIT);
+	MoCapData            data;
+	mapper.createSceneDescription(data);
+	TEST_REQUIRE(data.frame.nMarkerSets == KINECT_MAX_USERS);
+	TEST_REQUIRE(data.frame.nSkeletons  == KINECT_MAX_USERS);
+	TEST_CHECK(data.description.nDataDescriptions == 2 * KINECT_MAX_USERS);
+	TEST_CHECK(strcmp(data.frame.MocapData[0].szName, "user 1") == 0);
+
+	// the arrays of the layout must not be reallocated
+	std::vector<const void*> arrLayout;
+	for (int sIdx = 0; sIdx < KINECT_MAX_USERS; sIdx++)
+	{
+		arrLayout.push_back(data.frame.MocapData[sIdx].Markers);
+		arrLayout.push_back(data.frame.Skeletons[sIdx].RigidBodyData);
+	}
+
+	int skeletonA = -1, skeletonB = -1, skeletonC = -1;
+	for (uint32_t fIdx = 0; fIdx < FRAME_COUNT; fIdx++)
+	{
+		KinectFrame frame;
+		TEST_REQUIRE(sensor.waitForFrame(frame, 1000));
+		TEST_REQUIRE(frame.frameNumber == fIdx);
+		mapper.update(frame);
+		mapper.writeFrame(data.frame);
+		TEST_CHECK(data.frame.iFrame == (int) fIdx);
+
+		int a = findSkeleton(mapper, 101);
+		int b = findSkeleton(mapper, 202);
+		int c = findSkeleton(mapper, 303);
+
+		// the first user is kept for a few frames after leaving, then the skeleton is free
+		if (fIdx == 0)  skeletonA = a;
+		TEST_CHECK((fIdx <= 59 + LOST_FRAME_LIMIT) ? (a == skeletonA) : (a < 0));
+
+		if (fIdx == 10) skeletonB = b;
+		TEST_CHECK((fIdx >= 10) ? (b == skeletonB) : (b < 0));
+
+		if (fIdx == 70) skeletonC = c;
+		if (fIdx >= 70) TEST_CHECK(c == skeletonC);
+
+		// joint positions of tracked users end up in their skeleton
+		if ((fIdx >= 10) && (skeletonB >= 0))
+		{
+			const sSkeletonData& refSkeleton = data.frame.Skeletons[skeletonB];
+			TEST_CHECK(refSkeleton.skeletonID == skeletonB + 1);
+			TEST_CHECK(std::fabs(refSkeleton.RigidBodyData[3].x - getJointX(202, fIdx, 3)) < 1e-4f); // recording is text
+			TEST_CHECK(refSkeleton.RigidBodyData[3].params == 0x01);
+			TEST_CHECK(data.frame.MocapData[skeletonB].Markers[3][0] == refSkeleton.RigidBodyData[3].x);
+		}
+
+		// a lost user is reported without tracking until the skeleton is free
+		if ((fIdx > 59) && (fIdx <= 59 + LOST_FRAME_LIMIT))
+		{
+			TEST_CHECK(data.frame.Skeletons[skeletonA].RigidBodyData[3].params == 0x00);
+		}
+
+		TEST_CHECK(data.frame.nMarkerSets == KINECT_MAX_USERS);
+		TEST_CHECK(data.frame.nSkeletons  == KINECT_MAX_USERS);
+	}
+	sensor.close();
+
+	TEST_CHECK(skeletonA == 0);
+	TEST_CHECK(skeletonB == 1);
+	TEST_CHECK(skeletonC == 0); // reuses the free skeleton of the first user
+	TEST_CHECK(mapper.getActiveUserCount() == 2);
+
+	// freed skeletons report all joints at 0
+	for (int sIdx = 2; sIdx < KINECT_MAX_USERS; sIdx++)
+	{
+		TEST_CHECK(data.frame.MocapData[sIdx].Markers[0][0] == 0);
+		TEST_CHECK(data.frame.Skeletons[sIdx].RigidBodyData[0].qw == 1);
+	}
+
+	for (int sIdx = 0; sIdx < KINECT_MAX_USERS; sIdx++)
+	{
+		TEST_CHECK(data.frame.MocapData[sIdx].Markers        == arrLayout[2 * sIdx]);
+		TEST_CHECK(data.frame.Skeletons[sIdx].RigidBodyData == arrLayout[2 * sIdx + 1]);
+	}
+
+	std::remove(RECORDING_FILENAME);
+}
+
+
+int main()
+{
+	TEST_RUN(testReplayedUsersKeepTheirSkeleton);
+	return testResult();
+}
@@ -0,0 +1,525 @@
+/**
+ * Tests for loading PieceMeta packages (MoCapPieceMeta.h) from a local folder with the structure of the web API:
+ * the stream data is loaded on the worker threads, through the stream cache (PieceMetaSource.h) where possible,
+ * and resampled into the playback buffer.
+ */
+
+#include "TestFramework.h"
+
+#include "MoCapPieceMeta.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+TEST_MAIN_VARIABLES
+
+
+#define SOURCE_DIRECTORY   "PieceMetaTestSource"
+#define CACHE_DIRECTORY    "PieceMetaTestCache"
+#define RESAMPLE_DIRECTORY "PieceMetaTestResample"
+#define PACKAGE_UUID       "package-1"
+#define CHANNEL_COUNT      4
+#define FRAME_COUNT        50
+#define FPS                100
+
+
+// the parts of the main program that the PieceMeta module uses (see MotionServerMain.cpp)
+void signalNewFrame()
+{
+	// nothing to do
+}
+
+
+static void createDirectory(const std::string& strName)
+{
+#ifdef _WIN32
+	_mkdir(strName.c_str());
+#else
+	mkdir(strName.c_str(), 0755);
+#endif
+}
+
+
+static void writeFile(const std::string& strFilename, const std::string& strContent)
+{
+	std::ofstream file(strFilename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	file << strContent;
+}
+
+
+static std::string getStreamUUID(int channel, int axis)
+{
+	std::stringstream strUUID;
+	strUUID << "stream-" << channel << "-" << "xyz"[axis];
+	return strUUID.str();
+}
+
+
+/**
+ * Gets the value of a stream frame, different for each version of the data.
+ */
+static float getValue(int channel, int axis, int frame, int version)
+{
+	return version * 1000.0f + channel * 100.0f + axis * 10.0f + frame * 0.5f;
+}
+
+
+/**
+ * Writes the description of the streams of a channel: one "position" group with x/y/z.
+ */
+static void writeStreamList(int channel, long frameCount)
+{
+	std::stringstream strList;
+	strList << "[";
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (axis > 0) strList << ",";
+		strList << "{\"uuid\":\"" << getStreamUUID(channel, axis) << "\",\"title\":\"" << "xyz"[axis] << "\","
+		        << "\"group\":\"position\",\"fps\":" << FPS << ",\"frameCount\":" << frameCount << "}";
+	}
+	strList << "]";
+
+	std::stringstream strDirectory;
+	strDirectory << SOURCE_DIRECTORY "/channels/channel-" << channel;
+	createDirectory(strDirectory.str());
+	writeFile(strDirectory.str() + "/streams.json", strList.str());
+}
+
+
+/**
+ * Writes the data of a stream.
+ */
+static void writeStreamData(int channel, int axis, int frames, int version)
+{
+	std::stringstream strData;
+	strData << "{\"uuid\":\"" << getStreamUUID(channel, axis) << "\",\"frames\":[";
+	for (int fIdx = 0; fIdx < frames; fIdx++)
+	{
+		strData << ((fIdx > 0) ? "," : "") << getValue(channel, axis, fIdx, version);
+	}
+	strData << "]}";
+	writeFile(SOURCE_DIRECTORY "/streams/" + getStreamUUID(channel, axis) + ".json", strData.str());
+}
+
+
+/**
+ * Creates a package with a few channels of version 0 data.
+ */
+static void createPackage()
+{
+	createDirectory(SOURCE_DIRECTORY);
+	createDirectory(SOURCE_DIRECTORY "/packages");
+	createDirectory(SOURCE_DIRECTORY "/packages/" PACKAGE_UUID);
+	createDirectory(SOURCE_DIRECTORY "/channels");
+	createDirectory(SOURCE_DIRECTORY "/streams");
+	createDirectory(CACHE_DIRECTORY);
+
+	writeFile(SOURCE_DIRECTORY "/packages.json", "[{\"uuid\":\"" PACKAGE_UUID "\",\"title\":\"Test package\"}]");
+
+	std::stringstream strChannels;
+	strChannels << "[";
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+	{
+		if (channel > 0) strChannels << ",";
+		strChannels << "{\"uuid\":\"channel-" << channel << "\",\"title\":\"Channel " << channel << "\"}";
+
+		writeStreamList(channel, FRAME_COUNT);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			writeStreamData(channel, axis, FRAME_COUNT, 0);
+		}
+	}
+	strChannels << "]";
+	writeFile(SOURCE_DIRECTORY "/packages/" PACKAGE_UUID "/channels.json", strChannels.str());
+}
+
+
+static void removePackage()
+{
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+	{
+		std::stringstream strDirectory;
+		strDirectory << SOURCE_DIRECTORY "/channels/channel-" << channel;
+		std::remove((strDirectory.str() + "/streams.json").c_str());
+		std::remove(strDirectory.str().c_str());
+		for (int axis = 0; axis < 3; axis++)
+		{
+			std::remove((SOURCE_DIRECTORY "/streams/" + getStreamUUID(channel, axis) + ".json").c_str());
+			std::remove((CACHE_DIRECTORY "/" + getStreamUUID(channel, axis) + ".bin").c_str());
+		}
+	}
+	std::remove(SOURCE_DIRECTORY "/packages/" PACKAGE_UUID "/channels.json");
+	std::remove(SOURCE_DIRECTORY "/packages/" PACKAGE_UUID);
+	std::remove(SOURCE_DIRECTORY "/packages.json");
+	std::remove(SOURCE_DIRECTORY "/packages");
+	std::remove(SOURCE_DIRECTORY "/channels");
+	std::remove(SOURCE_DIRECTORY "/streams");
+	std::remove(SOURCE_DIRECTORY);
+	std::remove(CACHE_DIRECTORY);
+}
+
+
+/**
+ * Loads the package with several worker threads.
+ *
+ * @return <code>true</code> if the package was loaded and the scene description created
+ */
+static bool loadPackage(MoCapPieceMeta*& refpSystem, MoCapData& refData)
+{
+	MoCapPieceMetaConfiguration configuration;
+	configuration.handleParameter(0, PACKAGE_UUID);
+	configuration.handleParameter(2, SOURCE_DIRECTORY);
+	configuration.handleParameter(3, CACHE_DIRECTORY);
+	configuration.handleParameter(5, "3");
+
+	refpSystem = new MoCapPieceMeta(configuration);
+	return refpSystem->initialise() && refpSystem->getSceneDescription(refData);
+}
+
+
+/**
+ * Checks the marker positions of the first frame against the data versions of the channels.
+ */
+static bool isFirstFrame(const MoCapData& refData, const int arrVersions[CHANNEL_COUNT])
+{
+	const sMarkerSetData& refMarkers = refData.frame.MocapData[0];
+	if ((refData.frame.nMarkerSets != 1) || (refMarkers.nMarkers != CHANNEL_COUNT)) return false;
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (refMarkers.Markers[channel][axis] != getValue(channel, axis, 0, arrVersions[channel])) return false;
+		}
+	}
+	return true;
+}
+
+
+/**
+ * Loading without cached data reads the folder and fills the cache,
+ * loading again takes the data from the cache.
+ */
+static void testCacheMissAndHit()
+{
+	const int arrVersions[CHANNEL_COUNT] = { 0, 0, 0, 0 };
+
+	// cache miss: data from the folder, then stored in the cache
+	{
+		MoCapData       data;
+		MoCapPieceMeta* pSystem = NULL;
+		TEST_CHECK(loadPackage(pSystem, data));
+		TEST_CHECK(isFirstFrame(data, arrVersions));
+		TEST_CHECK(strcmp(data.description.arrDataDescriptions[0].Data.MarkerSetDescription->szMarkerNames[1], "Channel 1/position") == 0);
+		delete pSystem;
+	}
+
+	PieceMetaStreamCache cache(CACHE_DIRECTORY);
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			std::vector<float> cached;
+			TEST_CHECK(cache.load(getStreamUUID(channel, axis), FRAME_COUNT, cached));
+			TEST_CHECK(cached.size() == FRAME_COUNT);
+		}
+	}
+
+	// cache hit: the stream files in the folder are broken now, but never read
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			writeFile(SOURCE_DIRECTORY "/streams/" + getStreamUUID(channel, axis) + ".json", "{\"frames\":[broken");
+		}
+	}
+	{
+		MoCapData       data;
+		MoCapPieceMeta* pSystem = NULL;
+		TEST_CHECK(loadPackage(pSystem, data));
+		TEST_CHECK(isFirstFrame(data, arrVersions));
+		delete pSystem;
+	}
+}
+
+
+/**
+ * Cached data of a stream whose frame count has changed is read again,
+ * as is a truncated cache file.
+ */
+static void testStaleAndTruncatedCache()
+{
+	// channel 0 has changed: new frame count and data
+	writeStreamList(0, FRAME_COUNT - 10);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		writeStreamData(0, axis, FRAME_COUNT - 10, 1);
+	}
+
+	// the cache file of one stream of channel 1 is truncated
+	std::string strCacheFile = CACHE_DIRECTORY "/" + getStreamUUID(1, 0) + ".bin";
+	std::string strCached;
+	{
+		std::ifstream file(strCacheFile.c_str(), std::ios::in | std::ios::binary);
+		std::stringstream strContent;
+		strContent << file.rdbuf();
+		strCached = strContent.str();
+	}
+	TEST_REQUIRE(strCached.size() == 12 + FRAME_COUNT * sizeof(float));
+	writeFile(strCacheFile, strCached.substr(0, strCached.size() - 3 * sizeof(float)));
+	writeStreamData(1, 0, FRAME_COUNT, 2);
+
+	PieceMetaStreamCache cache(CACHE_DIRECTORY);
+	std::vector<float>   cached;
+	TEST_CHECK(!cache.load(getStreamUUID(1, 0), FRAME_COUNT, cached));
+	TEST_CHECK(!cache.load(getStreamUUID(0, 0), FRAME_COUNT - 10, cached));
+
+	MoCapData       data;
+	MoCapPieceMeta* pSystem = NULL;
+	TEST_CHECK(loadPackage(pSystem, data));
+	delete pSystem;
+
+	// channel 0 comes from the folder, the truncated stream as well, everything else from the cache
+	const sMarkerSetData& refMarkers = data.frame.MocapData[0];
+	TEST_REQUIRE(refMarkers.nMarkers == CHANNEL_COUNT);
+	TEST_CHECK(refMarkers.Markers[0][0] == getValue(0, 0, 0, 1));
+	TEST_CHECK(refMarkers.Markers[0][2] == getValue(0, 2, 0, 1));
+	TEST_CHECK(refMarkers.Markers[1][0] == getValue(1, 0, 0, 2));
+	TEST_CHECK(refMarkers.Markers[1][1] == getValue(1, 1, 0, 0));
+	TEST_CHECK(refMarkers.Markers[3][2] == getValue(3, 2, 0, 0));
+
+	TEST_CHECK(cache.load(getStreamUUID(1, 0), FRAME_COUNT, cached));
+	TEST_CHECK(cached.size() == FRAME_COUNT);
+	TEST_CHECK(cache.load(getStreamUUID(0, 0), FRAME_COUNT - 10, cached));
+	TEST_CHECK(cached.size() == FRAME_COUNT - 10);
+}
+
+
+/**
+ * A cache file announcing more data than it contains is rejected without allocating the announced size.
+ */
+static void testCacheHeaderBeyondFileSize()
+{
+	PieceMetaStreamCache cache(CACHE_DIRECTORY);
+	std::vector<float>   data(10, 1.0f);
+	TEST_REQUIRE(cache.store("damaged", 10, data));
+
+	std::string strFilename = CACHE_DIRECTORY "/damaged.bin";
+	{
+		std::fstream file(strFilename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		uint32_t storedFrames = 0xFFFFFFF0;
+		file.seekp(8);
+		file.write((const char*) &storedFrames, sizeof(storedFrames));
+	}
+	TEST_CHECK(!cache.load("damaged", 10, data));
+
+	std::remove(strFilename.c_str());
+}
+
+
+/**
+ * The folder delivers a whole stream file for every range that is requested:
+ * a file that is shorter than announced, or longer than one range, is still read once.
+ */
+static void testFolderIgnoresRange()
+{
+	// shorter than announced
+	writeStreamList(2, FRAME_COUNT + 20);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		writeStreamData(2, axis, FRAME_COUNT, 3);
+	}
+	// longer than one range of 6000 frames
+	writeStreamList(3, 7000);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		writeStreamData(3, axis, 7000, 3);
+	}
+
+	MoCapData       data;
+	MoCapPieceMeta* pSystem = NULL;
+	TEST_CHECK(loadPackage(pSystem, data));
+	delete pSystem;
+
+	PieceMetaStreamCache cache(CACHE_DIRECTORY);
+	std::vector<float>   cached;
+	TEST_CHECK(cache.load(getStreamUUID(2, 1), FRAME_COUNT + 20, cached));
+	TEST_CHECK(cached.size() == FRAME_COUNT);
+	TEST_CHECK(cache.load(getStreamUUID(3, 1), 7000, cached));
+	TEST_REQUIRE(cached.size() == 7000);
+	TEST_CHECK(cached[6999] == getValue(3, 1, 6999, 3));
+}
+
+
+/**
+ * A stream of the resampling package, described by its values at its own rate.
+ */
+struct sResampleStream
+{
+	const char*        channel;
+	const char*        title;
+	const char*        group;
+	float              fps;
+	std::vector<float> values;
+};
+
+
+/**
+ * Writes a package of streams with different rates and groups, to check the playback buffer.
+ */
+static void createResamplePackage(const std::vector<sResampleStream>& refStreams)
+{
+	createDirectory(RESAMPLE_DIRECTORY);
+	createDirectory(RESAMPLE_DIRECTORY "/packages");
+	createDirectory(RESAMPLE_DIRECTORY "/packages/resample");
+	createDirectory(RESAMPLE_DIRECTORY "/channels");
+	createDirectory(RESAMPLE_DIRECTORY "/streams");
+	writeFile(RESAMPLE_DIRECTORY "/packages.json", "[{\"uuid\":\"resample\",\"title\":\"Resampling\"}]");
+	writeFile(RESAMPLE_DIRECTORY "/packages/resample/channels.json",
+		"[{\"uuid\":\"arm\",\"title\":\"Arm\"},{\"uuid\":\"leg\",\"title\":\"Leg\"}]");
+
+	const char* arrChannels[] = { "arm", "leg" };
+	for (const char* channel : arrChannels)
+	{
+		std::stringstream strList;
+		strList << "[";
+		for (size_t sIdx = 0; sIdx < refStreams.size(); sIdx++)
+		{
+			const sResampleStream& refStream = refStreams[sIdx];
+			if (strcmp(refStream.channel, channel) != 0) continue;
+
+			std::stringstream strData;
+			strData << "{\"frames\":[";
+			for (size_t fIdx = 0; fIdx < refStream.values.size(); fIdx++)
+			{
+				strData << ((fIdx > 0) ? "," : "") << refStream.values[fIdx];
+			}
+			strData << "]}";
+			std::stringstream strUUID;
+			strUUID << "resample-" << sIdx;
+			writeFile(RESAMPLE_DIRECTORY "/streams/" + strUUID.str() + ".json", strData.str());
+
+			if (strList.str().size() > 1) strList << ",";
+			strList << "{\"uuid\":\"" << strUUID.str() << "\",\"title\":\"" << refStream.title << "\","
+			        << "\"group\":\"" << refStream.group << "\",\"fps\":" << refStream.fps << ","
+			        << "\"frameCount\":" << refStream.values.size() << "}";
+		}
+		strList << "]";
+		createDirectory(RESAMPLE_DIRECTORY "/channels/" + std::string(channel));
+		writeFile(RESAMPLE_DIRECTORY "/channels/" + std::string(channel) + "/streams.json", strList.str());
+	}
+}
+
+
+static void removeResamplePackage(size_t streamCount)
+{
+	for (size_t sIdx = 0; sIdx < streamCount; sIdx++)
+	{
+		std::stringstream strFilename;
+		strFilename << RESAMPLE_DIRECTORY "/streams/resample-" << sIdx << ".json";
+		std::remove(strFilename.str().c_str());
+	}
+	std::remove(RESAMPLE_DIRECTORY "/channels/arm/streams.json");
+	std::remove(RESAMPLE_DIRECTORY "/channels/leg/streams.json");
+	std::remove(RESAMPLE_DIRECTORY "/channels/arm");
+	std::remove(RESAMPLE_DIRECTORY "/channels/leg");
+	std::remove(RESAMPLE_DIRECTORY "/packages/resample/channels.json");
+	std::remove(RESAMPLE_DIRECTORY "/packages/resample");
+	std::remove(RESAMPLE_DIRECTORY "/packages.json");
+	std::remove(RESAMPLE_DIRECTORY "/packages");
+	std::remove(RESAMPLE_DIRECTORY "/channels");
+	std::remove(RESAMPLE_DIRECTORY "/streams");
+	std::remove(RESAMPLE_DIRECTORY);
+}
+
+
+/**
+ * Streams of different rates are resampled to the highest rate and interleaved into markers:
+ * up to three streams of a <channel>/<group> are x/y/z of one marker, shorter streams hold their last value,
+ * and the playback covers the longest stream, rounded up to whole frames.
+ */
+static void testPlaybackBuffer()
+{
+	std::vector<sResampleStream> streams =
+	{
+		{ "arm", "x",     "position", 100, { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 } },
+		{ "arm", "y",     "position",  50, { 100, 102, 104, 106, 108 } },
+		{ "arm", "z",     "position", 100, { 50, 51, 52, 53 } },
+		{ "arm", "speed", "",         100, { 5, 6 } },                        // no group: marker of its own
+		{ "leg", "x",     "position",  30, { 0, 3, 6, 9, 12, 15, 18, 21, 24, 27 } }, // 0.333s: longest stream
+		{ "leg", "y",     "position", 100, { 7, 7 } },
+		{ "leg", "z",     "position", 100, { 8, 8 } },
+		{ "leg", "x2",    "position", 100, { 9 } },                           // fourth stream: second marker
+	};
+	createResamplePackage(streams);
+
+	MoCapPieceMetaConfiguration configuration;
+	configuration.handleParameter(0, "resample");
+	configuration.handleParameter(2, RESAMPLE_DIRECTORY);
+	configuration.handleParameter(4, "");
+
+	MoCapData      data;
+	MoCapPieceMeta system(configuration);
+	TEST_REQUIRE(system.initialise());
+	TEST_REQUIRE(system.getSceneDescription(data));
+	TEST_CHECK(system.getUpdateRate() == 100);
+
+	const sMarkerSetDescription* pDescription = data.description.arrDataDescriptions[0].Data.MarkerSetDescription;
+	TEST_REQUIRE(pDescription->nMarkers == 4);
+	TEST_CHECK(strcmp(pDescription->szMarkerNames[0], "Arm/position")   == 0);
+	TEST_CHECK(strcmp(pDescription->szMarkerNames[1], "Arm/speed")      == 0);
+	TEST_CHECK(strcmp(pDescription->szMarkerNames[2], "Leg/position")   == 0);
+	TEST_CHECK(strcmp(pDescription->szMarkerNames[3], "Leg/position_2") == 0);
+
+	// ceil(10 / 30 * 100) = 34 frames
+	const int frames = 34;
+	for (int fIdx = 0; fIdx <= frames; fIdx++)
+	{
+		int frame = fIdx % frames; // wraps around after the last frame
+		TEST_REQUIRE(system.getFrameData(data));
+		TEST_CHECK(data.frame.iFrame == frame);
+		TEST_CHECK(std::fabs(data.frame.fTimestamp - frame / 100.0f) < 1e-6f);
+
+		const MarkerData* arrMarkers = data.frame.MocapData[0].Markers;
+		TEST_CHECK(arrMarkers[0][0] == std::min(frame, 9));
+		TEST_CHECK(arrMarkers[0][1] == ((frame < 8) ? 100 + frame : 108)); // 50 FPS interpolated
+		TEST_CHECK(arrMarkers[0][2] == 50 + std::min(frame, 3));
+		TEST_CHECK(arrMarkers[1][0] == ((frame < 1) ? 5 : 6));
+		TEST_CHECK((arrMarkers[1][1] == 0) && (arrMarkers[1][2] == 0));
+		TEST_CHECK(std::fabs(arrMarkers[2][0] - ((frame < 30) ? 0.9f * frame : 27)) < 1e-4f); // 30 FPS interpolated
+		TEST_CHECK((arrMarkers[2][1] == 7) && (arrMarkers[2][2] == 8));
+		TEST_CHECK((arrMarkers[3][0] == 9) && (arrMarkers[3][1] == 0) && (arrMarkers[3][2] == 0));
+
+		system.update();
+	}
+
+	system.deinitialise();
+	removeResamplePackage(streams.size());
+}
+
+
+int main()
+{
+	createPackage();
+
+	TEST_RUN(testCacheMissAndHit);
+	TEST_RUN(testStaleAndTruncatedCache);
+	TEST_RUN(testCacheHeaderBeyondFileSize);
+	TEST_RUN(testFolderIgnoresRange);
+	TEST_RUN(testPlaybackBuffer);
+
+	removePackage();
+	return testResult();
+}
@@ -0,0 +1,82 @@
+/**
+ * Minimal helpers for the tests of the platform independent parts of the server.
+ *
+ * Each test is a function that uses TEST_CHECK for its conditions.
+ * TEST_RUN runs a test and reports it, testResult() gives the exit code for CTest.
+ */
+
+#pragma once
+
+#include <iostream>
+
+
+namespace test
+{
+	extern int failedChecks;
+	extern int failedTests;
+}
+
+
+/**
+ * Checks a condition and reports the location if it fails (the test continues).
+ */
+#define TEST_CHECK(condition) \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": Check failed: " << #condition << std::endl; \
+			test::failedChecks++; \
+		} \
+	}
+
+/**
+ * Checks a condition and ends the test if it fails, e.g., before accessing data that depends on it.
+ */
+#define TEST_REQUIRE(condition) \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": Requirement failed: " << #condition << std::endl; \
+			test::failedChecks++; \
+			return; \
+		} \
+	}
+
+/**
+ * Runs a test function and reports its result.
+ */
+#define TEST_RUN(function) \
+	{ \
+		int failedBefore = test::failedChecks; \
+		function(); \
+		bool passed = (test::failedChecks == failedBefore); \
+		if (!passed) test::failedTests++; \
+		std::cout << (passed ? "[ PASS ] " : "[ FAIL ] ") << #function << std::endl; \
+	}
+
+/**
+ * Defines the counters, must be used once per test executable.
+ */
+#define TEST_MAIN_VARIABLES \
+	namespace test \
+	{ \
+		int failedChecks = 0; \
+		int failedTests  = 0; \
+	}
+
+
+/**
+ * Gets the exit code of the test executable.
+ *
+ * @return 0 if all tests passed, 1 if not
+ */
+inline int testResult()
+{
+	if (test::failedTests > 0)
+	{
+		std::cout << test::failedTests << " test(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "All tests passed" << std::endl;
+	return 0;
+}
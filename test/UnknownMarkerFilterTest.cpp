@@ -0,0 +1,119 @@
+/**
+ * Tests for the deduplication and limiting of unknown markers (UnknownMarkerFilter.h).
+ */
+
+#include "TestFramework.h"
+
+#include "UnknownMarkerFilter.h"
+
+#include <cmath>
+#include <limits>
+
+TEST_MAIN_VARIABLES
+
+
+static void addMarker(UnknownMarkerFilter& refFilter, float x, float y, float z)
+{
+	MarkerData marker = { x, y, z };
+	refFilter.addMarker(marker);
+}
+
+
+static bool isMarkerAt(const MarkerData& refMarker, float x, float y, float z)
+{
+	return (std::fabs(refMarker[0] - x) < 1e-5f) && (std::fabs(refMarker[1] - y) < 1e-5f) && (std::fabs(refMarker[2] - z) < 1e-5f);
+}
+
+
+/**
+ * Markers in the same voxel are merged at their average position, others are kept in their order.
+ */
+static void testMergeWithinVoxel()
+{
+	UnknownMarkerFilter filter;
+	filter.setVoxelSize(0.01f);
+
+	filter.beginFrame();
+	addMarker(filter,  1.001f, 2.001f, 3.001f);
+	addMarker(filter, -1.001f, 2.001f, 3.001f); // negative coordinate, different voxel
+	addMarker(filter,  1.003f, 2.003f, 3.003f);
+	addMarker(filter,  1.005f, 2.005f, 3.005f);
+	TEST_REQUIRE(filter.process() == 2);
+
+	const MarkerData* pMarkers = filter.getMarkers();
+	TEST_CHECK(isMarkerAt(pMarkers[0],  1.003f, 2.003f, 3.003f));
+	TEST_CHECK(isMarkerAt(pMarkers[1], -1.001f, 2.001f, 3.001f));
+}
+
+
+/**
+ * The voxel table is reused between frames of different sizes.
+ */
+static void testFramesOfDifferentSizes()
+{
+	UnknownMarkerFilter filter;
+	filter.setVoxelSize(0.001f);
+	filter.setMarkerLimit(100000);
+
+	const int arrCounts[] = { 10000, 3, 0, 5000 };
+	for (int count : arrCounts)
+	{
+		filter.beginFrame();
+		for (int mIdx = 0; mIdx < count; mIdx++)
+		{
+			// pairs of markers 0.2mm apart in the middle of a voxel
+			float x = (mIdx / 2) * 0.01f + 0.0003f + (mIdx % 2) * 0.0002f;
+			addMarker(filter, x, 1.0f, 1.0f);
+		}
+		TEST_CHECK(filter.process() == (count + 1) / 2);
+	}
+}
+
+
+/**
+ * Markers that are too far apart for the voxel grid are not wrapped into the same voxel.
+ */
+static void testCoordinatesBeyondGrid()
+{
+	UnknownMarkerFilter filter;
+	filter.setVoxelSize(1.0f);
+
+	filter.beginFrame();
+	addMarker(filter, 0.5f, 0.5f, 0.5f);
+	addMarker(filter, 0.5f + (1 << 21), 0.5f, 0.5f); // same voxel key if the coordinate wraps
+	addMarker(filter, 0.5f - (1 << 21), 0.5f, 0.5f);
+	addMarker(filter, std::numeric_limits<float>::quiet_NaN(), 0.5f, 0.5f);
+	addMarker(filter, 0.6f, 0.6f, 0.6f);
+	TEST_CHECK(filter.process() == 4);
+	TEST_CHECK(isMarkerAt(filter.getMarkers()[0], 0.55f, 0.55f, 0.55f));
+}
+
+
+/**
+ * With more markers than the limit, the ones closest to the centre are kept in their order.
+ */
+static void testMarkerLimit()
+{
+	UnknownMarkerFilter filter;
+	filter.setMarkerLimit(2);
+	filter.setPriorityCentre(10.0f, 0.0f, 0.0f);
+
+	filter.beginFrame();
+	addMarker(filter,  0.0f, 0.0f, 0.0f);
+	addMarker(filter, 11.0f, 0.0f, 0.0f);
+	addMarker(filter, 50.0f, 0.0f, 0.0f);
+	addMarker(filter,  9.5f, 0.0f, 0.0f);
+	TEST_REQUIRE(filter.process() == 2);
+	TEST_CHECK(isMarkerAt(filter.getMarkers()[0], 11.0f, 0.0f, 0.0f));
+	TEST_CHECK(isMarkerAt(filter.getMarkers()[1],  9.5f, 0.0f, 0.0f));
+}
+
+
+int main()
+{
+	TEST_RUN(testMergeWithinVoxel);
+	TEST_RUN(testFramesOfDifferentSizes);
+	TEST_RUN(testCoordinatesBeyondGrid);
+	TEST_RUN(testMarkerLimit);
+	return testResult();
+}
@@ -0,0 +1,389 @@
+/**
+ * Tests for the extraction of XBee API frames from a received byte stream (XBeeFrameDecoder.h).
+ */
+
+#include "TestFramework.h"
+
+#include "XBeeFrameDecoder.h"
+#include "XBeePacket.h"
+
+#include <string.h>
+#include <vector>
+
+TEST_MAIN_VARIABLES
+
+
+typedef std::vector<uint8_t> Bytes;
+
+
+/**
+ * Creates a complete API frame (delimiter, length, payload, checksum).
+ */
+static Bytes createFrame(const Bytes& refPayload)
+{
+	Bytes   frame;
+	uint8_t sum = 0;
+	frame.push_back((uint8_t) XBeePacket::START_DELIMITER);
+	frame.push_back((uint8_t) (refPayload.size() >> 8));
+	frame.push_back((uint8_t) (refPayload.size() & 0xFF));
+	for (uint8_t value : refPayload)
+	{
+		frame.push_back(value);
+		sum += value;
+	}
+	frame.push_back(0xFF - sum);
+	return frame;
+}
+
+
+/**
+ * Simple random numbers with a fixed sequence.
+ */
+static uint32_t nextRandom(uint32_t& refState)
+{
+	refState = refState * 1664525 + 1013904223;
+	return refState >> 8;
+}
+
+
+/**
+ * Creates a receive packet (frame type 0x90) as sent by the interaction devices.
+ */
+static Bytes createReceivePacket(uint32_t& refRandom)
+{
+	Bytes payload;
+	payload.push_back(0x90);
+	for (int nIdx = 0; nIdx < 8; nIdx++) payload.push_back((uint8_t) nextRandom(refRandom)); // 64 bit address
+	payload.push_back((uint8_t) nextRandom(refRandom)); // 16 bit address
+	payload.push_back((uint8_t) nextRandom(refRandom));
+	payload.push_back(0x01); // options
+	size_t dataLength = 1 + nextRandom(refRandom) % 80;
+	for (size_t nIdx = 0; nIdx < dataLength; nIdx++) payload.push_back((uint8_t) nextRandom(refRandom));
+	return createFrame(payload);
+}
+
+
+/**
+ * Creates a stream of receive packets and AT command responses as recorded from a coordinator.
+ */
+static std::vector<Bytes> createRecordedFrames(size_t count)
+{
+	std::vector<Bytes> frames;
+	uint32_t random = 1234;
+	for (size_t nIdx = 0; nIdx < count; nIdx++)
+	{
+		if (nIdx % 50 == 0)
+		{
+			const uint8_t arrResponse[] = { 0x88, (uint8_t) nIdx, 'N', 'D', 0x00 }; // AT command response
+			frames.push_back(createFrame(Bytes(arrResponse, arrResponse + sizeof(arrResponse))));
+		}
+		else
+		{
+			frames.push_back(createReceivePacket(random));
+		}
+	}
+	return frames;
+}
+
+
+static void append(Bytes& refStream, const Bytes& refData)
+{
+	refStream.insert(refStream.end(), refData.begin(), refData.end());
+}
+
+
+static Bytes toBytes(const XBeeReadBuffer& refFrame)
+{
+	const uint8_t* pData = (const uint8_t*) refFrame.data();
+	return Bytes(pData, pData + refFrame.size());
+}
+
+
+/**
+ * Feeds a stream into the decoder in chunks of varying size, like the serial port delivers it,
+ * and collects the extracted frames.
+ */
+static std::vector<Bytes> decodeStream(XBeeFrameDecoder& refDecoder, const Bytes& refStream, size_t maxChunk, bool useWriteBuffer)
+{
+	std::vector<Bytes> frames;
+	XBeeReadBuffer     frame;
+	uint32_t           random = 42;
+	size_t             pos    = 0;
+	while (pos < refStream.size())
+	{
+		size_t chunk = 1 + nextRandom(random) % maxChunk;
+		if (chunk > refStream.size() - pos) chunk = refStream.size() - pos;
+
+		if (useWriteBuffer)
+		{
+			size_t   space;
+			uint8_t* pWrite = refDecoder.getWriteBuffer(space);
+			if (chunk > space) chunk = space;
+			if (chunk > 0)
+			{
+				memcpy(pWrite, refStream.data() + pos, chunk);
+				refDecoder.commit(chunk);
+			}
+		}
+		else
+		{
+			chunk = refDecoder.addData(refStream.data() + pos, chunk);
+		}
+		pos += chunk;
+
+		while (refDecoder.nextFrame(frame))
+		{
+			frames.push_back(toBytes(frame));
+		}
+	}
+	return frames;
+}
+
+
+/**
+ * Frames split across any number of reads are reassembled, also when wrapping around the ring buffer.
+ */
+static void testSplitFrames()
+{
+	std::vector<Bytes> frames = createRecordedFrames(200);
+	Bytes stream;
+	for (const Bytes& frame : frames) append(stream, frame);
+
+	const size_t arrChunkSizes[] = { 1, 2, 3, 7, 64, 1000 };
+	for (size_t maxChunk : arrChunkSizes)
+	{
+		XBeeFrameDecoder decoder(128); // smaller than the stream > wraps around many times
+		TEST_CHECK(decodeStream(decoder, stream, maxChunk, (maxChunk % 2) == 1) == frames);
+		TEST_CHECK(decoder.getSkippedBytes() == 0);
+		TEST_CHECK(decoder.getRejectedFrames() == 0);
+		TEST_CHECK(decoder.getAvailable() == 0);
+	}
+
+	// an incomplete frame is kept until the rest arrives
+	XBeeFrameDecoder decoder;
+	XBeeReadBuffer   frame;
+	decoder.addData(frames[1].data(), frames[1].size() - 1);
+	TEST_CHECK(!decoder.nextFrame(frame));
+	TEST_CHECK(decoder.getAvailable() == frames[1].size() - 1);
+	decoder.addData(frames[1].data() + frames[1].size() - 1, 1);
+	TEST_REQUIRE(decoder.nextFrame(frame));
+	TEST_CHECK(toBytes(frame) == frames[1]);
+	TEST_CHECK(frame.calculateChecksum() == 0xFF);
+}
+
+
+/**
+ * Frames with a wrong checksum are rejected, the surrounding frames are still extracted.
+ */
+static void testBadChecksum()
+{
+	std::vector<Bytes> frames = createRecordedFrames(3);
+	Bytes corrupted = frames[1];
+	corrupted.back() ^= 0x01;
+
+	Bytes stream;
+	append(stream, frames[0]);
+	append(stream, corrupted);
+	append(stream, frames[2]);
+
+	XBeeFrameDecoder decoder;
+	std::vector<Bytes> decoded = decodeStream(decoder, stream, 5, false);
+	TEST_REQUIRE(decoded.size() == 2);
+	TEST_CHECK(decoded[0] == frames[0]);
+	TEST_CHECK(decoded[1] == frames[2]);
+	TEST_CHECK(decoder.getRejectedFrames() >= 1);
+	TEST_CHECK(decoder.getSkippedBytes() == corrupted.size());
+}
+
+
+/**
+ * After noise, including false start delimiters with impossible or plausible lengths,
+ * the decoder finds the next real frame.
+ */
+static void testResyncAfterGarbage()
+{
+	std::vector<Bytes> frames = createRecordedFrames(4);
+	const uint8_t arrGarbage[] =
+	{
+		0x00, 0xFF, 0x13, 0x11,
+		XBeePacket::START_DELIMITER, 0x00, 0x00,        // zero length
+		XBeePacket::START_DELIMITER, 0xFF, 0xFF,        // longer than the buffer
+		XBeePacket::START_DELIMITER, 0x00, 0x30, 0x55   // plausible length reaching into the next frame
+	};
+
+	Bytes stream;
+	append(stream, frames[0]);
+	append(stream, Bytes(arrGarbage, arrGarbage + sizeof(arrGarbage)));
+	append(stream, frames[1]);
+	append(stream, Bytes(arrGarbage, arrGarbage + 4));
+	append(stream, frames[2]);
+	append(stream, frames[3]);
+
+	const size_t arrChunkSizes[] = { 1, 4, 100 };
+	for (size_t maxChunk : arrChunkSizes)
+	{
+		XBeeFrameDecoder decoder(256);
+		TEST_CHECK(decodeStream(decoder, stream, maxChunk, true) == frames);
+		TEST_CHECK(decoder.getSkippedBytes() == sizeof(arrGarbage) + 4);
+		TEST_CHECK(decoder.getRejectedFrames() == 3);
+	}
+}
+
+
+/**
+ * A false start delimiter whose length fits into the buffer but not into any XBee API frame
+ * is skipped right away instead of holding back the frames behind it.
+ */
+static void testImplausibleLength()
+{
+	std::vector<Bytes> frames = createRecordedFrames(4);
+	const uint8_t arrGarbage[] = { XBeePacket::START_DELIMITER, 0x03, 0xF0 }; // 1008 bytes
+
+	Bytes stream;
+	append(stream, frames[0]);
+	append(stream, Bytes(arrGarbage, arrGarbage + sizeof(arrGarbage)));
+	for (size_t fIdx = 1; fIdx < frames.size(); fIdx++)
+	{
+		append(stream, frames[fIdx]);
+	}
+
+	XBeeFrameDecoder decoder; // default capacity: the length alone would fit
+	TEST_CHECK(decodeStream(decoder, stream, stream.size(), true) == frames);
+	TEST_CHECK(decoder.getSkippedBytes() == sizeof(arrGarbage));
+	TEST_CHECK(decoder.getRejectedFrames() == 1);
+}
+
+
+/**
+ * The decoder expects API mode 1 (AP=1): bytes that API mode 2 would escape (0x7E, 0x7D, 0x11, 0x13)
+ * are passed through unchanged in the length, the payload, and the checksum.
+ */
+static void testEscapedBytes()
+{
+	Bytes payload;
+	payload.push_back(0x90);
+	const uint8_t arrSpecial[] = { 0x7E, 0x7D, 0x11, 0x13, 0x7D, 0x5E, 0x7E, 0x00 };
+	while (payload.size() < 0x7E) // length byte 0x7E
+	{
+		payload.push_back(arrSpecial[payload.size() % sizeof(arrSpecial)]);
+	}
+	Bytes frame = createFrame(payload);
+	TEST_REQUIRE(frame[2] == 0x7E);
+
+	// make the checksum a delimiter as well
+	uint8_t adjust = frame.back() - 0x7E;
+	payload[1] += adjust;
+	frame = createFrame(payload);
+	TEST_REQUIRE(frame.back() == 0x7E);
+
+	std::vector<Bytes> frames;
+	frames.push_back(frame);
+	frames.push_back(createFrame(Bytes(arrSpecial, arrSpecial + sizeof(arrSpecial))));
+	frames.push_back(frame);
+
+	Bytes stream;
+	for (const Bytes& f : frames) append(stream, f);
+
+	XBeeFrameDecoder decoder(256);
+	TEST_CHECK(decodeStream(decoder, stream, 3, true) == frames);
+	TEST_CHECK(decoder.getSkippedBytes() == 0);
+}
+
+
+/**
+ * A long recorded stream is decoded completely, in whatever chunks it arrives.
+ */
+static void testRecordedStream()
+{
+	std::vector<Bytes> frames = createRecordedFrames(5000);
+	Bytes stream;
+	for (const Bytes& frame : frames) append(stream, frame);
+
+	XBeeFrameDecoder decoder(1024);
+	TEST_CHECK(decodeStream(decoder, stream, 300, true) == frames);
+	TEST_CHECK(decoder.getSkippedBytes() == 0);
+	TEST_CHECK(decoder.getRejectedFrames() == 0);
+}
+
+
+/**
+ * In a recorded stream with corrupted bytes, lost delimiters, and inserted noise
+ * the intact frames are still extracted in order and the damaged ones are dropped.
+ */
+static void testCorruptedStream()
+{
+	std::vector<Bytes> frames = createRecordedFrames(5000);
+	std::vector<Bytes> intact;
+	Bytes              stream;
+	uint32_t           random = 99;
+	for (const Bytes& refFrame : frames)
+	{
+		Bytes frame = refFrame;
+		switch (nextRandom(random) % 20)
+		{
+			case 0: // flipped payload or checksum byte
+				frame[3 + nextRandom(random) % (frame.size() - 3)] ^= (uint8_t) (1 + nextRandom(random) % 255);
+				break;
+
+			case 1: // lost delimiter
+				frame[0] = 0x00;
+				break;
+
+			case 2: // noise before the frame
+				for (int nIdx = 0; nIdx < 5; nIdx++) stream.push_back((uint8_t) (nextRandom(random) & 0x7D));
+				intact.push_back(frame);
+				break;
+
+			default:
+				intact.push_back(frame);
+				break;
+		}
+		append(stream, frame);
+	}
+	TEST_REQUIRE(intact.size() < frames.size());
+
+	XBeeFrameDecoder   decoder(1024);
+	std::vector<Bytes> decoded = decodeStream(decoder, stream, 300, true);
+	TEST_CHECK(decoded == intact);
+	TEST_CHECK(decoder.getRejectedFrames() > 0);
+	TEST_CHECK(decoder.getSkippedBytes() > 0);
+
+	// everything that was extracted is a valid frame
+	for (const Bytes& refFrame : decoded)
+	{
+		uint8_t sum = 0;
+		for (size_t nIdx = 3; nIdx < refFrame.size(); nIdx++) sum += refFrame[nIdx];
+		TEST_CHECK(sum == 0xFF);
+	}
+}
+
+
+/**
+ * Removing the buffered data starts over with the next received byte.
+ */
+static void testReset()
+{
+	std::vector<Bytes> frames = createRecordedFrames(2);
+	XBeeFrameDecoder decoder;
+	XBeeReadBuffer   frame;
+	decoder.addData(frames[0].data(), 5);
+	decoder.reset();
+	TEST_CHECK(decoder.getAvailable() == 0);
+	decoder.addData(frames[1].data(), frames[1].size());
+	TEST_REQUIRE(decoder.nextFrame(frame));
+	TEST_CHECK(toBytes(frame) == frames[1]);
+}
+
+
+int main()
+{
+	TEST_RUN(testSplitFrames);
+	TEST_RUN(testBadChecksum);
+	TEST_RUN(testResyncAfterGarbage);
+	TEST_RUN(testImplausibleLength);
+	TEST_RUN(testEscapedBytes);
+	TEST_RUN(testRecordedStream);
+	TEST_RUN(testCorruptedStream);
+	TEST_RUN(testReset);
+	return testResult();
+}
@@ -0,0 +1,100 @@
+/**
+ * Stand-in for the NatNet server of the NatNet SDK, used by the sender tests instead of the SDK header.
+ * SendPacket() delivers each packet to a number of simulated clients by copying it into their receive buffers,
+ * and optionally takes a fixed time per client, like a server that sends to many unicast clients.
+ * Only the functions the tested classes use are provided.
+ */
+
+#pragma once
+
+#include "NatNetTypes.h"
+
+#include <chrono>
+#include <mutex>
+#include <string.h>
+#include <vector>
+
+
+class NatNetServer
+{
+public:
+
+	/**
+	 * Creates a server stand-in.
+	 *
+	 * @param clientCount  the amount of clients each packet is delivered to
+	 * @param sendTime     the time each delivery to a client takes
+	 */
+	NatNetServer(int clientCount = 1, std::chrono::microseconds sendTime = std::chrono::microseconds(0)) :
+		m_clientBuffers(clientCount > 0 ? clientCount : 1),
+		m_sendTime(sendTime),
+		m_sendCalls(0),
+		m_deliveries(0)
+	{
+		for (auto& refBuffer : m_clientBuffers)
+		{
+			refBuffer.resize(sizeof(sPacket));
+		}
+	}
+
+	int SendPacket(sPacket* pPacket)
+	{
+		size_t size = sizeof(sPacket) - sizeof(pPacket->Data) + pPacket->nDataBytes;
+		for (auto& refBuffer : m_clientBuffers)
+		{
+			// busy waiting, sleeping is too coarse for times per client
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + m_sendTime;
+			memcpy(refBuffer.data(), pPacket, size);
+			while (std::chrono::steady_clock::now() < end) { }
+		}
+
+		std::lock_guard<std::mutex> lock(m_mtxSent);
+		m_sendCalls++;
+		m_deliveries += m_clientBuffers.size();
+		m_sentPackets.push_back(std::vector<unsigned char>((unsigned char*) pPacket, ((unsigned char*) pPacket) + size));
+		return ErrorCode_OK;
+	}
+
+	/**
+	 * Gets copies of all packets sent so far (header and data, as far as used).
+	 *
+	 * @return the sent packets
+	 */
+	std::vector<std::vector<unsigned char>> getSentPackets()
+	{
+		std::lock_guard<std::mutex> lock(m_mtxSent);
+		return m_sentPackets;
+	}
+
+	/**
+	 * Gets the amount of SendPacket() calls.
+	 *
+	 * @return the amount of calls
+	 */
+	size_t getSendCalls()
+	{
+		std::lock_guard<std::mutex> lock(m_mtxSent);
+		return m_sendCalls;
+	}
+
+	/**
+	 * Gets the amount of packets delivered to all clients together.
+	 *
+	 * @return the amount of deliveries
+	 */
+	size_t getDeliveries()
+	{
+		std::lock_guard<std::mutex> lock(m_mtxSent);
+		return m_deliveries;
+	}
+
+private:
+
+	std::vector<std::vector<unsigned char>> m_clientBuffers;
+	std::chrono::microseconds               m_sendTime;
+
+	std::mutex                              m_mtxSent;
+	std::vector<std::vector<unsigned char>> m_sentPackets;
+	size_t                                  m_sendCalls;
+	size_t                                  m_deliveries;
+};